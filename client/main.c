@@ -64,6 +64,8 @@ Some examples: \n\n\
   >> myqtt-client --host localhost --port 1883 --client-id aspl --username aspl --password test1234 --subscribe \"0,myqtt/this/is a test\"\n\n\
 - Get messages: (note this operations blocks and prints all messages received due to subscriptions)\n\
   >> myqtt-client --host localhost --port 1883 --client-id aspl --username aspl --password test1234 --get-msgs\n\n\
+- Benchmark: (4 publishers and 2 subscribers during 30 seconds using QoS 0 and 1)\n\
+  >> myqtt-client --host localhost --port 1883 --bench --bench-publishers 4 --bench-subscribers 2 --bench-qos 0,1 --bench-duration 30\n\n\
 "
 
 
@@ -106,17 +108,12 @@ void  _msg   (MyQttCtx * ctx, const char * file, int line, const char * format,
 	return;
 }
 
-MyQttConn * make_connection (void)
+MyQttConn * make_connection_aux (const char * client_id, axl_bool clean_session, axl_bool exit_on_failure)
 {
 
 	MyQttConn     * conn;
 	const char    * proto = "mqtt";
 	MyQttConnOpts * opts;
-	axl_bool        clean_session = axl_false;
-
-	/* check if clean session is registered */
-	if (exarg_is_defined ("clean-session"))
-		clean_session = axl_true;
 
 	/* get proto if defined */
 	if (exarg_is_defined ("proto") && exarg_get_string ("proto"))
@@ -133,13 +130,13 @@ MyQttConn * make_connection (void)
 
 	/* create connection */
 	if (axl_cmp (proto, "mqtt"))
-		conn = myqtt_conn_new (ctx, exarg_get_string ("client-id"), clean_session, 30, exarg_get_string ("host"), exarg_get_string ("port"), opts, NULL, NULL);
+		conn = myqtt_conn_new (ctx, client_id, clean_session, 30, exarg_get_string ("host"), exarg_get_string ("port"), opts, NULL, NULL);
 #if defined(ENABLE_TLS_SUPPORT)
 	else if (axl_cmp (proto, "mqtt-tls")) {
 		myqtt_tls_opts_ssl_peer_verify (opts, axl_false);
 
 		/* create connection */
-		conn = myqtt_tls_conn_new (ctx, exarg_get_string ("client-id"), clean_session, 30, exarg_get_string ("host"), exarg_get_string ("port"), opts, NULL, NULL);
+		conn = myqtt_tls_conn_new (ctx, client_id, clean_session, 30, exarg_get_string ("host"), exarg_get_string ("port"), opts, NULL, NULL);
 #endif
 	} else {
 		printf ("ERROR: protocol not supported (%s), unable to connect to %s:%s\n", 
@@ -151,7 +148,12 @@ MyQttConn * make_connection (void)
 	if (! myqtt_conn_is_ok (conn, axl_false)) {
 		printf ("ERROR: unable to connect to %s:%s (error = %d : %s)..\n", exarg_get_string ("host"), exarg_get_string ("port"), 
 			myqtt_conn_get_last_err (conn), myqtt_conn_get_code_to_err (myqtt_conn_get_last_err (conn)));
-		exit (-1);
+		if (exit_on_failure)
+			exit (-1);
+
+		/* release connection and report failure */
+		myqtt_conn_close (conn);
+		return NULL;
 	} /* end if */
 
 	/* report connection created */
@@ -159,6 +161,17 @@ MyQttConn * make_connection (void)
 	return conn;
 }
 
+MyQttConn * make_connection (void)
+{
+	axl_bool        clean_session = axl_false;
+
+	/* check if clean session is registered */
+	if (exarg_is_defined ("clean-session"))
+		clean_session = axl_true;
+
+	return make_connection_aux (exarg_get_string ("client-id"), clean_session, axl_true);
+}
+
 
 /** 
  * @internal Init for all exarg functions provided by the myqttd
@@ -222,6 +235,28 @@ int  main_init_exarg (int argc, char ** argv)
 	exarg_install_arg ("ping", "g", EXARG_NONE,
 			   "Allows to send a ping message to the server.");
 
+	/* benchmark options */
+	exarg_install_arg ("bench", "b", EXARG_NONE,
+			   "Run a load generator against the server, reporting throughput, end-to-end latency percentiles and error counts. See --bench-* options.");
+	exarg_install_arg ("bench-publishers", NULL, EXARG_STRING,
+			   "Number of publisher connections used by --bench (1 by default).");
+	exarg_install_arg ("bench-subscribers", NULL, EXARG_STRING,
+			   "Number of subscriber connections used by --bench (1 by default).");
+	exarg_install_arg ("bench-topic", NULL, EXARG_STRING,
+			   "Topic used by --bench publishers. First %d found is replaced by the publisher number (myqtt/bench/%d by default).");
+	exarg_install_arg ("bench-sub-topic", NULL, EXARG_STRING,
+			   "Topic filter subscribed by --bench subscribers (myqtt/bench/# by default).");
+	exarg_install_arg ("bench-payload", NULL, EXARG_STRING,
+			   "Payload size in bytes used by --bench (64 by default, 16 minimum).");
+	exarg_install_arg ("bench-qos", NULL, EXARG_STRING,
+			   "QoS mix used by --bench publishers in turns, for example 0,1,2 (0 by default).");
+	exarg_install_arg ("bench-rate", NULL, EXARG_STRING,
+			   "Target rate in msgs/sec for each --bench publisher (0 by default: as fast as possible).");
+	exarg_install_arg ("bench-duration", NULL, EXARG_STRING,
+			   "How long --bench publishers run, in seconds (10 by default).");
+	exarg_install_arg ("bench-report", NULL, EXARG_STRING,
+			   "Report format for --bench: text (default) or json.");
+
 	/* call to parse arguments */
 	exarg_parse (argc, argv);
 
@@ -568,6 +603,418 @@ void client_handle_topic_match (int argc, char ** argv)
 	return;
 }
 
+/* minimum payload size: send stamp (8 bytes) + publisher (4 bytes) + sequence (4 bytes) */
+#define BENCH_HEADER_SIZE 16
+
+typedef struct _BenchPublisher {
+	int               index;
+	MyQttConn       * conn;
+	char            * topic;
+	MyQttThread       thread;
+	long              sent;
+	long              errors;
+	long              bytes;
+	long long         finished;
+} BenchPublisher;
+
+typedef struct _BenchState {
+	MyQttMutex        mutex;
+	int               payload_size;
+	int               qos_mix[16];
+	int               qos_mix_count;
+	int               rate;
+	int               wait_publish;
+	long long         deadline;
+
+	/* reception stats */
+	long              received;
+	long              recv_bytes;
+	long              recv_errors;
+	long long         recv_last;
+	long            * latencies;
+	long              latencies_count;
+	long              latencies_size;
+} BenchState;
+
+BenchState bench;
+
+long long bench_now (void)
+{
+	struct timeval stamp;
+
+	gettimeofday (&stamp, NULL);
+	return ((long long) stamp.tv_sec * 1000000) + stamp.tv_usec;
+}
+
+int bench_get_int (char * option, int default_value)
+{
+	if (exarg_is_defined (option))
+		return myqtt_support_strtod (exarg_get_string (option), NULL);
+	return default_value;
+}
+
+const char * bench_get_string (char * option, const char * default_value)
+{
+	if (exarg_is_defined (option) && exarg_get_string (option))
+		return exarg_get_string (option);
+	return default_value;
+}
+
+/** 
+ * @internal Builds the topic used by the provided publisher,
+ * replacing the first %d found in the pattern by the publisher index.
+ */
+char * bench_topic (const char * pattern, int index)
+{
+	const char * mark = strstr (pattern, "%d");
+	char       * prefix;
+	char       * result;
+
+	if (mark == NULL)
+		return axl_strdup (pattern);
+
+	prefix = axl_new (char, (mark - pattern) + 1);
+	memcpy (prefix, pattern, mark - pattern);
+	result = axl_strdup_printf ("%s%d%s", prefix, index, mark + 2);
+	axl_free (prefix);
+	return result;
+}
+
+void bench_on_msg (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg, axlPointer user_data)
+{
+	long long   now   = bench_now ();
+	long long   stamp;
+	int         size  = myqtt_msg_get_app_msg_size (msg);
+	long      * temp;
+
+	myqtt_mutex_lock (&bench.mutex);
+	if (size < BENCH_HEADER_SIZE) {
+		/* not a benchmark message */
+		bench.recv_errors++;
+		myqtt_mutex_unlock (&bench.mutex);
+		return;
+	} /* end if */
+
+	/* get send stamp embedded by the publisher */
+	memcpy (&stamp, myqtt_msg_get_app_msg (msg), sizeof (stamp));
+
+	bench.received++;
+	bench.recv_bytes += size;
+	bench.recv_last   = now;
+
+	/* record latency */
+	if (bench.latencies_count == bench.latencies_size) {
+		temp = axl_realloc (bench.latencies, sizeof (long) * (bench.latencies_size * 2 + 1024));
+		if (temp == NULL) {
+			bench.recv_errors++;
+			myqtt_mutex_unlock (&bench.mutex);
+			return;
+		} /* end if */
+		bench.latencies      = temp;
+		bench.latencies_size = bench.latencies_size * 2 + 1024;
+	} /* end if */
+	bench.latencies[bench.latencies_count] = (long) (now - stamp);
+	bench.latencies_count++;
+	myqtt_mutex_unlock (&bench.mutex);
+
+	return;
+}
+
+axlPointer bench_publisher (BenchPublisher * pub)
+{
+	unsigned char * payload  = axl_new (unsigned char, bench.payload_size);
+	long long       next     = bench_now ();
+	long long       stamp;
+	int             interval = bench.rate > 0 ? 1000000 / bench.rate : 0;
+	int             seq      = 0;
+	int             qos;
+
+	if (payload == NULL) {
+		pub->errors++;
+		pub->finished = bench_now ();
+		return NULL;
+	} /* end if */
+	memset (payload, 'x', bench.payload_size);
+
+	while (bench_now () < bench.deadline) {
+		/* honour rate target (msgs/sec per publisher) */
+		if (interval > 0) {
+			stamp = bench_now ();
+			if (next > stamp)
+				myqtt_sleep (next - stamp);
+			next += interval;
+		} /* end if */
+
+		/* check connection status */
+		if (! myqtt_conn_is_ok (pub->conn, axl_false)) {
+			pub->errors++;
+			break;
+		} /* end if */
+
+		/* get qos to use for this message */
+		qos   = bench.qos_mix[seq % bench.qos_mix_count];
+
+		/* embed header: send stamp, publisher and sequence */
+		stamp = bench_now ();
+		memcpy (payload, &stamp, sizeof (stamp));
+		memcpy (payload + 8, &pub->index, sizeof (int));
+		memcpy (payload + 12, &seq, sizeof (int));
+
+		if (myqtt_conn_pub (pub->conn, pub->topic, payload, bench.payload_size, qos, axl_false, qos == MYQTT_QOS_0 ? 0 : bench.wait_publish)) {
+			pub->sent++;
+			pub->bytes += bench.payload_size;
+		} else
+			pub->errors++;
+
+		seq++;
+	} /* end while */
+
+	pub->finished = bench_now ();
+	axl_free (payload);
+	return NULL;
+}
+
+int bench_latency_cmp (const void * a, const void * b)
+{
+	long la = *((const long *) a);
+	long lb = *((const long *) b);
+
+	return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+long bench_percentile (double percentile)
+{
+	if (bench.latencies_count == 0)
+		return 0;
+	return bench.latencies[(long) ((bench.latencies_count - 1) * percentile)];
+}
+
+void client_handle_bench (int argc, char ** argv)
+{
+	int               publishers   = bench_get_int ("bench-publishers", 1);
+	int               subscribers  = bench_get_int ("bench-subscribers", 1);
+	int               duration     = bench_get_int ("bench-duration", 10);
+	const char      * topic        = bench_get_string ("bench-topic", "myqtt/bench/%d");
+	const char      * sub_topic    = bench_get_string ("bench-sub-topic", "myqtt/bench/#");
+	const char      * qos_mix      = bench_get_string ("bench-qos", "0");
+	const char      * report       = bench_get_string ("bench-report", "text");
+	const char      * client_id    = bench_get_string ("client-id", "myqtt-bench");
+	BenchPublisher  * pubs;
+	MyQttConn      ** subs;
+	char            * id;
+	int               iterator;
+	int               sub_qos      = MYQTT_QOS_0;
+	int               sub_result   = 0;
+	int               conn_errors  = 0;
+	long long         started;
+	long long         finished;
+	long              last_received;
+	int               idle;
+	double            elapsed;
+	double            recv_elapsed;
+	long              sent         = 0;
+	long              sent_bytes   = 0;
+	long              pub_errors   = 0;
+	long long         latency_sum  = 0;
+	long              total;
+
+	memset (&bench, 0, sizeof (BenchState));
+	bench.payload_size = bench_get_int ("bench-payload", 64);
+	bench.rate         = bench_get_int ("bench-rate", 0);
+	bench.wait_publish = bench_get_int ("wait", 10);
+
+	if (publishers < 1 || subscribers < 0 || duration < 1) {
+		printf ("ERROR: wrong benchmark configuration: publishers must be > 0, subscribers >= 0 and duration > 0\n");
+		exit (-1);
+	} /* end if */
+	if (bench.payload_size < BENCH_HEADER_SIZE)
+		bench.payload_size = BENCH_HEADER_SIZE;
+
+	/* parse qos mix (e.g. 0,1,2): messages are sent using them in turns */
+	iterator = 0;
+	while (qos_mix[iterator]) {
+		if (qos_mix[iterator] >= '0' && qos_mix[iterator] <= '2' && bench.qos_mix_count < 16) {
+			bench.qos_mix[bench.qos_mix_count] = qos_mix[iterator] - '0';
+			if (bench.qos_mix[bench.qos_mix_count] > sub_qos)
+				sub_qos = bench.qos_mix[bench.qos_mix_count];
+			bench.qos_mix_count++;
+		} else if (qos_mix[iterator] != ',') {
+			printf ("ERROR: wrong QoS mix found (%s), expected something like 0,1,2\n", qos_mix);
+			exit (-1);
+		} /* end if */
+		iterator++;
+	} /* end while */
+	if (bench.qos_mix_count == 0) {
+		printf ("ERROR: no QoS found in QoS mix provided (%s), expected something like 0,1,2\n", qos_mix);
+		exit (-1);
+	} /* end if */
+
+	if (! axl_cmp (report, "text") && ! axl_cmp (report, "json")) {
+		printf ("ERROR: unsupported report format (%s), use text or json\n", report);
+		exit (-1);
+	} /* end if */
+
+	myqtt_mutex_create (&bench.mutex);
+	pubs = axl_new (BenchPublisher, publishers);
+	subs = axl_new (MyQttConn *, subscribers + 1);
+
+	/* create subscribers first so all messages are received */
+	iterator = 0;
+	while (iterator < subscribers) {
+		id   = axl_strdup_printf ("%s-sub-%d", client_id, iterator);
+		subs[iterator] = make_connection_aux (id, axl_true, axl_false);
+		axl_free (id);
+
+		if (subs[iterator] == NULL) {
+			conn_errors++;
+			iterator++;
+			continue;
+		} /* end if */
+
+		myqtt_conn_set_on_msg (subs[iterator], bench_on_msg, NULL);
+		if (! myqtt_conn_sub (subs[iterator], bench.wait_publish, sub_topic, sub_qos, &sub_result)) {
+			printf ("ERROR: unable to subscribe to %s (subscriber %d)..\n", sub_topic, iterator);
+			conn_errors++;
+			myqtt_conn_close (subs[iterator]);
+			subs[iterator] = NULL;
+		} /* end if */
+
+		iterator++;
+	} /* end while */
+
+	/* create publishers */
+	iterator = 0;
+	while (iterator < publishers) {
+		id   = axl_strdup_printf ("%s-pub-%d", client_id, iterator);
+		pubs[iterator].index = iterator;
+		pubs[iterator].topic = bench_topic (topic, iterator);
+		pubs[iterator].conn  = make_connection_aux (id, axl_true, axl_false);
+		axl_free (id);
+
+		if (pubs[iterator].conn == NULL)
+			conn_errors++;
+		iterator++;
+	} /* end while */
+
+	msg ("starting benchmark: %d publishers, %d subscribers, duration %d secs", publishers, subscribers, duration);
+
+	/* start publishers */
+	started        = bench_now ();
+	bench.deadline = started + ((long long) duration * 1000000);
+	iterator = 0;
+	while (iterator < publishers) {
+		if (pubs[iterator].conn && ! myqtt_thread_create (&pubs[iterator].thread, (MyQttThreadFunc) bench_publisher, &pubs[iterator], MYQTT_THREAD_CONF_END)) {
+			printf ("ERROR: unable to start publisher thread %d..\n", iterator);
+			myqtt_conn_close (pubs[iterator].conn);
+			pubs[iterator].conn = NULL;
+			conn_errors++;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* wait for publishers to finish */
+	finished = started;
+	iterator = 0;
+	while (iterator < publishers) {
+		if (pubs[iterator].conn) {
+			myqtt_thread_destroy (&pubs[iterator].thread, axl_false);
+			if (pubs[iterator].finished > finished)
+				finished = pubs[iterator].finished;
+			sent       += pubs[iterator].sent;
+			sent_bytes += pubs[iterator].bytes;
+			pub_errors += pubs[iterator].errors;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* wait for in-flight messages: stop after 1 sec without
+	 * receiving or after wait seconds */
+	idle          = 0;
+	last_received = -1;
+	iterator      = 0;
+	while (subscribers > 0 && idle < 10 && iterator < (bench.wait_publish * 10)) {
+		myqtt_sleep (100000);
+		myqtt_mutex_lock (&bench.mutex);
+		if (bench.received == last_received)
+			idle++;
+		else
+			idle = 0;
+		last_received = bench.received;
+		myqtt_mutex_unlock (&bench.mutex);
+		iterator++;
+	} /* end while */
+
+	/* close all connections */
+	iterator = 0;
+	while (iterator < publishers) {
+		if (pubs[iterator].conn)
+			myqtt_conn_close (pubs[iterator].conn);
+		axl_free (pubs[iterator].topic);
+		iterator++;
+	} /* end while */
+	iterator = 0;
+	while (iterator < subscribers) {
+		if (subs[iterator])
+			myqtt_conn_close (subs[iterator]);
+		iterator++;
+	} /* end while */
+	axl_free (pubs);
+	axl_free (subs);
+
+	/* compute latency stats */
+	myqtt_mutex_lock (&bench.mutex);
+	qsort (bench.latencies, bench.latencies_count, sizeof (long), bench_latency_cmp);
+	iterator = 0;
+	total    = bench.latencies_count;
+	while (iterator < total) {
+		latency_sum += bench.latencies[iterator];
+		iterator++;
+	} /* end while */
+	elapsed = (double) (finished - started) / 1000000;
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	/* reception rates are measured until the last message
+	 * received (in-flight messages arrive after publishers
+	 * finish) */
+	recv_elapsed = bench.received > 0 ? (double) (bench.recv_last - started) / 1000000 : elapsed;
+	if (recv_elapsed <= 0)
+		recv_elapsed = elapsed;
+
+	if (axl_cmp (report, "json")) {
+		printf ("{\"duration\": %.3f, \"publishers\": %d, \"subscribers\": %d, \"conn_errors\": %d, \"payload_size\": %d, \"qos\": \"%s\", \"rate\": %d,\n",
+			elapsed, publishers, subscribers, conn_errors, bench.payload_size, qos_mix, bench.rate);
+		printf (" \"published\": %ld, \"pub_errors\": %ld, \"pub_msgs_sec\": %.2f, \"pub_bytes_sec\": %.2f,\n",
+			sent, pub_errors, sent / elapsed, sent_bytes / elapsed);
+		printf (" \"received\": %ld, \"recv_errors\": %ld, \"recv_duration\": %.3f, \"recv_msgs_sec\": %.2f, \"recv_bytes_sec\": %.2f,\n",
+			bench.received, bench.recv_errors, recv_elapsed, bench.received / recv_elapsed, bench.recv_bytes / recv_elapsed);
+		printf (" \"latency_usecs\": {\"min\": %ld, \"avg\": %ld, \"p50\": %ld, \"p90\": %ld, \"p99\": %ld, \"p999\": %ld, \"max\": %ld}}\n",
+			bench_percentile (0), total ? (long) (latency_sum / total) : 0, bench_percentile (0.5), bench_percentile (0.9),
+			bench_percentile (0.99), bench_percentile (0.999), bench_percentile (1));
+	} else {
+		printf ("MyQtt benchmark report\n");
+		printf ("  duration:        %.3f secs\n", elapsed);
+		printf ("  connections:     %d publishers, %d subscribers, %d errors\n", publishers, subscribers, conn_errors);
+		printf ("  payload:         %d bytes, qos mix %s, rate %d msgs/sec per publisher (0 = unlimited)\n", bench.payload_size, qos_mix, bench.rate);
+		printf ("  published:       %ld msgs, %ld errors, %.2f msgs/sec, %.2f bytes/sec\n", sent, pub_errors, sent / elapsed, sent_bytes / elapsed);
+		printf ("  received:        %ld msgs, %ld errors, %.2f msgs/sec, %.2f bytes/sec (%.3f secs)\n", bench.received, bench.recv_errors, 
+			bench.received / recv_elapsed, bench.recv_bytes / recv_elapsed, recv_elapsed);
+		printf ("  latency (usecs): min %ld, avg %ld, p50 %ld, p90 %ld, p99 %ld, p99.9 %ld, max %ld\n",
+			bench_percentile (0), total ? (long) (latency_sum / total) : 0, bench_percentile (0.5), bench_percentile (0.9),
+			bench_percentile (0.99), bench_percentile (0.999), bench_percentile (1));
+	} /* end if */
+	myqtt_mutex_unlock (&bench.mutex);
+
+	axl_free (bench.latencies);
+	myqtt_mutex_destroy (&bench.mutex);
+
+	/* report failure if something went wrong */
+	if (conn_errors > 0 || pub_errors > 0 || bench.recv_errors > 0)
+		exit (-1);
+
+	return;
+}
+
 int main (int argc, char ** argv)
 {
 	/*** init exarg library ***/
@@ -594,6 +1041,8 @@ int main (int argc, char ** argv)
 		client_handle_topic_match (argc, argv);
 	else if (exarg_is_defined ("ping"))
 		client_handle_ping (argc, argv);
+	else if (exarg_is_defined ("bench"))
+		client_handle_bench (argc, argv);
 	else {
 		printf ("ERROR: no operation defined, please run %s --help to get information\n", argv[0]);
 		exit (-1);
@@ -234,6 +234,19 @@ struct _MyQttConn {
 	 */
 	MyQttSend    send;
 
+	/** 
+	 * @internal Optional token aware writer (see
+	 * MyQttSendToken). When defined, it is used by
+	 * myqtt_msg_send_raw and the sequencer instead of send.
+	 */
+	MyQttSendToken send_token;
+
+	/** 
+	 * @internal Last token handed by
+	 * __myqtt_conn_next_send_token (guarded by op_mutex).
+	 */
+	int          send_tokens;
+
 	/** 
 	 * @brief Writer function used by the MyQtt Library to actually received data
 	 */
@@ -349,6 +362,14 @@ struct _MyQttConn {
 	 */
 	int                         sequencer_messages;
 
+	/** 
+	 * @internal Signals the sequencer to hand each message
+	 * entirely to the send handler (instead of 4096 bytes
+	 * fragments) because the transport frames each send
+	 * operation (WebSocket).
+	 */
+	axl_bool                    send_whole_msg;
+
 	/*** subscriptions ***/
 	axlHash                   * subs;
 	axlHash                   * wild_subs;
@@ -380,6 +401,12 @@ struct _MyQttConn {
 	char          * certificate;
 	char          * private_key;
 	char          * chain_certificate;
+
+	/*** transport read buffer support ***/
+	unsigned char * read_buffer;
+	int             read_buffer_size;
+	int             read_buffer_start;
+	int             read_buffer_end;
 };
 
 axl_bool               myqtt_conn_ref_internal           (MyQttConn   * conn, 
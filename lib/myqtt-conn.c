@@ -48,6 +48,7 @@
 /* include connection internal definition */
 #include <myqtt-conn-private.h>
 #include <myqtt-addrinfo.h>
+#include <myqtt-probes.h>
 
 #if defined(AXL_OS_UNIX)
 # include <netinet/tcp.h>
@@ -347,6 +348,9 @@ MyQttConn * myqtt_conn_new_empty_from_conn (MyQttCtx        * ctx,
 
 		/* set accepted */
 		connection->last_err           = MYQTT_CONNACK_ACCEPTED;
+		if (role != MyQttRoleMasterListener) {
+			MYQTT_PROBE3 (conn_open, connection->id, role, socket);
+		} /* end if */
 
 	} else {
 		/* set a wrong socket connection in the case a not
@@ -1143,6 +1147,7 @@ axl_bool __myqtt_conn_send_connect (MyQttCtx * ctx, MyQttConn * conn, MyQttConnO
 	
 	/* report message sent */
 	myqtt_log (MYQTT_LEVEL_DEBUG, "CONNECT message of %d bytes sent", size);
+	__myqtt_metrics_count_msg (ctx, axl_false, size);
 
 	/* call to release */
 	myqtt_msg_free_build (ctx, msg, size);
@@ -1431,6 +1436,7 @@ void __myqtt_conn_new_internal (MyQttCtx * ctx, MyQttConn * connection, MyQttCon
 		/* connection ok */
 		myqtt_log (MYQTT_LEVEL_DEBUG, "MQTT connection OK (conn-id=%d)", connection->id);
 		connection->last_err           = MYQTT_CONNACK_ACCEPTED;
+		MYQTT_PROBE3 (conn_open, connection->id, connection->role, connection->session);
 	} /* end if */
 
  report_connection:
@@ -1900,7 +1906,8 @@ void            myqtt_conn_send_connect_reply (MyQttConn * conn, MyQttConnAckTyp
 	/* send message */
 	if (! myqtt_msg_send_raw (conn, reply, size)) {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to send CONNACK message, errno=%d", errno);
-	} /* end if */
+	} else
+		__myqtt_metrics_count_msg (ctx, axl_false, size);
 
 	/* free reply */
 	myqtt_msg_free_build (ctx, reply, size);
@@ -1982,24 +1989,16 @@ const char        * myqtt_conn_get_code_to_err (MyQttConnAckTypes code)
 }
 
 /** 
- * @internal Get the next package id available over the provided
- * connection.
+ * @internal Picks and records the next package id available over the
+ * provided connection. Must be called with conn->op_mutex locked and
+ * the pkgids storage initialised.
  */
-int __myqtt_conn_get_next_pkgid_aux (MyQttCtx * ctx, MyQttConn * conn, MyQttQos qos)
+int __myqtt_conn_pick_pkgid (MyQttCtx * ctx, MyQttConn * conn)
 {
 	int      pkg_id = 1;
 	int      value;
 	int      iterator;
 
-	/* init pkgids database */
-	if (! myqtt_storage_init (ctx, conn, MYQTT_STORAGE_PKGIDS)) {
-		/* failed to initialise package ids */
-		return pkg_id;
-	} /* end if */
-
-	/* lock operation mutex */
-	myqtt_mutex_lock (&conn->op_mutex);
-
 	/* get the list */
 	if (conn->sent_pkgids == NULL)
 		conn->sent_pkgids = axl_list_new (axl_list_equal_int, NULL);
@@ -2046,9 +2045,6 @@ int __myqtt_conn_get_next_pkgid_aux (MyQttCtx * ctx, MyQttConn * conn, MyQttQos
 				/* insert value into this position */
 				axl_list_add_at (conn->sent_pkgids, INT_TO_PTR (pkg_id), iterator);
 
-				/* unlock operation mutex */
-				myqtt_mutex_unlock (&conn->op_mutex);
-
 				return pkg_id;
 			} /* end if */
 
@@ -2060,12 +2056,68 @@ int __myqtt_conn_get_next_pkgid_aux (MyQttCtx * ctx, MyQttConn * conn, MyQttQos
 		axl_list_append (conn->sent_pkgids, INT_TO_PTR (pkg_id));
 	} /* end if */
 
+	return pkg_id;
+}
+
+/** 
+ * @internal Get the next package id available over the provided
+ * connection.
+ */
+int __myqtt_conn_get_next_pkgid_aux (MyQttCtx * ctx, MyQttConn * conn, MyQttQos qos)
+{
+	int      pkg_id = 1;
+
+	/* init pkgids database */
+	if (! myqtt_storage_init (ctx, conn, MYQTT_STORAGE_PKGIDS)) {
+		/* failed to initialise package ids */
+		return pkg_id;
+	} /* end if */
+
+	/* lock operation mutex */
+	myqtt_mutex_lock (&conn->op_mutex);
+
+	pkg_id = __myqtt_conn_pick_pkgid (ctx, conn);
+
 	/* unlock operation mutex */
 	myqtt_mutex_unlock (&conn->op_mutex);
 
 	return pkg_id;
 }
 
+/** 
+ * @internal Get count package ids available over the provided
+ * connection at once (one storage init and one op_mutex lock for the
+ * whole set).
+ */
+void __myqtt_conn_get_next_pkgids (MyQttCtx * ctx, MyQttConn * conn, int * pkg_ids, int count)
+{
+	int iterator = 0;
+
+	/* init pkgids database */
+	if (! myqtt_storage_init (ctx, conn, MYQTT_STORAGE_PKGIDS)) {
+		/* failed to initialise package ids, report default
+		 * value as __myqtt_conn_get_next_pkgid_aux does */
+		while (iterator < count) {
+			pkg_ids[iterator] = 1;
+			iterator++;
+		} /* end while */
+		return;
+	} /* end if */
+
+	/* lock operation mutex */
+	myqtt_mutex_lock (&conn->op_mutex);
+
+	while (iterator < count) {
+		pkg_ids[iterator] = __myqtt_conn_pick_pkgid (ctx, conn);
+		iterator++;
+	} /* end while */
+
+	/* unlock operation mutex */
+	myqtt_mutex_unlock (&conn->op_mutex);
+
+	return;
+}
+
 int __myqtt_conn_get_next_pkgid (MyQttCtx * ctx, MyQttConn * conn, MyQttQos qos) {
 	int pkg_id;
 	int iterator = 0;
@@ -2438,6 +2490,442 @@ axl_bool            myqtt_conn_pub             (MyQttConn           * conn,
 	return __myqtt_conn_pub_send_and_handle_reply (ctx, conn, packet_id, qos, handle, wait_publish, msg, size);
 }
 
+/** 
+ * @internal Completion state for a set of messages published with
+ * myqtt_conn_pub_batch.
+ */
+struct _MyQttPubBatch {
+	MyQttConn       * conn;
+	int               count;
+	int               wait_publish;
+	long              started;
+	/* per message state */
+	int             * packet_ids;
+	MyQttQos        * qos;
+	axlPointer      * handles;
+	unsigned char  ** msgs;
+	int             * sizes;
+	axl_bool        * ok;
+};
+
+/** 
+ * @internal Release batch memory (not the messages or the handles).
+ */
+void __myqtt_conn_pub_batch_free (MyQttPubBatch * batch)
+{
+	if (batch == NULL)
+		return;
+	if (batch->conn)
+		myqtt_conn_unref (batch->conn, "pub-batch");
+	axl_free (batch->packet_ids);
+	axl_free (batch->qos);
+	axl_free (batch->handles);
+	axl_free (batch->msgs);
+	axl_free (batch->sizes);
+	axl_free (batch->ok);
+	axl_free (batch);
+	return;
+}
+
+/** 
+ * @internal Seconds still available to wait for replies or 0 if the
+ * wait_publish period is over.
+ */
+int __myqtt_conn_pub_batch_remaining (MyQttPubBatch * batch)
+{
+	int remaining = batch->wait_publish - (int) (time (NULL) - batch->started);
+	return remaining > 0 ? remaining : 0;
+}
+
+/** 
+ * @internal Waits for the reply expected for packet_id (or removes
+ * the wait reply if the period is over) reporting if it matches the
+ * provided type.
+ */
+axl_bool __myqtt_conn_pub_batch_get_reply (MyQttPubBatch * batch, int packet_id, MyQttMsgType type)
+{
+	MyQttMsg  * reply;
+	MyQttConn * conn = batch->conn;
+	MyQttCtx  * ctx  = conn->ctx;
+	int         remaining;
+	axl_bool    result;
+
+	remaining = __myqtt_conn_pub_batch_remaining (batch);
+	if (remaining == 0) {
+		/* no more time, release wait reply */
+		__myqtt_reader_remove_wait_reply (conn, packet_id, axl_false);
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Expecting %s for packet_id=%d conn-id=%d but wait_publish=%d period is over",
+			   myqtt_msg_get_type_str2 (type), packet_id, conn->id, batch->wait_publish);
+		return axl_false;
+	} /* end if */
+
+	reply  = __myqtt_reader_get_reply (conn, packet_id, remaining, axl_false);
+	result = reply && reply->type == type && reply->packet_id == packet_id;
+	if (! result) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Expecting %s, received empty reply, wrong reply type or different packet id in reply=%p (%s) (packet id=%d != %d) conn-id=%d",
+			   myqtt_msg_get_type_str2 (type), reply, reply ? myqtt_msg_get_type_str (reply) : "UNKNOWN", 
+			   reply ? reply->packet_id : -1, packet_id, conn->id);
+	} /* end if */
+	myqtt_msg_unref (reply);
+
+	return result;
+}
+
+/** 
+ * @brief Allows to publish a set of application messages on the
+ * provided connection with a single operation.
+ *
+ * The function works like calling \ref myqtt_conn_pub for each item
+ * but packet ids for QoS 1 and QoS 2 messages are allocated at once
+ * and all messages are handed to the sequencer with a single
+ * operation. The function does not wait for replies: use \ref
+ * myqtt_conn_pub_batch_wait with the handle returned to wait for all
+ * PUBACK (QoS 1) and PUBREC/PUBCOMP (QoS 2) replies collectively.
+ *
+ * @param conn The connection where the publish operation will take place.
+ *
+ * @param items The set of messages to publish (see \ref MyQttPubItem).
+ *
+ * @param items_count Number of items.
+ *
+ * @param wait_publish Max amount of time, in seconds, to wait for the
+ * complete publication of all messages (counted from this call). If
+ * 0 is provided no reply is waited (as \ref myqtt_conn_pub does).
+ *
+ * @return A completion handle that must be passed to \ref
+ * myqtt_conn_pub_batch_wait (which releases it), or NULL if the
+ * messages couldn't be queued (in that case nothing was sent).
+ */
+MyQttPubBatch     * myqtt_conn_pub_batch       (MyQttConn           * conn,
+						MyQttPubItem        * items,
+						int                   items_count,
+						int                   wait_publish)
+{
+	MyQttCtx            * ctx;
+	MyQttPubBatch       * batch;
+	int                 * ids = NULL;
+	int                   ids_count = 0;
+	int                   ids_next  = 0;
+	int                   iterator;
+	int                   qos;
+	axl_bool              skip_storage;
+
+	if (conn == NULL || conn->ctx == NULL || items == NULL || items_count <= 0)
+		return NULL;
+
+	/* get reference to the context */
+	ctx = conn->ctx;
+
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to publish, connection received is not working");
+		return NULL;
+	} /* end if */
+
+	/* check items and count packet ids required */
+	iterator = 0;
+	while (iterator < items_count) {
+		if (! items[iterator].topic_name || strlen (items[iterator].topic_name) > 65535) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Topic name for item %d is NULL or bigger than 65535 and this is not allowed by MQTT", iterator);
+			return NULL;
+		} /* end if */
+
+		qos = items[iterator].qos & ~MYQTT_QOS_SKIP_STORAGE;
+		if (qos < 0 || qos > 2) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Wrong QoS value received=%d for item %d, unable to publish messages", items[iterator].qos, iterator);
+			return NULL;
+		} /* end if */
+		if (qos > 0)
+			ids_count++;
+		iterator++;
+	} /* end while */
+
+	/* create batch */
+	batch = axl_new (MyQttPubBatch, 1);
+	if (batch == NULL)
+		return NULL;
+	batch->count        = items_count;
+	batch->wait_publish = wait_publish;
+	batch->started      = time (NULL);
+	batch->packet_ids   = axl_new (int, items_count);
+	batch->qos          = axl_new (MyQttQos, items_count);
+	batch->handles      = axl_new (axlPointer, items_count);
+	batch->msgs         = axl_new (unsigned char *, items_count);
+	batch->sizes        = axl_new (int, items_count);
+	batch->ok           = axl_new (axl_bool, items_count);
+	if (ids_count > 0)
+		ids = axl_new (int, ids_count);
+	if (batch->packet_ids == NULL || batch->qos == NULL || batch->handles == NULL || batch->msgs == NULL ||
+	    batch->sizes == NULL || batch->ok == NULL || (ids_count > 0 && ids == NULL)) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to acquire memory to publish %d messages", items_count);
+		axl_free (ids);
+		__myqtt_conn_pub_batch_free (batch);
+		return NULL;
+	} /* end if */
+
+	/* get all packet ids at once */
+	if (ids_count > 0)
+		__myqtt_conn_get_next_pkgids (ctx, conn, ids, ids_count);
+
+	/* build (and store) all messages */
+	iterator  = 0;
+	while (iterator < items_count) {
+		batch->qos[iterator]        = items[iterator].qos;
+		batch->packet_ids[iterator] = -1;
+		qos                         = items[iterator].qos & ~MYQTT_QOS_SKIP_STORAGE;
+		skip_storage                = (items[iterator].qos & MYQTT_QOS_SKIP_STORAGE) == MYQTT_QOS_SKIP_STORAGE;
+
+		if (qos == 0) {
+			/* dup = axl_false, qos = 0, retain = <as described by item> */
+			batch->msgs[iterator] = myqtt_msg_build  (ctx, MYQTT_PUBLISH, axl_false, 0, items[iterator].retain, &batch->sizes[iterator],
+								  /* topic name */
+								  MYQTT_PARAM_UTF8_STRING, strlen (items[iterator].topic_name), items[iterator].topic_name,
+								  /* message */
+								  MYQTT_PARAM_BINARY_PAYLOAD, items[iterator].app_message_size, items[iterator].app_message,
+								  MYQTT_PARAM_END);
+		} else {
+			batch->packet_ids[iterator] = ids[ids_next];
+			ids_next++;
+
+			/* dup = axl_false, qos = 1/2, retain = <as described by item> */
+			batch->msgs[iterator] = myqtt_msg_build  (ctx, MYQTT_PUBLISH, axl_false, qos, items[iterator].retain, &batch->sizes[iterator],
+								  /* topic name */
+								  MYQTT_PARAM_UTF8_STRING, strlen (items[iterator].topic_name), items[iterator].topic_name,
+								  /* packet id */
+								  MYQTT_PARAM_16BIT_INT, batch->packet_ids[iterator],
+								  /* message */
+								  MYQTT_PARAM_BINARY_PAYLOAD, items[iterator].app_message_size, items[iterator].app_message,
+								  MYQTT_PARAM_END);
+		} /* end if */
+
+		if (batch->msgs[iterator] == NULL || batch->sizes[iterator] == 0) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to create PUBLISH message for item %d, empty/NULL value reported by myqtt_msg_build()", iterator);
+			goto release_batch;
+		} /* end if */
+
+		if (qos > 0 && ! skip_storage) {
+			/* store message before attempting to deliver it */
+			batch->handles[iterator] = myqtt_storage_store_msg (ctx, conn, batch->packet_ids[iterator], qos, 
+									    batch->msgs[iterator], batch->sizes[iterator]);
+			if (! batch->handles[iterator]) {
+				myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to storage message %d for publication, unable to continue", iterator);
+				myqtt_msg_free_build (ctx, batch->msgs[iterator], batch->sizes[iterator]);
+				batch->msgs[iterator] = NULL;
+				goto release_batch;
+			} /* end if */
+		} /* end if */
+
+		iterator++;
+	} /* end while */
+
+	/* prepare replies before sending anything */
+	iterator = 0;
+	while (iterator < items_count) {
+		if (batch->packet_ids[iterator] > 0 && wait_publish > 0)
+			__myqtt_reader_prepare_wait_reply (conn, batch->packet_ids[iterator], axl_false);
+		iterator++;
+	} /* end while */
+
+	/* keep a reference during the batch life */
+	if (! myqtt_conn_ref (conn, "pub-batch")) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to publish, failed to acquire connection reference");
+		goto remove_replies;
+	} /* end if */
+	batch->conn = conn;
+
+	/* queue all messages with a single sequencer operation (msgs
+	 * are now owned by the sequencer) */
+	myqtt_log (MYQTT_LEVEL_DEBUG, "Sending %d PUBLISH messages (batch) conn-id=%d wait_publish=%d", items_count, conn->id, wait_publish);
+	if (! myqtt_sequencer_send_batch (conn, MYQTT_PUBLISH, batch->msgs, batch->sizes, items_count)) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to queue data for delivery, failed to send publish messages (batch)");
+		iterator = 0;
+		while (iterator < items_count) {
+			if (batch->packet_ids[iterator] > 0 && wait_publish > 0)
+				__myqtt_reader_remove_wait_reply (conn, batch->packet_ids[iterator], axl_false);
+			/* do not release package ids on failure to
+			 * avoid overwriting packages ids (as
+			 * myqtt_conn_pub does) */
+			if (batch->handles[iterator])
+				myqtt_storage_release_msg (ctx, conn, batch->handles[iterator], batch->msgs[iterator], batch->sizes[iterator]);
+			iterator++;
+		} /* end while */
+		axl_free (ids);
+		__myqtt_conn_pub_batch_free (batch);
+		return NULL;
+	} /* end if */
+
+	axl_free (ids);
+	return batch;
+
+ remove_replies:
+	iterator = 0;
+	while (iterator < items_count) {
+		if (batch->packet_ids[iterator] > 0 && wait_publish > 0)
+			__myqtt_reader_remove_wait_reply (conn, batch->packet_ids[iterator], axl_false);
+		iterator++;
+	} /* end while */
+	iterator = items_count;
+
+ release_batch:
+	/* release everything built so far (items [0, iterator)) */
+	while (iterator > 0) {
+		iterator--;
+		if (batch->handles[iterator])
+			myqtt_storage_release_msg (ctx, conn, batch->handles[iterator], batch->msgs[iterator], batch->sizes[iterator]);
+		myqtt_msg_free_build (ctx, batch->msgs[iterator], batch->sizes[iterator]);
+	} /* end while */
+
+	/* release all packet ids allocated (nothing was sent) */
+	iterator = 0;
+	while (iterator < ids_count) {
+		__myqtt_conn_release_pkgid (ctx, conn, ids[iterator]);
+		iterator++;
+	} /* end while */
+	axl_free (ids);
+	__myqtt_conn_pub_batch_free (batch);
+	return NULL;
+}
+
+/** 
+ * @brief Waits for the complete publication of the messages queued by
+ * \ref myqtt_conn_pub_batch, releasing the handle.
+ *
+ * Replies are awaited collectively and limited by the wait_publish
+ * period configured on \ref myqtt_conn_pub_batch: first all PUBACK
+ * (QoS 1) and PUBREC (QoS 2) replies, then all PUBREL messages are
+ * sent with a single sequencer operation and finally all PUBCOMP
+ * replies are awaited.
+ *
+ * @param batch The handle returned by \ref myqtt_conn_pub_batch. It
+ * is no longer valid after this call.
+ *
+ * @param confirmed Optional reference where the number of messages
+ * published is reported. QoS 0 messages (and all messages when
+ * wait_publish was 0) count as published once queued.
+ *
+ * @return axl_true if all messages were published, otherwise
+ * axl_false is returned.
+ */
+axl_bool            myqtt_conn_pub_batch_wait  (MyQttPubBatch       * batch,
+						int                 * confirmed)
+{
+	MyQttConn       * conn;
+	MyQttCtx        * ctx;
+	unsigned char  ** rels      = NULL;
+	int             * rel_sizes = NULL;
+	int             * rel_index = NULL;
+	int               rel_count = 0;
+	int               iterator;
+	int               qos;
+	int               count     = 0;
+	axl_bool          result    = axl_true;
+
+	if (confirmed)
+		(*confirmed) = 0;
+	if (batch == NULL)
+		return axl_false;
+
+	conn = batch->conn;
+	ctx  = conn->ctx;
+
+	/* QoS 0 messages (or no wait) are done once queued */
+	iterator = 0;
+	while (iterator < batch->count) {
+		batch->ok[iterator] = batch->packet_ids[iterator] <= 0 || batch->wait_publish <= 0;
+		iterator++;
+	} /* end while */
+
+	if (batch->wait_publish > 0) {
+		rels      = axl_new (unsigned char *, batch->count);
+		rel_sizes = axl_new (int, batch->count);
+		rel_index = axl_new (int, batch->count);
+
+		/* first round: PUBACK (QoS 1) and PUBREC (QoS 2) */
+		iterator = 0;
+		while (iterator < batch->count) {
+			if (batch->packet_ids[iterator] <= 0) {
+				iterator++;
+				continue;
+			} /* end if */
+
+			qos = batch->qos[iterator] & ~MYQTT_QOS_SKIP_STORAGE;
+			batch->ok[iterator] = __myqtt_conn_pub_batch_get_reply (batch, batch->packet_ids[iterator], 
+										qos == MYQTT_QOS_1 ? MYQTT_PUBACK : MYQTT_PUBREC);
+			if (qos == MYQTT_QOS_2) {
+				/* in any case, remove message from local storage */
+				if (batch->handles[iterator]) {
+					myqtt_storage_release_msg (ctx, conn, batch->handles[iterator], batch->msgs[iterator], batch->sizes[iterator]);
+					batch->handles[iterator] = NULL;
+				} /* end if */
+
+				if (batch->ok[iterator]) {
+					/* build PUBREL, reusing packet id */
+					if (rels && rel_sizes && rel_index)
+						rels[rel_count] = myqtt_msg_build  (ctx, MYQTT_PUBREL, axl_false, MYQTT_QOS_1, axl_false, &rel_sizes[rel_count],
+										    /* packet id */
+										    MYQTT_PARAM_16BIT_INT, batch->packet_ids[iterator],
+										    MYQTT_PARAM_END);
+					if (rels == NULL || rel_sizes == NULL || rel_index == NULL || rels[rel_count] == NULL || rel_sizes[rel_count] == 0) {
+						myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to create PUBREL message for packet_id=%d", batch->packet_ids[iterator]);
+						batch->ok[iterator] = axl_false;
+					} else {
+						/* prepare reply */
+						__myqtt_reader_prepare_wait_reply (conn, batch->packet_ids[iterator], axl_false);
+						rel_index[rel_count] = iterator;
+						rel_count++;
+					} /* end if */
+				} /* end if */
+			} /* end if */
+
+			iterator++;
+		} /* end while */
+
+		/* second round: send all PUBREL at once */
+		if (rel_count > 0 && ! myqtt_sequencer_send_batch (conn, MYQTT_PUBREL, rels, rel_sizes, rel_count)) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to queue data for delivery (PUBREL), failed to send %d PUBREL messages", rel_count);
+			iterator = 0;
+			while (iterator < rel_count) {
+				__myqtt_reader_remove_wait_reply (conn, batch->packet_ids[rel_index[iterator]], axl_false);
+				batch->ok[rel_index[iterator]] = axl_false;
+				iterator++;
+			} /* end while */
+			rel_count = 0;
+		} /* end if */
+
+		/* third round: PUBCOMP */
+		iterator = 0;
+		while (iterator < rel_count) {
+			batch->ok[rel_index[iterator]] = __myqtt_conn_pub_batch_get_reply (batch, batch->packet_ids[rel_index[iterator]], MYQTT_PUBCOMP);
+			iterator++;
+		} /* end while */
+
+		axl_free (rels);
+		axl_free (rel_sizes);
+		axl_free (rel_index);
+	} /* end if */
+
+	/* release packet ids (only when publication finished ok, as
+	 * myqtt_conn_pub does) and stored messages */
+	iterator = 0;
+	while (iterator < batch->count) {
+		if (batch->ok[iterator])
+			count++;
+		else
+			result = axl_false;
+
+		if (batch->packet_ids[iterator] > 0 && batch->ok[iterator])
+			__myqtt_conn_release_pkgid (ctx, conn, batch->packet_ids[iterator]);
+		if (batch->handles[iterator])
+			myqtt_storage_release_msg (ctx, conn, batch->handles[iterator], batch->msgs[iterator], batch->sizes[iterator]);
+		iterator++;
+	} /* end while */
+
+	if (confirmed)
+		(*confirmed) = count;
+
+	__myqtt_conn_pub_batch_free (batch);
+	return result;
+}
+
 /** 
  * @brief Allows to queue PUBLISH messages on local storage,
  * associated to the provided client identifier, that will be sent
@@ -3204,6 +3692,7 @@ axl_bool                    myqtt_conn_close                  (MyQttConn * conne
 	
 		/* report message sent */
 		myqtt_log (MYQTT_LEVEL_DEBUG, "DISCONNECT message of %d bytes sent", size);
+		__myqtt_metrics_count_msg (ctx, axl_false, size);
 
 		/* call to release */
 		myqtt_msg_free_build (ctx, msg, size);
@@ -4012,6 +4501,10 @@ void               myqtt_conn_free (MyQttConn * connection)
 	/* free possible msg and buffer */
 	axl_free (connection->buffer);
 
+	/* free transport read buffer */
+	axl_free (connection->read_buffer);
+	connection->read_buffer = NULL;
+
 	/* release ping resp queue if defined */
 	myqtt_async_queue_unref (connection->ping_resp_queue);
 	connection->ping_resp_queue = NULL;
@@ -4707,6 +5200,7 @@ void           __myqtt_conn_set_not_connected (MyQttConn * connection,
 		myqtt_mutex_lock  (&(connection->ref_mutex));
 		connection->is_connected = axl_false;
 		myqtt_mutex_unlock  (&(connection->ref_mutex));
+		MYQTT_PROBE2 (conn_close, connection->id, status);
 
 		/* unlock now the op mutex is not blocked */
 		myqtt_mutex_unlock (&connection->op_mutex);
@@ -5577,6 +6071,81 @@ axl_bool   myqtt_conn_remove_on_close (MyQttConn          * connection,
 	return axl_false;
 }
 
+/** 
+ * @internal Serves the read requested from the connection read
+ * buffer, refilling it from the receive handler when it gets empty.
+ */
+int                 __myqtt_conn_buffered_receive     (MyQttConn        * connection,
+						       unsigned char    * buffer,
+						       int                buffer_len)
+{
+	int served = 0;
+	int size;
+	int result;
+
+	/* serve content already buffered */
+	if (connection->read_buffer_start < connection->read_buffer_end) {
+		served = connection->read_buffer_end - connection->read_buffer_start;
+		if (served > buffer_len)
+			served = buffer_len;
+		memcpy (buffer, connection->read_buffer + connection->read_buffer_start, served);
+		connection->read_buffer_start += served;
+
+		/* reset indexes when the buffer is drained */
+		if (connection->read_buffer_start == connection->read_buffer_end) {
+			connection->read_buffer_start = 0;
+			connection->read_buffer_end   = 0;
+		} /* end if */
+
+		if (served == buffer_len)
+			return served;
+	} /* end if */
+
+	/* buffer was disabled after content was stored or the
+	 * request is big enough to be read directly */
+	size = connection->read_buffer_size;
+	if (size <= 0 || (buffer_len - served) >= size) {
+		result = connection->receive (connection, buffer + served, buffer_len - served);
+		if (result <= 0)
+			return served > 0 ? served : result;
+		return served + result;
+	} /* end if */
+
+	/* allocate buffer on first use */
+	if (connection->read_buffer == NULL) {
+		connection->read_buffer = axl_new (unsigned char, size);
+		if (connection->read_buffer == NULL) {
+			result = connection->receive (connection, buffer + served, buffer_len - served);
+			if (result <= 0)
+				return served > 0 ? served : result;
+			return served + result;
+		} /* end if */
+	} /* end if */
+
+	/* pull as much as possible from the transport */
+	result = connection->receive (connection, connection->read_buffer, size);
+	if (result <= 0)
+		return served > 0 ? served : result;
+
+	connection->read_buffer_end   = result;
+	connection->read_buffer_start = 0;
+
+	/* serve the rest of the request */
+	if (result > (buffer_len - served))
+		result = buffer_len - served;
+	memcpy (buffer + served, connection->read_buffer, result);
+	connection->read_buffer_start = result;
+	served += result;
+
+	/* reset indexes when the buffer is drained */
+	if (connection->read_buffer_start == connection->read_buffer_end) {
+		connection->read_buffer_start = 0;
+		connection->read_buffer_end   = 0;
+	} /* end if */
+
+	return served;
+}
+
 /** 
  * @internal
  * @brief Allows to invoke current receive handler defined by \ref MyQttReceive.
@@ -5601,7 +6170,74 @@ int                 myqtt_conn_invoke_receive         (MyQttConn        * connec
 	if (connection == NULL || buffer == NULL || connection->receive == NULL)
 		return -1;
 
-	return connection->receive (connection, buffer, buffer_len);
+	/* no read buffer configured and nothing pending on it */
+	if (connection->read_buffer_size <= 0 && connection->read_buffer_start == connection->read_buffer_end)
+		return connection->receive (connection, buffer, buffer_len);
+
+	return __myqtt_conn_buffered_receive (connection, buffer, buffer_len);
+}
+
+/** 
+ * @brief Allows to configure a transport level read buffer on the
+ * provided connection.
+ *
+ * When configured, each read done on the connection is served from
+ * memory, pulling up to <b>size</b> bytes at once from the current
+ * \ref MyQttReceive handler every time the buffer gets empty. This
+ * is used by transports where each receive call is expensive (for
+ * example, TLS records or WebSocket frames) so the small header
+ * reads done by the MQTT engine do not hit the transport every time.
+ *
+ * The function is usually called by transport implementations
+ * (TLS, WebSocket) right after installing their \ref MyQttReceive
+ * handler.
+ *
+ * @param conn The connection to configure.
+ *
+ * @param size The amount of bytes to pull from the transport on each
+ * read. Use 0 to disable the buffer (content already buffered is
+ * still served before reading from the transport).
+ */
+void                myqtt_conn_set_read_buffer        (MyQttConn        * conn,
+						       int                size)
+{
+	if (conn == NULL)
+		return;
+
+	/* release current buffer if it is empty so it is allocated
+	 * again with the new size on the next read */
+	if (conn->read_buffer_start == conn->read_buffer_end) {
+		axl_free (conn->read_buffer);
+		conn->read_buffer       = NULL;
+		conn->read_buffer_start = 0;
+		conn->read_buffer_end   = 0;
+	} /* end if */
+
+	conn->read_buffer_size = size > 0 ? size : 0;
+	return;
+}
+
+/** 
+ * @brief Allows to check if the provided connection has content
+ * already read from the transport that is waiting to be
+ * processed.
+ *
+ * Content stored on the transport read buffer (see \ref
+ * myqtt_conn_set_read_buffer) is not reported by the I/O waiting
+ * mechanism because it is no longer on the socket. The MyQtt reader
+ * uses this function to process those connections without waiting
+ * for the socket to become readable again.
+ *
+ * @param conn The connection to check.
+ *
+ * @return axl_true if there is content buffered, otherwise axl_false
+ * is returned.
+ */
+axl_bool            myqtt_conn_has_pending_data       (MyQttConn        * conn)
+{
+	if (conn == NULL)
+		return axl_false;
+	return conn->read_buffer_start < conn->read_buffer_end;
 }
 
 /** 
@@ -5623,10 +6259,62 @@ int                 myqtt_conn_invoke_send            (MyQttConn           * con
 						       const unsigned char * buffer,
 						       int                   buffer_len)
 {
+	int written;
+
 	if (connection == NULL || buffer == NULL || ! myqtt_conn_is_ok (connection, axl_false))
 		return -1;
 
-	return connection->send (connection, buffer, buffer_len);
+	written = connection->send (connection, buffer, buffer_len);
+	MYQTT_PROBE3 (socket_write, connection->id, buffer_len, written);
+
+	return written;
+}
+
+/** 
+ * @internal Returns a new token to identify a send operation (and
+ * its retries) on the provided connection (see MyQttSendToken). 0 is
+ * returned if the connection has no token aware send handler.
+ */
+int                 __myqtt_conn_next_send_token      (MyQttConn           * conn)
+{
+	int token;
+
+	if (conn == NULL || conn->send_token == NULL)
+		return 0;
+
+	myqtt_mutex_lock (&conn->op_mutex);
+	conn->send_tokens++;
+	/* 0 is reserved to report no token */
+	if (conn->send_tokens <= 0)
+		conn->send_tokens = 1;
+	token = conn->send_tokens;
+	myqtt_mutex_unlock (&conn->op_mutex);
+
+	return token;
+}
+
+/** 
+ * @internal Same as \ref myqtt_conn_invoke_send but using the token
+ * aware send handler (if defined and a token is provided) so retries
+ * of the same send operation are recognized by the transport.
+ */
+int                 __myqtt_conn_invoke_send_token    (MyQttConn           * connection,
+						       int                   token,
+						       const unsigned char * buffer,
+						       int                   buffer_len)
+{
+	int written;
+
+	if (token == 0 || connection == NULL || connection->send_token == NULL)
+		return myqtt_conn_invoke_send (connection, buffer, buffer_len);
+
+	if (buffer == NULL || ! myqtt_conn_is_ok (connection, axl_false))
+		return -1;
+
+	written = connection->send_token (connection, token, buffer, buffer_len);
+	MYQTT_PROBE3 (socket_write, connection->id, buffer_len, written);
+
+	return written;
 }
 
 /** 
@@ -100,6 +100,14 @@ axl_bool            myqtt_conn_pub             (MyQttConn           * conn,
 						axl_bool              retain,
 						int                   wait_publish);
 
+MyQttPubBatch     * myqtt_conn_pub_batch       (MyQttConn           * conn,
+						MyQttPubItem        * items,
+						int                   items_count,
+						int                   wait_publish);
+
+axl_bool            myqtt_conn_pub_batch_wait  (MyQttPubBatch       * batch,
+						int                 * confirmed);
+
 axl_bool            myqtt_conn_offline_pub     (MyQttCtx            * ctx,
 						const char          * client_identifier,
 						const char          * topic_name,
@@ -203,6 +211,13 @@ void                __myqtt_conn_shutdown_and_record_error (MyQttConn     * conn
 							    const char    * message,
 							    ...);
 
+int                 __myqtt_conn_next_send_token      (MyQttConn           * conn);
+
+int                 __myqtt_conn_invoke_send_token    (MyQttConn           * conn,
+						       int                   token,
+						       const unsigned char * buffer,
+						       int                   buffer_len);
+
 void                myqtt_conn_free                   (MyQttConn * conn);
 
 MYQTT_SOCKET        myqtt_conn_get_socket             (MyQttConn * conn);
@@ -315,6 +330,11 @@ int                 myqtt_conn_invoke_send            (MyQttConn             * c
 							const unsigned char  * buffer,
 							int                    buffer_len);
 
+void                myqtt_conn_set_read_buffer        (MyQttConn        * conn,
+						       int                size);
+
+axl_bool            myqtt_conn_has_pending_data       (MyQttConn        * conn);
+
 void                myqtt_conn_sanity_socket_check        (MyQttCtx * ctx, axl_bool      enable);
 
 void                myqtt_conn_shutdown                   (MyQttConn * conn);
@@ -275,6 +275,24 @@ struct _MyQttCtx {
 	MyQttCond                   subs_c;
 	int                         publish_ops;
 
+	/* messages delivered to subscribers (MYQTT_ATOMIC_*) */
+	long                        delivered_msgs;
+
+	/* subscriptions installed for connections currently
+	 * connected, including those restored from sessions
+	 * (MYQTT_ATOMIC_*) */
+	int                         conn_subs;
+
+	/* metrics (see myqtt-metrics.c) */
+	axl_bool                    metrics_enabled;
+	MyQttMutex                  metrics_m;
+	MyQttMetrics                metrics;
+
+	/* storage gauges: messages stored and not released yet and
+	 * retained messages (MYQTT_ATOMIC_*) */
+	int                         storage_msgs;
+	int                         retained_msgs;
+
 	axlHash                   * client_ids;
 	MyQttMutex                  client_ids_m;
 
@@ -293,5 +311,46 @@ struct _MyQttCtx {
 	axlPointer              post_ssl_check_data;
 };
 
+/** 
+ * @internal Updates and reads of counters and gauges kept by the
+ * context (delivered_msgs, conn_subs, storage gauges and metrics
+ * counters). They are done with atomic builtins when available and
+ * under metrics_m otherwise. MYQTT_ATOMIC_ADD_POSITIVE doesn't let
+ * the value go below 0.
+ */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define MYQTT_HAVE_ATOMICS 1
+#define MYQTT_ATOMIC_ADD(ctx, var, value) ((void) __sync_add_and_fetch (&(var), (value)))
+#define MYQTT_ATOMIC_READ(ctx, var, result) ((result) = __sync_add_and_fetch (&(var), 0))
+#define MYQTT_ATOMIC_ADD_POSITIVE(ctx, var, value) do {				\
+	__typeof__ (var) __old;							\
+	__typeof__ (var) __new;							\
+	do {									\
+		__old = (var);							\
+		__new = __old + (value);					\
+		if (__new < 0)							\
+			__new = 0;						\
+	} while (! __sync_bool_compare_and_swap (&(var), __old, __new));	\
+} while (0)
+#else
+#define MYQTT_ATOMIC_ADD(ctx, var, value) do {		\
+	myqtt_mutex_lock (&(ctx)->metrics_m);		\
+	(var) += (value);				\
+	myqtt_mutex_unlock (&(ctx)->metrics_m);		\
+} while (0)
+#define MYQTT_ATOMIC_READ(ctx, var, result) do {	\
+	myqtt_mutex_lock (&(ctx)->metrics_m);		\
+	(result) = (var);				\
+	myqtt_mutex_unlock (&(ctx)->metrics_m);		\
+} while (0)
+#define MYQTT_ATOMIC_ADD_POSITIVE(ctx, var, value) do {	\
+	myqtt_mutex_lock (&(ctx)->metrics_m);		\
+	(var) += (value);				\
+	if ((var) < 0)					\
+		(var) = 0;				\
+	myqtt_mutex_unlock (&(ctx)->metrics_m);		\
+} while (0)
+#endif
+
 #endif /* __MYQTT_CTX_PRIVATE_H__ */
 
@@ -116,6 +116,9 @@ MyQttCtx * myqtt_ctx_new (void)
 	/* client ids */
 	myqtt_mutex_create (&ctx->client_ids_m);
 
+	/* metrics */
+	myqtt_mutex_create (&ctx->metrics_m);
+
 	/* set default connect timeout */
 	ctx->connection_connect_std_timeout = 15;
 
@@ -784,6 +787,63 @@ int         myqtt_ctx_ref_count                 (MyQttCtx  * ctx)
 	return result;
 }
 
+/** 
+ * @brief Allows to get the amount of messages delivered to subscribed
+ * connections (publications forwarded by this context) since it was
+ * started.
+ *
+ * @param ctx The myqtt context to get the count from.
+ *
+ * @return Messages delivered or -1 if it fails.
+ */
+long        myqtt_ctx_get_delivered_msgs        (MyQttCtx  * ctx)
+{
+	long result;
+	if (ctx == NULL)
+		return -1;
+
+	MYQTT_ATOMIC_READ (ctx, ctx->delivered_msgs, result);
+
+	return result;
+}
+
+/** 
+ * @brief Allows to get the amount of subscriptions installed for
+ * connections currently connected to this context.
+ *
+ * Subscriptions are accounted once they are accepted (including
+ * storage when the connection has a session) and those restored
+ * during session recovery. Subscriptions replacing a previous one
+ * with the same topic filter are not accounted twice.
+ *
+ * @param ctx The myqtt context to get the count from.
+ *
+ * @return Subscriptions installed or -1 if it fails.
+ */
+int         myqtt_ctx_get_subs_count            (MyQttCtx  * ctx)
+{
+	int result;
+	if (ctx == NULL)
+		return -1;
+
+	MYQTT_ATOMIC_READ (ctx, ctx->conn_subs, result);
+
+	return result;
+}
+
+/** 
+ * @internal Updates subscriptions installed for connections (see
+ * myqtt_ctx_get_subs_count).
+ */
+void        __myqtt_ctx_subs_update             (MyQttCtx  * ctx, int delta)
+{
+	if (ctx == NULL || delta == 0)
+		return;
+
+	MYQTT_ATOMIC_ADD_POSITIVE (ctx, ctx->conn_subs, delta);
+	return;
+}
+
 /** 
  * @brief Decrease reference count and nullify caller's pointer in the
  * case the count reaches 0.
@@ -916,6 +976,9 @@ void        myqtt_ctx_free2 (MyQttCtx * ctx, const char * who)
 	myqtt_mutex_destroy (&ctx->client_ids_m);
 	axl_hash_free (ctx->client_ids);
 
+	/* release metrics */
+	myqtt_mutex_destroy (&ctx->metrics_m);
+
 	/* release path */
 	axl_free (ctx->storage_path);
 
@@ -116,6 +116,12 @@ void        myqtt_ctx_unref2                    (MyQttCtx ** ctx, const char * w
 
 int         myqtt_ctx_ref_count                 (MyQttCtx  * ctx);
 
+long        myqtt_ctx_get_delivered_msgs        (MyQttCtx  * ctx);
+
+int         myqtt_ctx_get_subs_count            (MyQttCtx  * ctx);
+
+void        __myqtt_ctx_subs_update             (MyQttCtx  * ctx, int delta);
+
 void        myqtt_ctx_free                      (MyQttCtx * ctx);
 
 void        myqtt_ctx_free2                     (MyQttCtx * ctx, const char * who);
@@ -160,6 +160,26 @@ typedef int      (*MyQttSend)                (MyQttConn           * connection,
 					      const unsigned char * buffer,
 					      int                   buffer_len);
 
+/** 
+ * @internal Send handler for transports that may keep part of a
+ * send operation queued (returning -2) to be completed by a later
+ * call. It receives a token that identifies the send operation so
+ * its retries can be told apart from other send operations on the
+ * same connection.
+ * 
+ * @param connection MyQtt Connection where the data will be sent.
+ * @param token      Token identifying the send operation (see \ref __myqtt_conn_next_send_token).
+ * @param buffer     The buffer holding data to be sent
+ * @param buffer_len The buffer len.
+ * 
+ * @return How many data was actually sent, -1 on failure or -2 if
+ * the operation must be retried with the same token.
+ */
+typedef int      (*MyQttSendToken)           (MyQttConn           * connection,
+					      int                   token,
+					      const unsigned char * buffer,
+					      int                   buffer_len);
+
 /** 
  * @brief Defines the readers handlers used to actually received data
  * from the underlying socket descriptor.
@@ -149,7 +149,7 @@ int __myqtt_io_waiting_default_wait_on (axlPointer __fd_group, int max_fds, MyQt
 	if (MYQTT_IO_IS (wait_to, READ_OPERATIONS)) {
 		/* init wait */
 		tv.tv_sec    = 0;
-		tv.tv_usec   = 500000;
+		tv.tv_usec   = MYQTT_IO_IS (wait_to, NOWAIT_OPERATIONS) ? 0 : 500000;
 		result       = select (max_fds + 1, &(_select->set), NULL,   NULL, &tv);
 	} else if (MYQTT_IO_IS (wait_to, WRITE_OPERATIONS)) {
 		tv.tv_sec    = 1;
@@ -391,7 +391,7 @@ int __myqtt_io_waiting_poll_wait_on (axlPointer __fd_group, int max_fds, MyQttIo
 	 * <b>wait_to</b> value. */
 	if (MYQTT_IO_IS (wait_to, READ_OPERATIONS)) {
 		/* wait for read operations */
-		result       = poll (_poll->set, _poll->length, 500);
+		result       = poll (_poll->set, _poll->length, MYQTT_IO_IS (wait_to, NOWAIT_OPERATIONS) ? 0 : 500);
 	} else 	if (MYQTT_IO_IS (wait_to, WRITE_OPERATIONS)) {
 		/* wait for write operations */
 		result       = poll (_poll->set, _poll->length, 1000);
@@ -668,7 +668,7 @@ int __myqtt_io_waiting_epoll_wait_on (axlPointer __fd_group, int max_fds, MyQttI
 	/* perform the select operation according to the
 	 * <b>wait_to</b> value. */
 	if (MYQTT_IO_IS (wait_to, READ_OPERATIONS)) {
-		result = epoll_wait (epoll->set, epoll->events, epoll->length, 500);
+		result = epoll_wait (epoll->set, epoll->events, epoll->length, MYQTT_IO_IS (wait_to, NOWAIT_OPERATIONS) ? 0 : 500);
 	} else 	if (MYQTT_IO_IS (wait_to, WRITE_OPERATIONS)) {
 		result = epoll_wait (epoll->set, epoll->events, epoll->length, 1000);
 	} /* end if */
@@ -1389,6 +1389,10 @@ void                 myqtt_io_waiting_invoke_dispatch         (MyQttCtx
  * inside the fd set), and you don't want to return how many sockets
  * have changed, just return a positive value (<b>1</b>).
  *
+ * When the operation requested includes \ref NOWAIT_OPERATIONS, the
+ * handler should only check sockets status and return without
+ * blocking (the reader has content already buffered to process).
+ *
  * @param ctx The context where the operation will be performed.
  * 
  * @param wait_on The handler to be used. The function will fail on
@@ -0,0 +1,476 @@
+/* 
+ *  MyQtt: A high performance open source MQTT implementation
+ *  Copyright (C) 2016 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build MQTT enabled solutions contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         C/ Antonio Suarez Nº 10, 
+ *         Edificio Alius A, Despacho 102
+ *         Alcalá de Henares 28802 (Madrid)
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/mqtt
+ *                        http://www.aspl.es/myqtt
+ */
+
+#include <myqtt-metrics.h>
+
+/* local include */
+#include <myqtt-ctx-private.h>
+
+#define LOG_DOMAIN "myqtt-metrics"
+
+/** 
+ * \defgroup myqtt_metrics MyQtt Metrics: counters and latency histograms
+ */
+
+/** 
+ * \addtogroup myqtt_metrics
+ * @{
+ */
+
+/** 
+ * @brief Allows to enable/disable metrics collection on the provided
+ * context (disabled by default).
+ *
+ * Once enabled, the context keeps counters for messages and bytes in
+ * and out (\ref MyQttMetricCounter) and latency histograms for
+ * publish ingress to egress, storage operations, auth (on connect
+ * handler) and sequencer queue wait (\ref MyQttMetricHistogram). Use
+ * \ref myqtt_metrics_snapshot to get them.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param enable axl_true to enable metrics, otherwise axl_false.
+ */
+void         myqtt_metrics_enable            (MyQttCtx             * ctx,
+					      axl_bool               enable)
+{
+	if (ctx == NULL)
+		return;
+
+	myqtt_mutex_lock (&ctx->metrics_m);
+	if (enable && ! ctx->metrics_enabled) {
+		/* start collecting from scratch */
+		memset (&ctx->metrics, 0, sizeof (MyQttMetrics));
+		ctx->metrics.started = myqtt_metrics_now ();
+	} /* end if */
+	ctx->metrics_enabled = enable;
+	myqtt_mutex_unlock (&ctx->metrics_m);
+
+	return;
+}
+
+/** 
+ * @brief Allows to check if metrics are being collected on the
+ * provided context.
+ *
+ * @param ctx The context to check.
+ *
+ * @return axl_true if metrics are enabled, otherwise axl_false.
+ */
+axl_bool     myqtt_metrics_is_enabled        (MyQttCtx             * ctx)
+{
+	if (ctx == NULL)
+		return axl_false;
+	/* read without lock: it is only a hint to skip taking stamps */
+	return ctx->metrics_enabled;
+}
+
+/** 
+ * @brief Increases the provided counter.
+ *
+ * @param ctx The context where the counter is updated.
+ *
+ * @param counter The counter to update.
+ *
+ * @param value The amount to add.
+ */
+void         myqtt_metrics_count             (MyQttCtx             * ctx,
+					      MyQttMetricCounter     counter,
+					      long long              value)
+{
+	if (ctx == NULL || ! ctx->metrics_enabled || counter < 0 || counter >= MYQTT_METRIC_COUNTERS)
+		return;
+
+	MYQTT_ATOMIC_ADD (ctx, ctx->metrics.counters[counter], value);
+
+	return;
+}
+
+/** 
+ * @internal Accounts a message (and its size) received or sent.
+ */
+void         __myqtt_metrics_count_msg       (MyQttCtx             * ctx,
+					      axl_bool               incoming,
+					      long long              size)
+{
+	if (ctx == NULL || ! ctx->metrics_enabled)
+		return;
+
+	MYQTT_ATOMIC_ADD (ctx, ctx->metrics.counters[incoming ? MYQTT_METRIC_MSGS_IN : MYQTT_METRIC_MSGS_OUT], 1);
+	MYQTT_ATOMIC_ADD (ctx, ctx->metrics.counters[incoming ? MYQTT_METRIC_BYTES_IN : MYQTT_METRIC_BYTES_OUT], size);
+
+	return;
+}
+
+/** 
+ * @internal Returns the bucket where the provided value is recorded.
+ */
+int __myqtt_metrics_bucket (long long value)
+{
+	int exp = 4;
+
+	if (value < 0)
+		return 0;
+	if (value < 16)
+		return (int) value;
+
+	/* get highest bit set */
+	while (exp < 40 && (value >> (exp + 1)) > 0)
+		exp++;
+	if ((value >> (exp + 1)) > 0)
+		return MYQTT_METRIC_BUCKETS - 1;
+
+	return 16 + ((exp - 4) * 8) + (int) ((value >> (exp - 3)) & 7);
+}
+
+/** 
+ * @internal Returns the highest value recorded on the provided bucket.
+ */
+long long __myqtt_metrics_bucket_value (int bucket)
+{
+	int exp;
+	int sub;
+
+	if (bucket < 16)
+		return bucket;
+
+	exp = ((bucket - 16) / 8) + 4;
+	sub = (bucket - 16) % 8;
+	return ((((long long) 8 + sub) << (exp - 3)) + ((long long) 1 << (exp - 3))) - 1;
+}
+
+/** 
+ * @brief Records a latency value into the provided histogram.
+ *
+ * @param ctx The context where the value is recorded.
+ *
+ * @param histogram The histogram to update.
+ *
+ * @param usecs The value to record (microseconds).
+ */
+void         myqtt_metrics_record            (MyQttCtx             * ctx,
+					      MyQttMetricHistogram   histogram,
+					      long long              usecs)
+{
+	MyQttHistogram * hist;
+
+	if (ctx == NULL || ! ctx->metrics_enabled || histogram < 0 || histogram >= MYQTT_METRIC_HISTOGRAMS)
+		return;
+	if (usecs < 0)
+		usecs = 0;
+
+	myqtt_mutex_lock (&ctx->metrics_m);
+	hist = &ctx->metrics.histograms[histogram];
+	if (hist->count == 0 || usecs < hist->min)
+		hist->min = usecs;
+	if (usecs > hist->max)
+		hist->max = usecs;
+	hist->count++;
+	hist->sum += usecs;
+	hist->buckets[__myqtt_metrics_bucket (usecs)]++;
+	myqtt_mutex_unlock (&ctx->metrics_m);
+
+	return;
+}
+
+/** 
+ * @brief Records into the provided histogram the time elapsed since
+ * the provided stamp (as reported by \ref myqtt_metrics_now). Nothing
+ * is recorded if stamp is 0.
+ *
+ * @param ctx The context where the value is recorded.
+ *
+ * @param histogram The histogram to update.
+ *
+ * @param stamp Stamp where the operation started.
+ */
+void         myqtt_metrics_record_since      (MyQttCtx             * ctx,
+					      MyQttMetricHistogram   histogram,
+					      long long              stamp)
+{
+	if (stamp <= 0)
+		return;
+	myqtt_metrics_record (ctx, histogram, myqtt_metrics_now () - stamp);
+	return;
+}
+
+/** 
+ * @brief Gets a copy of current metrics, optionally resetting them
+ * at the same time (so no event is lost or accounted twice between
+ * snapshots).
+ *
+ * @param ctx The context where metrics are taken from.
+ *
+ * @param snapshot Reference to the caller's structure where metrics
+ * are copied.
+ *
+ * @param reset axl_true to reset all counters and histograms.
+ *
+ * @return axl_true if the snapshot was taken, otherwise axl_false
+ * (NULL parameters or metrics not enabled).
+ */
+axl_bool     myqtt_metrics_snapshot          (MyQttCtx             * ctx,
+					      MyQttMetrics         * snapshot,
+					      axl_bool               reset)
+{
+#if defined(MYQTT_HAVE_ATOMICS)
+	int iterator;
+#endif
+
+	if (ctx == NULL || snapshot == NULL)
+		return axl_false;
+
+	myqtt_mutex_lock (&ctx->metrics_m);
+	if (! ctx->metrics_enabled) {
+		myqtt_mutex_unlock (&ctx->metrics_m);
+		return axl_false;
+	} /* end if */
+
+	memcpy (snapshot, &ctx->metrics, sizeof (MyQttMetrics));
+#if defined(MYQTT_HAVE_ATOMICS)
+	/* counters are updated without metrics_m: take (and reset)
+	 * each one atomically so no event is lost */
+	iterator = 0;
+	while (iterator < MYQTT_METRIC_COUNTERS) {
+		if (reset)
+			snapshot->counters[iterator] = __sync_fetch_and_and (&ctx->metrics.counters[iterator], 0);
+		else
+			snapshot->counters[iterator] = __sync_add_and_fetch (&ctx->metrics.counters[iterator], 0);
+		iterator++;
+	} /* end while */
+	if (reset) {
+		memset (ctx->metrics.histograms, 0, sizeof (ctx->metrics.histograms));
+		ctx->metrics.started = myqtt_metrics_now ();
+	} /* end if */
+#else
+	if (reset) {
+		memset (&ctx->metrics, 0, sizeof (MyQttMetrics));
+		ctx->metrics.started = myqtt_metrics_now ();
+	} /* end if */
+#endif
+	myqtt_mutex_unlock (&ctx->metrics_m);
+
+	return axl_true;
+}
+
+/** 
+ * @brief Adds all counters and histograms from one snapshot into
+ * another (for example, to aggregate metrics from several contexts).
+ *
+ * @param into The snapshot that is updated. It must be initialized
+ * (for example, with zeros).
+ *
+ * @param from The snapshot to add.
+ */
+void         myqtt_metrics_merge             (MyQttMetrics         * into,
+					      MyQttMetrics         * from)
+{
+	int              iterator;
+	int              bucket;
+	MyQttHistogram * dst;
+	MyQttHistogram * src;
+
+	if (into == NULL || from == NULL)
+		return;
+
+	/* keep oldest start */
+	if (into->started == 0 || (from->started > 0 && from->started < into->started))
+		into->started = from->started;
+
+	iterator = 0;
+	while (iterator < MYQTT_METRIC_COUNTERS) {
+		into->counters[iterator] += from->counters[iterator];
+		iterator++;
+	} /* end while */
+
+	iterator = 0;
+	while (iterator < MYQTT_METRIC_HISTOGRAMS) {
+		dst = &into->histograms[iterator];
+		src = &from->histograms[iterator];
+		if (src->count > 0) {
+			if (dst->count == 0 || src->min < dst->min)
+				dst->min = src->min;
+			if (src->max > dst->max)
+				dst->max = src->max;
+			dst->count += src->count;
+			dst->sum   += src->sum;
+
+			bucket = 0;
+			while (bucket < MYQTT_METRIC_BUCKETS) {
+				dst->buckets[bucket] += src->buckets[bucket];
+				bucket++;
+			} /* end while */
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	return;
+}
+
+/** 
+ * @brief Gets the value at the provided percentile from a histogram.
+ *
+ * @param histogram The histogram to check.
+ *
+ * @param percentile The percentile requested (0.0 - 1.0, for example
+ * 0.99).
+ *
+ * @return The value found (with the histogram precision, never above
+ * the max value recorded) or 0 if the histogram is empty.
+ */
+long long    myqtt_metrics_percentile        (MyQttHistogram       * histogram,
+					      double                 percentile)
+{
+	long long target;
+	long long seen = 0;
+	long long value;
+	int       bucket;
+
+	if (histogram == NULL || histogram->count == 0)
+		return 0;
+
+	target = (long long) (histogram->count * percentile);
+	if (target < 1)
+		target = 1;
+	if (target > histogram->count)
+		target = histogram->count;
+
+	bucket = 0;
+	while (bucket < MYQTT_METRIC_BUCKETS) {
+		seen += histogram->buckets[bucket];
+		if (seen >= target) {
+			value = __myqtt_metrics_bucket_value (bucket);
+			return value > histogram->max ? histogram->max : value;
+		} /* end if */
+		bucket++;
+	} /* end while */
+
+	return histogram->max;
+}
+
+/** 
+ * @brief Gets how many values recorded on the provided histogram are
+ * below or equal to the provided value.
+ *
+ * The function works with the histogram precision: values recorded on
+ * a bucket that covers the provided value but also higher values are
+ * not counted. This is suitable for rendering cumulative buckets
+ * (like Prometheus "le" buckets) from a snapshot.
+ *
+ * @param histogram The histogram to check.
+ *
+ * @param value The upper bound (inclusive) to check.
+ *
+ * @return The number of values found or 0 if the histogram is empty.
+ */
+long long    myqtt_metrics_count_below       (MyQttHistogram       * histogram,
+					      long long              value)
+{
+	long long seen = 0;
+	int       bucket;
+
+	if (histogram == NULL || histogram->count == 0 || value < 0)
+		return 0;
+	if (value >= histogram->max)
+		return histogram->count;
+
+	bucket = 0;
+	while (bucket < MYQTT_METRIC_BUCKETS && __myqtt_metrics_bucket_value (bucket) <= value) {
+		seen += histogram->buckets[bucket];
+		bucket++;
+	} /* end while */
+
+	return seen;
+}
+
+/** 
+ * @brief Returns a name for the provided counter.
+ */
+const char * myqtt_metrics_counter_name      (MyQttMetricCounter     counter)
+{
+	switch (counter) {
+	case MYQTT_METRIC_MSGS_IN:
+		return "msgs_in";
+	case MYQTT_METRIC_MSGS_OUT:
+		return "msgs_out";
+	case MYQTT_METRIC_BYTES_IN:
+		return "bytes_in";
+	case MYQTT_METRIC_BYTES_OUT:
+		return "bytes_out";
+	default:
+		break;
+	}
+	return "unknown";
+}
+
+/** 
+ * @brief Returns a name for the provided histogram.
+ */
+const char * myqtt_metrics_histogram_name    (MyQttMetricHistogram   histogram)
+{
+	switch (histogram) {
+	case MYQTT_METRIC_PUBLISH:
+		return "publish";
+	case MYQTT_METRIC_STORAGE:
+		return "storage";
+	case MYQTT_METRIC_AUTH:
+		return "auth";
+	case MYQTT_METRIC_SEQUENCER:
+		return "sequencer";
+	default:
+		break;
+	}
+	return "unknown";
+}
+
+/** 
+ * @brief Returns current stamp in microseconds as used by the
+ * metrics module.
+ */
+long long    myqtt_metrics_now               (void)
+{
+	struct timeval stamp;
+
+	gettimeofday (&stamp, NULL);
+	return ((long long) stamp.tv_sec * 1000000) + stamp.tv_usec;
+}
+
+/** 
+ * @} 
+ */
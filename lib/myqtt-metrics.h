@@ -0,0 +1,94 @@
+/* 
+ *  MyQtt: A high performance open source MQTT implementation
+ *  Copyright (C) 2016 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build MQTT enabled solutions contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         C/ Antonio Suarez Nº 10, 
+ *         Edificio Alius A, Despacho 102
+ *         Alcalá de Henares 28802 (Madrid)
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/mqtt
+ *                        http://www.aspl.es/myqtt
+ */
+#ifndef __MYQTT_METRICS_H__
+#define __MYQTT_METRICS_H__
+
+#include <myqtt.h>
+
+/** 
+ * \addtogroup myqtt_metrics
+ * @{
+ */
+
+void         myqtt_metrics_enable            (MyQttCtx             * ctx,
+					      axl_bool               enable);
+
+axl_bool     myqtt_metrics_is_enabled        (MyQttCtx             * ctx);
+
+void         myqtt_metrics_count             (MyQttCtx             * ctx,
+					      MyQttMetricCounter     counter,
+					      long long              value);
+
+void         myqtt_metrics_record            (MyQttCtx             * ctx,
+					      MyQttMetricHistogram   histogram,
+					      long long              usecs);
+
+void         myqtt_metrics_record_since      (MyQttCtx             * ctx,
+					      MyQttMetricHistogram   histogram,
+					      long long              stamp);
+
+axl_bool     myqtt_metrics_snapshot          (MyQttCtx             * ctx,
+					      MyQttMetrics         * snapshot,
+					      axl_bool               reset);
+
+void         myqtt_metrics_merge             (MyQttMetrics         * into,
+					      MyQttMetrics         * from);
+
+long long    myqtt_metrics_percentile        (MyQttHistogram       * histogram,
+					      double                 percentile);
+
+long long    myqtt_metrics_count_below       (MyQttHistogram       * histogram,
+					      long long              value);
+
+const char * myqtt_metrics_counter_name      (MyQttMetricCounter     counter);
+
+const char * myqtt_metrics_histogram_name    (MyQttMetricHistogram   histogram);
+
+long long    myqtt_metrics_now               (void);
+
+/** 
+ * @}
+ */
+
+/*** internal API: don't use it, it may change at any time ***/
+void         __myqtt_metrics_count_msg       (MyQttCtx             * ctx,
+					      axl_bool               incoming,
+					      long long              size);
+
+#endif
@@ -92,6 +92,10 @@ struct _MyQttMsg {
 	/* reference to the topic name in the case this is a PUBLISH
 	 * message */
 	char                * topic_name;
+
+	/* stamp (microseconds) when the message was received (only
+	 * when metrics are enabled) */
+	long long             received;
 };
 
 #endif
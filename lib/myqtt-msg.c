@@ -1014,13 +1014,18 @@ axl_bool             myqtt_msg_send_raw     (MyQttConn * connection, const unsig
  	int          wait_result;
  	int          tries    = 3;
  	axlPointer   on_write = NULL;
+	int          token;
 
 	v_return_val_if_fail (connection, axl_false);
 	v_return_val_if_fail (myqtt_conn_is_ok (connection, axl_false), axl_false);
 	v_return_val_if_fail (a_msg, axl_false);
 
+	/* identify this send operation so the transport can tell
+	 * its retries apart */
+	token = __myqtt_conn_next_send_token (connection);
+
  again:
-	if ((bytes = myqtt_conn_invoke_send (connection, a_msg + total, msg_size - total)) < 0) {
+	if ((bytes = __myqtt_conn_invoke_send_token (connection, token, a_msg + total, msg_size - total)) < 0) {
 		if (errno == MYQTT_EINTR)
 			goto again;
  		if ((errno == MYQTT_EWOULDBLOCK) || (errno == MYQTT_EAGAIN) || (bytes == -2)) {
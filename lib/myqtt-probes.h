@@ -0,0 +1,78 @@
+/* 
+ *  MyQtt: A high performance open source MQTT implementation
+ *  Copyright (C) 2016 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build MQTT enabled solutions contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         C/ Antonio Suarez Nº 10, 
+ *         Edificio Alius A, Despacho 102
+ *         Alcalá de Henares 28802 (Madrid)
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/mqtt
+ *                        http://www.aspl.es/myqtt
+ */
+#ifndef __MYQTT_PROBES_H__
+#define __MYQTT_PROBES_H__
+
+/** 
+ * @internal Static tracepoints (USDT) placed on libMyQtt hot paths.
+ *
+ * Probes are only compiled when the library is configured with
+ * --enable-usdt (ENABLE_MYQTT_USDT defined and sys/sdt.h
+ * available). Otherwise, all macros expand to nothing.
+ *
+ * When compiled, each probe is a single nop instruction that is only
+ * patched when a tracer (bpftrace, perf, systemtap) attaches to it,
+ * so arguments passed must be values already at hand (no function
+ * calls, no formatting). All probes are registered under the "myqtt"
+ * provider:
+ *
+ * - conn_open (conn_id, role, socket)
+ * - conn_close (conn_id, status)
+ * - frame_received (conn_id, type, size)
+ * - ack_received (conn_id, type, packet_id)
+ * - publish_dispatch (topic, qos, size)
+ * - publish_done (topic, delivered)
+ * - subscriber_enqueue (conn_id, topic, qos)
+ * - socket_write (conn_id, requested, written)
+ * - storage_store (client_id, packet_id, size)
+ * - storage_release (client_id, size)
+ *
+ * See doc/bpftrace/ for sample scripts.
+ */
+#if defined(ENABLE_MYQTT_USDT)
+#include <sys/sdt.h>
+
+#define MYQTT_PROBE2(name,a,b)       DTRACE_PROBE2 (myqtt, name, a, b)
+#define MYQTT_PROBE3(name,a,b,c)     DTRACE_PROBE3 (myqtt, name, a, b, c)
+#else
+#define MYQTT_PROBE2(name,a,b)
+#define MYQTT_PROBE3(name,a,b,c)
+#endif
+
+#endif
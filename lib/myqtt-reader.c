@@ -42,6 +42,7 @@
 #include <myqtt-ctx-private.h>
 #include <myqtt-conn-private.h>
 #include <myqtt-msg-private.h>
+#include <myqtt-probes.h>
 
 #define LOG_DOMAIN "myqtt-reader"
 
@@ -67,7 +68,8 @@ typedef enum {
 	TERMINATE, 
 	IO_WAIT_CHANGED,
 	IO_WAIT_READY,
-	FOREACH
+	FOREACH,
+	UNBLOCK
 } WatchType;
 
 typedef struct _MyQttReaderData {
@@ -373,6 +375,7 @@ void __myqtt_reader_handle_connect (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg *
 	int                 desp;
 	int                 connect_flags_index;
 	char              * payload;
+	long long           stamp;
 	
 
 	/* const char * username = NULL;
@@ -513,7 +516,9 @@ void __myqtt_reader_handle_connect (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg *
 	if (ctx->on_connect) {
 		/* call to user level application to decide about this
 		 * new request */
+		stamp    = ctx->metrics_enabled ? myqtt_metrics_now () : 0;
 		response = ctx->on_connect (ctx, conn, ctx->on_connect_data);
+		myqtt_metrics_record_since (ctx, MYQTT_METRIC_AUTH, stamp);
 	} /* end if */
 
 	/* after on_connect has finished, clear password */
@@ -624,6 +629,7 @@ void __myqtt_reader_subscribe (MyQttCtx * ctx, const char * client_identifier, M
 	axlHash   * hash;
 	axlHash   * sub_hash;
 	axl_bool    should_release = axl_true;
+	int         added          = 0;
 
 	if (ctx == NULL || topic_filter == NULL)
 		return;
@@ -636,11 +642,19 @@ void __myqtt_reader_subscribe (MyQttCtx * ctx, const char * client_identifier, M
 		/** CONNECTION REGISTRY **/
 		/* reached this point, subscription is accepted */
 		myqtt_mutex_lock (&conn->op_mutex);
-		if ((strstr (topic_filter, "#") != NULL) || (strstr (topic_filter, "+") != NULL))
+		if ((strstr (topic_filter, "#") != NULL) || (strstr (topic_filter, "+") != NULL)) {
+			added = axl_hash_exists (conn->wild_subs, (axlPointer) topic_filter) ? 0 : 1;
 			axl_hash_insert_full (conn->wild_subs, (axlPointer) topic_filter, axl_free, INT_TO_PTR (qos), NULL);
-		else
+		} else {
+			added = axl_hash_exists (conn->subs, (axlPointer) topic_filter) ? 0 : 1;
 			axl_hash_insert_full (conn->subs, (axlPointer) topic_filter, axl_free, INT_TO_PTR (qos), NULL);
+		} /* end if */
 		myqtt_mutex_unlock (&conn->op_mutex);
+
+		/* account subscription installed (replacing a
+		 * previous one with the same topic filter is not a
+		 * new subscription) */
+		__myqtt_ctx_subs_update (ctx, added);
 	} /* end if */
 
 	/** CONTEXT REGISTRY **/
@@ -1120,6 +1134,7 @@ void __myqtt_reader_handle_wait_reply (MyQttCtx * ctx, MyQttConn * conn, MyQttMs
 		msg->packet_id = -1;
 	else
 		msg->packet_id = myqtt_get_16bit (msg->payload);
+	MYQTT_PROBE3 (ack_received, conn->id, msg->type, msg->packet_id);
 	myqtt_log (MYQTT_LEVEL_DEBUG, "Pushing %s msg=%d, for packet-id=%d conn-id=%d conn=%p", myqtt_msg_get_type_str (msg), msg->id, msg->packet_id, conn->id, conn);
 
 	/* now call to wait queue if defined */
@@ -1215,6 +1230,7 @@ void __myqtt_reader_handle_unsubscribe (MyQttCtx * ctx, MyQttConn * conn, MyQttM
 	axlHash                * sub_hash;
 	unsigned char          * reply;
 	int                      size;
+	int                      removed;
 
 	/* check if this is a listener */
 	if (conn->role != MyQttRoleListener) {
@@ -1273,12 +1289,17 @@ void __myqtt_reader_handle_unsubscribe (MyQttCtx * ctx, MyQttConn * conn, MyQttM
 			
 
 		/* CONNECTION CONTEXT: remove subscription from the connection */
+		removed = 0;
 		myqtt_mutex_lock (&conn->op_mutex);
-		if ((strstr (topic_filter, "#") != NULL) || (strstr (topic_filter, "+") != NULL))
+		if ((strstr (topic_filter, "#") != NULL) || (strstr (topic_filter, "+") != NULL)) {
+			removed = axl_hash_exists (conn->wild_subs, topic_filter) ? 1 : 0;
 			axl_hash_remove (conn->wild_subs, topic_filter);
-		else
+		} else {
+			removed = axl_hash_exists (conn->subs, topic_filter) ? 1 : 0;
 			axl_hash_remove (conn->subs, topic_filter);
+		} /* end if */
 		myqtt_mutex_unlock (&conn->op_mutex);
+		__myqtt_ctx_subs_update (ctx, - removed);
 
 		/* CONTEXT: lock subscribtions to remove connection subscription */
 		myqtt_mutex_lock (&ctx->subs_m);
@@ -1403,9 +1424,10 @@ axl_bool __myqtt_reader_handle_retained_msg (MyQttCtx * ctx, MyQttMsg * msg)
 } /* end if */
 
 /** @internal call to do publish with the provided connection pointed
- * by the provided cursor and message
+ * by the provided cursor and message. Returns axl_true if the message
+ * was sent.
  */
-void __myqtt_reader_do_publish_aux (MyQttCtx * ctx, axlHashCursor * cursor, MyQttMsg * msg)
+axl_bool __myqtt_reader_do_publish_aux (MyQttCtx * ctx, axlHashCursor * cursor, MyQttMsg * msg)
 {
 	MyQttQos    qos;
 	MyQttConn * conn;
@@ -1415,7 +1437,7 @@ void __myqtt_reader_do_publish_aux (MyQttCtx * ctx, axlHashCursor * cursor, MyQt
 	
 	/* skip connection because it is not ok */
 	if (! myqtt_conn_is_ok (conn, axl_false)) 
-		return;
+		return axl_false;
 	
 	/* get qos to publish */
 	qos  = msg->qos;
@@ -1434,10 +1456,13 @@ void __myqtt_reader_do_publish_aux (MyQttCtx * ctx, axlHashCursor * cursor, MyQt
 		   msg->topic_name, qos, msg->app_message_size, conn);
 	
 	/* retain = axl_false always : MQTT-2.1.2-11 */
-	if (! myqtt_conn_pub (conn, msg->topic_name, (axlPointer) msg->app_message, msg->app_message_size, qos, axl_false, 60))
+	if (! myqtt_conn_pub (conn, msg->topic_name, (axlPointer) msg->app_message, msg->app_message_size, qos, axl_false, 60)) {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to publish message message, errno=%d", errno); 
+		return axl_false;
+	} /* end if */
+	MYQTT_PROBE3 (subscriber_enqueue, conn->id, msg->topic_name, qos);
 	
-	return;
+	return axl_true;
 }
       
 
@@ -1452,6 +1477,7 @@ void __myqtt_reader_do_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg
 	axlHashCursor          * cursor2;
 	const char             * topic_filter;
 	axl_bool                 someone_subscribed = axl_false;
+	int                      delivered          = 0;
 
 	/**** SERVER HANDLING ****
 	 *
@@ -1463,6 +1489,7 @@ void __myqtt_reader_do_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg
 	 *
 	 * In short, the code ensures these hashes are static structures.
 	 */
+	MYQTT_PROBE3 (publish_dispatch, msg->topic_name, msg->qos, msg->app_message_size);
 
 	/* check for packages with retain flag */
 	if (msg->retain) {
@@ -1486,7 +1513,8 @@ void __myqtt_reader_do_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg
 		while (axl_hash_cursor_has_item (cursor)) {
 			
 			/* call to do publish */
-			__myqtt_reader_do_publish_aux (ctx, cursor, msg);
+			if (__myqtt_reader_do_publish_aux (ctx, cursor, msg))
+				delivered++;
 			someone_subscribed = axl_true;
 			
 			/* next item */
@@ -1518,7 +1546,8 @@ void __myqtt_reader_do_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg
 		while (axl_hash_cursor_has_item (cursor2)) {
 			
 			/* call to do publish */
-			__myqtt_reader_do_publish_aux (ctx, cursor2, msg);
+			if (__myqtt_reader_do_publish_aux (ctx, cursor2, msg))
+				delivered++;
 			someone_subscribed = axl_true;
 			
 			/* next connection */
@@ -1569,6 +1598,15 @@ void __myqtt_reader_do_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg
 	ctx->publish_ops--;
 	myqtt_mutex_unlock (&ctx->subs_m);
 
+	/* account deliveries (without contending with
+	 * subscriptions) */
+	if (delivered > 0)
+		MYQTT_ATOMIC_ADD (ctx, ctx->delivered_msgs, delivered);
+
+	/* record ingress to egress time */
+	myqtt_metrics_record_since (ctx, MYQTT_METRIC_PUBLISH, msg->received);
+	MYQTT_PROBE2 (publish_done, msg->topic_name, delivered);
+
 	if (! someone_subscribed) {
 		/* no one interested in this, no one subscribed to received this */
 		myqtt_log (MYQTT_LEVEL_DEBUG, "Published topic name '%s' but no one was subscribed to it", msg->topic_name);
@@ -1990,6 +2028,14 @@ void __myqtt_reader_process_socket (MyQttCtx  * ctx,
 	}
 
 	/* printf ("myqtt_msg_get_next (conn), remaining_bytes=%d, bytes_read=%d, conn-id=%d : %s\n", conn->remaining_bytes, conn->bytes_read, myqtt_conn_get_id (conn), myqtt_msg_get_type_str (msg)); */
+
+	MYQTT_PROBE3 (frame_received, conn->id, msg->type, msg->size);
+
+	/* account message received */
+	if (ctx->metrics_enabled) {
+		__myqtt_metrics_count_msg (ctx, axl_true, msg->size);
+		msg->received = myqtt_metrics_now ();
+	} /* end if */
 	
 	/* myqtt_log (MYQTT_LEVEL_DEBUG, "Handling message received %p, type: %s", msg, myqtt_msg_get_type_str (msg)); */
 
@@ -2125,6 +2171,12 @@ axl_bool   myqtt_reader_register_watch (MyQttReaderData * data, axlList * conn_l
 	case FOREACH:
 		/* just unref myqtt reader data */
 		break;
+	case UNBLOCK:
+		/* watch again the connection (it is already in
+		 * conn_list), flag cleared from the reader thread */
+		connection->is_blocked = axl_false;
+		myqtt_conn_unref (connection, "myqtt reader (unblock)");
+		break;
 	} /* end switch */
 	
 	axl_free (data);
@@ -2615,28 +2667,49 @@ void       __myqtt_reader_remove_conn_from_hash (MyQttConn * conn, axlHashCursor
 	return;
 }
 
-/* publish will if defined */
-void __myqtt_reader_check_and_trigger_will (MyQttCtx * ctx, MyQttConn * conn)
+/** 
+ * @brief Allows to publish a message from the server side (without a
+ * connection sending it) to all subscribers of the provided context,
+ * the same way it is done with PUBLISH messages received.
+ *
+ * @param ctx The context where the operation takes place. It must be
+ * a context where storage was loaded (server side, see \ref myqtt_storage_load).
+ *
+ * @param topic_name The topic name to publish.
+ *
+ * @param app_msg The application message to publish.
+ *
+ * @param app_msg_size The application message size.
+ *
+ * @param qos The publish qos.
+ *
+ * @param retain axl_true to handle the message as retained.
+ *
+ * @return axl_true if the message was published, otherwise axl_false
+ * is returned.
+ */
+axl_bool myqtt_reader_publish (MyQttCtx            * ctx,
+			       const char          * topic_name,
+			       const unsigned char * app_msg,
+			       int                   app_msg_size,
+			       MyQttQos              qos,
+			       axl_bool              retain)
 {
-	MyQttMsg * msg;
+	MyQttMsg      * msg;
+	unsigned char * content;
 
-	/* do not trigger will if it is not defined if it is a
-	 * initiator */
-	if (ctx->myqtt_exit)
-		return;
-	if (conn->role == MyQttRoleInitiator)
-		return;
-	if (conn->will_topic == NULL)
-		return;
+	if (ctx == NULL || topic_name == NULL || app_msg_size < 0 || ctx->subs == NULL)
+		return axl_false;
 
 	/* prepare message */
 	msg = axl_new (MyQttMsg, 1);
 	if (msg == NULL)
-		return;
+		return axl_false;
 	
 	/* configure message */
 	msg->type      = MYQTT_PUBLISH;
-	msg->qos       = conn->will_qos;
+	msg->qos       = qos;
+	msg->retain    = retain;
 	msg->ref_count = 1;
 	myqtt_mutex_create (&(msg->mutex));
 	msg->id        = __myqtt_msg_get_next_id (ctx, "get-next");
@@ -2646,20 +2719,42 @@ void __myqtt_reader_check_and_trigger_will (MyQttCtx * ctx, MyQttConn * conn)
 	myqtt_ctx_ref2 (ctx, "new msg");
 
 	/* setup app messages and topic */
-	msg->app_message      = (unsigned char *) axl_strdup (conn->will_msg);
-	msg->app_message_size = conn->will_msg ? strlen (conn->will_msg) : 0;
+	content               = axl_new (unsigned char, app_msg_size + 1);
+	if (app_msg_size > 0)
+		memcpy (content, app_msg, app_msg_size);
+	msg->app_message      = content;
+	msg->app_message_size = app_msg_size;
 	msg->size             = msg->app_message_size;
 	msg->payload          = msg->app_message;
 
 	/* configure topic */
-	msg->topic_name       = axl_strdup (conn->will_topic);
+	msg->topic_name       = axl_strdup (topic_name);
 
 	/* call to publish */
-	__myqtt_reader_do_publish (ctx, conn, msg);
+	__myqtt_reader_do_publish (ctx, NULL, msg);
 
 	/* release message */
 	myqtt_msg_unref (msg);	
 
+	return axl_true;
+}
+
+/* publish will if defined */
+void __myqtt_reader_check_and_trigger_will (MyQttCtx * ctx, MyQttConn * conn)
+{
+	/* do not trigger will if it is not defined if it is a
+	 * initiator */
+	if (ctx->myqtt_exit)
+		return;
+	if (conn->role == MyQttRoleInitiator)
+		return;
+	if (conn->will_topic == NULL)
+		return;
+
+	/* call to publish */
+	myqtt_reader_publish (ctx, conn->will_topic, (const unsigned char *) conn->will_msg, 
+			      conn->will_msg ? strlen (conn->will_msg) : 0, conn->will_qos, axl_false);
+
 	return;
 }
 
@@ -2675,6 +2770,9 @@ axlPointer __myqtt_reader_remove_conn_refs_aux (axlPointer _conn)
 	/* get context reference */
 	ctx = conn->ctx;
 
+	/* subscriptions of this connection are no longer installed */
+	__myqtt_ctx_subs_update (ctx, - (axl_hash_items (conn->subs) + axl_hash_items (conn->wild_subs)));
+
 	if (axl_hash_items (conn->subs) > 0) {
 		/* create cursor */
 		cursor = axl_hash_cursor_new (conn->subs);
@@ -2897,6 +2995,60 @@ MYQTT_SOCKET   __myqtt_reader_build_set_to_watch (MyQttCtx     * ctx,
 	
 }
 
+/** 
+ * @internal Max number of passes done over connections with
+ * content on their transport read buffer before going back to the
+ * I/O waiting mechanism.
+ */
+#define MYQTT_READER_BUFFERED_PASSES 64
+
+/** 
+ * @internal Process connections that have content already read from
+ * the transport (see myqtt_conn_set_read_buffer). That content is no
+ * longer on the socket so the I/O waiting mechanism won't report it.
+ *
+ * @return axl_true if, after all passes, there are still connections
+ * with content buffered.
+ */
+axl_bool __myqtt_reader_process_buffered (MyQttCtx      * ctx,
+					  axlListCursor * conn_cursor)
+{
+	MyQttConn * connection;
+	axl_bool    pending = axl_true;
+	int         passes  = 0;
+
+	while (pending && passes < MYQTT_READER_BUFFERED_PASSES) {
+		pending = axl_false;
+		passes++;
+
+		axl_list_cursor_first (conn_cursor);
+		while (axl_list_cursor_has_item (conn_cursor)) {
+			connection = axl_list_cursor_get (conn_cursor);
+
+			/* skip broken, unwatched or blocked
+			 * connections: they are handled when the
+			 * watching set is built */
+			if (myqtt_conn_is_ok (connection, axl_false) &&
+			    ! connection->reader_unwatch &&
+			    ! myqtt_conn_is_blocked (connection) &&
+			    myqtt_conn_has_pending_data (connection)) {
+
+				/* process next message buffered */
+				__myqtt_reader_process_socket (ctx, connection);
+
+				/* check if there is more */
+				if (myqtt_conn_has_pending_data (connection))
+					pending = axl_true;
+			} /* end if */
+
+			/* get the next */
+			axl_list_cursor_next (conn_cursor);
+		} /* end while */
+	} /* end while */
+
+	return pending;
+}
+
 void __myqtt_reader_check_connection_list (MyQttCtx     * ctx,
 					    axlPointer      on_reading, 
 					    axlListCursor * conn_cursor, 
@@ -3174,6 +3326,7 @@ axlPointer __myqtt_reader_run (MyQttCtx * ctx)
 	MYQTT_SOCKET      max_fds     = 0;
 	MYQTT_SOCKET      result;
 	int                error_tries = 0;
+	axl_bool           buffered    = axl_false;
 
 	/* initialize the read set */
 	if (ctx->on_reading != NULL)
@@ -3213,6 +3366,10 @@ axlPointer __myqtt_reader_run (MyQttCtx * ctx)
 			goto __myqtt_reader_run_first_connection;
 		}
 
+		/* process content already buffered by transports
+		 * (TLS, WebSocket) before waiting on sockets */
+		buffered = __myqtt_reader_process_buffered (ctx, ctx->conn_cursor);
+
 		/* build socket descriptor to be read */
 		max_fds = __myqtt_reader_build_set_to_watch (ctx, ctx->on_reading, ctx->conn_cursor, ctx->srv_cursor);
 		if (errno == EBADF) {
@@ -3221,9 +3378,14 @@ axlPointer __myqtt_reader_run (MyQttCtx * ctx)
 			__myqtt_reader_detect_and_cleanup_connections (ctx);
 			continue;
 		} /* end if */
-		
-		/* perform IO blocking wait for read operation */
-		result = myqtt_io_waiting_invoke_wait (ctx, ctx->on_reading, max_fds, READ_OPERATIONS);
+
+		/* perform IO blocking wait for read operation (if
+		 * there is still content buffered, just check sockets
+		 * without blocking so that content is not delayed) */
+		if (buffered)
+			result = myqtt_io_waiting_invoke_wait (ctx, ctx->on_reading, max_fds, READ_OPERATIONS | NOWAIT_OPERATIONS);
+		else
+			result = myqtt_io_waiting_invoke_wait (ctx, ctx->on_reading, max_fds, READ_OPERATIONS);
 
 		/* do automatic thread pool resize here */
 		__myqtt_thread_pool_automatic_resize (ctx);  
@@ -3667,6 +3829,38 @@ void myqtt_reader_notify_change_done_io_api   (MyQttCtx * ctx)
 	return;
 }
 
+/** 
+ * @internal Asks the reader to watch again a connection that was
+ * blocked (is_blocked) by the reader thread itself. The flag is
+ * cleared by the reader thread so the caller doesn't wait for it.
+ *
+ * @param ctx The context where the operation will be implemented.
+ *
+ * @param conn The connection to unblock.
+ *
+ * @return axl_true if the request was queued, otherwise axl_false
+ * (reader not running or connection reference failed).
+ */
+axl_bool           __myqtt_reader_unblock_connection (MyQttCtx  * ctx,
+						      MyQttConn * conn)
+{
+	MyQttReaderData * data;
+
+	if (ctx == NULL || ctx->reader_queue == NULL || myqtt_is_exiting (ctx))
+		return axl_false;
+
+	/* reference released by the reader */
+	if (! myqtt_conn_ref (conn, "myqtt reader (unblock)"))
+		return axl_false;
+
+	data             = axl_new (MyQttReaderData, 1);
+	data->type       = UNBLOCK;
+	data->connection = conn;
+	QUEUE_PUSH (ctx->reader_queue, data);
+
+	return axl_true;
+}
+
 /** 
  * @internal Function that allows to preform a foreach operation over
  * all connections handled by the myqtt reader.
@@ -98,9 +98,18 @@ void               __myqtt_reader_subscribe (MyQttCtx   * ctx,
 
 void __myqtt_reader_move_offline_to_online  (MyQttCtx * ctx, MyQttConn * conn);
 
+axl_bool __myqtt_reader_unblock_connection (MyQttCtx * ctx, MyQttConn * conn);
+
 axl_bool myqtt_reader_is_wrong_topic  (const char * topic_filter);
 
 axl_bool myqtt_reader_topic_filter_match (const char * topic_name, const char * topic_filter);
 
+axl_bool myqtt_reader_publish            (MyQttCtx            * ctx,
+					  const char          * topic_name,
+					  const unsigned char * app_msg,
+					  int                   app_msg_size,
+					  MyQttQos              qos,
+					  axl_bool              retain);
+
 
 #endif
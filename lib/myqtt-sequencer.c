@@ -44,6 +44,73 @@
 
 #define LOG_DOMAIN "myqtt-sequencer"
 
+/** 
+ * @internal Time (microseconds) a message can stay blocked on a
+ * token aware transport before the connection is closed (same limit
+ * myqtt_msg_send_raw applies: 3 tries of 1 second).
+ */
+#define MYQTT_SEQUENCER_WRITE_TIMEOUT 3000000
+
+/** 
+ * @internal Sends the next step of the provided message on a token
+ * aware transport without blocking when the socket is not writable.
+ *
+ * @return Bytes written, 0 if the message is blocked and must be
+ * retried later or -1 on failure (connection is shutdown).
+ */
+int __myqtt_sequencer_send_token (MyQttCtx * ctx, MyQttConn * conn, MyQttSequencerData * data, int size)
+{
+	int       result;
+	long long now;
+
+	/* first attempt: get a token for this operation */
+	if (data->token == 0)
+		data->token = __myqtt_conn_next_send_token (conn);
+
+	result = __myqtt_conn_invoke_send_token (conn, data->token, data->message + data->step, size);
+	if (result > 0) {
+		/* notify content written */
+		myqtt_conn_set_receive_stamp (conn, 0, result);
+
+		data->token   = 0;
+		data->blocked = 0;
+		return result;
+	} /* end if */
+
+	if (result == -2 && myqtt_conn_is_ok (conn, axl_false)) {
+		/* not writable yet, check how long */
+		now = myqtt_metrics_now ();
+		if (data->blocked == 0)
+			data->blocked = now;
+		if ((now - data->blocked) < MYQTT_SEQUENCER_WRITE_TIMEOUT)
+			return 0;
+
+		__myqtt_conn_shutdown_and_record_error (
+			conn, MyQttError,
+			"found timeout while waiting to perform write operation and maximum tries were reached");
+		return -1;
+	} /* end if */
+
+	__myqtt_conn_shutdown_and_record_error (conn, MyQttError, "unable to write data to socket");
+	return -1;
+}
+
+/** 
+ * @internal Checks if the connection is on the provided list.
+ */
+axl_bool __myqtt_sequencer_is_blocked (axlList * blocked, MyQttConn * conn)
+{
+	int iterator = 0;
+
+	while (iterator < axl_list_length (blocked)) {
+		if (axl_list_get_nth (blocked, iterator) == conn)
+			return axl_true;
+		iterator++;
+	} /* end while */
+
+	return axl_false;
+}
+
 axl_bool myqtt_sequencer_queue_data (MyQttCtx * ctx, MyQttSequencerData * data)
 {
 	v_return_val_if_fail (data, axl_false);
@@ -81,6 +148,10 @@ axl_bool myqtt_sequencer_queue_data (MyQttCtx * ctx, MyQttSequencerData * data)
 	data->conn->sequencer_messages++;
 	myqtt_mutex_unlock (&data->conn->op_mutex);
 
+	/* stamp message to measure queue wait */
+	if (ctx->metrics_enabled)
+		data->queued = myqtt_metrics_now ();
+
 	/* lock connection and queue message */
 	myqtt_mutex_lock (&ctx->pending_messages_m);
 
@@ -152,6 +223,114 @@ axl_bool myqtt_sequencer_send                     (MyQttConn            * conn,
 	return axl_true;
 }
 
+/** 
+ * @internal Queues count messages for the same connection with a
+ * single sequencer operation: one op_mutex update, one
+ * pending_messages lock and one signal for the whole set. As with
+ * myqtt_sequencer_send, provided msgs are now owned by this function
+ * even if it fails (in which case nothing is queued).
+ */
+axl_bool myqtt_sequencer_send_batch               (MyQttConn            * conn, 
+						   MyQttMsgType           type,
+						   unsigned char       ** msgs, 
+						   int                  * msg_sizes,
+						   int                    count)
+{
+	MyQttSequencerData ** items;
+	MyQttCtx            * ctx;
+	int                   iterator;
+	int                   refs = 0;
+	long long             queued;
+
+	if (conn == NULL || msgs == NULL || msg_sizes == NULL || count <= 0) {
+		/* free build */
+		iterator = 0;
+		while (msgs && msg_sizes && iterator < count) {
+			axl_free (msgs[iterator]);
+			iterator++;
+		} /* end while */
+		return axl_false;
+	} /* end if */
+
+	/* acquire reference to the context */
+	ctx = conn->ctx;
+
+	/* check state before handling these messages */
+	if (ctx->myqtt_exit) {
+		myqtt_log (MYQTT_LEVEL_WARNING, "Not queueing data because this myqtt instance is finishing..");
+		goto release_msgs;
+	} /* end if */
+
+	items = axl_new (MyQttSequencerData *, count);
+	if (items == NULL) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to acquire memory to send messages");
+		goto release_msgs;
+	} /* end if */
+
+	/* configure packages to send, acquiring a connection
+	 * reference for each one (released by the sequencer as it
+	 * happens with myqtt_sequencer_queue_data) */
+	queued   = ctx->metrics_enabled ? myqtt_metrics_now () : 0;
+	iterator = 0;
+	while (iterator < count) {
+		items[iterator] = axl_new (MyQttSequencerData, 1);
+		if (items[iterator] == NULL || ! myqtt_conn_ref (conn, "sequencer")) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Not queueing data, failed to prepare message %d of %d for conn-id=%d",
+				   iterator, count, conn->id);
+			axl_free (items[iterator]);
+			break;
+		} /* end if */
+		refs++;
+
+		items[iterator]->conn         = conn;
+		items[iterator]->message      = msgs[iterator];
+		items[iterator]->message_size = msg_sizes[iterator];
+		items[iterator]->type         = type;
+		items[iterator]->queued       = queued;
+		iterator++;
+	} /* end while */
+
+	if (refs != count) {
+		/* release what was prepared */
+		iterator = 0;
+		while (iterator < refs) {
+			myqtt_conn_unref (conn, "sequencer");
+			axl_free (items[iterator]);
+			iterator++;
+		} /* end while */
+		axl_free (items);
+		goto release_msgs;
+	} /* end if */
+
+	/* increase pending messages to be sent */
+	myqtt_mutex_lock (&conn->op_mutex);
+	conn->sequencer_messages += count;
+	myqtt_mutex_unlock (&conn->op_mutex);
+
+	/* queue all messages */
+	myqtt_mutex_lock (&ctx->pending_messages_m);
+	iterator = 0;
+	while (iterator < count) {
+		axl_list_append (ctx->pending_messages, items[iterator]);
+		iterator++;
+	} /* end while */
+	myqtt_mutex_unlock (&ctx->pending_messages_m);
+
+	/* signal sequencer to move on! */
+	myqtt_cond_signal (&ctx->pending_messages_c);
+
+	axl_free (items);
+	return axl_true;
+
+ release_msgs:
+	iterator = 0;
+	while (iterator < count) {
+		myqtt_msg_free_build (ctx, msgs[iterator], msg_sizes[iterator]);
+		iterator++;
+	} /* end while */
+	return axl_false;
+}
+
 axlPointer __myqtt_sequencer_run (axlPointer _data)
 {
 
@@ -163,10 +342,16 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 	MyQttSequencerData   * data;
 	MyQttConn            * conn;
 	int                    size;
+	int                    result;
+	axlList              * blocked;
+	axl_bool               progress;
 
 	/* get a cursor */
 	cursor = axl_list_cursor_new (ctx->pending_messages);
 
+	/* connections with a message blocked on the current pass */
+	blocked = axl_list_new (axl_list_equal_ptr, NULL);
+
 	/* lock mutex to handle pending messages */
 	myqtt_mutex_lock (&ctx->pending_messages_m);
 
@@ -191,6 +376,7 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 
 			/* release cursor */
 			axl_list_cursor_free (cursor);
+			axl_list_free (blocked);
 			
 			myqtt_log (MYQTT_LEVEL_DEBUG, "exiting myqtt sequencer thread ..");
 
@@ -201,6 +387,7 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 		} /* end if */
 
 		/* process all ready connections */
+		progress = axl_false;
 		axl_list_cursor_first (cursor);
 		while (axl_list_cursor_has_item (cursor)) {
 
@@ -208,6 +395,13 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 			data    = axl_list_cursor_get (cursor);
 			conn    = data->conn;
 
+			/* keep order: skip messages queued after one
+			 * blocked for the same connection */
+			if (__myqtt_sequencer_is_blocked (blocked, conn)) {
+				axl_list_cursor_next (cursor);
+				continue;
+			} /* end if */
+
 			/* check connection is working */
 			if (! myqtt_conn_is_ok (conn, axl_false)) {
 				myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to send MQTT %s message, connection is not working, closing (conn=%p, conn-id=%d, size=%d)",
@@ -215,16 +409,40 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 				goto release_message;
 			} /* end if */
 
-			/* write step */
-			if ((data->message_size - data->step) > 4096)
+			/* record queue wait when starting to write */
+			if (data->step == 0 && data->queued > 0) {
+				myqtt_metrics_record_since (ctx, MYQTT_METRIC_SEQUENCER, data->queued);
+				data->queued = 0;
+			} /* end if */
+
+			/* write step (framing transports get the whole
+			 * message so it travels on a single frame) */
+			if (! conn->send_whole_msg && (data->message_size - data->step) > 4096)
 				size = 4096;
 			else
 				size = data->message_size - data-> step;
 
 			myqtt_log (MYQTT_LEVEL_DEBUG, "Sending %s (%s): size=%d, message-size=%d, step=%d, conn-id=%d", 
-				   ((data->message_size - data->step) > 4096) ? "fragment" : "complete msg",
+				   (size < (data->message_size - data->step)) ? "fragment" : "complete msg",
 				   myqtt_msg_get_type_str2 (data->type), size, data->message_size, data->step, conn->id);
-			if (! myqtt_msg_send_raw (conn, data->message + data->step, size)) {
+			if (conn->send_token) {
+				/* token aware transports (WebSocket) are
+				 * not waited here: a connection that is
+				 * not writable must not delay the rest */
+				result = __myqtt_sequencer_send_token (ctx, conn, data, size);
+				if (result < 0) {
+					myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to send MQTT message (type: %d, size: %d (total: %d), step: %d) error was errno=%d",  
+						   data->type, size, data->message_size, data->step, errno); 
+					goto release_message;
+				} /* end if */
+				if (result == 0) {
+					/* blocked, retry on next pass */
+					axl_list_append (blocked, conn);
+					axl_list_cursor_next (cursor);
+					continue;
+				} /* end if */
+				size = result;
+			} else if (! myqtt_msg_send_raw (conn, data->message + data->step, size)) {
 				myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to send MQTT message (type: %d, size: %d (total: %d), step: %d) error was errno=%d",  
 					   data->type, size, data->message_size, data->step, errno); 
 				goto release_message;
@@ -278,9 +496,12 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 			
 			/* increase step */
 			data->step += size;
+			progress    = axl_true;
 
 			/* check if we have finished with this data to be sent */
 			if (data->step == data->message_size) {
+				/* account message sent */
+				__myqtt_metrics_count_msg (ctx, axl_false, data->message_size);
 
 			release_message:
 				/* notify message sent */
@@ -309,6 +530,13 @@ axlPointer __myqtt_sequencer_run (axlPointer _data)
 			/* call to get next */
 			axl_list_cursor_next (cursor);
 		} /* end while */
+
+		/* only blocked messages remain: wait a bit (or until a
+		 * new message is queued) before retrying them */
+		if (! progress && axl_list_length (blocked) > 0 && axl_list_length (ctx->pending_messages) > 0)
+			myqtt_cond_timedwait (&ctx->pending_messages_c, &ctx->pending_messages_m, 10000);
+		while (axl_list_length (blocked) > 0)
+			axl_list_unlink_first (blocked);
 		
 	} /* end while */
 
@@ -345,6 +573,28 @@ axl_bool  myqtt_sequencer_run (MyQttCtx * ctx)
 }
 
 
+/** 
+ * @brief Allows to get the number of messages queued into the
+ * sequencer, waiting to be written.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @return Number of messages queued or -1 if it fails.
+ */
+int      myqtt_sequencer_queue_depth (MyQttCtx * ctx)
+{
+	int depth;
+
+	if (ctx == NULL || ctx->pending_messages == NULL)
+		return -1;
+
+	myqtt_mutex_lock (&ctx->pending_messages_m);
+	depth = axl_list_length (ctx->pending_messages);
+	myqtt_mutex_unlock (&ctx->pending_messages_m);
+
+	return depth;
+}
+
 /** 
  * @internal
  * @brief Stop myqtt sequencer process.
@@ -49,6 +49,12 @@ axl_bool myqtt_sequencer_send                     (MyQttConn            * conn,
 						   unsigned char        * msg, 
 						   int                    msg_size);
 
+axl_bool myqtt_sequencer_send_batch               (MyQttConn            * conn, 
+						   MyQttMsgType           type,
+						   unsigned char       ** msgs, 
+						   int                  * msg_sizes,
+						   int                    count);
+
 axl_bool myqtt_sequencer_run                      (MyQttCtx * ctx);
 
 void     myqtt_sequencer_stop                     (MyQttCtx * ctx);
@@ -58,6 +64,8 @@ axl_bool myqtt_sequencer_direct_send              (MyQttConn       * conn,
 
 void     myqtt_sequencer_signal_update            (MyQttConn    * conn);
 
+int      myqtt_sequencer_queue_depth              (MyQttCtx     * ctx);
+
 #endif
 
 
@@ -39,6 +39,7 @@
 #include <myqtt-storage.h>
 #include <myqtt-conn-private.h>
 #include <myqtt-ctx-private.h>
+#include <myqtt-probes.h>
 #include <dirent.h>
 
 /*
@@ -116,6 +117,16 @@ int __myqtt_storage_check (MyQttCtx * ctx, const char * client_identifier, axl_b
 	return axl_true; /* everything ok */
 }
 
+/** 
+ * @internal Updates the provided storage gauge (see \ref
+ * myqtt_storage_backlog and \ref myqtt_storage_retained_count).
+ */
+void __myqtt_storage_gauge_update (MyQttCtx * ctx, int * gauge, int value)
+{
+	MYQTT_ATOMIC_ADD_POSITIVE (ctx, (*gauge), value);
+	return;
+}
+
 axl_bool __myqtt_storage_init_base_storage (MyQttCtx * ctx)
 {
 	char       * env;
@@ -479,6 +490,9 @@ axl_bool myqtt_storage_clear_offline    (MyQttCtx      * ctx,
 	/* now create message directory, subs and will */
 	if ((storage & MYQTT_STORAGE_MSGS) == MYQTT_STORAGE_MSGS || 
 	    (storage & MYQTT_STORAGE_ALL) == MYQTT_STORAGE_ALL) {
+		/* account messages removed */
+		__myqtt_storage_gauge_update (ctx, &ctx->storage_msgs, - myqtt_storage_queued_messages_offline (ctx, client_identifier));
+
 		full_path = myqtt_support_build_filename (ctx->storage_path, client_identifier, "msgs", NULL);
 		result    = __myqtt_storage_remove_files_from_dir (ctx, full_path);
 
@@ -1273,6 +1287,8 @@ axlPointer myqtt_storage_store_msg_offline (MyQttCtx      * ctx,
 
 	/* message saved */
 	fclose (handle);
+	__myqtt_storage_gauge_update (ctx, &ctx->storage_msgs, 1);
+	MYQTT_PROBE3 (storage_store, client_identifier, packet_id, app_msg_size);
 	return full_path;	
 }
 
@@ -1297,17 +1313,25 @@ axlPointer myqtt_storage_store_msg_offline (MyQttCtx      * ctx,
  */
 axlPointer myqtt_storage_store_msg   (MyQttCtx * ctx, MyQttConn * conn, int packet_id, MyQttQos qos, unsigned char * app_msg, int app_msg_size)
 {
+	long long  stamp;
+	axlPointer handle;
+
 	/* avoid segfault when conn reference is NULL */
 	if (conn == NULL)
 		return axl_false; 
 
+	stamp = ctx->metrics_enabled ? myqtt_metrics_now () : 0;
 	if (ctx->on_store) {
 		/* call to check if we can store the message */
 		if (! ctx->on_store (ctx, conn, conn->client_identifier, packet_id, qos, app_msg, app_msg_size, ctx->on_store_data))
 			return NULL;
 	} /* end if */
 
-	return myqtt_storage_store_msg_offline (ctx, conn->client_identifier, packet_id, qos | MYQTT_QOS_SKIP_STOREAGE_NOTIFY, app_msg, app_msg_size);
+	handle = myqtt_storage_store_msg_offline (ctx, conn->client_identifier, packet_id, qos | MYQTT_QOS_SKIP_STOREAGE_NOTIFY, app_msg, app_msg_size);
+
+	/* record time taken */
+	myqtt_metrics_record_since (ctx, MYQTT_METRIC_STORAGE, stamp);
+	return handle;
 }
 
 /** 
@@ -1333,9 +1357,10 @@ axl_bool myqtt_storage_release_msg   (MyQttCtx      * ctx,
 				      unsigned char * app_msg,
 				      int             app_msg_size)
 {
-	MyQttQos qos;
-	int      packet_id;
-	int      pos;
+	MyQttQos  qos;
+	int       packet_id;
+	int       pos;
+	long long stamp;
 
 	/* check input values */
 	if (ctx == NULL || conn == NULL)
@@ -1347,6 +1372,8 @@ axl_bool myqtt_storage_release_msg   (MyQttCtx      * ctx,
 
 	/* release the message */
 	if (handle) {
+		stamp = ctx->metrics_enabled ? myqtt_metrics_now () : 0;
+
 		/* check and call on release message */
 		if (ctx->on_release) {
 			/* get packet id */
@@ -1366,6 +1393,11 @@ axl_bool myqtt_storage_release_msg   (MyQttCtx      * ctx,
 
 		unlink ((const char *) handle);
 		axl_free ((char *) handle);
+		__myqtt_storage_gauge_update (ctx, &ctx->storage_msgs, -1);
+		MYQTT_PROBE2 (storage_release, conn->client_identifier, app_msg_size);
+
+		/* record time taken */
+		myqtt_metrics_record_since (ctx, MYQTT_METRIC_STORAGE, stamp);
 	} /* end if */
 
 	return axl_true;
@@ -1406,6 +1438,7 @@ axl_bool       myqtt_storage_retain_msg_set (MyQttCtx            * ctx,
 	char            * path_item;
 	struct timeval    stamp;
 	FILE            * handle;
+	axl_bool          replaced = axl_false;
 
 	if (ctx == NULL || topic_name == NULL || app_msg_size < 0)
 		return axl_false;
@@ -1433,7 +1466,7 @@ axl_bool       myqtt_storage_retain_msg_set (MyQttCtx            * ctx,
 	/* remove the retained message if it does exists */
 	if (myqtt_support_file_test (full_path, FILE_EXISTS | FILE_IS_DIR)) {
 		/* directory exists, check to remove previous subscription */
-		__myqtt_storage_sub_exists (ctx, full_path, topic_name, strlen (topic_name), axl_true, axl_true, NULL, NULL, NULL);
+		replaced = __myqtt_storage_sub_exists (ctx, full_path, topic_name, strlen (topic_name), axl_true, axl_true, NULL, NULL, NULL);
 	} else {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "Found path %s does not exists, calling myqtt_mkdir ()", full_path);
 		
@@ -1498,6 +1531,10 @@ axl_bool       myqtt_storage_retain_msg_set (MyQttCtx            * ctx,
 	fclose (handle);
 
 	axl_free (aux_path);
+
+	/* account new retained message */
+	if (! replaced)
+		__myqtt_storage_gauge_update (ctx, &ctx->retained_msgs, 1);
 	
 	return axl_true;
 }
@@ -1538,7 +1575,8 @@ void       myqtt_storage_retain_msg_release (MyQttCtx      * ctx,
 
 	/* remove subscription (well, in fact topic name) and message associated if it exists */
 	myqtt_log (MYQTT_LEVEL_DEBUG, "Releasing retained message for subscription %s at %s", topic_name, full_path);
-	__myqtt_storage_sub_exists (ctx, full_path, topic_name, strlen (topic_name), axl_true, axl_true, NULL, NULL, NULL);
+	if (__myqtt_storage_sub_exists (ctx, full_path, topic_name, strlen (topic_name), axl_true, axl_true, NULL, NULL, NULL))
+		__myqtt_storage_gauge_update (ctx, &ctx->retained_msgs, -1);
 	axl_free (full_path);
 
 	return;
@@ -2093,6 +2131,7 @@ int     myqtt_storage_load             (MyQttCtx      * ctx)
 	DIR           * sub_dir;
 	struct dirent * entry;
 	int             entries = 0;
+	axlList       * retained;
 
 	if (ctx == NULL || ! ctx->storage_path) {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to load local storage because context (%p) is not defined or storage path is empty: %s",
@@ -2145,6 +2184,9 @@ int     myqtt_storage_load             (MyQttCtx      * ctx)
 		axl_free (aux_path);
 #endif
 
+		/* account messages queued from previous runs */
+		__myqtt_storage_gauge_update (ctx, &ctx->storage_msgs, myqtt_storage_queued_messages_offline (ctx, entry->d_name));
+
 		/* found directory (a session identifier) */
 		if (myqtt_storage_sub_count_offline (ctx, entry->d_name) > 0)  {
 			/* found entry with subscriptions */
@@ -2163,6 +2205,13 @@ finish:
 	myqtt_mutex_unlock (&ctx->ref_mutex);
 	closedir (sub_dir);
 
+	/* account retained messages from previous runs */
+	retained = myqtt_storage_get_retained_topics (ctx, "#");
+	if (retained) {
+		__myqtt_storage_gauge_update (ctx, &ctx->retained_msgs, axl_list_length (retained));
+		axl_list_free (retained);
+	} /* end if */
+
 	return entries;
 }
 
@@ -2364,6 +2413,51 @@ axlList * myqtt_storage_get_retained_topics (MyQttCtx * ctx, const char * topic_
 
 	return list;
 }
+
+/** 
+ * @brief Allows to get the number of messages stored (in-flight and
+ * queued for offline sessions) that weren't released yet.
+ *
+ * The value is maintained as messages are stored and released (no
+ * storage inspection is done).
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @return Number of messages stored or -1 if it fails.
+ */
+int       myqtt_storage_backlog (MyQttCtx * ctx)
+{
+	int count;
+
+	if (ctx == NULL)
+		return -1;
+
+	MYQTT_ATOMIC_READ (ctx, ctx->storage_msgs, count);
+
+	return count;
+}
+
+/** 
+ * @brief Allows to get the number of retained messages stored.
+ *
+ * The value is maintained as retained messages are set and released
+ * (no storage inspection is done).
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @return Number of retained messages or -1 if it fails.
+ */
+int       myqtt_storage_retained_count (MyQttCtx * ctx)
+{
+	int count;
+
+	if (ctx == NULL)
+		return -1;
+
+	MYQTT_ATOMIC_READ (ctx, ctx->retained_msgs, count);
+
+	return count;
+}
        
 /** 
  * @} 
@@ -159,6 +159,10 @@ axl_bool myqtt_storage_set_path         (MyQttCtx      * ctx,
 
 axlList  * myqtt_storage_get_retained_topics  (MyQttCtx * ctx, const char * topic_filter);
 
+int        myqtt_storage_backlog              (MyQttCtx * ctx);
+
+int        myqtt_storage_retained_count       (MyQttCtx * ctx);
+
 /*** internal API: don't use it, it may change at any time ***/
 void     __myqtt_storage_get_values_from_file_name (MyQttCtx * ctx, const char * file_name, int * packet_id, int * size, int * qos);
 
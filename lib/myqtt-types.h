@@ -116,7 +116,14 @@ typedef enum {
 	 * is being requested for its availability to perform a write
 	 * operation on them.
 	 */
-	WRITE_OPERATIONS = 1 << 1
+	WRITE_OPERATIONS = 1 << 1,
+	/** 
+	 * @brief Combined with \ref READ_OPERATIONS, requests the
+	 * wait to return without blocking (zero timeout). Used by the
+	 * reader when some connection has content already buffered
+	 * so sockets are checked without delaying that content.
+	 */
+	NOWAIT_OPERATIONS = 1 << 2
 } MyQttIoWaitingFor;
 
 /**
@@ -677,6 +684,38 @@ typedef enum {
 	MYQTT_QOS_2 = 2
 } MyQttQos;
 
+/** 
+ * @brief Application message to be published with \ref
+ * myqtt_conn_pub_batch. Fields have the same meaning as the
+ * parameters of \ref myqtt_conn_pub.
+ */
+typedef struct _MyQttPubItem {
+	/** 
+	 * @brief The name of the topic for the application message.
+	 */
+	const char  * topic_name;
+	/** 
+	 * @brief The application message and its size.
+	 */
+	axlPointer    app_message;
+	int           app_message_size;
+	/** 
+	 * @brief The quality of service for this message.
+	 */
+	MyQttQos      qos;
+	/** 
+	 * @brief Enable message retention.
+	 */
+	axl_bool      retain;
+} MyQttPubItem;
+
+/** 
+ * @brief Completion handle returned by \ref myqtt_conn_pub_batch
+ * used to wait for all publications to complete with \ref
+ * myqtt_conn_pub_batch_wait.
+ */
+typedef struct _MyQttPubBatch MyQttPubBatch;
+
 /** 
  * @brief Message type (Control packet types).
  */
@@ -888,6 +927,116 @@ typedef enum {
 	
 } MyQttStorage;
 
+/** 
+ * @brief Counters maintained by the \ref myqtt_metrics "metrics module".
+ */
+typedef enum {
+	/** 
+	 * @brief Messages received (all MQTT control packets).
+	 */
+	MYQTT_METRIC_MSGS_IN   = 0,
+	/** 
+	 * @brief Messages sent (all MQTT control packets).
+	 */
+	MYQTT_METRIC_MSGS_OUT  = 1,
+	/** 
+	 * @brief Bytes received (payload and variable header, without
+	 * fixed header).
+	 */
+	MYQTT_METRIC_BYTES_IN  = 2,
+	/** 
+	 * @brief Bytes sent.
+	 */
+	MYQTT_METRIC_BYTES_OUT = 3,
+	/** 
+	 * @internal Number of counters available.
+	 */
+	MYQTT_METRIC_COUNTERS  = 4
+} MyQttMetricCounter;
+
+/** 
+ * @brief Latency histograms maintained by the \ref myqtt_metrics
+ * "metrics module". All values are recorded in microseconds.
+ */
+typedef enum {
+	/** 
+	 * @brief Time since a PUBLISH is received until it is queued
+	 * for all subscribers (ingress to egress).
+	 */
+	MYQTT_METRIC_PUBLISH   = 0,
+	/** 
+	 * @brief Time taken by storage operations (store and release
+	 * messages).
+	 */
+	MYQTT_METRIC_STORAGE   = 1,
+	/** 
+	 * @brief Time taken by the on connect handler to authorize a
+	 * CONNECT request.
+	 */
+	MYQTT_METRIC_AUTH      = 2,
+	/** 
+	 * @brief Time a message waits at the sequencer queue until it
+	 * starts being written.
+	 */
+	MYQTT_METRIC_SEQUENCER = 3,
+	/** 
+	 * @internal Number of histograms available.
+	 */
+	MYQTT_METRIC_HISTOGRAMS = 4
+} MyQttMetricHistogram;
+
+/** 
+ * @brief Number of buckets used by each \ref MyQttHistogram: values
+ * below 16 have its own bucket and then each power of two is split
+ * into 8 buckets (12.5% precision) up to 2^40 microseconds.
+ */
+#define MYQTT_METRIC_BUCKETS 312
+
+/** 
+ * @brief Log-linear (HDR style) latency histogram.
+ */
+typedef struct _MyQttHistogram {
+	/** 
+	 * @brief Values recorded.
+	 */
+	long long count;
+	/** 
+	 * @brief Sum of all values recorded.
+	 */
+	long long sum;
+	/** 
+	 * @brief Min value recorded.
+	 */
+	long long min;
+	/** 
+	 * @brief Max value recorded.
+	 */
+	long long max;
+	/** 
+	 * @brief Values recorded on each bucket.
+	 */
+	long long buckets[MYQTT_METRIC_BUCKETS];
+} MyQttHistogram;
+
+/** 
+ * @brief Metrics snapshot as reported by \ref myqtt_metrics_snapshot.
+ */
+typedef struct _MyQttMetrics {
+	/** 
+	 * @brief Stamp (microseconds) when metrics started to be
+	 * collected (or were reset).
+	 */
+	long long      started;
+	/** 
+	 * @brief Counters, indexed by \ref MyQttMetricCounter.
+	 */
+	long long      counters[MYQTT_METRIC_COUNTERS];
+	/** 
+	 * @brief Histograms, indexed by \ref MyQttMetricHistogram.
+	 */
+	MyQttHistogram histograms[MYQTT_METRIC_HISTOGRAMS];
+} MyQttMetrics;
+
 /***** INTERNAL TYPES: don't use them because they may change at any time without change API notification ****/
 
 /** 
@@ -924,6 +1073,26 @@ typedef struct _MyQttSequencerData {
 	 */
 	MyQttMsgType         type;
 
+	/** 
+	 * @brief Stamp (microseconds) when the message was queued
+	 * (only when metrics are enabled).
+	 */
+	long long            queued;
+
+	/** 
+	 * @brief Token identifying the send operation on
+	 * connections with a token aware send handler (0 if not
+	 * started).
+	 */
+	int                  token;
+
+	/** 
+	 * @brief Stamp (microseconds) when the transport first
+	 * reported the message could not be written yet (0 if not
+	 * blocked).
+	 */
+	long long            blocked;
+
 } MyQttSequencerData;
 
 /**
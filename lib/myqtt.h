@@ -249,6 +249,7 @@ BEGIN_C_DECLS
 #include <myqtt-sequencer.h>
 #include <myqtt-msg.h>
 #include <myqtt-storage.h>
+#include <myqtt-metrics.h>
 
 END_C_DECLS
 
@@ -721,6 +721,80 @@ PyObject * py_myqtt_conn_pub (PyObject * self, PyObject * args, PyObject * kwds)
 	return Py_BuildValue ("i", result);
 }
 
+PyObject * py_myqtt_conn_pub_many (PyObject * self, PyObject * args, PyObject * kwds)
+{
+	PyObject       * items        = NULL;
+	PyObject       * items_tuple;
+	int              wait_publish = 10;
+	int              items_count;
+	int              iterator;
+	MyQttPubItem   * pub_items;
+	MyQttPubBatch  * batch;
+	int              confirmed    = 0;
+	axl_bool         result       = axl_false;
+	MyQttConn      * conn;
+
+	/* now parse arguments */
+	static char *kwlist[] = {"items", "wait_publish", NULL};
+
+	/* parse and check result */
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, &items, &wait_publish))
+		return NULL;
+
+	/* get a tuple copy so the list can't change while threads
+	 * are allowed */
+	items_tuple = PySequence_Tuple (items);
+	if (items_tuple == NULL)
+		return NULL;
+	items_count = PyTuple_Size (items_tuple);
+	if (items_count <= 0) {
+		Py_DECREF (items_tuple);
+		return Py_BuildValue ("i", 0);
+	} /* end if */
+
+	pub_items = axl_new (MyQttPubItem, items_count);
+	if (pub_items == NULL) {
+		Py_DECREF (items_tuple);
+		return PyErr_NoMemory ();
+	} /* end if */
+
+	/* get all (topic, msg, [qos], [retain]) items */
+	iterator = 0;
+	while (iterator < items_count) {
+		if (! PyArg_ParseTuple (PyTuple_GetItem (items_tuple, iterator), "ss#|ii",
+					&pub_items[iterator].topic_name,
+					&pub_items[iterator].app_message, &pub_items[iterator].app_message_size,
+					&pub_items[iterator].qos, &pub_items[iterator].retain)) {
+			axl_free (pub_items);
+			Py_DECREF (items_tuple);
+			return NULL;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* allow threads */
+	Py_BEGIN_ALLOW_THREADS
+
+	/* call to publish all messages and wait for them */
+	conn   = py_myqtt_conn_get (self);
+	batch  = myqtt_conn_pub_batch (conn, pub_items, items_count, wait_publish);
+	if (batch)
+		result = myqtt_conn_pub_batch_wait (batch, &confirmed);
+
+	/* report a simple log here */
+	py_myqtt_log (result == axl_false ? PY_MYQTT_CRITICAL : PY_MYQTT_DEBUG, "myqtt_conn_pub_batch () = %d (reported), %d of %d messages published",
+		      result, confirmed, items_count);
+
+	/* end threads */
+	Py_END_ALLOW_THREADS
+
+	axl_free (pub_items);
+	Py_DECREF (items_tuple);
+
+	/* report number of messages published */
+	return Py_BuildValue ("i", confirmed);
+}
+
 PyObject * py_myqtt_conn_ping (PyObject * self, PyObject * args, PyObject * kwds)
 {
 	int          wait_pingresp = 10;
@@ -778,6 +852,127 @@ PyObject * py_myqtt_conn_get_next (PyObject * self, PyObject * args, PyObject *
 }
 
 
+/** 
+ * @internal On msg handler used by get_next_batch: messages are
+ * queued without bridging into python, so no GIL is acquired per
+ * message received.
+ */
+void py_myqtt_conn_batch_queue_msg (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg, axlPointer user_data)
+{
+	myqtt_msg_ref (msg);
+	myqtt_async_queue_push ((MyQttAsyncQueue *) user_data, msg);
+	return;
+}
+
+/** 
+ * @internal Wakes up get_next_batch waiters when the connection is
+ * closed.
+ */
+void py_myqtt_conn_batch_on_close (MyQttConn * conn, axlPointer user_data)
+{
+	myqtt_async_queue_push ((MyQttAsyncQueue *) user_data, INT_TO_PTR (-1));
+	return;
+}
+
+/** 
+ * @internal Releases the get_next_batch queue along with the messages
+ * still queued.
+ */
+void py_myqtt_conn_batch_release (axlPointer user_data)
+{
+	MyQttAsyncQueue * queue = user_data;
+	MyQttMsg        * msg;
+
+	while (myqtt_async_queue_length (queue) > 0) {
+		msg = myqtt_async_queue_pop (queue);
+		if (PTR_TO_INT (msg) != -1)
+			myqtt_msg_unref (msg);
+	} /* end while */
+	myqtt_async_queue_unref (queue);
+
+	return;
+}
+
+PyObject * py_myqtt_conn_get_next_batch (PyObject * self, PyObject * args, PyObject * kwds)
+{
+	int                max_msgs = 100;
+	long               timeout  = 10;
+	int                count    = 0;
+	int                iterator;
+	MyQttConn        * conn;
+	MyQttAsyncQueue  * queue;
+	MyQttMsg         * msg;
+	MyQttMsg        ** msgs;
+	PyObject         * result;
+	
+	/* now parse arguments */
+	static char *kwlist[] = {"max_msgs", "timeout", NULL};
+
+	/* parse and check result */
+	if (! PyArg_ParseTupleAndKeywords(args, kwds, "|il", kwlist, &max_msgs, &timeout))
+		return NULL;
+
+	if (max_msgs <= 0) {
+		PyErr_SetString (PyExc_ValueError, "Expected to receive a max_msgs value bigger than 0");
+		return NULL;
+	} /* end if */
+
+	msgs = axl_new (MyQttMsg *, max_msgs);
+	if (msgs == NULL)
+		return PyErr_NoMemory ();
+
+	/* get the queue installed on first use: it stays in place
+	 * between calls so no message is lost while python processes
+	 * the previous batch */
+	conn  = py_myqtt_conn_get (self);
+	queue = myqtt_conn_get_data (conn, "py:conn:batch");
+	if (queue == NULL) {
+		queue = myqtt_async_queue_new ();
+		myqtt_conn_set_data_full (conn, "py:conn:batch", queue, NULL, py_myqtt_conn_batch_release);
+		myqtt_conn_set_on_close (conn, axl_false, py_myqtt_conn_batch_on_close, queue);
+	} /* end if */
+
+	/* (re)install handler in case set_on_msg replaced it */
+	myqtt_conn_set_on_msg (conn, py_myqtt_conn_batch_queue_msg, queue);
+
+	/* allow threads */
+	Py_BEGIN_ALLOW_THREADS
+
+	/* wait for the first message and then drain what is already
+	 * queued, up to max_msgs */
+	if (timeout > 0)
+		msg = myqtt_async_queue_timedpop (queue, timeout * 1000);
+	else
+		msg = myqtt_async_queue_pop (queue);
+	while (msg) {
+		if (PTR_TO_INT (msg) == -1) {
+			/* connection closed, keep the mark for next calls */
+			myqtt_async_queue_push (queue, msg);
+			break;
+		} /* end if */
+
+		msgs[count] = msg;
+		count++;
+		if (count == max_msgs || myqtt_async_queue_length (queue) == 0)
+			break;
+		msg = myqtt_async_queue_pop (queue);
+	} /* end while */
+
+	/* end threads */
+	Py_END_ALLOW_THREADS
+
+	/* build result (python msgs steal references) */
+	result   = PyList_New (count);
+	iterator = 0;
+	while (iterator < count) {
+		PyList_SET_ITEM (result, iterator, py_myqtt_msg_create (msgs[iterator], axl_false));
+		iterator++;
+	} /* end while */
+	axl_free (msgs);
+
+	return result;
+}
+
 PyObject * py_myqtt_conn_set_on_msg (PyObject * self, PyObject * args, PyObject * kwds)
 {
 	PyObject                  * on_msg        = NULL;
@@ -1215,12 +1410,18 @@ static PyMethodDef py_myqtt_conn_methods[] = {
 	/* pub */
 	{"pub", (PyCFunction) py_myqtt_conn_pub, METH_VARARGS | METH_KEYWORDS,
 	 "API wrapper for myqtt_conn_pub. This method allows to publish to a particular topic."},
+	/* pub_many */
+	{"pub_many", (PyCFunction) py_myqtt_conn_pub_many, METH_VARARGS | METH_KEYWORDS,
+	 "API wrapper for myqtt_conn_pub_batch. This method allows to publish a list of (topic, msg, [qos], [retain]) items, waiting for all of them collectively."},
 	/* ping */
 	{"ping", (PyCFunction) py_myqtt_conn_ping, METH_VARARGS | METH_KEYWORDS,
 	 "API wrapper for myqtt_conn_ping. This method allows to ping connect server."},
 	/* get_next */
 	{"get_next", (PyCFunction) py_myqtt_conn_get_next, METH_VARARGS | METH_KEYWORDS,
 	 "API wrapper for myqtt_conn_get_next. This method allows to implement a synchronous blocking wait for the next message, limiting the wait to the amount of microseconds provided."},
+	/* get_next_batch */
+	{"get_next_batch", (PyCFunction) py_myqtt_conn_get_next_batch, METH_VARARGS | METH_KEYWORDS,
+	 "Waits (without holding the GIL) for the next message and returns a list with it plus all messages already queued, up to max_msgs. Messages are queued by a C handler that stays installed between calls (replacing the one configured with set_on_msg), so they are received without calling into python."},
 	/* set_on_msg */
 	{"set_on_msg", (PyCFunction) py_myqtt_conn_set_on_msg, METH_VARARGS | METH_KEYWORDS,
 	 "API wrapper for myqtt_conn_set_on_msg. This method allows to configure a handler which will be called in case a message is received on the provided connection."},
@@ -124,6 +124,9 @@ PyObject * py_myqtt_msg_get_attr (PyObject *o, PyObject *attr_name) {
 	} else if (axl_cmp (attr, "qos")) {
 		/* get message qos */
 		return Py_BuildValue ("i", myqtt_msg_get_qos (self->msg));
+	} else if (axl_cmp (attr, "content_view")) {
+		/* get a read only memoryview over app msg (no copy) */
+		return PyMemoryView_FromObject (o);
 	} /* end if */
 
 	/* first implement generic attr already defined */
@@ -139,6 +142,34 @@ PyObject * py_myqtt_msg_get_attr (PyObject *o, PyObject *attr_name) {
  	{NULL}  
 }; */
 
+/** 
+ * @brief Implements the buffer protocol for myqtt.Msg, exposing the
+ * application message (content) read only and without copying
+ * it. The view holds a reference to the python msg, so the MyQttMsg
+ * stays referenced until the view is released.
+ */
+static int py_myqtt_msg_get_buffer (PyObject * o, Py_buffer * view, int flags)
+{
+	PyMyQttMsg * self = (PyMyQttMsg *) o;
+
+	if (self->msg == NULL) {
+		PyErr_SetString (PyExc_BufferError, "myqtt.Msg has no message associated");
+		return -1;
+	} /* end if */
+
+	return PyBuffer_FillInfo (view, o, (void *) myqtt_msg_get_app_msg (self->msg),
+				  myqtt_msg_get_app_msg_size (self->msg), 1, flags);
+}
+
+static PyBufferProcs py_myqtt_msg_as_buffer = {
+	0,                         /* bf_getreadbuffer */
+	0,                         /* bf_getwritebuffer */
+	0,                         /* bf_getsegcount */
+	0,                         /* bf_getcharbuffer */
+	(getbufferproc) py_myqtt_msg_get_buffer, /* bf_getbuffer */
+	0,                         /* bf_releasebuffer */
+};
+
 
 static PyTypeObject PyMyQttMsgType = {
     PyObject_HEAD_INIT(NULL)
@@ -160,8 +191,8 @@ static PyTypeObject PyMyQttMsgType = {
     0,                         /* tp_str*/
     py_myqtt_msg_get_attr, /* tp_getattro*/
     0,                         /* tp_setattro*/
-    0,                         /* tp_as_buffer*/
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,  /* tp_flags*/
+    &py_myqtt_msg_as_buffer,   /* tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_NEWBUFFER,  /* tp_flags*/
     "myqtt.Msg, the object used to represent a MQTT msg.",           /* tp_doc */
     0,		               /* tp_traverse */
     0,		               /* tp_clear */
@@ -342,6 +342,131 @@ def test_04 ():
 
     return True
 
+def test_04a ():
+    # call to initialize a context 
+    ctx = myqtt.Ctx ()
+
+    # call to init ctx 
+    if not ctx.init ():
+        error ("Failed to init MyQtt context")
+        return False
+
+    conn = myqtt.Conn (ctx, host, port, "test_04a", True, 30)
+    if not conn.is_ok ():
+        error ("Expected to find proper connection result, but found error. Error code was: " + str(conn.status) + ", message: " + conn.error_msg)
+        return False
+
+    (status, sub_qos) = conn.sub ("test_04a", myqtt.qos0, 10)
+    if not status:
+        error ("Failed to subscribe")
+        return False
+
+    # install batch queue before publishing (nothing should be found)
+    msgs = conn.get_next_batch (10, 1)
+    if len (msgs) != 0:
+        error ("Expected to find no message but found: %d" % len (msgs))
+        return False
+
+    info ("Publishing 5 messages...")
+    for iterator in range (5):
+        content = "This is test message %d" % iterator
+        if not conn.pub ("test_04a", content, len (content), myqtt.qos0, False, 0):
+            error ("Failed to publish message..")
+            return False
+
+    # collect messages in batches
+    msgs  = []
+    tries = 0
+    while len (msgs) < 5 and tries < 10:
+        msgs  = msgs + conn.get_next_batch (10, 1000)
+        tries = tries + 1
+
+    if len (msgs) != 5:
+        error ("Expected to receive 5 messages but found: %d" % len (msgs))
+        return False
+
+    iterator = 0
+    for msg in msgs:
+        content = "This is test message %d" % iterator
+        # check buffer protocol and view (no copy)
+        if memoryview (msg).tobytes () != content:
+            error ("Expected to find content '%s' but found '%s'" % (content, memoryview (msg).tobytes ()))
+            return False
+        if msg.content_view.tobytes () != msg.content:
+            error ("Expected content_view to match content")
+            return False
+        if not memoryview (msg).readonly:
+            error ("Expected read only memoryview")
+            return False
+        iterator = iterator + 1
+
+    conn.close ()
+    ctx.exit ()
+
+    # finish ctx 
+    del ctx
+
+    return True
+
+def test_04b ():
+    # call to initialize a context 
+    ctx = myqtt.Ctx ()
+
+    # call to init ctx 
+    if not ctx.init ():
+        error ("Failed to init MyQtt context")
+        return False
+
+    conn = myqtt.Conn (ctx, host, port, "test_04b", True, 30)
+    if not conn.is_ok ():
+        error ("Expected to find proper connection result, but found error. Error code was: " + str(conn.status) + ", message: " + conn.error_msg)
+        return False
+
+    (status, sub_qos) = conn.sub ("test_04b", myqtt.qos0, 10)
+    if not status:
+        error ("Failed to subscribe")
+        return False
+
+    # install batch queue before publishing
+    conn.get_next_batch (10, 1)
+
+    info ("Publishing 6 messages with pub_many (QoS 0, 1 and 2)...")
+    items = []
+    for iterator in range (6):
+        items.append (("test_04b", "This is test message %d" % iterator, iterator % 3, False))
+
+    published = conn.pub_many (items, 10)
+    if published != 6:
+        error ("Expected to publish 6 messages but found: %d" % published)
+        return False
+
+    # collect messages in batches
+    msgs  = []
+    tries = 0
+    while len (msgs) < 6 and tries < 10:
+        msgs  = msgs + conn.get_next_batch (10, 1000)
+        tries = tries + 1
+
+    if len (msgs) != 6:
+        error ("Expected to receive 6 messages but found: %d" % len (msgs))
+        return False
+
+    iterator = 0
+    for msg in msgs:
+        content = "This is test message %d" % iterator
+        if msg.content != content:
+            error ("Expected to find content '%s' but found '%s'" % (content, msg.content))
+            return False
+        iterator = iterator + 1
+
+    conn.close ()
+    ctx.exit ()
+
+    # finish ctx 
+    del ctx
+
+    return True
+
 def test_05 ():
     # call to initialize a context 
     ctx = myqtt.Ctx ()
@@ -1412,6 +1537,8 @@ tests = [
    (test_02,   "Check PyMyQtt basic MQTT connection"),
    (test_03,   "Check PyMyQtt basic MQTT connection and subscription"),
    (test_04,   "Check PyMyQtt basic subscribe function (QOS 0) and publish"),
+   (test_04a,  "Check PyMyQtt batched receive (get_next_batch) and msg buffer protocol"),
+   (test_04b,  "Check PyMyQtt batch publish (pub_many)"),
    (test_05,   "Check PyMyQtt check ping server (PINGREQ)"),
    (test_06,   "Check PyMyQtt check client identifier function"),
    (test_07,   "Check PyMyqtt client auth (CONNECT simple auth)"),
@@ -90,6 +90,7 @@ Development headers required to create myqtt modules or tools.
   /usr/include/myqtt-1.0/myqtt-ctx-private.h
   /usr/include/myqtt-1.0/myqtt.h
   /usr/include/myqtt-1.0/myqtt-sequencer.h
+  /usr/include/myqtt-1.0/myqtt-metrics.h
   /usr/include/myqtt-1.0/myqtt-thread.h
   /usr/include/myqtt-1.0/myqtt-handlers.h
   /usr/include/myqtt-1.0/myqtt-thread-pool.h
@@ -403,6 +404,21 @@ Extension plugin that provides status options to clients
   /etc/myqtt/mods-available/mod-status.xml
   /etc/myqtt/status/status.example.conf
 
+# myqttd-mod-prometheus package
+%package -n myqttd-mod-prometheus
+Summary: Extension plugin that serves MyQttD metrics for Prometheus
+Group: System Environment/Libraries
+Requires: libmyqtt-1.0
+%description  -n myqttd-mod-prometheus
+Extension plugin that serves MyQttD metrics for Prometheus
+%files -n myqttd-mod-prometheus
+  /usr/lib/myqtt/modules/mod-prometheus.a
+  /usr/lib/myqtt/modules/mod-prometheus.so
+  /usr/lib/myqtt/modules/mod-prometheus.so.0.0.0
+  /usr/lib/myqtt/modules/mod-prometheus.so.0
+  /etc/myqtt/mods-available/mod-prometheus.xml
+  /etc/myqtt/prometheus/prometheus.example.conf
+
 
 
 
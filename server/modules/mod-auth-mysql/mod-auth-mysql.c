@@ -50,6 +50,7 @@
 
 /* mysql flags */
 #include <mysql.h>
+#include <errmsg.h>
 
 
 /* use this declarations to avoid c++ compilers to mangle exported
@@ -59,6 +60,177 @@ BEGIN_C_DECLS
 MyQttdCtx * ctx = NULL;
 axlDoc    * modconfig = NULL;
 
+/** 
+ * @internal Default amount of connections kept by each dsn pool
+ * (configurable with pool-size attribute).
+ */
+#define MOD_AUTH_MYSQL_POOL_SIZE  8
+
+/** 
+ * @internal Default amount of seconds a pooled connection can stay
+ * idle before it is checked with mysql_ping (configurable with
+ * pool-ping attribute).
+ */
+#define MOD_AUTH_MYSQL_POOL_PING  30
+
+/** 
+ * @internal Max amount of microseconds a caller waits for a pooled
+ * connection to be released when the pool is exhausted.
+ */
+#define MOD_AUTH_MYSQL_POOL_WAIT  5000000
+
+/** 
+ * @internal Default amount of seconds ACLs loaded from the database
+ * are cached (configurable with acl-ttl attribute, 0 disables the
+ * cache).
+ */
+#define MOD_AUTH_MYSQL_ACL_TTL    60
+
+/** 
+ * @internal Permission bits of a compiled ACL.
+ */
+#define MOD_AUTH_MYSQL_ACL_W        (1 << 0)
+#define MOD_AUTH_MYSQL_ACL_PUBLISH  (1 << 1)
+#define MOD_AUTH_MYSQL_ACL_PUBLISH0 (1 << 2)
+#define MOD_AUTH_MYSQL_ACL_PUBLISH1 (1 << 3)
+#define MOD_AUTH_MYSQL_ACL_PUBLISH2 (1 << 4)
+
+/** 
+ * @internal ACL row (domain_acl or user_acl) compiled to be applied
+ * without querying the database.
+ */
+typedef struct _ModAuthMySqlAcl {
+	char              * topic_filter;
+	/* axl_false when the filter can be compared as a plain string */
+	axl_bool            has_wildcards;
+	axl_bool            apply_after;
+	/* 0 to use domain default acl */
+	MyQttPublishCodes   action_if_matches;
+	int                 perms;
+} ModAuthMySqlAcl;
+
+/** 
+ * @internal Set of ACLs loaded for a domain or user. Sets are
+ * reference counted (acl_mutex) so they can be replaced while being
+ * applied.
+ */
+typedef struct _ModAuthMySqlAclSet {
+	ModAuthMySqlAcl   * acls;
+	int                 count;
+	/* when it was loaded and the acl_generation at that moment */
+	long                stamp;
+	int                 generation;
+	int                 refs;
+} ModAuthMySqlAclSet;
+
+/* domain acls cached by domain name and cache settings */
+MyQttMutex   acl_mutex;
+axlHash    * domain_acls     = NULL;
+int          acl_generation  = 0;
+long         acl_ttl         = MOD_AUTH_MYSQL_ACL_TTL;
+
+/* axl_true once acl and usage caches (and their mutexes) were
+ * created, init may fail before */
+axl_bool     caches_ready    = axl_false;
+
+/** 
+ * @internal Hot statements run on every publish, prepared once per
+ * pooled connection.
+ */
+#define MOD_AUTH_MYSQL_SQL_GET_USAGE    "SELECT COALESCE(current_day_usage, 0), COALESCE(current_month_usage, 0) FROM user_msg_tracking WHERE user_id = ?"
+#define MOD_AUTH_MYSQL_SQL_ADD_USAGE    "INSERT INTO user_msg_tracking (current_day_usage, current_month_usage, user_id) VALUES (0, 0, ?)"
+
+/** 
+ * @internal Default amount of seconds message usage is kept in
+ * memory before being written (configurable with usage-flush-period,
+ * 0 writes on every publish).
+ */
+#define MOD_AUTH_MYSQL_USAGE_FLUSH_PERIOD  5
+
+/** 
+ * @internal Default amount of pending increments that forces usage to
+ * be written (configurable with usage-flush-count).
+ */
+#define MOD_AUTH_MYSQL_USAGE_FLUSH_COUNT   1000
+
+/** 
+ * @internal Max amount of users updated by a single UPDATE.
+ */
+#define MOD_AUTH_MYSQL_USAGE_BATCH         100
+
+/** 
+ * @internal Message usage tracked in memory for a user. day_usage
+ * and month_usage are the values last read from the database (plus
+ * what was written since then), pending the increments not written
+ * yet and flushing the increments being written by the flush in
+ * progress (still accounted until the UPDATE commits).
+ */
+typedef struct _ModAuthMySqlUsage {
+	int          user_id;
+	long         day_usage;
+	long         month_usage;
+	long         pending;
+	long         flushing;
+	/* axl_false when values must be read again from the database */
+	axl_bool     loaded;
+} ModAuthMySqlUsage;
+
+typedef struct _ModAuthMySqlUsageBatch {
+	int        * ids;
+	long       * deltas;
+	int          count;
+} ModAuthMySqlUsageBatch;
+
+/* usage tracked by user_id */
+MyQttMutex   usage_mutex;
+/* serializes mod_auth_mysql_usage_flush calls */
+MyQttMutex   usage_flush_mutex;
+axlHash    * usage_table         = NULL;
+long         usage_pending       = 0;
+long         usage_flush_period  = MOD_AUTH_MYSQL_USAGE_FLUSH_PERIOD;
+long         usage_flush_count   = MOD_AUTH_MYSQL_USAGE_FLUSH_COUNT;
+int          usage_event_id      = -1;
+
+/** 
+ * @internal Max amount of columns supported by
+ * __mod_auth_mysql_stmt_run
+ */
+#define MOD_AUTH_MYSQL_STMT_MAX_COLS 4
+
+/** 
+ * @internal Connection handled by a pool along with the prepared
+ * statements created on it (indexed by their SQL text).
+ */
+typedef struct _ModAuthMySqlConn {
+	MYSQL      * conn;
+	/* last time the connection was used */
+	long         stamp;
+	axlHash    * stmts;
+} ModAuthMySqlConn;
+
+/** 
+ * @internal Bounded pool of persistent connections associated to
+ * a dsn node (annotated at the node as "mod:mysql:pool").
+ */
+typedef struct _ModAuthMySqlPool {
+	MyQttMutex   mutex;
+	MyQttCond    cond;
+
+	/* connections available */
+	axlList    * idle;
+	/* connections created (idle + in use) */
+	int          size;
+	int          max_size;
+	int          ping_period;
+
+	/* pool stats */
+	long         created;
+	long         reused;
+	long         waits;
+	long         reconnects;
+	long         failures;
+} ModAuthMySqlPool;
+
 int      __mod_auth_mysql_get_user_id (MyQttConn * conn)
 {
 	int value;
@@ -135,7 +307,7 @@ MYSQL * mod_auth_mysql_get_connection (MyQttdCtx      * ctx,
 {
 	MYSQL   * conn;
 	int       port = 0;
-	int       reconnect = 1;
+	int       reconnect = 0;
 
 	if (ctx == NULL || dsn_node == NULL) {
 		axl_error_report (err, -1, "Received null ctx, auth db node or sql query, failed to run SQL command");
@@ -171,7 +343,9 @@ MYSQL * mod_auth_mysql_get_connection (MyQttdCtx      * ctx,
 		return NULL;
 	} /* end if */
 
-	/* flag here to reconnect in case of lost connection */
+	/* do not reconnect silently: the connection pool checks and
+	 * replaces broken connections (an automatic reconnect would
+	 * invalidate prepared statements cached for this connection) */
 	mysql_options (conn, MYSQL_OPT_RECONNECT, (const char *) &reconnect);
 
 	return conn;
@@ -206,6 +380,396 @@ axl_bool mod_auth_mysql_check_conn (MyQttdCtx * ctx, axlNode * dsn_node)
 	return axl_true;
 }
 
+/** 
+ * @internal Releases a pooled connection and all prepared statements
+ * created on it.
+ */
+void __mod_auth_mysql_conn_free (ModAuthMySqlConn * dbconn)
+{
+	if (dbconn == NULL)
+		return;
+
+	/* statements must be closed before the connection */
+	axl_hash_free (dbconn->stmts);
+	mysql_close (dbconn->conn);
+	axl_free (dbconn);
+	return;
+}
+
+void __mod_auth_mysql_stmt_close (axlPointer stmt)
+{
+	mysql_stmt_close ((MYSQL_STMT *) stmt);
+	return;
+}
+
+/** 
+ * @internal Reports if the last error found on the connection means
+ * it can't be used anymore.
+ */
+axl_bool __mod_auth_mysql_is_broken (unsigned int error_code)
+{
+	return error_code == CR_SERVER_GONE_ERROR || error_code == CR_SERVER_LOST;
+}
+
+void __mod_auth_mysql_pool_free (axlPointer _pool)
+{
+	ModAuthMySqlPool * pool = _pool;
+
+	if (pool == NULL)
+		return;
+
+	axl_list_free (pool->idle);
+	myqtt_mutex_destroy (&pool->mutex);
+	myqtt_cond_destroy (&pool->cond);
+	axl_free (pool);
+	return;
+}
+
+/** 
+ * @internal Creates the connection pool for the provided dsn node
+ * (connections are created on demand).
+ */
+void mod_auth_mysql_pool_init (MyQttdCtx * ctx, axlNode * dsn_node)
+{
+	ModAuthMySqlPool * pool;
+
+	pool              = axl_new (ModAuthMySqlPool, 1);
+	if (pool == NULL)
+		return;
+	pool->idle        = axl_list_new (axl_list_always_return_1, (axlDestroyFunc) __mod_auth_mysql_conn_free);
+	pool->max_size    = MOD_AUTH_MYSQL_POOL_SIZE;
+	pool->ping_period = MOD_AUTH_MYSQL_POOL_PING;
+	myqtt_mutex_create (&pool->mutex);
+	myqtt_cond_create (&pool->cond);
+
+	/* get pool settings */
+	if (HAS_ATTR (dsn_node, "pool-size") && atoi (ATTR_VALUE (dsn_node, "pool-size")) > 0)
+		pool->max_size    = atoi (ATTR_VALUE (dsn_node, "pool-size"));
+	if (HAS_ATTR (dsn_node, "pool-ping") && strlen (ATTR_VALUE (dsn_node, "pool-ping")) > 0)
+		pool->ping_period = atoi (ATTR_VALUE (dsn_node, "pool-ping"));
+
+	/* release pool with the node */
+	axl_node_annotate_data_full (dsn_node, "mod:mysql:pool", NULL, pool, __mod_auth_mysql_pool_free);
+	return;
+}
+
+/** 
+ * @internal Gets a connection from the pool associated to the dsn
+ * node, creating a new one if the pool is not full. Connections
+ * that were idle for more than pool-ping seconds are checked before
+ * being reported.
+ *
+ * The connection must be returned with \ref mod_auth_mysql_pool_release.
+ */
+ModAuthMySqlConn * mod_auth_mysql_pool_acquire (MyQttdCtx * ctx, axlNode * dsn_node, axlError ** err)
+{
+	ModAuthMySqlPool * pool;
+	ModAuthMySqlConn * dbconn = NULL;
+	MYSQL            * conn;
+	axl_bool           result;
+
+	pool = axl_node_annotate_get (dsn_node, "mod:mysql:pool", axl_false);
+	if (pool) {
+		myqtt_mutex_lock (&pool->mutex);
+		while (axl_true) {
+			/* reuse last connection released */
+			if (axl_list_length (pool->idle) > 0) {
+				dbconn = axl_list_get_first (pool->idle);
+				axl_list_unlink_first (pool->idle);
+				pool->reused++;
+				break;
+			} /* end if */
+
+			/* reserve a place to create a new one */
+			if (pool->size < pool->max_size) {
+				pool->size++;
+				break;
+			} /* end if */
+
+			/* pool exhausted, wait for a connection to be released */
+			pool->waits++;
+			MYQTT_COND_TIMEDWAIT (result, &pool->cond, &pool->mutex, MOD_AUTH_MYSQL_POOL_WAIT);
+			if (! result && axl_list_length (pool->idle) == 0 && pool->size >= pool->max_size) {
+				pool->failures++;
+				myqtt_mutex_unlock (&pool->mutex);
+				axl_error_report (err, -1, "Timeout while waiting for a pooled MySQL connection (pool-size=%d)", pool->max_size);
+				return NULL;
+			} /* end if */
+		} /* end while */
+		myqtt_mutex_unlock (&pool->mutex);
+
+		if (dbconn) {
+			/* check connections idle for long */
+			if ((myqttd_now () - dbconn->stamp) < pool->ping_period || mysql_ping (dbconn->conn) == 0)
+				return dbconn;
+
+			wrn ("Pooled MySQL connection is not working (%s), reconnecting", mysql_error (dbconn->conn));
+			__mod_auth_mysql_conn_free (dbconn);
+
+			myqtt_mutex_lock (&pool->mutex);
+			pool->reconnects++;
+			myqtt_mutex_unlock (&pool->mutex);
+		} /* end if */
+	} /* end if */
+
+	/* create a new connection (reusing the place reserved) */
+	conn = mod_auth_mysql_get_connection (ctx, dsn_node, err);
+	if (conn == NULL) {
+		if (pool) {
+			myqtt_mutex_lock (&pool->mutex);
+			pool->size--;
+			pool->failures++;
+			myqtt_cond_signal (&pool->cond);
+			myqtt_mutex_unlock (&pool->mutex);
+		} /* end if */
+		return NULL;
+	} /* end if */
+
+	dbconn        = axl_new (ModAuthMySqlConn, 1);
+	dbconn->conn  = conn;
+	dbconn->stamp = myqttd_now ();
+	dbconn->stmts = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+
+	if (pool) {
+		myqtt_mutex_lock (&pool->mutex);
+		pool->created++;
+		myqtt_mutex_unlock (&pool->mutex);
+	} /* end if */
+
+	return dbconn;
+}
+
+/** 
+ * @internal Returns a connection to the pool. If broken is axl_true,
+ * the connection is closed and its place is released so a new one
+ * is created on next acquire.
+ */
+void mod_auth_mysql_pool_release (axlNode * dsn_node, ModAuthMySqlConn * dbconn, axl_bool broken)
+{
+	ModAuthMySqlPool * pool;
+
+	if (dbconn == NULL)
+		return;
+
+	pool = axl_node_annotate_get (dsn_node, "mod:mysql:pool", axl_false);
+	if (pool == NULL) {
+		/* connection not handled by a pool */
+		__mod_auth_mysql_conn_free (dbconn);
+		return;
+	} /* end if */
+
+	if (broken) {
+		__mod_auth_mysql_conn_free (dbconn);
+
+		myqtt_mutex_lock (&pool->mutex);
+		pool->size--;
+		pool->reconnects++;
+		myqtt_cond_signal (&pool->cond);
+		myqtt_mutex_unlock (&pool->mutex);
+		return;
+	} /* end if */
+
+	dbconn->stamp = myqttd_now ();
+
+	/* place it first so hot connections are reused */
+	myqtt_mutex_lock (&pool->mutex);
+	axl_list_prepend (pool->idle, dbconn);
+	myqtt_cond_signal (&pool->cond);
+	myqtt_mutex_unlock (&pool->mutex);
+	return;
+}
+
+/** 
+ * @brief Allows to get current pool stats for the provided dsn
+ * node. Any of the output parameters can be NULL.
+ *
+ * @return axl_false if the dsn node has no pool associated.
+ */
+axl_bool mod_auth_mysql_pool_stats (axlNode * dsn_node, int * size, int * idle, int * max_size,
+				    long * created, long * reused, long * waits, long * reconnects, long * failures)
+{
+	ModAuthMySqlPool * pool;
+
+	pool = axl_node_annotate_get (dsn_node, "mod:mysql:pool", axl_false);
+	if (pool == NULL)
+		return axl_false;
+
+	myqtt_mutex_lock (&pool->mutex);
+	if (size)
+		(*size)       = pool->size;
+	if (idle)
+		(*idle)       = axl_list_length (pool->idle);
+	if (max_size)
+		(*max_size)   = pool->max_size;
+	if (created)
+		(*created)    = pool->created;
+	if (reused)
+		(*reused)     = pool->reused;
+	if (waits)
+		(*waits)      = pool->waits;
+	if (reconnects)
+		(*reconnects) = pool->reconnects;
+	if (failures)
+		(*failures)   = pool->failures;
+	myqtt_mutex_unlock (&pool->mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Reports pool stats for every dsn configured into the log.
+ */
+void mod_auth_mysql_pool_report (MyQttdCtx * ctx)
+{
+	axlNode * dsn_node;
+	int       size, idle, max_size;
+	long      created, reused, waits, reconnects, failures;
+
+	if (modconfig == NULL)
+		return;
+
+	dsn_node = axl_doc_get (modconfig, "/mod-auth-mysql/dsn");
+	while (dsn_node) {
+		if (mod_auth_mysql_pool_stats (dsn_node, &size, &idle, &max_size, &created, &reused, &waits, &reconnects, &failures)) {
+			msg ("MySQL pool dsn=%s: conns=%d/%d, idle=%d, created=%ld, reused=%ld, waits=%ld, reconnects=%ld, failures=%ld",
+			     ATTR_VALUE (dsn_node, "name") ? ATTR_VALUE (dsn_node, "name") : "", size, max_size, idle,
+			     created, reused, waits, reconnects, failures);
+		} /* end if */
+
+		/* get next node */
+		dsn_node = axl_node_get_next_called (dsn_node, "dsn");
+	} /* end while */
+
+	return;
+}
+
+/** 
+ * @internal Function used by regression tests to check the pool
+ * associated to the first dsn node.
+ */
+axl_bool __mod_auth_mysql_pool_stats_for_test (MyQttdCtx * ctx, int * size, int * max_size, long * created, long * reused)
+{
+	return mod_auth_mysql_pool_stats (axl_doc_get (modconfig, "/mod-auth-mysql/dsn"), size, NULL, max_size, created, reused, NULL, NULL, NULL);
+}
+
+/** 
+ * @internal Runs the server side prepared statement sql (which must
+ * be a static string because it is used as cache key) binding the
+ * integer param provided.
+ *
+ * @param values Where to store the first row columns found (as long)
+ * or NULL for statements that do not report rows.
+ *
+ * @param values_num Amount of columns to get (up to MOD_AUTH_MYSQL_STMT_MAX_COLS).
+ *
+ * @return -1 in case of failure. For queries, 1 if a row was found
+ * or 0 if not. For non queries, the amount of affected rows.
+ */
+long __mod_auth_mysql_stmt_run (MyQttdCtx * ctx, axlNode * dsn_node, const char * sql, int param, long * values, int values_num)
+{
+	ModAuthMySqlConn * dbconn;
+	MYSQL_STMT       * stmt;
+	MYSQL_BIND         bind_param[1];
+	MYSQL_BIND         bind_result[MOD_AUTH_MYSQL_STMT_MAX_COLS];
+	long long          columns[MOD_AUTH_MYSQL_STMT_MAX_COLS];
+	axlError         * err = NULL;
+	int                attempt;
+	int                iterator;
+	int                status;
+	long               result;
+
+	if (values_num > MOD_AUTH_MYSQL_STMT_MAX_COLS)
+		return -1;
+
+	if (HAS_ATTR_VALUE (dsn_node, "debug", "yes")) {
+		msg ("DEBUG: Running statement: %s (param=%d)", sql, param);
+	} /* end if */
+
+	/* retry once in the case the connection was lost */
+	for (attempt = 0; attempt < 2; attempt++) {
+		dbconn = mod_auth_mysql_pool_acquire (ctx, dsn_node, &err);
+		if (dbconn == NULL) {
+			error ("Failed to acquire connection to run statement (%s), error was: %s", sql, axl_error_get (err));
+			axl_error_free (err);
+			return -1;
+		} /* end if */
+
+		/* get statement prepared for this connection */
+		stmt = axl_hash_get (dbconn->stmts, (axlPointer) sql);
+		if (stmt == NULL) {
+			stmt = mysql_stmt_init (dbconn->conn);
+			if (stmt == NULL || mysql_stmt_prepare (stmt, sql, strlen (sql))) {
+				error ("Failed to prepare statement (%s), error was %u: %s", sql, mysql_errno (dbconn->conn), mysql_error (dbconn->conn));
+				if (stmt)
+					mysql_stmt_close (stmt);
+				status = __mod_auth_mysql_is_broken (mysql_errno (dbconn->conn));
+				mod_auth_mysql_pool_release (dsn_node, dbconn, status);
+				if (status)
+					continue;
+				return -1;
+			} /* end if */
+			axl_hash_insert_full (dbconn->stmts, (axlPointer) sql, NULL, stmt, __mod_auth_mysql_stmt_close);
+		} /* end if */
+
+		/* bind param and run */
+		memset (bind_param, 0, sizeof (bind_param));
+		bind_param[0].buffer_type = MYSQL_TYPE_LONG;
+		bind_param[0].buffer      = (char *) &param;
+		if (mysql_stmt_bind_param (stmt, bind_param) || mysql_stmt_execute (stmt)) {
+			error ("Failed to run statement (%s), error was %u: %s", sql, mysql_stmt_errno (stmt), mysql_stmt_error (stmt));
+			status = __mod_auth_mysql_is_broken (mysql_stmt_errno (stmt));
+
+			/* drop statement, it will be prepared again */
+			axl_hash_remove (dbconn->stmts, (axlPointer) sql);
+			mod_auth_mysql_pool_release (dsn_node, dbconn, status);
+			if (status)
+				continue;
+			return -1;
+		} /* end if */
+
+		if (values == NULL) {
+			/* non query, report affected rows */
+			result = (long) mysql_stmt_affected_rows (stmt);
+			mod_auth_mysql_pool_release (dsn_node, dbconn, axl_false);
+			return result;
+		} /* end if */
+
+		/* bind result columns */
+		memset (bind_result, 0, sizeof (bind_result));
+		iterator = 0;
+		while (iterator < values_num) {
+			columns[iterator]                 = 0;
+			bind_result[iterator].buffer_type = MYSQL_TYPE_LONGLONG;
+			bind_result[iterator].buffer      = (char *) &columns[iterator];
+			iterator++;
+		} /* end while */
+
+		result = -1;
+		if (mysql_stmt_bind_result (stmt, bind_result) == 0 && mysql_stmt_store_result (stmt) == 0) {
+			status = mysql_stmt_fetch (stmt);
+			if (status == 0 || status == MYSQL_DATA_TRUNCATED)
+				result = 1;
+			else if (status == MYSQL_NO_DATA)
+				result = 0;
+		} /* end if */
+		if (result == -1)
+			error ("Failed to get statement result (%s), error was %u: %s", sql, mysql_stmt_errno (stmt), mysql_stmt_error (stmt));
+		mysql_stmt_free_result (stmt);
+
+		/* copy values */
+		iterator = 0;
+		while (result == 1 && iterator < values_num) {
+			values[iterator] = (long) columns[iterator];
+			iterator++;
+		} /* end while */
+
+		mod_auth_mysql_pool_release (dsn_node, dbconn, axl_false);
+		return result;
+	} /* end for */
+
+	return -1;
+}
+
 char * __mod_auth_mysql_escape_query (const char * query)
 {
 	int iterator;
@@ -240,12 +804,14 @@ char * __mod_auth_mysql_escape_query (const char * query)
  */
 MYSQL_RES *     mod_auth_mysql_run_query_s   (MyQttdCtx * ctx, axlNode * dsn_node, const char  * query)
 {
-	int         iterator;
-	axl_bool    non_query;
-	MYSQL     * dbconn;
-	char      * local_query;
-	MYSQL_RES * result;
-	axlError  * err = NULL;
+	int                iterator;
+	int                attempt;
+	axl_bool           non_query;
+	axl_bool           broken;
+	ModAuthMySqlConn * dbconn;
+	char             * local_query;
+	MYSQL_RES        * result;
+	axlError         * err = NULL;
 
 	if (ctx == NULL || query == NULL)
 		return NULL;
@@ -267,50 +833,60 @@ MYSQL_RES *     mod_auth_mysql_run_query_s   (MyQttdCtx * ctx, axlNode * dsn_nod
 		iterator++;
 	} /* end if */
 
-	/* get connection */
-	dbconn = mod_auth_mysql_get_connection (ctx, dsn_node, &err);
-	if (dbconn == NULL) {
-		error ("Failed to acquire connection to run query (%s), error was: %s", local_query, axl_error_get (err));
-		axl_error_free (err);
+	/* retry once in the case the connection was lost */
+	for (attempt = 0; attempt < 2; attempt++) {
+		/* get connection */
+		dbconn = mod_auth_mysql_pool_acquire (ctx, dsn_node, &err);
+		if (dbconn == NULL) {
+			error ("Failed to acquire connection to run query (%s), error was: %s", local_query, axl_error_get (err));
+			axl_error_free (err);
 
-		/* release conn */
-		axl_free (local_query);
-		return NULL;
-	} /* end if */
+			/* release conn */
+			axl_free (local_query);
+			return NULL;
+		} /* end if */
 
-	/* now run query */
-	if (mysql_query (dbconn, local_query)) {
-		error ("Failed to run SQL query (%s), error was %u: %s", local_query, mysql_errno (dbconn), mysql_error (dbconn));
+		/* now run query */
+		if (mysql_query (dbconn->conn, local_query)) {
+			error ("Failed to run SQL query (%s), error was %u: %s", local_query, mysql_errno (dbconn->conn), mysql_error (dbconn->conn));
 
-		/* release the connection */
-		mysql_close (dbconn); 
+			/* release the connection */
+			broken = __mod_auth_mysql_is_broken (mysql_errno (dbconn->conn));
+			mod_auth_mysql_pool_release (dsn_node, dbconn, broken);
+			if (broken)
+				continue;
 
-		/* release conn */
-		axl_free (local_query);
-		return NULL;
-	} /* end if */
+			/* release conn */
+			axl_free (local_query);
+			return NULL;
+		} /* end if */
+
+		if (non_query) {
+			/* release the connection */
+			mod_auth_mysql_pool_release (dsn_node, dbconn, axl_false);
+
+			/* release conn */
+			axl_free (local_query);
+
+			/* report ok */
+			return INT_TO_PTR (axl_true);
+		} /* end if */
 
-	if (non_query) {
+		/* return result */
+		result = mysql_store_result (dbconn->conn);
+	
 		/* release the connection */
-		mysql_close (dbconn); 
+		mod_auth_mysql_pool_release (dsn_node, dbconn, axl_false);
 
 		/* release conn */
 		axl_free (local_query);
 
-		/* report ok */
-		return INT_TO_PTR (axl_true);
-	} /* end if */
-
-	/* return result */
-	result = mysql_store_result (dbconn);
-	
-	/* release the connection */
-	mysql_close (dbconn); 
+		return result;
+	} /* end for */
 
 	/* release conn */
 	axl_free (local_query);
-
-	return result;
+	return NULL;
 }
 
 /** 
@@ -387,7 +963,35 @@ long             __mod_auth_mysql_run_query_as_long (MyQttdCtx  * ctx,
 }
 
 
-void __mod_auth_mysql_run_query_for_test (MyQttdCtx * ctx, const char * query)
+/** 
+ * @brief Invalidates all ACLs cached so they are loaded again from
+ * the database on next publish.
+ */
+void mod_auth_mysql_acl_invalidate (MyQttdCtx * ctx)
+{
+	myqtt_mutex_lock (&acl_mutex);
+	acl_generation++;
+	myqtt_mutex_unlock (&acl_mutex);
+	return;
+}
+
+/** 
+ * @internal Command sent to the rest of myqttd processes to
+ * invalidate their ACLs cached.
+ */
+#define MOD_AUTH_MYSQL_ACL_INVALIDATE_CMD "mod-auth-mysql:acl-invalidate"
+
+/** 
+ * @internal Handles commands sent by other myqttd processes.
+ */
+void __mod_auth_mysql_on_command (MyQttdCtx * ctx, const char * command, axlPointer user_data)
+{
+	if (axl_cmp (command, MOD_AUTH_MYSQL_ACL_INVALIDATE_CMD))
+		mod_auth_mysql_acl_invalidate (ctx);
+	return;
+}
+
+void __mod_auth_mysql_run_query_keep_acls_for_test (MyQttdCtx * ctx, const char * query)
 {
 	/* get dsn database configuration node */
 	MYSQL_RES * res;
@@ -406,6 +1010,31 @@ void __mod_auth_mysql_run_query_for_test (MyQttdCtx * ctx, const char * query)
 	return;
 }
 
+void __mod_auth_mysql_run_query_for_test (MyQttdCtx * ctx, const char * query)
+{
+	__mod_auth_mysql_run_query_keep_acls_for_test (ctx, query);
+
+	/* tables may have been changed, do not use cached acls */
+	mod_auth_mysql_acl_invalidate (ctx);
+	return;
+}
+
+void __mod_auth_mysql_acl_config_for_test (MyQttdCtx * ctx, long ttl, const char * invalidate_topic)
+{
+	axlNode * dsn_node;
+
+	/* get dns node */
+	dsn_node = axl_doc_get (modconfig, "/mod-auth-mysql/dsn");
+
+	acl_ttl = ttl;
+	axl_node_remove_attribute (dsn_node, "acl-invalidate-topic");
+	if (invalidate_topic)
+		axl_node_set_attribute (dsn_node, "acl-invalidate-topic", invalidate_topic);
+
+	mod_auth_mysql_acl_invalidate (ctx);
+	return;
+}
+
 /** 
  * @brief Allows to run the provided query reporting the result.
  *
@@ -460,6 +1089,291 @@ MYSQL_RES * mod_auth_mysql_run_query (MyQttdCtx * ctx, axlNode * dsn_node, const
 	return result;
 }
 
+/** 
+ * @internal Runs a single UPDATE adding the deltas provided to each
+ * user usage.
+ */
+axl_bool __mod_auth_mysql_usage_flush_batch (MyQttdCtx * ctx, axlNode * dsn_node, int * ids, long * deltas, int count)
+{
+	char      * cases = NULL;
+	char      * in    = NULL;
+	char      * aux;
+	char      * query;
+	int         iterator;
+	MYSQL_RES * res;
+
+	iterator = 0;
+	while (iterator < count) {
+		aux   = axl_strdup_printf ("%s WHEN %d THEN %ld", cases ? cases : "", ids[iterator], deltas[iterator]);
+		axl_free (cases);
+		cases = aux;
+
+		aux   = axl_strdup_printf ("%s%s%d", in ? in : "", in ? "," : "", ids[iterator]);
+		axl_free (in);
+		in    = aux;
+
+		/* next position */
+		iterator++;
+	} /* end while */
+
+	query = axl_strdup_printf ("UPDATE user_msg_tracking SET current_day_usage = current_day_usage + CASE user_id%s END, current_month_usage = current_month_usage + CASE user_id%s END WHERE user_id IN (%s)",
+				   cases, cases, in);
+	res   = mod_auth_mysql_run_query_s (ctx, dsn_node, query);
+	axl_free (query);
+	axl_free (cases);
+	axl_free (in);
+
+	return res != NULL;
+}
+
+axl_bool __mod_auth_mysql_usage_collect (axlPointer key, axlPointer data, axlPointer user_data)
+{
+	ModAuthMySqlUsage      * usage = data;
+	ModAuthMySqlUsageBatch * batch = user_data;
+
+	if (usage->pending > 0) {
+		batch->ids[batch->count]    = usage->user_id;
+		batch->deltas[batch->count] = usage->pending;
+		batch->count++;
+
+		/* keep it accounted (as flushing) until written */
+		usage->flushing = usage->pending;
+		usage->pending  = 0;
+	} /* end if */
+
+	return axl_false; /* do not stop */
+}
+
+/** 
+ * @internal Completes the flush of the provided users: when written
+ * the increments are accounted as part of the usage (and values are
+ * read again so increments done by other processes are considered),
+ * otherwise they are restored as pending for the next flush.
+ */
+void __mod_auth_mysql_usage_flushed (int * ids, int count, axl_bool written)
+{
+	ModAuthMySqlUsage * usage;
+	int                 iterator;
+
+	myqtt_mutex_lock (&usage_mutex);
+	for (iterator = 0; iterator < count; iterator++) {
+		usage = usage_table ? axl_hash_get (usage_table, INT_TO_PTR (ids[iterator])) : NULL;
+		if (usage == NULL)
+			continue;
+		if (written) {
+			usage->day_usage   += usage->flushing;
+			usage->month_usage += usage->flushing;
+			usage->loaded       = axl_false;
+		} else {
+			usage->pending     += usage->flushing;
+			usage_pending      += usage->flushing;
+		} /* end if */
+		usage->flushing = 0;
+	} /* end for */
+	myqtt_mutex_unlock (&usage_mutex);
+	return;
+}
+
+axl_bool __mod_auth_mysql_usage_unload (axlPointer key, axlPointer data, axlPointer user_data)
+{
+	ModAuthMySqlUsage * usage = data;
+
+	usage->loaded = axl_false;
+	return axl_false; /* do not stop */
+}
+
+/** 
+ * @brief Writes all message usage pending into the database using
+ * batched UPDATEs.
+ */
+void mod_auth_mysql_usage_flush (MyQttdCtx * ctx, axlNode * dsn_node)
+{
+	ModAuthMySqlUsageBatch   batch;
+	int                      iterator;
+	int                      amount;
+	axl_bool                 written;
+
+	/* one flush at a time (flushing increments belong to it) */
+	myqtt_mutex_lock (&usage_flush_mutex);
+
+	/* collect pending increments */
+	myqtt_mutex_lock (&usage_mutex);
+	if (usage_table == NULL || usage_pending == 0) {
+		myqtt_mutex_unlock (&usage_mutex);
+		myqtt_mutex_unlock (&usage_flush_mutex);
+		return;
+	} /* end if */
+	batch.count  = 0;
+	batch.ids    = axl_new (int, axl_hash_items (usage_table) + 1);
+	batch.deltas = axl_new (long, axl_hash_items (usage_table) + 1);
+	axl_hash_foreach (usage_table, __mod_auth_mysql_usage_collect, &batch);
+	usage_pending = 0;
+	myqtt_mutex_unlock (&usage_mutex);
+
+	iterator = 0;
+	while (iterator < batch.count) {
+		amount = batch.count - iterator;
+		if (amount > MOD_AUTH_MYSQL_USAGE_BATCH)
+			amount = MOD_AUTH_MYSQL_USAGE_BATCH;
+
+		/* increments are only cleared once written, otherwise
+		 * they are kept to write them later */
+		written = __mod_auth_mysql_usage_flush_batch (ctx, dsn_node, batch.ids + iterator, batch.deltas + iterator, amount);
+		if (! written)
+			error ("Failed to write message usage for %d users, keeping it for next flush", amount);
+		__mod_auth_mysql_usage_flushed (batch.ids + iterator, amount, written);
+
+		/* next batch */
+		iterator += amount;
+	} /* end while */
+
+	myqtt_mutex_unlock (&usage_flush_mutex);
+
+	axl_free (batch.ids);
+	axl_free (batch.deltas);
+	return;
+}
+
+/** 
+ * @internal Event used to write message usage periodically.
+ */
+axl_bool __mod_auth_mysql_usage_flush_event (MyQttCtx * myqtt_ctx, axlPointer user_data, axlPointer user_data2)
+{
+	mod_auth_mysql_usage_flush (user_data, user_data2);
+	return axl_false; /* do not remove the event */
+}
+
+/** 
+ * @internal Forces usage to be read again from the database (used
+ * after day and month resets).
+ */
+void __mod_auth_mysql_usage_unload_all (void)
+{
+	myqtt_mutex_lock (&usage_mutex);
+	if (usage_table)
+		axl_hash_foreach (usage_table, __mod_auth_mysql_usage_unload, NULL);
+	myqtt_mutex_unlock (&usage_mutex);
+	return;
+}
+
+/** 
+ * @internal Accounts a new message published by the user, checking
+ * quotas when check_quota is axl_true. Usage is kept in memory and
+ * written by \ref mod_auth_mysql_usage_flush (after
+ * usage-flush-period seconds or usage-flush-count increments).
+ *
+ * @return 0 when the message was accounted, 1 when day quota was
+ * reached and 2 when month quota was reached (current usage is
+ * reported on day_usage and month_usage).
+ */
+int __mod_auth_mysql_usage_inc (MyQttdCtx * ctx, axlNode * dsn_node, MyQttdDomain * domain, int user_id,
+				axl_bool check_quota, long * day_usage, long * month_usage)
+{
+	ModAuthMySqlUsage * usage;
+	long                values[2] = {0, 0};
+	long                found;
+	axl_bool            flush;
+
+	myqtt_mutex_lock (&usage_mutex);
+	usage = axl_hash_get (usage_table, INT_TO_PTR (user_id));
+	if (usage == NULL || ! usage->loaded) {
+		myqtt_mutex_unlock (&usage_mutex);
+
+		/* no flush can run while usage is read: otherwise
+		 * the value read may already include increments
+		 * that are accounted again once the flush completes */
+		myqtt_mutex_lock (&usage_flush_mutex);
+
+		/* get current usage (prepared statements) */
+		found = __mod_auth_mysql_stmt_run (ctx, dsn_node, MOD_AUTH_MYSQL_SQL_GET_USAGE, user_id, values, 2);
+		if (found == 0) {
+			/* record does not exists, insert an empty one for this user */
+			__mod_auth_mysql_stmt_run (ctx, dsn_node, MOD_AUTH_MYSQL_SQL_ADD_USAGE, user_id, NULL, 0);
+		} /* end if */
+
+		myqtt_mutex_lock (&usage_mutex);
+		usage = axl_hash_get (usage_table, INT_TO_PTR (user_id));
+		if (usage == NULL) {
+			usage          = axl_new (ModAuthMySqlUsage, 1);
+			usage->user_id = user_id;
+			axl_hash_insert_full (usage_table, INT_TO_PTR (user_id), NULL, usage, axl_free);
+		} /* end if */
+
+		/* retry on next publish if reading failed */
+		if (found >= 0) {
+			usage->day_usage   = values[0];
+			usage->month_usage = values[1];
+			usage->loaded      = axl_true;
+		} /* end if */
+		myqtt_mutex_unlock (&usage_flush_mutex);
+	} /* end if */
+
+	/* get usage with this message */
+	(*day_usage)   = usage->day_usage + usage->flushing + usage->pending + 1;
+	(*month_usage) = usage->month_usage + usage->flushing + usage->pending + 1;
+
+	if (check_quota) {
+		/* limit here if quota has been reached */
+		if ((*day_usage) > myqttd_domain_get_day_message_quota (domain)) {
+			myqtt_mutex_unlock (&usage_mutex);
+			return 1;
+		} /* end if */
+		if ((*month_usage) > myqttd_domain_get_month_message_quota (domain)) {
+			myqtt_mutex_unlock (&usage_mutex);
+			return 2;
+		} /* end if */
+	} /* end if */
+
+	/* account message */
+	usage->pending++;
+	usage_pending++;
+	flush = usage_flush_period <= 0 || usage_pending >= usage_flush_count;
+	myqtt_mutex_unlock (&usage_mutex);
+
+	if (flush)
+		mod_auth_mysql_usage_flush (ctx, dsn_node);
+
+	return 0;
+}
+
+long __mod_auth_mysql_run_query_as_long_for_test (MyQttdCtx * ctx, const char * query)
+{
+	return __mod_auth_mysql_run_query_as_long (ctx, axl_doc_get (modconfig, "/mod-auth-mysql/dsn"), "%s", query);
+}
+
+void __mod_auth_mysql_usage_config_for_test (MyQttdCtx * ctx, long flush_period, long flush_count)
+{
+	axlNode * dsn_node;
+
+	/* get dns node */
+	dsn_node = axl_doc_get (modconfig, "/mod-auth-mysql/dsn");
+
+	/* write what is pending with previous settings */
+	if (usage_event_id != -1)
+		myqtt_thread_pool_remove_event (MYQTTD_MYQTT_CTX (ctx), usage_event_id);
+	usage_event_id = -1;
+	mod_auth_mysql_usage_flush (ctx, dsn_node);
+
+	usage_flush_period = flush_period;
+	usage_flush_count  = flush_count;
+	if (usage_flush_period > 0)
+		usage_event_id = myqtt_thread_pool_new_event (MYQTTD_MYQTT_CTX (ctx), usage_flush_period * 1000000,
+							      __mod_auth_mysql_usage_flush_event, ctx, dsn_node);
+	return;
+}
+
+int __mod_auth_mysql_usage_inc_for_test (MyQttdCtx * ctx, MyQttdDomain * domain, int user_id, axl_bool check_quota,
+					 long * day_usage, long * month_usage)
+{
+	return __mod_auth_mysql_usage_inc (ctx, axl_doc_get (modconfig, "/mod-auth-mysql/dsn"), domain, user_id, check_quota, day_usage, month_usage);
+}
+
+void __mod_auth_mysql_usage_flush_for_test (MyQttdCtx * ctx)
+{
+	mod_auth_mysql_usage_flush (ctx, axl_doc_get (modconfig, "/mod-auth-mysql/dsn"));
+	return;
+}
+
 /** 
  * @brief Handler called when day changes.
  */
@@ -470,8 +1384,22 @@ void mod_auth_mysql_change_day (MyQttdCtx * ctx, long new_value, axlPointer user
 	long        now;
 	axlNode   * dsn_node = user_data;
 
+	/* write usage pending before recording history */
+	mod_auth_mysql_usage_flush (ctx, dsn_node);
+
+	/* history and reset are done once, by the main process
+	 * (childs only write their pending usage and read it again) */
+	if (myqttd_ctx_is_child (ctx)) {
+		__mod_auth_mysql_usage_unload_all ();
+		return;
+	} /* end if */
+
 	/* get all usage records before setting them to 0 */
 	res = mod_auth_mysql_run_query_s (ctx,  dsn_node, "SELECT user_id, current_day_usage FROM user_msg_tracking WHERE current_day_usage > 0");
+	if (res == NULL) {
+		error ("SQL query for change_day failed...");
+		return;
+	} /* end if */
 
 	/* handle data to record history */
 	now = myqttd_now ();
@@ -496,6 +1424,9 @@ void mod_auth_mysql_change_day (MyQttdCtx * ctx, long new_value, axlPointer user
 	/* reset day usage for all mail plans */
 	mod_auth_mysql_run_query_s (ctx, dsn_node,"UPDATE user_msg_tracking SET current_day_usage = '0'");
 
+	/* read usage again */
+	__mod_auth_mysql_usage_unload_all ();
+
 	return;
 }
 
@@ -509,8 +1440,18 @@ void mod_auth_mysql_change_month (MyQttdCtx * ctx, long new_value, axlPointer us
 	long          now;
 	axlNode     * dsn_node = user_data;
 
+	/* write usage pending before recording history */
+	mod_auth_mysql_usage_flush (ctx, dsn_node);
+
+	/* history and reset are done once, by the main process
+	 * (childs only write their pending usage and read it again) */
+	if (myqttd_ctx_is_child (ctx)) {
+		__mod_auth_mysql_usage_unload_all ();
+		return;
+	} /* end if */
+
 	/* get all usage records before setting them to 0 */
-	res = mod_auth_mysql_run_query_s (ctx,  dsn_node, "SELECT user_id, current_month_usage FROM use_msg_tracking WHERE current_month_usage > 0");
+	res = mod_auth_mysql_run_query_s (ctx,  dsn_node, "SELECT user_id, current_month_usage FROM user_msg_tracking WHERE current_month_usage > 0");
 	if (res == NULL) {
 		error ("SQL query for change_month failed...");
 		return;
@@ -539,6 +1480,9 @@ void mod_auth_mysql_change_month (MyQttdCtx * ctx, long new_value, axlPointer us
 	/* reset day usage for all mail plans */
 	mod_auth_mysql_run_query (ctx, dsn_node, "UPDATE user_msg_tracking SET current_month_usage = '0'");
 
+	/* read usage again */
+	__mod_auth_mysql_usage_unload_all ();
+
 	return;
 }
 
@@ -703,6 +1647,183 @@ axl_bool        mod_auth_mysql_ensure_table (MyQttdCtx  * ctx,
 }
 
 
+/** 
+ * @internal Releases a reference to the set, acl_mutex must be
+ * held.
+ */
+void __mod_auth_mysql_acl_set_unref_unlocked (axlPointer _set)
+{
+	ModAuthMySqlAclSet * set = _set;
+	int                  iterator;
+
+	if (set == NULL)
+		return;
+	set->refs--;
+	if (set->refs > 0)
+		return;
+
+	iterator = 0;
+	while (iterator < set->count) {
+		axl_free (set->acls[iterator].topic_filter);
+		iterator++;
+	} /* end while */
+	axl_free (set->acls);
+	axl_free (set);
+	return;
+}
+
+void __mod_auth_mysql_acl_set_unref (axlPointer set)
+{
+	myqtt_mutex_lock (&acl_mutex);
+	__mod_auth_mysql_acl_set_unref_unlocked (set);
+	myqtt_mutex_unlock (&acl_mutex);
+	return;
+}
+
+/** 
+ * @internal Reports if the set can still be used, acl_mutex must be
+ * held.
+ */
+axl_bool __mod_auth_mysql_acl_set_is_valid (ModAuthMySqlAclSet * set)
+{
+	if (set == NULL || set->generation != acl_generation)
+		return axl_false;
+	return (myqttd_now () - set->stamp) < acl_ttl;
+}
+
+int __mod_auth_mysql_acl_get_bit (MyQttdCtx * ctx, MYSQL_RES * res, MYSQL_ROW row, const char * name, int bit)
+{
+	if (myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, res, row, name), NULL))
+		return bit;
+	return 0;
+}
+
+/** 
+ * @internal Compiles ACL rows received into a set with one reference
+ * owned by the caller. The result is released. A NULL result
+ * produces an empty set.
+ */
+ModAuthMySqlAclSet * __mod_auth_mysql_acl_set_compile (MyQttdCtx * ctx, MYSQL_RES * res, axl_bool is_domain_acl)
+{
+	ModAuthMySqlAclSet * set;
+	ModAuthMySqlAcl    * acl;
+	MYSQL_ROW            row;
+	const char         * topic_filter;
+
+	set             = axl_new (ModAuthMySqlAclSet, 1);
+	set->refs       = 1;
+	set->stamp      = myqttd_now ();
+	myqtt_mutex_lock (&acl_mutex);
+	set->generation = acl_generation;
+	myqtt_mutex_unlock (&acl_mutex);
+	if (res == NULL)
+		return set;
+
+	set->acls = axl_new (ModAuthMySqlAcl, mysql_num_rows (res) + 1);
+	row       = mysql_fetch_row (res);
+	while (row) {
+		topic_filter = __mod_auth_mysql_get_by_name (ctx, res, row, "topic_filter");
+		if (topic_filter == NULL) {
+			row = mysql_fetch_row (res);
+			continue;
+		} /* end if */
+
+		acl                    = &(set->acls[set->count]);
+		acl->topic_filter      = axl_strdup (topic_filter);
+		acl->has_wildcards     = strchr (topic_filter, '+') || strchr (topic_filter, '#');
+		acl->action_if_matches = myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, res, row, "action_if_matches"), NULL);
+		if (is_domain_acl)
+			acl->apply_after = myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, res, row, "apply_after"), NULL);
+
+		/* permissions */
+		acl->perms = __mod_auth_mysql_acl_get_bit (ctx, res, row, "w", MOD_AUTH_MYSQL_ACL_W) |
+			__mod_auth_mysql_acl_get_bit (ctx, res, row, "publish", MOD_AUTH_MYSQL_ACL_PUBLISH) |
+			__mod_auth_mysql_acl_get_bit (ctx, res, row, "publish0", MOD_AUTH_MYSQL_ACL_PUBLISH0) |
+			__mod_auth_mysql_acl_get_bit (ctx, res, row, "publish1", MOD_AUTH_MYSQL_ACL_PUBLISH1) |
+			__mod_auth_mysql_acl_get_bit (ctx, res, row, "publish2", MOD_AUTH_MYSQL_ACL_PUBLISH2);
+		set->count++;
+
+		/* get next row */
+		row = mysql_fetch_row (res);
+	} /* end while */
+
+	mysql_free_result (res);
+	return set;
+}
+
+/** 
+ * @internal Gets domain acls from cache or loads them from the
+ * database when they expired. The caller owns a reference to the set
+ * reported.
+ */
+ModAuthMySqlAclSet * __mod_auth_mysql_get_domain_acls (MyQttdCtx * ctx, axlNode * dsn_node, MyQttdDomain * domain)
+{
+	ModAuthMySqlAclSet * set;
+	MYSQL_RES          * res;
+
+	myqtt_mutex_lock (&acl_mutex);
+	set = axl_hash_get (domain_acls, (axlPointer) myqttd_domain_get_name (domain));
+	if (__mod_auth_mysql_acl_set_is_valid (set)) {
+		set->refs++;
+		myqtt_mutex_unlock (&acl_mutex);
+		return set;
+	} /* end if */
+	myqtt_mutex_unlock (&acl_mutex);
+
+	/* load acls */
+	res = mod_auth_mysql_run_query (ctx, dsn_node, "SELECT * FROM domain_acl WHERE is_active = '1' AND  domain_id = (SELECT id FROM domain WHERE is_active = '1' AND name = '%s')",
+					myqttd_domain_get_name (domain));
+	if (res == NULL)
+		return NULL;
+	set = __mod_auth_mysql_acl_set_compile (ctx, res, axl_true);
+
+	/* cache it (the cache owns one reference) */
+	if (acl_ttl > 0) {
+		myqtt_mutex_lock (&acl_mutex);
+		set->refs++;
+		axl_hash_insert_full (domain_acls, axl_strdup (myqttd_domain_get_name (domain)), axl_free, set, __mod_auth_mysql_acl_set_unref_unlocked);
+		myqtt_mutex_unlock (&acl_mutex);
+	} /* end if */
+
+	return set;
+}
+
+/** 
+ * @internal Gets user acls cached on the connection or loads them
+ * from the database when they expired. The caller owns a reference
+ * to the set reported.
+ */
+ModAuthMySqlAclSet * __mod_auth_mysql_get_user_acls (MyQttdCtx * ctx, axlNode * dsn_node, MyQttConn * conn, int user_id)
+{
+	ModAuthMySqlAclSet * set;
+	MYSQL_RES          * res;
+
+	myqtt_mutex_lock (&acl_mutex);
+	set = myqtt_conn_get_data (conn, "mod:mysql:auth:acls");
+	if (__mod_auth_mysql_acl_set_is_valid (set)) {
+		set->refs++;
+		myqtt_mutex_unlock (&acl_mutex);
+		return set;
+	} /* end if */
+	myqtt_mutex_unlock (&acl_mutex);
+
+	/* load acls */
+	res = mod_auth_mysql_run_query (ctx, dsn_node, "SELECT * FROM user_acl WHERE is_active = '1' AND user_id = '%d'", user_id);
+	if (res == NULL)
+		return NULL;
+	set = __mod_auth_mysql_acl_set_compile (ctx, res, axl_false);
+
+	/* cache it on the connection (which owns one reference) */
+	if (acl_ttl > 0) {
+		myqtt_mutex_lock (&acl_mutex);
+		set->refs++;
+		myqtt_mutex_unlock (&acl_mutex);
+		myqtt_conn_set_data_full (conn, "mod:mysql:auth:acls", set, NULL, __mod_auth_mysql_acl_set_unref);
+	} /* end if */
+
+	return set;
+}
+
 /** Implementation for MyQttdUsersLoadDb **/
 axlPointer __mod_auth_mysql_load (MyQttdCtx    * ctx,
 				  MyQttdDomain * domain,
@@ -762,6 +1883,9 @@ axl_bool __mod_auth_mysql_accept_user (MyQttdCtx * ctx, MyQttdDomain * domain, M
 					   user_id, time (NULL), myqtt_conn_get_host (conn), __mod_auth_mysql_get_protocol (conn));
 		mod_auth_mysql_run_query_s (ctx, dsn_node, query);
 		axl_free (query);
+
+		/* load user acls now so publish does not have to */
+		__mod_auth_mysql_acl_set_unref (__mod_auth_mysql_get_user_acls (ctx, dsn_node, conn, user_id));
 		
 	} /* end if */
 	
@@ -838,7 +1962,7 @@ axl_bool     __mod_auth_mysql_auth_user (MyQttdCtx    * ctx,
 	axl_bool    anonymous;
 	int         default_acl;
 	int         apply_message_quota;
-	char      * digest_password;
+	char      * user_key;
 	axl_bool    result;
 	int         user_id;
 	axl_bool    check_protocol_allowed;
@@ -914,21 +2038,18 @@ axl_bool     __mod_auth_mysql_auth_user (MyQttdCtx    * ctx,
 			return __mod_auth_mysql_reject_user (ctx, domain, dsn_node, domain_selected, users, conn, -1, user_name, clientid, "Username/clientid combination unknown for this domain");
 		} /* end if */
 
-		/* user and client id (and password) */
-		digest_password = myqtt_tls_get_digest (MYQTT_MD5, password);
-		if (digest_password == NULL) 
-			return __mod_auth_mysql_reject_user (ctx, domain, dsn_node, domain_selected, users, conn, -1, user_name, clientid, "Unable to encode password into MD5 for query");
-
-		/* get result */
-		result  = axl_cmp (digest_password, row[1]);
+		/* user and client id (and password): stored value is
+		 * an MD5 digest or a salted hash */
+		user_key = axl_strdup_printf ("%s\n%s\n%s", myqttd_domain_get_name (domain), clientid, user_name);
+		result   = myqttd_users_verify_password (ctx, user_key, row[1], password, MYQTTD_PASSWORD_MD5);
+		axl_free (user_key);
 
 		if (HAS_ATTR_VALUE (dsn_node, "debug", "yes")) {
-			/* report database password found and what was provided by the calling user */
-			msg ("Checking password [%s] == [%s], result %d", digest_password, row[1], result);
+			/* report result without exposing stored values */
+			msg ("Checking password for user [%s], client-id [%s], result %d", user_name, clientid, result);
 		} /* end if */
 		
 		user_id = myqtt_support_strtod (row[0], NULL);
-		axl_free (digest_password);
 		if (result)
 			check_protocol_allowed = __mod_auth_mysql_protocol_allowed (ctx, res, row, conn);
 		mysql_free_result (res);
@@ -1032,11 +2153,12 @@ void __mod_auth_mysql_show_mysql_row (MYSQL_RES * acls, MYSQL_ROW row)
 
 
 MyQttPublishCodes __mod_auth_mysql_apply_acl (MyQttdCtx * ctx, MyQttdDomain * domain, MyQttCtx * myqtt_ctx,
-					      MyQttConn * conn, MyQttMsg * msg, axl_bool apply_after, axl_bool is_domain_acl, MYSQL_RES * acls)
+					      MyQttConn * conn, MyQttMsg * msg, axl_bool apply_after, axl_bool is_domain_acl, ModAuthMySqlAclSet * acls)
 {
-	MYSQL_ROW            row;
-	axl_bool             local_apply_after;
-	const char         * topic_filter;
+	ModAuthMySqlAcl    * acl;
+	int                  iterator;
+	int                  perms;
+	const char         * topic;
 	MyQttPublishCodes    action_if_matches;
 	/* get default acl action to report it in case action_if_matches does not define any valid code: namely 0 */
 	MyQttPublishCodes    default_acl_action  = __mod_auth_mysql_get_default_acl (ctx, conn);
@@ -1045,56 +2167,48 @@ MyQttPublishCodes __mod_auth_mysql_apply_acl (MyQttdCtx * ctx, MyQttdDomain * do
 	if (acls == NULL)
 		return MYQTT_PUBLISH_DUNNO;
 
-	/* reset to the first position */
-	mysql_data_seek (acls, 0);
+	/* permissions that allow this publish to match */
+	perms = MOD_AUTH_MYSQL_ACL_W | MOD_AUTH_MYSQL_ACL_PUBLISH;
+	switch (myqtt_msg_get_qos (msg)) {
+	case MYQTT_QOS_0:
+		perms |= MOD_AUTH_MYSQL_ACL_PUBLISH0;
+		break;
+	case MYQTT_QOS_1:
+		perms |= MOD_AUTH_MYSQL_ACL_PUBLISH1;
+		break;
+	case MYQTT_QOS_2:
+		perms |= MOD_AUTH_MYSQL_ACL_PUBLISH2;
+		break;
+	default:
+		break;
+	} /* end switch */
 
-	/* get the first row */
-	row = mysql_fetch_row (acls);
-	while (row) {
+	topic    = myqtt_msg_get_topic (msg);
+	iterator = 0;
+	while (iterator < acls->count) {
+		acl = &(acls->acls[iterator]);
+		iterator++;
 
-		if (is_domain_acl) {
+		/* domain acl, do not apply it if apply_after does not match */
+		if (is_domain_acl && acl->apply_after != apply_after)
+			continue;
 
-			/* domain acl, get apply_after status */
-			local_apply_after = myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "apply_after"), NULL);
-			if (local_apply_after != apply_after) {
-				/* do not apply acl here, go to the next */
-				row = mysql_fetch_row (acls);
-				continue;
-			} /* end if */
-		} /* end if */
+		/* filter matches, apply option indicated */
+		if (! (acl->perms & perms))
+			continue;
 
 		/* check topic to see if it matches with message topic */
-		topic_filter = __mod_auth_mysql_get_by_name (ctx, acls, row, "topic_filter");
-		if (myqtt_reader_topic_filter_match (myqtt_msg_get_topic (msg), topic_filter)) {
-
+		if (acl->has_wildcards ? myqtt_reader_topic_filter_match (topic, acl->topic_filter) : axl_cmp (topic, acl->topic_filter)) {
 			/* get action if matches */
-			action_if_matches = myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "action_if_matches"), NULL);
+			action_if_matches = acl->action_if_matches;
 			if (action_if_matches == 0) {
 				/* let domain default configuration decide */
 				action_if_matches = default_acl_action;
 			} /* end if */
-			
-			/* filter matches, apply option indicated */
-			if (myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "w"), NULL))
-				return action_if_matches;
-			
-			if (myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "publish"), NULL))
-				return action_if_matches;
-			
-			if (myqtt_msg_get_qos (msg) == MYQTT_QOS_0 && myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "publish0"), NULL))
-				return action_if_matches;
-			
-			if (myqtt_msg_get_qos (msg) == MYQTT_QOS_1 && myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "publish1"), NULL))
-				return action_if_matches;
-			
-			if (myqtt_msg_get_qos (msg) == MYQTT_QOS_2 && myqtt_support_strtod (__mod_auth_mysql_get_by_name (ctx, acls, row, "publish2"), NULL))
-				return action_if_matches;
-		} /* end if */
-		
 
-		/* get next row */
-		row = mysql_fetch_row (acls);
-	} /* end if */
+			return action_if_matches;
+		} /* end if */
+	} /* end while */
 
 	return MYQTT_PUBLISH_DUNNO; /* no acl reported nothing especial, so let's continue */
 }
@@ -1102,7 +2216,7 @@ MyQttPublishCodes __mod_auth_mysql_apply_acl (MyQttdCtx * ctx, MyQttdDomain * do
 MyQttPublishCodes __mod_auth_mysql_on_publish_aux (MyQttdCtx * ctx,        MyQttdDomain * domain, 
 						   MyQttCtx  * myqtt_ctx,  MyQttConn    * conn, 
 						   MyQttMsg  * msg,        axlNode      * dsn_node,
-						   MYSQL_RES * users_acls, MYSQL_RES    * domain_acls,
+						   ModAuthMySqlAclSet * users_acls, ModAuthMySqlAclSet * domain_acls,
 						   int         user_id)
 {
 	MyQttPublishCodes     result;
@@ -1137,72 +2251,59 @@ MyQttPublishCodes __mod_auth_mysql_on_publish (MyQttdCtx * ctx,       MyQttdDoma
 {
 	int                   user_id     = __mod_auth_mysql_get_user_id (conn);
 	axlNode             * dsn_node    = user_data;
-	MYSQL_RES           * users_acls  = NULL;
-	MYSQL_RES           * domain_acls = NULL;
+	ModAuthMySqlAclSet  * users_acls  = NULL;
+	ModAuthMySqlAclSet  * domain_acls = NULL;
 	MyQttPublishCodes     result;
 	int                   apply_message_quota;
 	long                  current_day_usage;
 	long                  current_month_usage;
 
-	/* get acls for domain requested */
-	domain_acls = mod_auth_mysql_run_query (ctx, dsn_node, "SELECT * FROM domain_acl WHERE is_active = '1' AND  domain_id = (SELECT id FROM domain WHERE is_active = '1' AND name = '%s')",
-						myqttd_domain_get_name (domain));
+	/* get acls for domain requested (cached) */
+	domain_acls = __mod_auth_mysql_get_domain_acls (ctx, dsn_node, domain);
 	if (user_id > 0)  {
-		/* get user acls if user is defined */
-		users_acls  = mod_auth_mysql_run_query (ctx, dsn_node, "SELECT * FROM user_acl WHERE is_active = '1' AND user_id = '%d'", user_id);
+		/* get user acls if user is defined (cached on the connection) */
+		users_acls  = __mod_auth_mysql_get_user_acls (ctx, dsn_node, conn, user_id);
 	} /* end if */
 
 	/** call aux function, get result and release resources */
 	result = __mod_auth_mysql_on_publish_aux (ctx, domain, myqtt_ctx, conn, msg, dsn_node, users_acls, domain_acls, user_id);
 
-	/* release memory */
-	mysql_free_result (users_acls);
-	mysql_free_result (domain_acls);
+	/* release references */
+	__mod_auth_mysql_acl_set_unref (users_acls);
+	__mod_auth_mysql_acl_set_unref (domain_acls);
 
-	if (result == MYQTT_PUBLISH_OK && user_id > 0) {
-		/* check if record exists or not */
-		if (! __mod_auth_mysql_run_query_as_long (ctx, dsn_node, "SELECT count(*) FROM user_msg_tracking WHERE user_id = '%d'", user_id)) {
-			/* record does not exists, insert an empty one for this user */
-			mod_auth_mysql_run_query (ctx, dsn_node, "INSERT INTO user_msg_tracking (current_day_usage, current_month_usage, user_id) VALUES (0, 0, '%d')", user_id);
-		} /* end if */
-		
-		/* get current messages */
-		current_day_usage   = __mod_auth_mysql_run_query_as_long (ctx, dsn_node, "SELECT current_day_usage FROM user_msg_tracking WHERE user_id = '%d'", user_id);
-		if (current_day_usage >= 0)
-			current_day_usage++;
-		
-		current_month_usage = __mod_auth_mysql_run_query_as_long (ctx, dsn_node, "SELECT current_month_usage FROM user_msg_tracking WHERE user_id = '%d'", user_id);
-		if (current_month_usage >= 0)
-			current_month_usage++;
+	/* check for acl invalidation requests */
+	if (result == MYQTT_PUBLISH_OK && HAS_ATTR (dsn_node, "acl-invalidate-topic") &&
+	    axl_cmp (myqtt_msg_get_topic (msg), ATTR_VALUE (dsn_node, "acl-invalidate-topic"))) {
+		msg ("Received ACL invalidation request (topic %s), ACLs will be reloaded", myqtt_msg_get_topic (msg));
+		mod_auth_mysql_acl_invalidate (ctx);
 
-		/* ok, operation ok, now track publish limits, it any */
-		apply_message_quota = PTR_TO_INT (myqtt_conn_get_data (conn, "mod:mysql:auth:message_quota"));
-		if (apply_message_quota) {
-			
-			/* limit here if quota has been reached */
-			if (current_day_usage > myqttd_domain_get_day_message_quota (domain)) {
-				/* report to the log */
-				msg ("Publish rejected for user-id=%d, clientid=%s, username=%s, ip=%s, protocol=%s : daily quota has been reached (%d messages)",
-				     user_id,
-				     myqtt_conn_get_client_id (conn)  ? myqtt_conn_get_client_id (conn) : "",
-				     myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "", myqtt_conn_get_host (conn), __mod_auth_mysql_get_protocol (conn), current_day_usage);
-				return MYQTT_PUBLISH_DISCARD;
-			} /* end if */
-
-			/* month check*/
-			if (current_month_usage > myqttd_domain_get_month_message_quota (domain)) {
-				/* report to the log */
-				msg ("Publish rejected for user-id=%d, clientid=%s, username=%s, ip=%s, protocol=%s : monthly quota has been reached (%d messages)",
-				     user_id,
-				     myqtt_conn_get_client_id (conn)  ? myqtt_conn_get_client_id (conn) : "",
-				     myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "", myqtt_conn_get_host (conn), __mod_auth_mysql_get_protocol (conn), current_month_usage);
-				return MYQTT_PUBLISH_DISCARD;
-			} /* end if */
-			
-		} /* end if */
+		/* notify the rest of processes (parent and childs) */
+		myqttd_process_send_command (ctx, MOD_AUTH_MYSQL_ACL_INVALIDATE_CMD);
+	} /* end if */
 
-		/* reached this point, publish has not been limited by quota, update database database */
-		mod_auth_mysql_run_query (ctx, dsn_node, "UPDATE user_msg_tracking SET current_day_usage = current_day_usage + 1, current_month_usage = current_month_usage + 1 WHERE user_id = '%d'", user_id);
+	if (result == MYQTT_PUBLISH_OK && user_id > 0) {
+		/* ok, operation ok, now track publish limits, it any
+		 * (usage is kept in memory and written periodically) */
+		apply_message_quota = PTR_TO_INT (myqtt_conn_get_data (conn, "mod:mysql:auth:message_quota"));
+		switch (__mod_auth_mysql_usage_inc (ctx, dsn_node, domain, user_id, apply_message_quota, &current_day_usage, &current_month_usage)) {
+		case 1:
+			/* report to the log */
+			msg ("Publish rejected for user-id=%d, clientid=%s, username=%s, ip=%s, protocol=%s : daily quota has been reached (%d messages)",
+			     user_id,
+			     myqtt_conn_get_client_id (conn)  ? myqtt_conn_get_client_id (conn) : "",
+			     myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "", myqtt_conn_get_host (conn), __mod_auth_mysql_get_protocol (conn), current_day_usage);
+			return MYQTT_PUBLISH_DISCARD;
+		case 2:
+			/* report to the log */
+			msg ("Publish rejected for user-id=%d, clientid=%s, username=%s, ip=%s, protocol=%s : monthly quota has been reached (%d messages)",
+			     user_id,
+			     myqtt_conn_get_client_id (conn)  ? myqtt_conn_get_client_id (conn) : "",
+			     myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "", myqtt_conn_get_host (conn), __mod_auth_mysql_get_protocol (conn), current_month_usage);
+			return MYQTT_PUBLISH_DISCARD;
+		default:
+			break;
+		} /* end switch */
 	} /* end if */
 
 	/* call to report data...nice and clean code! how beatiful! */
@@ -1276,6 +2377,9 @@ static int  mod_auth_mysql_init (MyQttdCtx * _ctx)
 		/* close connection */
 		mysql_close (conn);
 
+		/* create connection pool for this dsn */
+		mod_auth_mysql_pool_init (ctx, dsn_node);
+
 		/* call to ensure databases */
 
 		/* domain table */
@@ -1407,6 +2511,26 @@ static int  mod_auth_mysql_init (MyQttdCtx * _ctx)
 	/* reached this point, all connections are working */
 	msg ("MySQL initial settings ok, registering backend");
 
+	/* init acl cache */
+	dsn_node    = axl_doc_get (modconfig, "/mod-auth-mysql/dsn");
+	if (HAS_ATTR (dsn_node, "acl-ttl") && strlen (ATTR_VALUE (dsn_node, "acl-ttl")) > 0)
+		acl_ttl = atoi (ATTR_VALUE (dsn_node, "acl-ttl"));
+	myqtt_mutex_create (&acl_mutex);
+	domain_acls = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+
+	/* init message usage tracking */
+	if (HAS_ATTR (dsn_node, "usage-flush-period") && strlen (ATTR_VALUE (dsn_node, "usage-flush-period")) > 0)
+		usage_flush_period = atoi (ATTR_VALUE (dsn_node, "usage-flush-period"));
+	if (HAS_ATTR (dsn_node, "usage-flush-count") && atoi (ATTR_VALUE (dsn_node, "usage-flush-count")) > 0)
+		usage_flush_count  = atoi (ATTR_VALUE (dsn_node, "usage-flush-count"));
+	myqtt_mutex_create (&usage_mutex);
+	myqtt_mutex_create (&usage_flush_mutex);
+	usage_table = axl_hash_new (axl_hash_int, axl_hash_equal_int);
+	caches_ready = axl_true;
+	if (usage_flush_period > 0)
+		usage_event_id = myqtt_thread_pool_new_event (MYQTTD_MYQTT_CTX (ctx), usage_flush_period * 1000000,
+							      __mod_auth_mysql_usage_flush_event, ctx, dsn_node);
+
 	/* install handlers to implement auth based on a simple xml
 	   backend */
 	if (! myqttd_users_register_backend (ctx, 
@@ -1425,6 +2549,9 @@ static int  mod_auth_mysql_init (MyQttdCtx * _ctx)
 	dsn_node = axl_doc_get (modconfig, "/mod-auth-mysql/dsn");
 	myqttd_ctx_add_on_publish (ctx, __mod_auth_mysql_on_publish, dsn_node);
 
+	/* receive ACL invalidations notified by other processes */
+	myqttd_process_add_on_command (ctx, __mod_auth_mysql_on_command, NULL);
+
 	/* register on subscribe */
 	/* myqttd_ctx_add_on_subscribe (ctx, __mod_auth_mysql_on_subscribe, NULL);  */
 
@@ -1447,9 +2574,39 @@ static void mod_auth_mysql_close (MyQttdCtx * ctx)
 
 	if (doc == NULL)
 		return;
+
+	/* stop periodic usage writes and write what is pending */
+	if (usage_event_id != -1)
+		myqtt_thread_pool_remove_event (MYQTTD_MYQTT_CTX (ctx), usage_event_id);
+	usage_event_id = -1;
+	if (caches_ready)
+		mod_auth_mysql_usage_flush (ctx, axl_doc_get (doc, "/mod-auth-mysql/dsn"));
+
+	/* report pool usage before closing pooled connections
+	 * (released along with the document) */
+	mod_auth_mysql_pool_report (ctx);
 	modconfig = NULL;
 	axl_doc_free (doc);
 
+	/* release acl cache and usage tracking (only created if
+	 * init reached that point) */
+	if (caches_ready) {
+		myqtt_mutex_lock (&acl_mutex);
+		axl_hash_free (domain_acls);
+		domain_acls = NULL;
+		myqtt_mutex_unlock (&acl_mutex);
+
+		myqtt_mutex_lock (&usage_mutex);
+		axl_hash_free (usage_table);
+		usage_table = NULL;
+		myqtt_mutex_unlock (&usage_mutex);
+
+		myqtt_mutex_destroy (&acl_mutex);
+		myqtt_mutex_destroy (&usage_mutex);
+		myqtt_mutex_destroy (&usage_flush_mutex);
+		caches_ready = axl_false;
+	} /* end if */
+
 	/* finish thread and library */
 	mysql_thread_end ();
 	mysql_library_end ();
@@ -1465,7 +2622,11 @@ static void mod_auth_mysql_close (MyQttdCtx * ctx)
  * should reread its files. It is an optional handler.
  */
 static void mod_auth_mysql_reconf (MyQttdCtx * ctx) {
-	/* for now nothing */
+	/* report pool usage */
+	mod_auth_mysql_pool_report (ctx);
+
+	/* force acls to be reloaded */
+	mod_auth_mysql_acl_invalidate (ctx);
 	return;
 }
 
@@ -57,27 +57,276 @@ typedef enum {
 	MOD_AUTH_XML_APPLY_AFTER  = 2
 } ModAuthXmlWhenToApply;
 
+/** 
+ * @internal Permission bits of a compiled acl (mode attribute).
+ */
+#define MOD_AUTH_XML_ACL_R        (1 << 0)
+#define MOD_AUTH_XML_ACL_W        (1 << 1)
+#define MOD_AUTH_XML_ACL_SUBSCRIBE (1 << 2)
+#define MOD_AUTH_XML_ACL_PUBLISH0 (1 << 3)
+#define MOD_AUTH_XML_ACL_PUBLISH1 (1 << 4)
+#define MOD_AUTH_XML_ACL_PUBLISH2 (1 << 5)
+
+/** 
+ * @internal <acl> node compiled.
+ */
+typedef struct _ModAuthXmlAcl {
+	char         * topic;
+	/* declaration order, used to apply first acl declared when
+	 * exact and wildcard acls match */
+	int            position;
+	int            perms;
+} ModAuthXmlAcl;
+
+/** 
+ * @internal Set of acls declared inside <global-acls> or <user>:
+ * acls without wildcards are indexed by topic and wildcard acls are
+ * kept in declaration order.
+ */
+typedef struct _ModAuthXmlAclTable {
+	axlHash      * exact;
+	axlList      * wildcards;
+	/* all acls (owner) */
+	axlList      * acls;
+} ModAuthXmlAclTable;
+
+/** 
+ * @internal <user> node loaded.
+ */
+typedef struct _ModAuthXmlUser ModAuthXmlUser;
+struct _ModAuthXmlUser {
+	char               * id;
+	char               * username;
+	char               * password;
+	ModAuthXmlAclTable * acls;
+
+	/* next user declared with the same id */
+	ModAuthXmlUser     * next_same_id;
+};
+
 typedef struct _ModAuthXmlBackend {
 
 	char         * full_path;
-	axlDoc       * doc;
 
 	axl_bool       anonymous;
 	/*
 	 * <myqtt-users password-format='plain|md5|sha1'>
 	 * 0 - plain : password as is, clear text
 	 * 1 - md5   : password md5 encoded
-	 * 2 - sha1  : password md5 encoded
+	 * 2 - sha1  : password sha1 encoded
+	 * (values starting with $pbkdf2-sha256$ are salted hashes)
 	 */
-	int            password_format;
-	axlNode      * global_acls;
-	
+	MyQttdPasswordFormat password_format;
+	ModAuthXmlAclTable  * global_acls;
+
 	MyQttPublishCodes     no_match_policy;
 	ModAuthXmlWhenToApply when_to_apply;
 	MyQttPublishCodes     deny_action;
 
+	/* users loaded (owner) and indexes to find them by client id
+	 * (first user declared) and by username */
+	axlList      * users;
+	axlHash      * by_id;
+	axlHash      * by_username;
+
 } ModAuthXmlBackend;
 
+void __mod_auth_xml_acl_free (axlPointer _acl)
+{
+	ModAuthXmlAcl * acl = _acl;
+
+	axl_free (acl->topic);
+	axl_free (acl);
+	return;
+}
+
+void __mod_auth_xml_acl_table_free (ModAuthXmlAclTable * table)
+{
+	if (table == NULL)
+		return;
+
+	axl_hash_free (table->exact);
+	axl_list_free (table->wildcards);
+	axl_list_free (table->acls);
+	axl_free (table);
+	return;
+}
+
+void __mod_auth_xml_user_free (axlPointer _user)
+{
+	ModAuthXmlUser * user = _user;
+
+	axl_free (user->id);
+	axl_free (user->username);
+	axl_free (user->password);
+	__mod_auth_xml_acl_table_free (user->acls);
+	axl_free (user);
+	return;
+}
+
+/** 
+ * @internal Translates mode attribute (comma separated list of r, w,
+ * rw, publish, subscribe, publish0, publish1, publish2) into
+ * permission bits.
+ */
+int __mod_auth_xml_acl_get_perms (const char * mode)
+{
+	char ** tokens;
+	char  * token;
+	int     iterator;
+	int     perms = 0;
+
+	if (mode == NULL)
+		return 0;
+
+	tokens = axl_split (mode, 1, ",");
+	if (tokens == NULL)
+		return 0;
+
+	iterator = 0;
+	while (tokens[iterator]) {
+		token = tokens[iterator];
+		axl_stream_trim (token);
+
+		if (axl_cmp (token, "r"))
+			perms |= MOD_AUTH_XML_ACL_R;
+		else if (axl_cmp (token, "w") || axl_cmp (token, "publish"))
+			perms |= MOD_AUTH_XML_ACL_W;
+		else if (axl_cmp (token, "rw") || axl_cmp (token, "wr"))
+			perms |= MOD_AUTH_XML_ACL_R | MOD_AUTH_XML_ACL_W;
+		else if (axl_cmp (token, "subscribe"))
+			perms |= MOD_AUTH_XML_ACL_SUBSCRIBE;
+		else if (axl_cmp (token, "publish0"))
+			perms |= MOD_AUTH_XML_ACL_PUBLISH0;
+		else if (axl_cmp (token, "publish1"))
+			perms |= MOD_AUTH_XML_ACL_PUBLISH1;
+		else if (axl_cmp (token, "publish2"))
+			perms |= MOD_AUTH_XML_ACL_PUBLISH2;
+
+		/* next position */
+		iterator++;
+	} /* end while */
+
+	axl_freev (tokens);
+	return perms;
+}
+
+/** 
+ * @internal Compiles all <acl> nodes found inside the provided node.
+ *
+ * @return A new acl table or NULL if no acl was declared.
+ */
+ModAuthXmlAclTable * __mod_auth_xml_acl_table_load (axlNode * parent)
+{
+	ModAuthXmlAclTable * table;
+	ModAuthXmlAcl      * acl;
+	axlNode            * node;
+	const char         * topic;
+	int                  position = 0;
+
+	node = axl_node_get_child_called (parent, "acl");
+	if (node == NULL)
+		return NULL;
+
+	table            = axl_new (ModAuthXmlAclTable, 1);
+	table->exact     = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+	table->wildcards = axl_list_new (axl_list_always_return_1, NULL);
+	table->acls      = axl_list_new (axl_list_always_return_1, __mod_auth_xml_acl_free);
+
+	while (node) {
+		topic = ATTR_VALUE (node, "topic");
+		if (topic) {
+			acl           = axl_new (ModAuthXmlAcl, 1);
+			acl->topic    = axl_strdup (topic);
+			acl->position = position++;
+			acl->perms    = __mod_auth_xml_acl_get_perms (ATTR_VALUE (node, "mode"));
+			axl_list_append (table->acls, acl);
+
+			if (strchr (topic, '+') || strchr (topic, '#'))
+				axl_list_append (table->wildcards, acl);
+			else if (! axl_hash_exists (table->exact, acl->topic))
+				axl_hash_insert (table->exact, acl->topic, acl);
+		} /* end if */
+
+		/* call to get next acl node */
+		node = axl_node_get_next_called (node, "acl");
+	} /* end while */
+
+	return table;
+}
+
+/** 
+ * @internal Loads all <user> nodes building indexes by client id and
+ * username.
+ */
+void __mod_auth_xml_users_load (ModAuthXmlBackend * backend, axlDoc * doc)
+{
+	axlNode        * node;
+	ModAuthXmlUser * user;
+	ModAuthXmlUser * last;
+
+	backend->users       = axl_list_new (axl_list_always_return_1, __mod_auth_xml_user_free);
+	backend->by_id       = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+	backend->by_username = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+
+	node = axl_doc_get (doc, "/myqtt-users/user");
+	while (node) {
+		user           = axl_new (ModAuthXmlUser, 1);
+		user->id       = axl_strdup (ATTR_VALUE (node, "id"));
+		user->username = axl_strdup (ATTR_VALUE (node, "username"));
+		user->password = axl_strdup (ATTR_VALUE (node, "password"));
+		user->acls     = __mod_auth_xml_acl_table_load (node);
+		axl_list_append (backend->users, user);
+
+		/* index by client id, chaining users with same id */
+		if (user->id) {
+			last = axl_hash_get (backend->by_id, user->id);
+			if (last == NULL)
+				axl_hash_insert (backend->by_id, user->id, user);
+			else {
+				while (last->next_same_id)
+					last = last->next_same_id;
+				last->next_same_id = user;
+			} /* end if */
+		} /* end if */
+
+		/* index by username (first declared) */
+		if (user->username && ! axl_hash_exists (backend->by_username, user->username))
+			axl_hash_insert (backend->by_username, user->username, user);
+
+		/* get next <user> node */
+		node = axl_node_get_next_called (node, "user");
+	} /* end while */
+
+	return;
+}
+
+/** 
+ * @internal Finds the user according to the check mode (see
+ * myqttd_support_check_mode).
+ */
+ModAuthXmlUser * __mod_auth_xml_find_user (ModAuthXmlBackend * backend, int check_mode, const char * client_id, const char * user_name)
+{
+	ModAuthXmlUser * user;
+
+	switch (check_mode) {
+	case 3:
+		/* user and client id */
+		user = axl_hash_get (backend->by_id, (axlPointer) client_id);
+		while (user && ! axl_cmp (user_name, user->username))
+			user = user->next_same_id;
+		return user;
+	case 2:
+		/* client id */
+		return axl_hash_get (backend->by_id, (axlPointer) client_id);
+	case 1:
+		/* user */
+		return axl_hash_get (backend->by_username, (axlPointer) user_name);
+	} /* end switch */
+
+	return NULL;
+}
+
 /** Implementation for MyQttdUsersLoadDb **/
 axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 				MyQttdDomain * domain,
@@ -90,7 +339,7 @@ axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 	ModAuthXmlBackend * backend;
 	axlError          * err = NULL;
 	const char        * value;
-	
+
 	if (full_path == NULL)
 		return NULL;
 
@@ -114,12 +363,12 @@ axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 	backend = axl_new (ModAuthXmlBackend, 1);
 	if (backend == NULL) {
 		axl_free (full_path);
+		axl_doc_free (doc);
 		return NULL;
 	} /* end if */
 
 	/* get references */
 	backend->full_path = full_path;
-	backend->doc       = doc;
 
 	/* configure anonymous status */
 	node = axl_doc_get (doc, "/myqtt-users");
@@ -127,21 +376,21 @@ axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 
 	/* configure password format indication */
 	if (HAS_ATTR_VALUE (node, "password-format", "md5"))
-		backend->password_format = 1;
+		backend->password_format = MYQTTD_PASSWORD_MD5;
 	else if (HAS_ATTR_VALUE (node, "password-format", "sha1"))
-		backend->password_format = 2;
+		backend->password_format = MYQTTD_PASSWORD_SHA1;
 	else {
 		/* just for clarity, if nothing is configured or
 		   "plain", password format is: plain (clear text) */
-		backend->password_format = 0;
+		backend->password_format = MYQTTD_PASSWORD_PLAIN;
 	} /* end if */
 
 	/* now get current global configuration */
-	backend->global_acls = axl_doc_get (backend->doc, "/myqtt-users/global-acls");
-	if (backend->global_acls) {
-		
+	node = axl_doc_get (doc, "/myqtt-users/global-acls");
+	if (node) {
+
 		/* get no match policy to quickly haccess it */
-		value = ATTR_VALUE (backend->global_acls, "no-match-policy");
+		value = ATTR_VALUE (node, "no-match-policy");
 		if (axl_cmp (value, "close"))
 			backend->no_match_policy = MYQTT_PUBLISH_CONN_CLOSE;
 		else if (axl_cmp (value, "discard") || axl_cmp (value, "deny"))
@@ -150,9 +399,9 @@ axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 			backend->no_match_policy = MYQTT_PUBLISH_OK;
 		else
 			backend->no_match_policy = MYQTT_PUBLISH_OK; /* by default ok for no-match-policy */
-		
+
 		/* and deny action if defined */
-		value = ATTR_VALUE (backend->global_acls, "deny-action");
+		value = ATTR_VALUE (node, "deny-action");
 		if (axl_cmp (value, "close"))
 			backend->deny_action = MYQTT_PUBLISH_CONN_CLOSE;
 		else if (axl_cmp (value, "discard") || axl_cmp (value, "deny"))
@@ -161,18 +410,26 @@ axlPointer __mod_auth_xml_load (MyQttdCtx    * ctx,
 			backend->deny_action = MYQTT_PUBLISH_OK;
 		else
 			backend->deny_action = MYQTT_PUBLISH_DISCARD; /* by default discard */
-		
+
 		/* and when to apply if defined */
-		value = ATTR_VALUE (backend->global_acls, "when-to-apply");
+		value = ATTR_VALUE (node, "when-to-apply");
 		if (axl_cmp (value, "before"))
 			backend->when_to_apply = MOD_AUTH_XML_APPLY_BEFORE;
 		else if (axl_cmp (value, "after"))
 			backend->when_to_apply = MOD_AUTH_XML_APPLY_AFTER;
 		else
 			backend->when_to_apply = MOD_AUTH_XML_APPLY_BEFORE; /* by default apply before */
-		
+
+		/* compile global acls */
+		backend->global_acls = __mod_auth_xml_acl_table_load (node);
+
 	} /* end if */
 
+	/* load users and their acls: the document is not used after
+	 * this point */
+	__mod_auth_xml_users_load (backend, doc);
+	axl_doc_free (doc);
+
 	/* report backend */
 	return backend;
 }
@@ -188,7 +445,6 @@ axl_bool     __mod_auth_xml_user_exists (MyQttdCtx    * ctx,
 					 const char   * user_name)
 {
 	ModAuthXmlBackend * backend    = _backend;
-	axlNode           * node       = axl_doc_get (backend->doc, "/myqtt-users/user");
 	int                 check_mode = 0;
 
 	if (backend->anonymous) {
@@ -202,32 +458,8 @@ axl_bool     __mod_auth_xml_user_exists (MyQttdCtx    * ctx,
 		return axl_false;
 	} /* end if */
 
-	while (node) {
-		switch (check_mode) {
-		case 3:
-			/* user and client id */
-			if (axl_cmp (client_id, ATTR_VALUE (node, "id")) && 
-			    axl_cmp (user_name, ATTR_VALUE (node, "username")))
-				return axl_true;
-			break;
-		case 2:
-			/* client id */
-			if (axl_cmp (client_id, ATTR_VALUE (node, "id")))
-				return axl_true;
-			break;
-		case 1:
-			/* user */
-			if (axl_cmp (user_name, ATTR_VALUE (node, "username")))
-				return axl_true;
-			break;
-		} /* end switch */
-
-		/* get next <user> node */
-		node = axl_node_get_next_called (node, "user");
-	} /* end while */
-
-	/* user does not exists for this backend */
-	return axl_false;
+	/* find user through indexes */
+	return __mod_auth_xml_find_user (backend, check_mode, client_id, user_name) != NULL;
 }
 
 /** Implementation for MyQttdUsersAuthUser **/
@@ -242,12 +474,10 @@ axl_bool     __mod_auth_xml_auth_user (MyQttdCtx    * ctx,
 				       const char   * password)
 {
 	ModAuthXmlBackend * backend    = _backend;
-	axlNode           * node       = axl_doc_get (backend->doc, "/myqtt-users/user");
+	ModAuthXmlUser    * user;
 	int                 check_mode = 0;
 	axl_bool            result;
-#if defined(ENABLE_TLS_SUPPORT)
-	char              * temp;
-#endif
+	char              * user_key;
 
 	/* check to authorize user if the is we have anonymous option
 	 * enabled */
@@ -262,74 +492,27 @@ axl_bool     __mod_auth_xml_auth_user (MyQttdCtx    * ctx,
 		return axl_false;
 	} /* end if */
 
-	while (node) {
-		switch (check_mode) {
-		case 3:
-			/* user and client id (and password) */
-			if (axl_cmp (client_id, ATTR_VALUE (node, "id")) && 
-			    axl_cmp (user_name, ATTR_VALUE (node, "username"))) {
-
-				/* check password here */
-				result = axl_false;
-				switch (backend->password_format) {
-				case 0:
-					/* plain */
-					result = axl_cmp (password, ATTR_VALUE (node, "password"));
-					break;
-#if defined(ENABLE_TLS_SUPPORT)
-				case 1:
-					/* md5 */
-					temp   = myqtt_tls_get_digest (MYQTT_MD5, ATTR_VALUE (node, "password"));
-					result = axl_cmp (password, temp);
-					axl_free (temp);
-					break;
-				case 2:
-					/* sha1 */
-					temp   = myqtt_tls_get_digest (MYQTT_SHA1, ATTR_VALUE (node, "password"));
-					result = axl_cmp (password, temp);
-					axl_free (temp);
-					break;
-				} /* end switch */
-#endif
+	/* find user through indexes */
+	user = __mod_auth_xml_find_user (backend, check_mode, client_id, user_name);
+	if (user == NULL) {
+		/* user does not exists for this backend */
+		return axl_false;
+	} /* end if */
 
-				/* check authentication to store node
-				 * for later use and report result */
-				if (result) {
-					/* anotate this node into the connection */
-					myqtt_conn_set_data (conn, "mod:auth:xml:user-node", node);
-				} /* end if */
-				
-				return result;
-			}
-			break;
-		case 2:
-			/* client id */
-			if (axl_cmp (client_id, ATTR_VALUE (node, "id"))) {
-				
-				/* anotate this node into the connection */
-				myqtt_conn_set_data (conn, "mod:auth:xml:user-node", node);
-				
-				return axl_true;
-			}
-			break;
-		case 1:
-			/* user */
-			if (axl_cmp (user_name, ATTR_VALUE (node, "username"))) {
-				
-				/* anotate this node into the connection */
-				myqtt_conn_set_data (conn, "mod:auth:xml:user-node", node);
-				
-				return axl_true;
-			} /* end if */
-			break;
-		} /* end switch */
+	if (check_mode == 3) {
+		/* user and client id (and password): check password here */
+		user_key = axl_strdup_printf ("%s\n%s\n%s", backend->full_path, user->id ? user->id : "", user->username ? user->username : "");
+		result   = myqttd_users_verify_password (ctx, user_key, user->password, password, backend->password_format);
+		axl_free (user_key);
 
-		/* get next <user> node */
-		node = axl_node_get_next_called (node, "user");
-	} /* end while */
+		if (! result)
+			return axl_false;
+	} /* end if */
+
+	/* anotate this user into the connection for later use */
+	myqtt_conn_set_data (conn, "mod:auth:xml:user", user);
 
-	/* user does not exists for this backend */
-	return axl_false;
+	return axl_true;
 }
 
 /** MyQttdUsersUnloadDb **/
@@ -338,64 +521,76 @@ void __mod_auth_xml_unload (MyQttdCtx * ctx,
 {
 	ModAuthXmlBackend * backend = _backend;
 	
-	/* release full path and internal document holding database */
+	/* release full path, users and acls loaded */
 	axl_free (backend->full_path);
-	/* printf ("%s:%d -- axl_doc_free (%p)\n", __AXL_FILE__, __AXL_LINE__, backend->doc); */
-	axl_doc_free (backend->doc);
+	__mod_auth_xml_acl_table_free (backend->global_acls);
+	axl_hash_free (backend->by_id);
+	axl_hash_free (backend->by_username);
+	axl_list_free (backend->users);
 	axl_free (backend);
 
 	return;
 }
 
-axl_bool __mod_auth_xml_on_publish_acl_deny (ModAuthXmlBackend * backend, axlNode * acl, MyQttMsg * msg, MyQttConn * conn) {
+axl_bool __mod_auth_xml_on_publish_acl_deny (ModAuthXmlBackend * backend, ModAuthXmlAclTable * acls, MyQttMsg * msg, MyQttConn * conn) {
+
+	ModAuthXmlAcl   * acl;
+	ModAuthXmlAcl   * wildcard;
+	const char      * topic;
+	int               iterator;
+	int               perms;
+
+	if (acls == NULL)
+		return axl_true; /* not denied */
+
+	/* find first acl declared matching the topic: exact match or
+	 * wildcard declared before it */
+	topic    = myqtt_msg_get_topic (msg);
+	acl      = axl_hash_get (acls->exact, (axlPointer) topic);
+	iterator = 0;
+	while (iterator < axl_list_length (acls->wildcards)) {
+		wildcard = axl_list_get_nth (acls->wildcards, iterator);
+		if (acl && wildcard->position > acl->position)
+			break;
+		if (myqtt_reader_topic_filter_match (topic, wildcard->topic)) {
+			acl = wildcard;
+			break;
+		} /* end if */
+		iterator++;
+	} /* end while */
 
 	if (acl == NULL)
 		return axl_true; /* not denied */
 
-	while (acl) {
-
-		/* printf ("ACL: checking %s == %s\n", ATTR_VALUE (acl, "topic"), myqtt_msg_get_topic (msg)); */
-		if (axl_cmp (ATTR_VALUE (acl, "topic"), myqtt_msg_get_topic (msg))) {
-			
-			/* acl found, see policy */
-			if (strstr ("w", ATTR_VALUE (acl, "mode"))) {
-				/* found write acl in PUBLISH acl, so allow it */
-				return axl_true;
-			}
-			
-			/* acl found, see policy */
-			if (strstr ("publish", ATTR_VALUE (acl, "mode"))) {
-				/* found write acl in PUBLISH acl, so allow it */
-				return axl_true;
-			} 
-
-			/* acl found, see policy */
-			if ((strstr ("publish0", ATTR_VALUE (acl, "mode")) && myqtt_msg_get_qos (msg) == MYQTT_QOS_0) ||
-			    (strstr ("publish1", ATTR_VALUE (acl, "mode")) && myqtt_msg_get_qos (msg) == MYQTT_QOS_1) ||
-			    (strstr ("publish2", ATTR_VALUE (acl, "mode")) && myqtt_msg_get_qos (msg) == MYQTT_QOS_2)) {
-				/* found write acl in PUBLISH acl, so allow it */
-				return axl_true;
-			}
-
-			/* reached this point, acl was found, but it
-			 * does not allow PUBLISH (write) */
-			error ("Denied PUBLISH operation from %s:%s (client-id: %s, user: %s) because acl %s (%s)",
-			       myqtt_conn_get_host (conn), myqtt_conn_get_port (conn),
-			       myqtt_conn_get_client_id (conn), myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "<not defined>",
-			       myqtt_msg_get_topic (msg),
-			       backend->full_path);
-			
-			return axl_false; /** DENIED **/
-			
-		} /* end while */
+	/* acl found, see policy */
+	perms = MOD_AUTH_XML_ACL_W;
+	switch (myqtt_msg_get_qos (msg)) {
+	case MYQTT_QOS_0:
+		perms |= MOD_AUTH_XML_ACL_PUBLISH0;
+		break;
+	case MYQTT_QOS_1:
+		perms |= MOD_AUTH_XML_ACL_PUBLISH1;
+		break;
+	case MYQTT_QOS_2:
+		perms |= MOD_AUTH_XML_ACL_PUBLISH2;
+		break;
+	default:
+		break;
+	} /* end switch */
+	if (acl->perms & perms) {
+		/* found write acl in PUBLISH acl, so allow it */
+		return axl_true;
+	} /* end if */
 
-		
-		/* call to get next acl node */
-		acl = axl_node_get_next_called (acl, "acl");
-		
-	} /* end while */
-	
-	return axl_true; /* not denied */
+	/* reached this point, acl was found, but it
+	 * does not allow PUBLISH (write) */
+	error ("Denied PUBLISH operation from %s:%s (client-id: %s, user: %s) because acl %s (%s)",
+	       myqtt_conn_get_host (conn), myqtt_conn_get_port (conn),
+	       myqtt_conn_get_client_id (conn), myqtt_conn_get_username (conn) ? myqtt_conn_get_username (conn) : "<not defined>",
+	       myqtt_msg_get_topic (msg),
+	       backend->full_path);
+
+	return axl_false; /** DENIED **/
 }
 
 MyQttPublishCodes __mod_auth_xml_report (MyQttdCtx * ctx, MyQttMsg * msg, MyQttConn * conn, MyQttPublishCodes code)
@@ -415,7 +610,7 @@ MyQttPublishCodes __mod_auth_xml_on_publish (MyQttdCtx * ctx,       MyQttdDomain
 
 	MyQttdUsers       * users = myqttd_domain_get_users_backend (domain);
 	ModAuthXmlBackend * backend;
-	axlNode           * node;
+	ModAuthXmlUser    * user;
 
 	if (users == NULL) {
 		error ("Connection close on publish because Users' backend is not available..");
@@ -433,16 +628,16 @@ MyQttPublishCodes __mod_auth_xml_on_publish (MyQttdCtx * ctx,       MyQttdDomain
 	if (backend->when_to_apply == MOD_AUTH_XML_APPLY_BEFORE) {
 		
 		/* do acl apply before applying users' acls */
-		if (! __mod_auth_xml_on_publish_acl_deny (backend, axl_node_get_child_called (backend->global_acls, "acl"), msg, conn))
+		if (! __mod_auth_xml_on_publish_acl_deny (backend, backend->global_acls, msg, conn))
 			return __mod_auth_xml_report (ctx, msg, conn, backend->deny_action);
 		
 	} /* end if */
 
 	/* find user and apply its acls if defined */
-	node = myqtt_conn_get_data (conn, "mod:auth:xml:user-node");
+	user = myqtt_conn_get_data (conn, "mod:auth:xml:user");
 
-	/* USER: apply acls if defined for the provided user node */
-	if (! __mod_auth_xml_on_publish_acl_deny (backend, axl_node_get_child_called (node, "acl"), msg, conn))
+	/* USER: apply acls if defined for the provided user */
+	if (! __mod_auth_xml_on_publish_acl_deny (backend, user ? user->acls : NULL, msg, conn))
 		return __mod_auth_xml_report (ctx, msg, conn, backend->deny_action);
 
 
@@ -450,7 +645,7 @@ MyQttPublishCodes __mod_auth_xml_on_publish (MyQttdCtx * ctx,       MyQttdDomain
 	if (backend->when_to_apply == MOD_AUTH_XML_APPLY_AFTER) {
 		
 		/* do acl apply after applying users' acls */
-		if (! __mod_auth_xml_on_publish_acl_deny (backend, axl_node_get_child_called (backend->global_acls, "acl"), msg, conn))
+		if (! __mod_auth_xml_on_publish_acl_deny (backend, backend->global_acls, msg, conn))
 			return __mod_auth_xml_report (ctx, msg, conn, backend->deny_action);
 		
 	} /* end if */
@@ -594,9 +789,18 @@ END_C_DECLS
  * - <b>plain</b> : passwords stored as is (not recommended)
  * - <b>md5</b> : passwords stored in md5
  * - <b>sha1</b> : passwords stored in sha1
+ *
+ * No matter the format, passwords starting with
+ * <b>$pbkdf2-sha256$</b> are checked as salted PBKDF2 hashes (see
+ * myqttd_users_password_hash). All comparisons run in constant time.
  * 
  *
  * \note It is possible to use same database for different domains.
+ *
+ * \note users.xml is only read when the domain backend is loaded:
+ * users and acls are kept in memory indexed by client id and username
+ * (acls without wildcards are indexed by topic), so changes require
+ * reloading the domain.
  * 
  * 
  * \section myqttd_mod_auth_xml_anonymous Configuring anonymous login
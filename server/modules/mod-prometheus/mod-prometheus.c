@@ -0,0 +1,872 @@
+/* 
+ *  MyQtt: A high performance open source MQTT implementation
+ *  Copyright (C) 2016 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build MQTT enabled solutions contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         C/ Antonio Suarez Nº 10, 
+ *         Edificio Alius A, Despacho 102
+ *         Alcalá de Henares 28802 (Madrid)
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/mqtt
+ *                        http://www.aspl.es/myqtt
+ */
+
+#include <myqttd.h>
+
+/* include private headers */
+#include <myqttd-ctx-private.h>
+
+#if defined(ENABLE_TLS_SUPPORT)
+#include <myqtt-tls.h>
+#endif
+
+#if defined(AXL_OS_UNIX)
+#include <poll.h>
+#endif
+
+/* use this declarations to avoid c++ compilers to mangle exported
+ * names. */
+BEGIN_C_DECLS
+
+MyQttdCtx    * ctx = NULL;
+axlDoc       * mod_prometheus_conf = NULL;
+
+/* listener serving metrics and the thread attending it */
+MYQTT_SOCKET   mod_prometheus_socket  = MYQTT_INVALID_SOCKET;
+MyQttThread    mod_prometheus_thread;
+axl_bool       mod_prometheus_running = axl_false;
+axl_bool       mod_prometheus_exit    = axl_false;
+
+/* scrapes being attended (each one by its own thread) */
+#define MOD_PROMETHEUS_MAX_SCRAPES   8
+#define MOD_PROMETHEUS_READ_TIMEOUT  2000
+#define MOD_PROMETHEUS_SEND_TIMEOUT  5000
+MyQttMutex     mod_prometheus_mutex;
+MyQttCond      mod_prometheus_cond;
+int            mod_prometheus_scrapes = 0;
+
+/** 
+ * @internal Upper bounds (microseconds) used to render latency
+ * histograms as Prometheus cumulative buckets (le labels are reported
+ * in seconds).
+ */
+long long      mod_prometheus_bounds[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 
+					  100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, -1};
+
+/** 
+ * @internal Buffer where the metrics document is rendered.
+ */
+typedef struct _ModPrometheusBuffer {
+	char * content;
+	int    size;
+	int    length;
+} ModPrometheusBuffer;
+
+/** 
+ * @internal Values collected from each domain before rendering so
+ * every metric family is reported grouped.
+ */
+typedef struct _ModPrometheusDomain {
+	char         * name;
+	int            conns;
+	int            sessions;
+	int            subs;
+	long           msgs_in;
+	long           msgs_out;
+	long           month_quota;
+	long           day_quota;
+	int            conn_limit;
+	int            storage_limit;
+	int            storage_msgs;
+	int            retained_msgs;
+	int            running_threads;
+	int            waiting_threads;
+	int            pending_tasks;
+	axl_bool       has_metrics;
+	MyQttMetrics   metrics;
+} ModPrometheusDomain;
+
+/** 
+ * @internal Appends the provided content into the buffer.
+ */
+void __mod_prometheus_printf (ModPrometheusBuffer * buffer, const char * format, ...)
+{
+	va_list   args;
+	char    * content;
+	char    * aux;
+	int       length;
+
+	va_start (args, format);
+	content = axl_strdup_printfv (format, args);
+	va_end (args);
+	if (content == NULL)
+		return;
+
+	length = strlen (content);
+	if ((buffer->length + length + 1) > buffer->size) {
+		aux = axl_realloc (buffer->content, (buffer->size + length + 1) * 2);
+		if (aux == NULL) {
+			axl_free (content);
+			return;
+		} /* end if */
+		buffer->content = aux;
+		buffer->size    = (buffer->size + length + 1) * 2;
+	} /* end if */
+
+	memcpy (buffer->content + buffer->length, content, length + 1);
+	buffer->length += length;
+	axl_free (content);
+
+	return;
+}
+
+/** 
+ * @internal Returns a copy of the provided value escaped to be used
+ * as a label value (backslash, double quote and new line).
+ */
+char * __mod_prometheus_escape (const char * value)
+{
+	char * result;
+	int    iterator = 0;
+	int    length   = 0;
+
+	if (value == NULL)
+		return axl_strdup ("");
+
+	result = axl_new (char, (strlen (value) * 2) + 1);
+	if (result == NULL)
+		return NULL;
+	while (value[iterator]) {
+		if (value[iterator] == '\\' || value[iterator] == '"') {
+			result[length++] = '\\';
+			result[length++] = value[iterator];
+		} else if (value[iterator] == '\n') {
+			result[length++] = '\\';
+			result[length++] = 'n';
+		} else
+			result[length++] = value[iterator];
+		iterator++;
+	} /* end while */
+
+	return result;
+}
+
+/** 
+ * @internal Adds metric family header (HELP and TYPE).
+ */
+void __mod_prometheus_family (ModPrometheusBuffer * buffer, const char * name, const char * type, const char * help)
+{
+	__mod_prometheus_printf (buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+	return;
+}
+
+/** 
+ * @internal Collects values from each domain. Only domain stats and
+ * metrics mutexes are used, subscription and publish structures are
+ * never locked.
+ */
+axl_bool __mod_prometheus_collect_domain (axlPointer key, axlPointer data, axlPointer user_data)
+{
+	MyQttdDomain        * domain = data;
+	axlList             * list   = user_data;
+	ModPrometheusDomain * item;
+
+	item = axl_new (ModPrometheusDomain, 1);
+	if (item == NULL)
+		return axl_false;
+	item->name          = __mod_prometheus_escape (myqttd_domain_get_name (domain));
+	item->conns         = myqttd_domain_conn_count (domain);
+	item->sessions      = myqttd_domain_session_count (domain);
+	item->subs          = myqttd_domain_subs_count (domain);
+	item->msgs_in       = myqttd_domain_msgs_in (domain);
+	item->msgs_out      = myqttd_domain_msgs_out (domain);
+	item->month_quota   = myqttd_domain_get_month_message_quota (domain);
+	item->day_quota     = myqttd_domain_get_day_message_quota (domain);
+	item->conn_limit    = domain->settings ? domain->settings->conn_limit : -1;
+	item->storage_limit = domain->settings ? domain->settings->storage_messages_limit : -1;
+
+	if (domain->initialized && domain->myqtt_ctx) {
+		item->storage_msgs  = myqtt_storage_backlog (domain->myqtt_ctx);
+		item->retained_msgs = myqtt_storage_retained_count (domain->myqtt_ctx);
+		myqtt_thread_pool_stats (domain->myqtt_ctx, &item->running_threads, &item->waiting_threads, &item->pending_tasks);
+		item->has_metrics   = myqttd_domain_get_metrics (domain, &item->metrics, axl_false);
+	} /* end if */
+
+	axl_list_append (list, item);
+	return axl_false; /* keep iterating over all items */
+}
+
+/** 
+ * @internal Releases a collected domain.
+ */
+void __mod_prometheus_domain_free (axlPointer _item)
+{
+	ModPrometheusDomain * item = _item;
+
+	axl_free (item->name);
+	axl_free (item);
+	return;
+}
+
+/** 
+ * @internal Renders an integer metric family with one value per
+ * collected domain.
+ */
+#define MOD_PROMETHEUS_DOMAIN_FAMILY(buffer,domains,family,type,help,field) do {		\
+	axlListCursor       * __cursor;							\
+	ModPrometheusDomain * __item;							\
+	__mod_prometheus_family (buffer, family, type, help);				\
+	__cursor = axl_list_cursor_new (domains);					\
+	while (axl_list_cursor_has_item (__cursor)) {					\
+		__item = axl_list_cursor_get (__cursor);				\
+		__mod_prometheus_printf (buffer, "%s{domain=\"%s\"} %lld\n",		\
+					 family, __item->name, (long long) __item->field); \
+		axl_list_cursor_next (__cursor);					\
+	}										\
+	axl_list_cursor_free (__cursor);						\
+} while (0)
+
+/** 
+ * @internal Renders the provided histogram as a Prometheus histogram
+ * (seconds).
+ */
+void __mod_prometheus_histogram (ModPrometheusBuffer * buffer, MyQttHistogram * histogram, const char * name)
+{
+	char * family;
+	int    iterator = 0;
+
+	family = axl_strdup_printf ("myqtt_%s_latency_seconds", name);
+	if (family == NULL)
+		return;
+
+	__mod_prometheus_printf (buffer, "# HELP %s Latency of %s operations in seconds\n# TYPE %s histogram\n", 
+				 family, name, family);
+	while (mod_prometheus_bounds[iterator] > 0) {
+		__mod_prometheus_printf (buffer, "%s_bucket{le=\"%g\"} %lld\n", family, 
+					 (double) mod_prometheus_bounds[iterator] / 1000000,
+					 myqtt_metrics_count_below (histogram, mod_prometheus_bounds[iterator]));
+		iterator++;
+	} /* end while */
+	__mod_prometheus_printf (buffer, "%s_bucket{le=\"+Inf\"} %lld\n", family, histogram->count);
+	__mod_prometheus_printf (buffer, "%s_sum %.6f\n", family, (double) histogram->sum / 1000000);
+	__mod_prometheus_printf (buffer, "%s_count %lld\n", family, histogram->count);
+
+	axl_free (family);
+	return;
+}
+
+/** 
+ * @internal Renders all metrics into the provided buffer (Prometheus
+ * text exposition format, version 0.0.4).
+ */
+void __mod_prometheus_render (MyQttdCtx * ctx, ModPrometheusBuffer * buffer)
+{
+	MyQttMetrics        * metrics;
+	axlList             * domains;
+	axlList             * children;
+	axlListCursor       * cursor;
+	ModPrometheusDomain * item;
+	MyQttdChild         * child;
+	char                * server_name;
+	int                   iterator;
+	int                   running_threads;
+	int                   waiting_threads;
+	int                   pending_tasks;
+	int                   epoch;
+#if defined(ENABLE_TLS_SUPPORT)
+	long                  tls_resumed;
+	long                  tls_full;
+#endif
+
+	/* server wide values */
+	__mod_prometheus_family (buffer, "myqttd_domains_enabled", "gauge", "Number of domains enabled");
+	__mod_prometheus_printf (buffer, "myqttd_domains_enabled %d\n", myqttd_domain_count_enabled (ctx));
+
+	myqtt_thread_pool_stats (MYQTTD_MYQTT_CTX (ctx), &running_threads, &waiting_threads, &pending_tasks);
+
+#if defined(ENABLE_TLS_SUPPORT)
+	/* TLS session resumption */
+	myqtt_tls_session_stats (MYQTTD_MYQTT_CTX (ctx), &tls_resumed, &tls_full);
+	__mod_prometheus_family (buffer, "myqtt_tls_handshakes_total", "counter", "TLS handshakes completed at the server side (resumed sessions or full handshakes)");
+	__mod_prometheus_printf (buffer, "myqtt_tls_handshakes_total{type=\"resumed\"} %ld\n", tls_resumed);
+	__mod_prometheus_printf (buffer, "myqtt_tls_handshakes_total{type=\"full\"} %ld\n", tls_full);
+#endif
+
+	/* child processes */
+	__mod_prometheus_family (buffer, "myqttd_child_processes", "gauge", "Number of child processes running");
+	__mod_prometheus_printf (buffer, "myqttd_child_processes %d\n", myqttd_process_child_count (ctx));
+	children = myqttd_process_child_list (ctx);
+	if (children && axl_list_length (children) > 0) {
+		__mod_prometheus_family (buffer, "myqttd_child_process_info", "gauge", "Child processes running and the serverName they attend");
+		cursor = axl_list_cursor_new (children);
+		while (axl_list_cursor_has_item (cursor)) {
+			child       = axl_list_cursor_get (cursor);
+			server_name = __mod_prometheus_escape (child->serverName);
+			__mod_prometheus_printf (buffer, "myqttd_child_process_info{pid=\"%d\",server_name=\"%s\"} 1\n", 
+						 child->pid, server_name ? server_name : "");
+			axl_free (server_name);
+			axl_list_cursor_next (cursor);
+		} /* end while */
+		axl_list_cursor_free (cursor);
+	} /* end if */
+	axl_list_free (children);
+
+	/* collect domains */
+	domains = axl_list_new (axl_list_always_return_1, __mod_prometheus_domain_free);
+	if (domains == NULL)
+		return;
+	if (ctx->domains) {
+		/* keep settings and names retired by a concurrent
+		 * reload alive while domains are read */
+		epoch = __myqttd_ctx_retire_ref (ctx);
+		myqtt_hash_foreach (ctx->domains, __mod_prometheus_collect_domain, domains);
+		__myqttd_ctx_retire_unref (ctx, epoch);
+	} /* end if */
+
+	/* thread pool (main context reported as domain="_server") */
+	__mod_prometheus_family (buffer, "myqttd_thread_pool_threads", "gauge", "Threads on the thread pool by state");
+	__mod_prometheus_printf (buffer, "myqttd_thread_pool_threads{domain=\"_server\",state=\"running\"} %d\n", running_threads);
+	__mod_prometheus_printf (buffer, "myqttd_thread_pool_threads{domain=\"_server\",state=\"waiting\"} %d\n", waiting_threads);
+	cursor = axl_list_cursor_new (domains);
+	while (axl_list_cursor_has_item (cursor)) {
+		item = axl_list_cursor_get (cursor);
+		__mod_prometheus_printf (buffer, "myqttd_thread_pool_threads{domain=\"%s\",state=\"running\"} %d\n", item->name, item->running_threads);
+		__mod_prometheus_printf (buffer, "myqttd_thread_pool_threads{domain=\"%s\",state=\"waiting\"} %d\n", item->name, item->waiting_threads);
+		axl_list_cursor_next (cursor);
+	} /* end while */
+	axl_list_cursor_free (cursor);
+
+	__mod_prometheus_family (buffer, "myqttd_thread_pool_pending_tasks", "gauge", "Tasks waiting for a thread pool thread");
+	__mod_prometheus_printf (buffer, "myqttd_thread_pool_pending_tasks{domain=\"_server\"} %d\n", pending_tasks);
+	cursor = axl_list_cursor_new (domains);
+	while (axl_list_cursor_has_item (cursor)) {
+		item = axl_list_cursor_get (cursor);
+		__mod_prometheus_printf (buffer, "myqttd_thread_pool_pending_tasks{domain=\"%s\"} %d\n", item->name, item->pending_tasks);
+		axl_list_cursor_next (cursor);
+	} /* end while */
+	axl_list_cursor_free (cursor);
+
+	/* per domain values */
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_connections", "gauge", 
+				      "Connections currently accepted on the domain", conns);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_sessions", "gauge", 
+				      "Sessions currently stored on the domain", sessions);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_subscriptions", "gauge", 
+				      "Subscriptions currently registered on the domain", subs);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_publish_received_total", "counter", 
+				      "Messages published (accepted) into the domain", msgs_in);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_publish_sent_total", "counter", 
+				      "Messages delivered to subscribers of the domain", msgs_out);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_storage_messages", "gauge", 
+				      "Messages queued on the domain storage for offline sessions", storage_msgs);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_retained_messages", "gauge", 
+				      "Retained messages stored on the domain", retained_msgs);
+
+	/* configured limits and quotas (-1 when not configured) */
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_connection_limit", "gauge", 
+				      "Connections allowed on the domain (-1 no limit)", conn_limit);
+	MOD_PROMETHEUS_DOMAIN_FAMILY (buffer, domains, "myqttd_domain_storage_messages_limit", "gauge", 
+				      "Stored messages allowed on the domain (-1 no limit)", storage_limit);
+	__mod_prometheus_family (buffer, "myqttd_domain_message_quota", "gauge", "Message quota configured on the domain by period (-1 no limit)");
+	cursor = axl_list_cursor_new (domains);
+	while (axl_list_cursor_has_item (cursor)) {
+		item = axl_list_cursor_get (cursor);
+		__mod_prometheus_printf (buffer, "myqttd_domain_message_quota{domain=\"%s\",period=\"day\"} %ld\n", item->name, item->day_quota);
+		__mod_prometheus_printf (buffer, "myqttd_domain_message_quota{domain=\"%s\",period=\"month\"} %ld\n", item->name, item->month_quota);
+		axl_list_cursor_next (cursor);
+	} /* end while */
+	axl_list_cursor_free (cursor);
+
+	/* metrics: counters per domain, and aggregated counters
+	 * (on their own myqtt_server_* family so they are not summed
+	 * twice with domain samples) and histograms (see
+	 * myqttd_domain_get_metrics_all) */
+	metrics = axl_new (MyQttMetrics, 1);
+	if (metrics && myqttd_domain_get_metrics_all (ctx, metrics, axl_false)) {
+		iterator = 0;
+		while (iterator < MYQTT_METRIC_COUNTERS) {
+			__mod_prometheus_printf (buffer, "# HELP myqtt_server_%s_total MQTT %s counted since metrics started (all domains and main context)\n# TYPE myqtt_server_%s_total counter\n",
+						 myqtt_metrics_counter_name (iterator), myqtt_metrics_counter_name (iterator),
+						 myqtt_metrics_counter_name (iterator));
+			__mod_prometheus_printf (buffer, "myqtt_server_%s_total %lld\n", 
+						 myqtt_metrics_counter_name (iterator), metrics->counters[iterator]);
+
+			__mod_prometheus_printf (buffer, "# HELP myqtt_%s_total MQTT %s counted by domain since metrics started\n# TYPE myqtt_%s_total counter\n",
+						 myqtt_metrics_counter_name (iterator), myqtt_metrics_counter_name (iterator),
+						 myqtt_metrics_counter_name (iterator));
+			cursor = axl_list_cursor_new (domains);
+			while (axl_list_cursor_has_item (cursor)) {
+				item = axl_list_cursor_get (cursor);
+				if (item->has_metrics)
+					__mod_prometheus_printf (buffer, "myqtt_%s_total{domain=\"%s\"} %lld\n", 
+								 myqtt_metrics_counter_name (iterator), item->name, item->metrics.counters[iterator]);
+				axl_list_cursor_next (cursor);
+			} /* end while */
+			axl_list_cursor_free (cursor);
+			iterator++;
+		} /* end while */
+
+		iterator = 0;
+		while (iterator < MYQTT_METRIC_HISTOGRAMS) {
+			__mod_prometheus_histogram (buffer, &metrics->histograms[iterator], myqtt_metrics_histogram_name (iterator));
+			iterator++;
+		} /* end while */
+	} /* end if */
+	axl_free (metrics);
+
+	axl_list_free (domains);
+	return;
+}
+
+/** 
+ * @internal Sends all content provided.
+ */
+axl_bool __mod_prometheus_send (MYQTT_SOCKET session, const char * content, int length)
+{
+	int written;
+
+	while (length > 0) {
+		written = send (session, content, length, 0);
+		if (written <= 0) {
+			if (written < 0 && errno == MYQTT_EINTR)
+				continue;
+			return axl_false;
+		} /* end if */
+		content += written;
+		length  -= written;
+	} /* end while */
+
+	return axl_true;
+}
+
+/** 
+ * @internal Waits up to the provided milliseconds for the socket to
+ * have data to read. Returns > 0 when ready, 0 on timeout and < 0 on
+ * error.
+ */
+int __mod_prometheus_wait (MYQTT_SOCKET session, int millis)
+{
+#if defined(AXL_OS_UNIX)
+	struct pollfd    fds;
+
+	/* poll has no limit on descriptor values (unlike fd_set) */
+	fds.fd      = session;
+	fds.events  = POLLIN;
+	fds.revents = 0;
+	return poll (&fds, 1, millis);
+#else
+	fd_set           fds;
+	struct timeval   timeout;
+
+	/* fd_set is a list of sockets on windows, any value fits */
+	FD_ZERO (&fds);
+	FD_SET (session, &fds);
+	timeout.tv_sec  = millis / 1000;
+	timeout.tv_usec = (millis % 1000) * 1000;
+	return select (session + 1, &fds, NULL, NULL, &timeout);
+#endif
+}
+
+/** 
+ * @internal Current time in milliseconds.
+ */
+long long __mod_prometheus_now (void)
+{
+	struct timeval now;
+
+	gettimeofday (&now, NULL);
+	return ((long long) now.tv_sec * 1000) + (now.tv_usec / 1000);
+}
+
+/** 
+ * @internal Sends an error reply with the provided status.
+ */
+void __mod_prometheus_reply_status (MYQTT_SOCKET session, const char * status)
+{
+	char * header;
+
+	header = axl_strdup_printf ("HTTP/1.0 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s\n",
+				    status, (int) strlen (status) + 1, status);
+	if (header)
+		__mod_prometheus_send (session, header, strlen (header));
+	axl_free (header);
+	return;
+}
+
+/** 
+ * @internal Attends a single HTTP request received.
+ */
+void __mod_prometheus_attend (MyQttdCtx * ctx, MYQTT_SOCKET session)
+{
+	char                  request[2048];
+	int                   length = 0;
+	int                   result;
+	long long             deadline;
+	int                   remaining;
+	ModPrometheusBuffer   buffer;
+	char                * header;
+	const char          * status = NULL;
+
+	/* read request headers (we only need the request line but
+	 * wait for them to avoid resetting the client), giving the
+	 * client MOD_PROMETHEUS_READ_TIMEOUT in total */
+	deadline = __mod_prometheus_now () + MOD_PROMETHEUS_READ_TIMEOUT;
+	while (length < (int) (sizeof (request) - 1)) {
+		remaining = (int) (deadline - __mod_prometheus_now ());
+		if (remaining <= 0)
+			break;
+		result = __mod_prometheus_wait (session, remaining);
+		if (result < 0 && errno == MYQTT_EINTR)
+			continue;
+		if (result == 0)
+			break;
+		if (result < 0)
+			return;
+
+		result = recv (session, request + length, sizeof (request) - 1 - length, 0);
+		if (result <= 0)
+			break;
+		length += result;
+		request[length] = 0;
+		if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+			break;
+	} /* end while */
+	request[length] = 0;
+
+	/* check request line */
+	if (length < 4 || ! axl_memcmp (request, "GET ", 4))
+		status = "405 Method Not Allowed";
+	else if (length < 13 || ! axl_memcmp (request + 4, "/metrics", 8) || (request[12] != ' ' && request[12] != '?'))
+		status = "404 Not Found";
+
+	if (status) {
+		__mod_prometheus_reply_status (session, status);
+		return;
+	} /* end if */
+
+	/* render metrics */
+	memset (&buffer, 0, sizeof (ModPrometheusBuffer));
+	__mod_prometheus_render (ctx, &buffer);
+
+	header = axl_strdup_printf ("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %d\r\nConnection: close\r\n\r\n",
+				    buffer.length);
+	if (header && __mod_prometheus_send (session, header, strlen (header)) && buffer.length > 0)
+		__mod_prometheus_send (session, buffer.content, buffer.length);
+
+	axl_free (header);
+	axl_free (buffer.content);
+	return;
+}
+
+/** 
+ * @internal Scrape being attended by its own thread.
+ */
+typedef struct _ModPrometheusScrape {
+	MyQttdCtx    * ctx;
+	MYQTT_SOCKET   session;
+} ModPrometheusScrape;
+
+/** 
+ * @internal Thread attending a single scrape so slow clients don't
+ * block others.
+ */
+axlPointer __mod_prometheus_scrape (axlPointer _scrape)
+{
+	ModPrometheusScrape * scrape = _scrape;
+#if defined(AXL_OS_UNIX)
+	struct timeval        timeout;
+
+	timeout.tv_sec  = MOD_PROMETHEUS_SEND_TIMEOUT / 1000;
+	timeout.tv_usec = 0;
+#else
+	DWORD                 timeout = MOD_PROMETHEUS_SEND_TIMEOUT;
+#endif
+
+	/* don't let a client not reading the reply hold the thread */
+	setsockopt (scrape->session, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof (timeout));
+
+	__mod_prometheus_attend (scrape->ctx, scrape->session);
+	myqtt_close_socket (scrape->session);
+	axl_free (scrape);
+
+	/* notify the scrape has finished */
+	myqtt_mutex_lock (&mod_prometheus_mutex);
+	mod_prometheus_scrapes--;
+	myqtt_cond_signal (&mod_prometheus_cond);
+	myqtt_mutex_unlock (&mod_prometheus_mutex);
+
+	return NULL;
+}
+
+/** 
+ * @internal Thread accepting requests, handing each one to its own
+ * thread (up to MOD_PROMETHEUS_MAX_SCRAPES at the same time).
+ */
+axlPointer __mod_prometheus_listener (axlPointer _ctx)
+{
+	MyQttdCtx           * ctx = _ctx;
+	MYQTT_SOCKET          session;
+	MyQttThread           thread;
+	ModPrometheusScrape * scrape;
+
+	while (! mod_prometheus_exit) {
+		/* wait for incoming connections, checking from time
+		 * to time if we have to finish */
+		if (__mod_prometheus_wait (mod_prometheus_socket, 250) <= 0)
+			continue;
+
+		session = myqtt_listener_accept (mod_prometheus_socket);
+		if (session == MYQTT_INVALID_SOCKET)
+			continue;
+
+		/* check scrapes being attended */
+		myqtt_mutex_lock (&mod_prometheus_mutex);
+		if (mod_prometheus_scrapes >= MOD_PROMETHEUS_MAX_SCRAPES) {
+			myqtt_mutex_unlock (&mod_prometheus_mutex);
+			wrn ("mod-prometheus: too many scrapes being attended (%d), rejecting request", MOD_PROMETHEUS_MAX_SCRAPES);
+			__mod_prometheus_reply_status (session, "503 Service Unavailable");
+			myqtt_close_socket (session);
+			continue;
+		} /* end if */
+		mod_prometheus_scrapes++;
+		myqtt_mutex_unlock (&mod_prometheus_mutex);
+
+		scrape = axl_new (ModPrometheusScrape, 1);
+		if (scrape) {
+			scrape->ctx     = ctx;
+			scrape->session = session;
+		} /* end if */
+		if (scrape == NULL || ! myqtt_thread_create (&thread, __mod_prometheus_scrape, scrape,
+							      MYQTT_THREAD_CONF_DETACHED, MYQTT_THREAD_CONF_END)) {
+			error ("mod-prometheus: unable to start thread to attend scrape (code %d) %s", errno, myqtt_errno_get_last_error ());
+			axl_free (scrape);
+			myqtt_close_socket (session);
+
+			myqtt_mutex_lock (&mod_prometheus_mutex);
+			mod_prometheus_scrapes--;
+			myqtt_mutex_unlock (&mod_prometheus_mutex);
+		} /* end if */
+	} /* end while */
+
+	return NULL;
+}
+
+/** 
+ * @brief Init function, perform all the necessary code to register
+ * handlers, configure MyQtt, and any other init task. The function
+ * must return true to signal that the module was properly initialized
+ * Otherwise, false must be returned.
+ */
+static int  mod_prometheus_init (MyQttdCtx * _ctx)
+{
+	char       * config;
+	axlError   * err = NULL;
+	axlNode    * node;
+	const char * host;
+	const char * port;
+
+	/* configure the module */
+	MYQTTD_MOD_PREPARE (_ctx);
+
+	/* metrics are only served by the main process */
+	if (myqttd_ctx_is_child (ctx))
+		return axl_true;
+
+	/* add default location if the document wasn't found */
+	myqtt_support_add_domain_search_path_ref (MYQTTD_MYQTT_CTX(ctx), axl_strdup ("mod-prometheus"),
+						  myqtt_support_build_filename (myqttd_sysconfdir (ctx), "myqtt", "prometheus", NULL));
+	config = myqtt_support_domain_find_data_file (MYQTTD_MYQTT_CTX (_ctx), "mod-prometheus", "prometheus.conf");
+	if (config == NULL) {
+		error ("Unable to find prometheus.conf file under expected locations, failed to activate mod-prometheus support (try checking %s/myqtt/prometheus/prometheus.conf)",
+		       myqttd_sysconfdir (ctx));
+		return axl_false;
+	} /* end if */
+
+	/* try to load configuration */
+	mod_prometheus_conf = axl_doc_parse_from_file (config, &err);
+	if (mod_prometheus_conf == NULL) {
+		error ("Unable to load configuration from %s, axl_doc_parse_from_file failed: %s",
+		       config, axl_error_get (err));
+		axl_free (config);
+		axl_error_free (err);
+		return axl_false;
+	} /* end if */
+	axl_free (config);
+
+	/* get listener configuration */
+	node = axl_doc_get (mod_prometheus_conf, "/mod-prometheus/listener");
+	host = node && HAS_ATTR (node, "host") ? ATTR_VALUE (node, "host") : "127.0.0.1";
+	port = node && HAS_ATTR (node, "port") ? ATTR_VALUE (node, "port") : "9604";
+
+	mod_prometheus_socket = myqtt_listener_sock_listen (MYQTTD_MYQTT_CTX (ctx), host, port, &err);
+	if (mod_prometheus_socket < 0) {
+		error ("Unable to start mod-prometheus listener at %s:%s: %s", host, port, axl_error_get (err));
+		axl_error_free (err);
+		mod_prometheus_socket = MYQTT_INVALID_SOCKET;
+		return axl_false;
+	} /* end if */
+
+	/* start thread serving metrics */
+	mod_prometheus_exit    = axl_false;
+	mod_prometheus_scrapes = 0;
+	myqtt_mutex_create (&mod_prometheus_mutex);
+	myqtt_cond_create (&mod_prometheus_cond);
+	if (! myqtt_thread_create (&mod_prometheus_thread, __mod_prometheus_listener, ctx, MYQTT_THREAD_CONF_END)) {
+		error ("Unable to start mod-prometheus thread (code %d) %s", errno, myqtt_errno_get_last_error ());
+		myqtt_mutex_destroy (&mod_prometheus_mutex);
+		myqtt_cond_destroy (&mod_prometheus_cond);
+		myqtt_close_socket (mod_prometheus_socket);
+		mod_prometheus_socket = MYQTT_INVALID_SOCKET;
+		return axl_false;
+	} /* end if */
+	mod_prometheus_running = axl_true;
+
+	msg ("mod-prometheus serving metrics at http://%s:%s/metrics", host, port);
+	return axl_true;
+}
+
+/** 
+ * @brief Close function called once the myqttd server wants to
+ * unload the module or it is being closed. All resource deallocation
+ * and stop operation required must be done here.
+ */
+static void mod_prometheus_close (MyQttdCtx * ctx)
+{
+	axlDoc * doc = mod_prometheus_conf;
+
+	/* stop listener thread and wait for scrapes being attended
+	 * (bounded by read and send timeouts) */
+	if (mod_prometheus_running) {
+		mod_prometheus_exit = axl_true;
+		myqtt_thread_destroy (&mod_prometheus_thread, axl_false);
+		mod_prometheus_running = axl_false;
+
+		myqtt_mutex_lock (&mod_prometheus_mutex);
+		while (mod_prometheus_scrapes > 0) {
+			MYQTT_COND_WAIT (&mod_prometheus_cond, &mod_prometheus_mutex);
+		} /* end while */
+		myqtt_mutex_unlock (&mod_prometheus_mutex);
+		myqtt_mutex_destroy (&mod_prometheus_mutex);
+		myqtt_cond_destroy (&mod_prometheus_cond);
+	} /* end if */
+	myqtt_close_socket (mod_prometheus_socket);
+	mod_prometheus_socket = MYQTT_INVALID_SOCKET;
+
+	mod_prometheus_conf = NULL;
+	axl_doc_free (doc);
+
+	return;
+}
+
+/** 
+ * @brief The reconf function is used by myqttd to notify to all
+ * its modules loaded that a reconfiguration signal was received and
+ * modules that could have configuration and run time change support,
+ * should reread its files. It is an optional handler.
+ */
+static void mod_prometheus_reconf (MyQttdCtx * ctx) {
+	/* listener address is only read at startup */
+	return;
+}
+
+/** 
+ * @brief Public entry point for the module to be loaded. This is the
+ * symbol the myqttd will lookup to load the rest of items.
+ */
+MyQttdModDef module_def = {
+	"mod-prometheus",
+	"Serves broker metrics (connections, rates, latencies, storage, threads) in Prometheus text format",
+	mod_prometheus_init,
+	mod_prometheus_close,
+	mod_prometheus_reconf,
+	NULL,
+};
+
+END_C_DECLS
+
+/** 
+ * \page myqttd_mod_prometheus mod-prometheus: Prometheus metrics endpoint for MyQttD
+ *
+ * \section myqttd_mod_prometheus_intro Introduction to mod-prometheus
+ *
+ * This module serves broker metrics over HTTP (<b>GET /metrics</b>)
+ * using Prometheus text exposition format so they can be scraped by
+ * Prometheus or any compatible collector. It reports:
+ *
+ * - Connections, sessions and subscriptions per domain.
+ * - Messages published and delivered per domain, and packets and
+ *   bytes sent/received (use rate() to get publish rates).
+ * - Latency histograms for publish, storage, auth and sequencer
+ *   operations.
+ *
+ * Packets and bytes counters and latency histograms require metrics
+ * enabled (&lt;metrics value="yes" /> at global-settings), which
+ * are disabled by default.
+ * - Storage usage (queued and retained messages) per domain.
+ * - Thread pool state and child processes running.
+ * - TLS handshakes resumed and full (when built with TLS support).
+ * - Connection limits and message quotas configured per domain.
+ *
+ * All values are taken from counters kept in memory, so a scrape
+ * never walks or locks subscriptions or messages being published.
+ * When domains are attended by child processes, domain values are
+ * only available inside each child and the main process reports
+ * those children.
+ *
+ * Values of the main context share their family with domain values
+ * using <b>domain="_server"</b> (thread pool), while counters
+ * aggregated from all domains are reported on their own
+ * <b>myqtt_server_*_total</b> families so they are not summed
+ * twice.
+ *
+ * \section myqttd_mod_prometheus_enabling Enabling mod-prometheus
+ *
+ * The module expects to find its configuration file at
+ * <b>/etc/myqtt/prometheus/prometheus.conf</b>. You can use the
+ * example provided and then enable the module:
+ *
+ * \code
+ * >> mv /etc/myqtt/prometheus/prometheus.example.conf /etc/myqtt/prometheus/prometheus.conf
+ * >> ln -s /etc/myqtt/mods-available/mod-prometheus.xml /etc/myqtt/mods-enabled/mod-prometheus.xml
+ * >> service myqtt restart
+ * \endcode
+ *
+ * \section myqttd_mod_prometheus_configuring Configuring mod-prometheus
+ *
+ * \htmlinclude prometheus.example.conf.tmp
+ *
+ * The &lt;listener> node configures the address and port where
+ * metrics are served (127.0.0.1:9604 by default). The endpoint has
+ * no authentication so keep it bound to a local or management
+ * address. Changing it requires restarting myqttd.
+ *
+ * Each scrape is attended by its own thread (up to 8 at the same
+ * time, further requests get 503) and clients have 2 seconds to send
+ * their request, so a slow client doesn't block others.
+ */
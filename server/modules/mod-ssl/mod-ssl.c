@@ -243,6 +243,36 @@ static int  mod_ssl_init (MyQttdCtx * _ctx)
 	node            = axl_doc_get (mod_ssl_conf, "mod-ssl");
 	__mod_ssl_debug = (node && HAS_ATTR_VALUE (node, "debug", "yes"));
 
+	/* configure session resumption (shared by all processes
+	 * through the files configured) */
+	node = axl_doc_get (mod_ssl_conf, "/mod-ssl/session-resumption");
+	if (node && HAS_ATTR_VALUE (node, "cache", "yes") && HAS_ATTR (node, "cache-path")) {
+		if (! myqtt_tls_set_session_cache (MYQTTD_MYQTT_CTX (ctx), ATTR_VALUE (node, "cache-path"),
+						   HAS_ATTR (node, "cache-timeout") ? myqtt_support_strtod (ATTR_VALUE (node, "cache-timeout"), NULL) : -1))
+			error ("Unable to configure TLS session cache at %s", ATTR_VALUE (node, "cache-path"));
+	} /* end if */
+	if (node && HAS_ATTR_VALUE (node, "tickets", "yes") && HAS_ATTR (node, "ticket-key-file")) {
+		if (! myqtt_tls_set_session_tickets (MYQTTD_MYQTT_CTX (ctx), ATTR_VALUE (node, "ticket-key-file"),
+						     HAS_ATTR (node, "ticket-rotation") ? myqtt_support_strtod (ATTR_VALUE (node, "ticket-rotation"), NULL) : -1))
+			error ("Unable to configure TLS session tickets using %s", ATTR_VALUE (node, "ticket-key-file"));
+	} /* end if */
+
+	/* enable kernel TLS if requested */
+	node = axl_doc_get (mod_ssl_conf, "/mod-ssl/kernel-tls");
+	if (node && HAS_ATTR_VALUE (node, "enabled", "yes")) {
+		if (! myqtt_tls_set_ktls (MYQTTD_MYQTT_CTX (ctx), axl_true))
+			wrn ("kTLS was requested but it is not supported by this build, using user space TLS");
+	} /* end if */
+
+	/* configure handshake workers */
+	node = axl_doc_get (mod_ssl_conf, "/mod-ssl/handshake-pool");
+	if (node) {
+		if (! myqtt_tls_set_handshake_pool (MYQTTD_MYQTT_CTX (ctx),
+						    HAS_ATTR (node, "workers") ? myqtt_support_strtod (ATTR_VALUE (node, "workers"), NULL) : -1,
+						    HAS_ATTR (node, "max-handshakes") ? myqtt_support_strtod (ATTR_VALUE (node, "max-handshakes"), NULL) : -1))
+			error ("Unable to configure TLS handshake pool");
+	} /* end if */
+
 	/* register listener activator: make myqttd server to support the following protocols: mqtt-tls, tls, ssl and mqtt-ssl */
 	myqttd_ctx_add_listener_activator (ctx, "mqtt-tls", __mod_ssl_start_listener, NULL);
 	myqttd_ctx_add_listener_activator (ctx, "tls", __mod_ssl_start_listener, NULL);
@@ -250,7 +280,9 @@ static int  mod_ssl_init (MyQttdCtx * _ctx)
 	myqttd_ctx_add_listener_activator (ctx, "mqtt-ssl", __mod_ssl_start_listener, NULL);
 
 	/* install handlers for SNI support: certificate selection
-	 * based on Server Name Indication */
+	 * based on Server Name Indication (they are only called the
+	 * first time a serverName is received, the SSL context
+	 * prepared is cached and shared by next connections) */
 	myqtt_tls_listener_set_certificate_handlers (MYQTTD_MYQTT_CTX (ctx),
 						     __mod_ssl_sni_certificate_handler,
 						     __mod_ssl_sni_private_handler,
@@ -267,6 +299,17 @@ static int  mod_ssl_init (MyQttdCtx * _ctx)
  */
 static void mod_ssl_close (MyQttdCtx * ctx)
 {
+	long resumed;
+	long full;
+	long failed;
+	long rejected;
+
+	/* report resumption and handshake pool stats */
+	myqtt_tls_session_stats (MYQTTD_MYQTT_CTX (ctx), &resumed, &full);
+	myqtt_tls_handshake_stats (MYQTTD_MYQTT_CTX (ctx), NULL, NULL, NULL, &failed, &rejected);
+	if (__mod_ssl_debug)
+		msg ("TLS handshakes: %ld resumed, %ld full, %ld failed, %ld rejected", resumed, full, failed, rejected);
+
 	/* printf ("%s:%d -- axl_doc_free (%p)\n", __AXL_FILE__, __AXL_LINE__, mod_ssl_conf); */
 	axl_doc_free (mod_ssl_conf);
 
@@ -281,7 +324,9 @@ static void mod_ssl_close (MyQttdCtx * ctx)
  * should reread its files. It is an optional handler.
  */
 static void mod_ssl_reconf (MyQttdCtx * ctx) {
-	/* for now nothing */
+	/* drop SSL contexts prepared for each serverName so
+	 * certificates are read again on next handshakes */
+	myqtt_tls_sni_cache_flush (MYQTTD_MYQTT_CTX (ctx));
 	return;
 }
 
@@ -163,6 +163,9 @@ void              myqttd_child_unref (MyQttdChild * child)
 	/* release server name */
 	axl_free (child->serverName);
 
+	/* release connections not sent (closing their sockets) */
+	axl_list_free (child->handoff_pending);
+
 	/* destroy mutex */
 	myqtt_mutex_destroy (&child->mutex);
 
@@ -41,6 +41,25 @@
 #ifndef __MYQTTD_CTX_PRIVATE_H__
 #define __MYQTTD_CTX_PRIVATE_H__
 
+/** 
+ * @internal Statistics that can be published as $SYS topics (see
+ * __myqttd_domain_sys_topics_start).
+ */
+typedef enum {
+	MYQTTD_SYS_CLIENTS       = 1 << 0,
+	MYQTTD_SYS_SUBSCRIPTIONS = 1 << 1,
+	MYQTTD_SYS_MESSAGES      = 1 << 2,
+	MYQTTD_SYS_BYTES         = 1 << 3,
+	MYQTTD_SYS_RETAINED      = 1 << 4,
+	MYQTTD_SYS_STORAGE       = 1 << 5,
+	MYQTTD_SYS_THREADS       = 1 << 6,
+	MYQTTD_SYS_SEQUENCER     = 1 << 7
+} MyQttdSysTopic;
+
+/** 
+ * @internal Asynchronous log writer (see myqttd-log.c).
+ */
+typedef struct _MyQttdLogWriter MyQttdLogWriter;
 
 struct _MyQttdCtx {
 	/* Reference to the myqttd myqtt context associated.
@@ -83,6 +102,7 @@ struct _MyQttdCtx {
 	int                  access_log;
 	MyQttdLoop         * log_manager;
 	axl_bool             use_syslog;
+	MyQttdLogWriter    * log_writer;
 
 	/*** myqttd config module ***/
 	axlDoc             * config;
@@ -111,6 +131,13 @@ struct _MyQttdCtx {
 	axlHash            * child_process;
 	MyQttMutex           child_process_mutex;
 
+	/* single loop (on the parent) watching the control
+	 * connections of all childs for commands they send (see
+	 * myqttd_process_send_command), and childs referenced by
+	 * it (protected by child_process_mutex) */
+	MyQttdLoop         * child_commands;
+	axlList            * child_commands_watched;
+
 	/*** support for proxy on parent ***/
 	MyQttdLoop         * proxy_loop;
 
@@ -120,17 +147,47 @@ struct _MyQttdCtx {
 	/* reference to authentication backends registered */
 	MyQttHash          * auth_backends;
 
+	/* recently verified credentials (LRU): key => MyQttdVerifyEntry,
+	 * most recently used at verify_head, protected by
+	 * verify_mutex */
+	MyQttMutex           verify_mutex;
+	axlHash            * verify_cache;
+	MyQttdVerifyEntry  * verify_head;
+	MyQttdVerifyEntry  * verify_tail;
+	char                 verify_secret[33];
+
 	/*** on publish handlers ***/
 	/* protected by data_mutex */
 	axlList            * on_publish_handlers;
 
+	/*** on process command handlers ***/
+	/* protected by data_mutex (see myqttd_process_add_on_command) */
+	axlList            * on_command_handlers;
+
 	/*** on listener activators ***/
 	MyQttHash          * listener_activators;
 
-	/* store for domain settings */
+	/* listeners started: bind-addr:port => MyQttConn (master
+	 * process only) */
+	MyQttHash          * listeners;
+
+	/* store for domain settings: objects are never updated in
+	 * place, reload swaps in new ones (so readers do not need to
+	 * lock) and retires the old ones */
 	MyQttHash            * domain_settings;
 	MyQttdDomainSetting  * default_setting;
 
+	/* objects replaced during a reload that may still be in use
+	 * by other threads (list of MyQttdRetired). Each connection
+	 * is accounted into the retire epoch that was current when it
+	 * was accepted (retire_conns: epoch -> live connections) and
+	 * an object is released once no connection accepted before it
+	 * was retired remains */
+	axlList              * retired;
+	axlHash              * retire_conns;
+	int                    retire_epoch;
+	MyQttMutex             retired_mutex;
+
 	/** 
 	 * @brief List of on day change registered handlers 
 	 */
@@ -145,6 +202,14 @@ struct _MyQttdCtx {
 	 * @brief Event id reference to stop it once started.
 	 */
 	long                  time_tracking_event_id;                   
+
+	/** 
+	 * @brief $SYS statistics topics configuration: event id,
+	 * topic prefix and statistics selected (MyQttdSysTopic).
+	 */
+	long                  sys_topics_event_id;
+	char                * sys_topics_prefix;
+	int                   sys_topics;
 };
 
 /** 
@@ -168,11 +233,40 @@ struct _MyQttdChild {
 	char              ** init_string_items;
 #endif
 
+	/* connections pending to be passed to this child, grouped
+	 * into a single sendmsg by the thread flushing them */
+	axlList            * handoff_pending;
+	axl_bool             handoff_flushing;
+
 	/* ref counting and mutex */
 	int                  ref_count;
 	MyQttMutex           mutex;
 };
 
+/** 
+ * @internal Connection passed from the parent to a child process
+ * (see myqttd-process.c).
+ */
+struct _MyQttdHandoff {
+	/* socket being passed */
+	MYQTT_SOCKET         socket;
+
+	/* encoded record sent as is (parent side) */
+	char               * record;
+	int                  record_size;
+
+	/* decoded record, strings point into the buffer where the
+	 * message was received (child side) */
+	char                 command;
+	axl_bool             handle_reply;
+	int                  has_tls;
+	int                  fix_server_name;
+	const char         * serverName;
+	const char         * remote_host;
+	const char         * remote_port;
+	const char         * remote_host_ip;
+};
+
 /** 
  * @internal Connection management done by conn-mgr module.
  */
@@ -181,6 +275,36 @@ typedef struct _MyQttdConnMgrState {
 	MyQttdCtx    * ctx;
 } MyQttdConnMgrState;
 
+/** 
+ * @internal Recently verified credential (see myqttd_users_verify_password).
+ */
+struct _MyQttdVerifyEntry {
+	/* user key and stored credential */
+	char               * key;
+	/* keyed digest of the password verified */
+	char               * fingerprint;
+
+	MyQttdVerifyEntry  * prev;
+	MyQttdVerifyEntry  * next;
+};
+
+/** 
+ * @internal Token bucket used to implement publish rate limits (see
+ * __myqttd_run_on_header_msg).
+ */
+struct _MyQttdTokenBucket {
+	double           tokens;
+	struct timeval   stamp;
+};
+
+/** 
+ * @internal Rate limit state associated to each connection.
+ */
+typedef struct _MyQttdConnRateLimit {
+	MyQttdTokenBucket msgs;
+	MyQttdTokenBucket bytes;
+} MyQttdConnRateLimit;
+
 /** 
  * @internal Domain definition.
  */
@@ -202,6 +326,24 @@ struct _MyQttdDomain {
 	/* reference to settings */
 	char                * use_settings;
 	MyQttdDomainSetting * settings;
+
+	/* live counters updated from on connect/close and publish
+	 * handlers (protected by stats_mutex); subscriptions are
+	 * accounted by libmyqtt (see myqttd_domain_subs_count) */
+	MyQttMutex     stats_mutex;
+	int            conn_count;
+	int            session_count;
+	long           msgs_in;
+
+	/* domain publish rate limit buckets (protected by
+	 * stats_mutex) */
+	MyQttdTokenBucket msg_bucket;
+	MyQttdTokenBucket byte_bucket;
+
+	/* counters and stamp from the last $SYS topics publication,
+	 * used to report rates (only used by the $SYS event) */
+	long long      sys_counters[MYQTT_METRIC_COUNTERS];
+	long long      sys_stamp;
 };
 
 typedef struct _MyQttdUsersBackend MyQttdUsersBackend;
@@ -239,6 +381,15 @@ struct _MyQttdOnPublishData {
 	axlPointer       user_data;
 };
 
+/** 
+ * @internal Type that represents an on command handler.
+ */
+typedef struct _MyQttdOnCommandData MyQttdOnCommandData;
+struct _MyQttdOnCommandData {
+	MyQttdOnCommand  on_command;
+	axlPointer       user_data;
+};
+
 /** 
  * @internal Type structure.
  */       
@@ -272,6 +423,18 @@ struct _MyQttdDomainSetting {
 	/* quota for number of messages per day and montly */
 	int         month_message_quota;
 	int         day_message_quota;
+
+	/* publish rate limits (token buckets): messages and bytes
+	 * per second with their burst size, for each client and for
+	 * the whole domain (values <= 0 means no limit) */
+	int         client_msg_rate;
+	int         client_msg_burst;
+	int         client_byte_rate;
+	int         client_byte_burst;
+	int         domain_msg_rate;
+	int         domain_msg_burst;
+	int         domain_byte_rate;
+	int         domain_byte_burst;
 	
 };
 
@@ -280,4 +443,10 @@ typedef struct _MyQttdHandlePtr {
 	axlPointer ptr;
 } MyQttdHandlerPtr;
 
+typedef struct _MyQttdRetired {
+	axlDestroyFunc destroy;
+	axlPointer     ptr;
+	int            epoch;
+} MyQttdRetired;
+
 #endif
@@ -99,12 +99,22 @@ MyQttdCtx * myqttd_ctx_new ()
 	/* init hash for auth backends */
 	ctx->auth_backends = myqtt_hash_new (axl_hash_string, axl_hash_equal_string);
 
+	/* init cache of verified credentials */
+	myqtt_mutex_create (&ctx->verify_mutex);
+	ctx->verify_cache  = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+
+	/* init objects retired by reload operations */
+	myqtt_mutex_create (&ctx->retired_mutex);
+
 	/* init listener activators */
 	ctx->listener_activators = myqtt_hash_new (axl_hash_string, axl_hash_equal_string);
 
 	/* init on publish handlers and mutex associated */
 	ctx->on_publish_handlers  = axl_list_new (axl_list_always_return_1, axl_free);
 
+	/* init process command handlers */
+	ctx->on_command_handlers  = axl_list_new (axl_list_always_return_1, axl_free);
+
 	/* return context created */
 	return ctx;
 }
@@ -127,6 +137,8 @@ void           myqttd_ctx_reinit (MyQttdCtx * ctx, MyQttdChild * child)
 	myqtt_mutex_create (&ctx->exit_mutex);
 	myqtt_mutex_create (&ctx->data_mutex);
 	myqtt_mutex_create (&ctx->registered_modules_mutex);
+	myqtt_mutex_create (&ctx->verify_mutex);
+	myqtt_mutex_create (&ctx->retired_mutex);
 
 	/* mutex on child object */
 	myqtt_mutex_create (&ctx->child->mutex);
@@ -665,6 +677,148 @@ axl_bool __myqttd_ctx_time_tracking        (MyQttCtx     * _ctx,
 }
 
 
+/** 
+ * @internal Releases a retired object.
+ */
+void __myqttd_ctx_free_retired (axlPointer _data)
+{
+	MyQttdRetired * data = _data;
+
+	if (data->destroy)
+		data->destroy (data->ptr);
+	axl_free (data);
+	return;
+}
+
+/** 
+ * @internal Records an object that was replaced during a reload
+ * operation but that may still be referenced by threads that read it
+ * without locking (settings, users backends...). It is released once
+ * all connections accepted before this call are closed (see
+ * __myqttd_ctx_retire_unref) or when the context is finished.
+ *
+ * Must be called with reload operations serialized (see
+ * myqttd_reload_config).
+ */
+void            __myqttd_ctx_retire (MyQttdCtx * ctx, axlPointer ptr, axlDestroyFunc destroy)
+{
+	MyQttdRetired * data;
+
+	if (ctx == NULL || ptr == NULL)
+		return;
+
+	data = axl_new (MyQttdRetired, 1);
+	if (data == NULL)
+		return;
+	data->destroy = destroy;
+	data->ptr     = ptr;
+
+	myqtt_mutex_lock (&ctx->retired_mutex);
+	if (ctx->retired == NULL)
+		ctx->retired = axl_list_new (axl_list_always_return_1, __myqttd_ctx_free_retired);
+
+	/* connections accepted from now on cannot see this object */
+	data->epoch = ctx->retire_epoch;
+	ctx->retire_epoch++;
+	axl_list_append (ctx->retired, data);
+	myqtt_mutex_unlock (&ctx->retired_mutex);
+	return;
+}
+
+/** 
+ * @internal Accounts a connection that may read objects that could be
+ * retired while it is running. Returns the epoch that must be passed
+ * to __myqttd_ctx_retire_unref once the connection is done.
+ */
+int             __myqttd_ctx_retire_ref (MyQttdCtx * ctx)
+{
+	int epoch;
+	int count;
+
+	myqtt_mutex_lock (&ctx->retired_mutex);
+	if (ctx->retire_conns == NULL)
+		ctx->retire_conns = axl_hash_new (axl_hash_int, axl_hash_equal_int);
+
+	epoch = ctx->retire_epoch;
+	count = PTR_TO_INT (axl_hash_get (ctx->retire_conns, INT_TO_PTR (epoch)));
+	axl_hash_insert (ctx->retire_conns, INT_TO_PTR (epoch), INT_TO_PTR (count + 1));
+	myqtt_mutex_unlock (&ctx->retired_mutex);
+
+	return epoch;
+}
+
+/** 
+ * @internal Finds the oldest epoch with live connections.
+ */
+axl_bool __myqttd_ctx_retire_min_epoch (axlPointer key, axlPointer data, axlPointer user_data)
+{
+	int * min_epoch = user_data;
+
+	if (PTR_TO_INT (key) < (*min_epoch))
+		(*min_epoch) = PTR_TO_INT (key);
+	return axl_false; /* keep iterating */
+}
+
+/** 
+ * @internal Releases the connection accounted by
+ * __myqttd_ctx_retire_ref and then releases retired objects that
+ * cannot be referenced by any remaining connection.
+ */
+void            __myqttd_ctx_retire_unref (MyQttdCtx * ctx, int epoch)
+{
+	int             count;
+	int             min_epoch;
+	int             iterator;
+	MyQttdRetired * data;
+	axlList       * released = NULL;
+
+	myqtt_mutex_lock (&ctx->retired_mutex);
+	if (ctx->retire_conns == NULL) {
+		myqtt_mutex_unlock (&ctx->retired_mutex);
+		return;
+	} /* end if */
+
+	count = PTR_TO_INT (axl_hash_get (ctx->retire_conns, INT_TO_PTR (epoch))) - 1;
+	if (count > 0) {
+		axl_hash_insert (ctx->retire_conns, INT_TO_PTR (epoch), INT_TO_PTR (count));
+		myqtt_mutex_unlock (&ctx->retired_mutex);
+		return;
+	} /* end if */
+	axl_hash_remove (ctx->retire_conns, INT_TO_PTR (epoch));
+
+	/* objects retired before the oldest live connection was
+	 * accepted are no longer reachable */
+	min_epoch = ctx->retire_epoch;
+	axl_hash_foreach (ctx->retire_conns, __myqttd_ctx_retire_min_epoch, &min_epoch);
+
+	iterator = 0;
+	while (ctx->retired && iterator < axl_list_length (ctx->retired)) {
+		data = axl_list_get_nth (ctx->retired, iterator);
+		if (data->epoch < min_epoch) {
+			if (released == NULL)
+				released = axl_list_new (axl_list_always_return_1, __myqttd_ctx_free_retired);
+			axl_list_unlink (ctx->retired, data);
+			axl_list_append (released, data);
+			continue;
+		} /* end if */
+		iterator++;
+	} /* end while */
+	myqtt_mutex_unlock (&ctx->retired_mutex);
+
+	/* release outside the lock */
+	axl_list_free (released);
+	return;
+}
+
+/** 
+ * @internal Releases domain settings (used at context cleanup).
+ */
+axl_bool __myqttd_ctx_free_setting (axlPointer key, axlPointer data, axlPointer user_data)
+{
+	axl_free (data);
+	return axl_false; /* do not stop */
+}
+
 /** 
  * @brief Deallocates the myqttd context provided.
  * 
@@ -688,6 +842,10 @@ void            myqttd_ctx_free (MyQttdCtx * ctx)
 	msg ("Releasing auth backends...");
 	myqtt_hash_unref (ctx->auth_backends);
 
+	/* release verified credentials */
+	__myqttd_users_verify_cache_free (ctx);
+	myqtt_mutex_destroy (&ctx->verify_mutex);
+
 	/* include a error warning */
 	if (ctx->myqtt_ctx) {
 		if (myqtt_ctx_ref_count (ctx->myqtt_ctx) <= 0) 
@@ -707,10 +865,20 @@ void            myqttd_ctx_free (MyQttdCtx * ctx)
 
 	/* release publish handlers */
 	axl_list_free (ctx->on_publish_handlers);
+	axl_list_free (ctx->on_command_handlers);
+
+	/* release $SYS topics prefix */
+	axl_free (ctx->sys_topics_prefix);
 
 	/* release settings */
 	axl_free (ctx->default_setting);
+	myqtt_hash_foreach (ctx->domain_settings, __myqttd_ctx_free_setting, NULL);
 	myqtt_hash_destroy (ctx->domain_settings);
+
+	/* release objects retired by reload operations */
+	axl_list_free (ctx->retired);
+	axl_hash_free (ctx->retire_conns);
+	myqtt_mutex_destroy (&ctx->retired_mutex);
 	myqtt_hash_destroy (ctx->listener_activators);
 
 	/* release the node itself */
@@ -108,6 +108,13 @@ void            myqttd_ctx_free                  (MyQttdCtx * ctx);
 /* @internal time tracking functions */
 axl_bool        __myqttd_ctx_ensure_day_month_in_place (MyQttdCtx * ctx);
 
+/* @internal reload support */
+void            __myqttd_ctx_retire (MyQttdCtx * ctx, axlPointer ptr, axlDestroyFunc destroy);
+
+int             __myqttd_ctx_retire_ref (MyQttdCtx * ctx);
+
+void            __myqttd_ctx_retire_unref (MyQttdCtx * ctx, int epoch);
+
 axl_bool        __myqttd_ctx_time_tracking             (MyQttCtx     * _ctx, 
 							axlPointer     user_data,
 							axlPointer     user_data2);
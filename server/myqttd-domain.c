@@ -62,6 +62,7 @@ void myqttd_domain_free (axlPointer _domain)
 
 	/* destroy mutex */
 	myqtt_mutex_destroy (&domain->mutex);
+	myqtt_mutex_destroy (&domain->stats_mutex);
 
 	axl_free (domain);
 
@@ -87,6 +88,20 @@ axl_bool   myqttd_domain_init (MyQttdCtx  * ctx)
 	return axl_true;
 }
 
+/** 
+ * @internal Replaces the string pointed by the provided reference
+ * without releasing the previous value (it may be in use by other
+ * threads, it is retired until the context is finished).
+ */
+void __myqttd_domain_replace_str (MyQttdCtx * ctx, char ** ref, const char * value)
+{
+	char * old = (*ref);
+
+	(*ref) = axl_strdup (value);
+	__myqttd_ctx_retire (ctx, old, axl_free);
+	return;
+}
+
 /** 
  * @brief Allows to add/update a domain with the provide initial data.
  *
@@ -134,6 +149,7 @@ axl_bool   myqttd_domain_add  (MyQttdCtx  * ctx,
 
 		/* init mutex */
 		myqtt_mutex_create (&domain->mutex);
+		myqtt_mutex_create (&domain->stats_mutex);
 
 		/* copy content */
 		domain->ctx          = ctx;
@@ -146,25 +162,41 @@ axl_bool   myqttd_domain_add  (MyQttdCtx  * ctx,
 		
 	} /* end if */
 
-	/* storage path */
-	if (domain->storage_path)
-		axl_free (domain->storage_path);
-	domain->storage_path = axl_strdup (storage_path);
+	/* storage path: it can't be changed once the domain context
+	 * is running */
+	if (domain->storage_path == NULL) 
+		domain->storage_path = axl_strdup (storage_path);
+	else if (! axl_cmp (domain->storage_path, storage_path)) {
+		if (domain->initialized)
+			wrn ("Domain %s storage path change (%s -> %s) will be applied on restart", name, domain->storage_path, storage_path);
+		else
+			__myqttd_domain_replace_str (ctx, &domain->storage_path, storage_path);
+	} /* end if */
 
-	/* users db */
-	if (domain->users_db)
-		axl_free (domain->users_db);
-	domain->users_db     = axl_strdup (user_db);
+	/* users db: retire current users backend (it may be in use)
+	 * so next auth loads users from the new location */
+	if (domain->users_db == NULL)
+		domain->users_db = axl_strdup (user_db);
+	else if (! axl_cmp (domain->users_db, user_db)) {
+		msg ("Domain %s users-db changed (%s -> %s)", name, domain->users_db, user_db);
+		myqtt_mutex_lock (&domain->mutex);
+		__myqttd_domain_replace_str (ctx, &domain->users_db, user_db);
+		__myqttd_ctx_retire (ctx, domain->users, (axlDestroyFunc) myqttd_users_free);
+		domain->users = NULL;
+		myqtt_mutex_unlock (&domain->mutex);
+	} /* end if */
 
 	/* setup new domain settings */
-	if (domain->use_settings)
-		axl_free (domain->use_settings);
-	domain->use_settings = axl_strdup (use_settings);
+	if (! axl_cmp (domain->use_settings, use_settings))
+		__myqttd_domain_replace_str (ctx, &domain->use_settings, use_settings);
 
 	/* configure active */
+	if (domain->is_active != is_active && ctx->started)
+		msg ("Domain %s is now %s", name, is_active ? "active" : "disabled");
 	domain->is_active    = is_active;
 	
-	/* reference to the settings configured */
+	/* reference to the settings configured (settings already
+	 * loaded are swapped by reference) */
 	if (use_settings) {
 		domain->settings = myqtt_hash_lookup (ctx->domain_settings, (axlPointer) use_settings);
 		if (! domain->settings)
@@ -595,6 +627,9 @@ int               myqttd_domain_count_enabled (MyQttdCtx * ctx)
  * @brief Allows to get the amount of connections the provide domain
  * have (users connected at this moment).
  *
+ * The value is maintained as connections are accepted and closed so
+ * calling this function does not iterate over connections.
+ *
  * @param domain The domain that is being checked for number of connections.
  *
  * @return Number of connections (without including listener
@@ -603,15 +638,18 @@ int               myqttd_domain_count_enabled (MyQttdCtx * ctx)
  */
 int               myqttd_domain_conn_count (MyQttdDomain * domain)
 {
+	int count;
+
 	if (domain == NULL)
 		return 0;
 	if (! domain->initialized)
 		return 0;
 
-	/* list of connections currently watched plus the amount of
-	 * connections are about to be watched because they are
-	 * waiting in the readers queue to be accepted. */
-	return axl_list_length (domain->myqtt_ctx->conn_list) + myqtt_async_queue_items (domain->myqtt_ctx->reader_queue);
+	myqtt_mutex_lock (&domain->stats_mutex);
+	count = domain->conn_count;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+
+	return count;
 }
 
 /** 
@@ -632,10 +670,465 @@ int               myqttd_domain_conn_count_all (MyQttdDomain * domain)
 	if (! domain->myqtt_ctx)
 		return 0;
 
-	/* list of connections currently watched */
+	/* connections currently accepted plus listeners */
 	return myqttd_domain_conn_count (domain) + axl_list_length (domain->myqtt_ctx->srv_list);
 }
 
+/** 
+ * @brief Allows to get the amount of connections with a persistent
+ * session (clean session disabled) currently connected to the
+ * provided domain.
+ *
+ * @param domain The domain that is being checked.
+ *
+ * @return Number of connections with session or 0 if it fails.
+ */
+int               myqttd_domain_session_count (MyQttdDomain * domain)
+{
+	int count;
+
+	if (domain == NULL)
+		return 0;
+
+	myqtt_mutex_lock (&domain->stats_mutex);
+	count = domain->session_count;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+
+	return count;
+}
+
+/** 
+ * @brief Allows to get the amount of subscriptions installed for
+ * connections currently connected to the provided domain (including
+ * subscriptions restored from sessions).
+ *
+ * Subscriptions are accounted by libmyqtt once they are accepted, so
+ * those denied later (for example, because they couldn't be saved
+ * into the session storage) are not reported.
+ *
+ * @param domain The domain that is being checked.
+ *
+ * @return Number of subscriptions or 0 if it fails.
+ */
+int               myqttd_domain_subs_count (MyQttdDomain * domain)
+{
+	if (domain == NULL)
+		return 0;
+	if (! domain->initialized)
+		return 0;
+
+	return myqtt_ctx_get_subs_count (domain->myqtt_ctx);
+}
+
+/** 
+ * @brief Allows to get the amount of messages published (accepted)
+ * into the provided domain since it was started.
+ *
+ * @param domain The domain that is being checked.
+ *
+ * @return Number of messages received or 0 if it fails.
+ */
+long              myqttd_domain_msgs_in (MyQttdDomain * domain)
+{
+	long count;
+
+	if (domain == NULL)
+		return 0;
+
+	myqtt_mutex_lock (&domain->stats_mutex);
+	count = domain->msgs_in;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+
+	return count;
+}
+
+/** 
+ * @brief Allows to get the amount of messages delivered to
+ * subscribers of the provided domain since it was started.
+ *
+ * @param domain The domain that is being checked.
+ *
+ * @return Number of messages delivered or 0 if it fails.
+ */
+long              myqttd_domain_msgs_out (MyQttdDomain * domain)
+{
+	if (domain == NULL)
+		return 0;
+	if (! domain->initialized)
+		return 0;
+
+	return myqtt_ctx_get_delivered_msgs (domain->myqtt_ctx);
+}
+
+/** 
+ * @brief Allows to get a snapshot of the metrics (counters and
+ * latency histograms) collected by the provided domain (see \ref
+ * myqtt_metrics_snapshot).
+ *
+ * @param domain The domain that is being checked.
+ *
+ * @param snapshot Reference to the caller's structure where metrics
+ * are copied.
+ *
+ * @param reset axl_true to reset domain metrics at the same time.
+ *
+ * @return axl_true if the snapshot was taken, otherwise axl_false
+ * (domain not initialized or metrics disabled).
+ */
+axl_bool          myqttd_domain_get_metrics (MyQttdDomain * domain, 
+					     MyQttMetrics * snapshot,
+					     axl_bool       reset)
+{
+	if (domain == NULL || snapshot == NULL)
+		return axl_false;
+	if (! domain->initialized)
+		return axl_false;
+
+	return myqtt_metrics_snapshot (domain->myqtt_ctx, snapshot, reset);
+}
+
+axl_bool __myqttd_domain_get_metrics_foreach (axlPointer _name, axlPointer _domain, axlPointer user_data)
+{
+	MyQttdDomain  * domain   = _domain;
+	axlPointer    * data     = user_data;
+	MyQttMetrics  * snapshot = data[0];
+	axl_bool        reset    = PTR_TO_INT (data[1]);
+	MyQttMetrics  * aux      = data[2];
+
+	if (! myqttd_domain_get_metrics (domain, aux, reset))
+		return axl_false; /* don't stop searching */
+
+	/* auth time is already accounted by the main context (it is
+	 * where CONNECT is handled), skip it here */
+	memset (&aux->histograms[MYQTT_METRIC_AUTH], 0, sizeof (MyQttHistogram));
+	myqtt_metrics_merge (snapshot, aux);
+
+	return axl_false; /* don't stop searching */
+}
+
+/** 
+ * @brief Allows to get server wide metrics: metrics collected by the
+ * main context (where connections are accepted and authenticated)
+ * aggregated with the metrics from every domain enabled.
+ *
+ * @param ctx The context where the operation is taking place.
+ *
+ * @param snapshot Reference to the caller's structure where metrics
+ * are copied.
+ *
+ * @param reset axl_true to reset all metrics at the same time.
+ *
+ * @return axl_true if the snapshot was taken, otherwise axl_false
+ * (metrics disabled).
+ */
+axl_bool          myqttd_domain_get_metrics_all (MyQttdCtx    * ctx,
+						 MyQttMetrics * snapshot,
+						 axl_bool       reset)
+{
+	axlPointer     data[3];
+	MyQttMetrics * aux;
+
+	if (ctx == NULL || snapshot == NULL)
+		return axl_false;
+
+	/* get main context metrics */
+	if (! myqtt_metrics_snapshot (ctx->myqtt_ctx, snapshot, reset))
+		return axl_false;
+
+	if (ctx->domains == NULL)
+		return axl_true;
+
+	/* now aggregate all domains */
+	aux     = axl_new (MyQttMetrics, 1);
+	if (aux == NULL)
+		return axl_false;
+	data[0] = snapshot;
+	data[1] = INT_TO_PTR (reset);
+	data[2] = aux;
+	myqtt_hash_foreach (ctx->domains, __myqttd_domain_get_metrics_foreach, data);
+	axl_free (aux);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Publishes the provided statistic value as retained $SYS
+ * topic into the provided domain.
+ */
+void __myqttd_domain_sys_publish (MyQttdDomain * domain, const char * prefix, const char * name, long long value)
+{
+	char * topic;
+	char * content;
+	int    content_len;
+
+	topic   = axl_strdup_printf ("%s/%s", prefix, name);
+	content = axl_strdup_printf ("%lld", value);
+	if (topic == NULL || content == NULL) {
+		axl_free (topic);
+		axl_free (content);
+		return;
+	} /* end if */
+	content_len = strlen (content);
+
+	/* save it as retained for later subscribers (retained
+	 * messages with qos 0 are not stored) and notify current
+	 * subscribers */
+	myqtt_storage_retain_msg_set (domain->myqtt_ctx, topic, MYQTT_QOS_1, (const unsigned char *) content, content_len);
+	myqtt_reader_publish (domain->myqtt_ctx, topic, (const unsigned char *) content, content_len, MYQTT_QOS_0, axl_false);
+
+	axl_free (topic);
+	axl_free (content);
+	return;
+}
+
+/** 
+ * @internal Returns the rate per second for the provided counter
+ * since the last publication.
+ */
+long long __myqttd_domain_sys_rate (MyQttdDomain * domain, MyQttMetrics * metrics, MyQttMetricCounter counter, long long elapsed)
+{
+	long long previous = domain->sys_counters[counter];
+
+	/* counters were reset by someone else */
+	if (metrics->counters[counter] < previous)
+		previous = 0;
+	if (elapsed <= 0)
+		return 0;
+
+	return ((metrics->counters[counter] - previous) * 1000000) / elapsed;
+}
+
+axl_bool __myqttd_domain_sys_topics_foreach (axlPointer _name, axlPointer _domain, axlPointer user_data)
+{
+	MyQttdDomain  * domain  = _domain;
+	MyQttMetrics  * metrics = user_data;
+	MyQttdCtx     * ctx     = domain->ctx;
+	const char    * prefix  = ctx->sys_topics_prefix;
+	long long       now;
+	long long       elapsed;
+	int             running_threads;
+	int             waiting_threads;
+	int             pending_tasks;
+
+	/* skip domains not started yet */
+	if (! domain->initialized || domain->myqtt_ctx == NULL)
+		return axl_false; /* don't stop searching */
+
+	if (ctx->sys_topics & MYQTTD_SYS_CLIENTS)
+		__myqttd_domain_sys_publish (domain, prefix, "clients/connected", myqttd_domain_conn_count (domain));
+	if (ctx->sys_topics & MYQTTD_SYS_SUBSCRIPTIONS)
+		__myqttd_domain_sys_publish (domain, prefix, "subscriptions/count", myqttd_domain_subs_count (domain));
+
+	/* rates: only available with metrics enabled */
+	if ((ctx->sys_topics & (MYQTTD_SYS_MESSAGES | MYQTTD_SYS_BYTES)) && myqtt_metrics_snapshot (domain->myqtt_ctx, metrics, axl_false)) {
+		now     = myqtt_metrics_now ();
+		elapsed = domain->sys_stamp > 0 ? now - domain->sys_stamp : 0;
+
+		if (ctx->sys_topics & MYQTTD_SYS_MESSAGES) {
+			__myqttd_domain_sys_publish (domain, prefix, "messages/received/per-second", __myqttd_domain_sys_rate (domain, metrics, MYQTT_METRIC_MSGS_IN, elapsed));
+			__myqttd_domain_sys_publish (domain, prefix, "messages/sent/per-second", __myqttd_domain_sys_rate (domain, metrics, MYQTT_METRIC_MSGS_OUT, elapsed));
+		} /* end if */
+		if (ctx->sys_topics & MYQTTD_SYS_BYTES) {
+			__myqttd_domain_sys_publish (domain, prefix, "bytes/received/per-second", __myqttd_domain_sys_rate (domain, metrics, MYQTT_METRIC_BYTES_IN, elapsed));
+			__myqttd_domain_sys_publish (domain, prefix, "bytes/sent/per-second", __myqttd_domain_sys_rate (domain, metrics, MYQTT_METRIC_BYTES_OUT, elapsed));
+		} /* end if */
+
+		/* save for next publication */
+		memcpy (domain->sys_counters, metrics->counters, sizeof (domain->sys_counters));
+		domain->sys_stamp = now;
+	} /* end if */
+
+	if (ctx->sys_topics & MYQTTD_SYS_RETAINED)
+		__myqttd_domain_sys_publish (domain, prefix, "retained/count", myqtt_storage_retained_count (domain->myqtt_ctx));
+	if (ctx->sys_topics & MYQTTD_SYS_STORAGE)
+		__myqttd_domain_sys_publish (domain, prefix, "storage/backlog", myqtt_storage_backlog (domain->myqtt_ctx));
+
+	if (ctx->sys_topics & MYQTTD_SYS_THREADS) {
+		myqtt_thread_pool_stats (domain->myqtt_ctx, &running_threads, &waiting_threads, &pending_tasks);
+		__myqttd_domain_sys_publish (domain, prefix, "threads/running", running_threads);
+		__myqttd_domain_sys_publish (domain, prefix, "threads/busy", running_threads - waiting_threads);
+		__myqttd_domain_sys_publish (domain, prefix, "threads/pending-tasks", pending_tasks);
+	} /* end if */
+
+	if (ctx->sys_topics & MYQTTD_SYS_SEQUENCER)
+		__myqttd_domain_sys_publish (domain, prefix, "sequencer/queue-depth", myqtt_sequencer_queue_depth (domain->myqtt_ctx));
+
+	return axl_false; /* don't stop searching */
+}
+
+/** 
+ * @internal Event handler that publishes $SYS statistics topics on
+ * every domain.
+ */
+axl_bool __myqttd_domain_sys_topics_event (MyQttCtx * myqtt_ctx, axlPointer user_data, axlPointer user_data2)
+{
+	MyQttdCtx    * ctx = user_data;
+	MyQttMetrics * metrics;
+	int            epoch;
+
+	/* avoid calling when myqttd is existing */
+	if (ctx->is_exiting)
+		return axl_true; /* remove event */
+
+	if (ctx->domains == NULL)
+		return axl_false; /* fire it again */
+
+	/* space used to get metrics snapshots */
+	metrics = axl_new (MyQttMetrics, 1);
+	if (metrics == NULL)
+		return axl_false; /* fire it again */
+
+	/* keep settings and names retired by a concurrent reload
+	 * alive while domains are read */
+	epoch = __myqttd_ctx_retire_ref (ctx);
+	myqtt_hash_foreach (ctx->domains, __myqttd_domain_sys_topics_foreach, metrics);
+	__myqttd_ctx_retire_unref (ctx, epoch);
+	axl_free (metrics);
+
+	return axl_false; /* do not remove the event, please fire it
+			   * again in the future */
+}
+
+/** 
+ * @internal Starts periodic $SYS statistics topics publication as
+ * configured by the provided <sys-topics> node:
+ *
+ * <sys-topics interval="10" prefix="$SYS/broker" topics="clients,subscriptions,messages,bytes,retained,storage,threads,sequencer" />
+ *
+ * interval is in seconds and topics is optional (all statistics are
+ * published by default).
+ */
+void __myqttd_domain_sys_topics_start (MyQttdCtx * ctx, axlNode * node)
+{
+	int          interval = 10;
+	const char * prefix   = "$SYS/broker";
+	char      ** items;
+	int          iterator;
+
+	if (ctx == NULL || node == NULL || ctx->sys_topics_event_id != 0)
+		return;
+
+	if (HAS_ATTR (node, "interval"))
+		interval = myqtt_support_strtod (ATTR_VALUE (node, "interval"), NULL);
+	if (interval <= 0) {
+		msg ("$SYS topics publication disabled (interval=%d)", interval);
+		return;
+	} /* end if */
+	if (HAS_ATTR (node, "prefix") && strlen (ATTR_VALUE (node, "prefix")) > 0)
+		prefix = ATTR_VALUE (node, "prefix");
+
+	/* get statistics selected */
+	ctx->sys_topics = MYQTTD_SYS_CLIENTS | MYQTTD_SYS_SUBSCRIPTIONS | MYQTTD_SYS_MESSAGES | MYQTTD_SYS_BYTES |
+		MYQTTD_SYS_RETAINED | MYQTTD_SYS_STORAGE | MYQTTD_SYS_THREADS | MYQTTD_SYS_SEQUENCER;
+	if (HAS_ATTR (node, "topics")) {
+		ctx->sys_topics = 0;
+		items           = axl_split (ATTR_VALUE (node, "topics"), 1, ",");
+		iterator        = 0;
+		while (items && items[iterator]) {
+			axl_stream_trim (items[iterator]);
+			if (axl_cmp (items[iterator], "clients"))
+				ctx->sys_topics |= MYQTTD_SYS_CLIENTS;
+			else if (axl_cmp (items[iterator], "subscriptions"))
+				ctx->sys_topics |= MYQTTD_SYS_SUBSCRIPTIONS;
+			else if (axl_cmp (items[iterator], "messages"))
+				ctx->sys_topics |= MYQTTD_SYS_MESSAGES;
+			else if (axl_cmp (items[iterator], "bytes"))
+				ctx->sys_topics |= MYQTTD_SYS_BYTES;
+			else if (axl_cmp (items[iterator], "retained"))
+				ctx->sys_topics |= MYQTTD_SYS_RETAINED;
+			else if (axl_cmp (items[iterator], "storage"))
+				ctx->sys_topics |= MYQTTD_SYS_STORAGE;
+			else if (axl_cmp (items[iterator], "threads"))
+				ctx->sys_topics |= MYQTTD_SYS_THREADS;
+			else if (axl_cmp (items[iterator], "sequencer"))
+				ctx->sys_topics |= MYQTTD_SYS_SEQUENCER;
+			else if (strlen (items[iterator]) > 0)
+				wrn ("Unknown $SYS statistic '%s' found at <sys-topics topics='...'>, skipping", items[iterator]);
+			iterator++;
+		} /* end while */
+		axl_freev (items);
+	} /* end if */
+
+	ctx->sys_topics_prefix = axl_strdup (prefix);
+	ctx->sys_topics_event_id = myqtt_thread_pool_new_event (ctx->myqtt_ctx, interval * 1000000, __myqttd_domain_sys_topics_event, ctx, NULL);
+	if (ctx->sys_topics_event_id == -1) {
+		error ("Unable to start $SYS topics publication, myqtt_thread_pool_new_event () failed");
+		ctx->sys_topics_event_id = 0;
+		return;
+	} /* end if */
+
+	msg ("Publishing $SYS topics at %s/ every %d seconds", ctx->sys_topics_prefix, interval);
+	return;
+}
+
+/** 
+ * @internal Returns axl_true if the provided topic is under $SYS
+ * topics prefix (only myqttd can publish there).
+ */
+axl_bool __myqttd_domain_is_sys_topic (MyQttdCtx * ctx, const char * topic_name)
+{
+	int prefix_len;
+
+	if (ctx == NULL || ctx->sys_topics_prefix == NULL || topic_name == NULL)
+		return axl_false;
+
+	prefix_len = strlen (ctx->sys_topics_prefix);
+	return axl_memcmp (topic_name, ctx->sys_topics_prefix, prefix_len) && (topic_name[prefix_len] == '/' || topic_name[prefix_len] == 0);
+}
+
+/** 
+ * @internal Reserves a connection slot in the domain checking the
+ * provided limit (limit <= 0 means no limit). Checking and
+ * accounting is done at once so concurrent CONNECT requests can't go
+ * over the limit.
+ *
+ * @return axl_true if the slot was reserved, otherwise axl_false. In
+ * the case of success, connections is updated with the count
+ * (including listeners) after reserving.
+ */
+axl_bool          __myqttd_domain_conn_reserve (MyQttdDomain * domain, int limit, int * connections)
+{
+	int listeners = axl_list_length (domain->myqtt_ctx->srv_list);
+
+	myqtt_mutex_lock (&domain->stats_mutex);
+	(*connections) = domain->conn_count + listeners + 1;
+	if (limit > 0 && (*connections) > limit) {
+		myqtt_mutex_unlock (&domain->stats_mutex);
+		return axl_false;
+	} /* end if */
+	domain->conn_count++;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Releases a connection slot (and the session accounted to
+ * it).
+ */
+void              __myqttd_domain_conn_release (MyQttdDomain * domain, axl_bool has_session)
+{
+	myqtt_mutex_lock (&domain->stats_mutex);
+	if (domain->conn_count > 0)
+		domain->conn_count--;
+	if (has_session && domain->session_count > 0)
+		domain->session_count--;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+	return;
+}
+
+/** 
+ * @internal Updates domain counters by the provided amounts.
+ */
+void              __myqttd_domain_stats_update (MyQttdDomain * domain, int sessions, long msgs_in)
+{
+	myqtt_mutex_lock (&domain->stats_mutex);
+	domain->session_count += sessions;
+	domain->msgs_in       += msgs_in;
+	myqtt_mutex_unlock (&domain->stats_mutex);
+	return;
+}
+
 /** 
  * @brief Allows to get internal domain name attribute. 
  *
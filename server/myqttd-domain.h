@@ -83,6 +83,33 @@ int               myqttd_domain_conn_count (MyQttdDomain * domain);
 
 int               myqttd_domain_conn_count_all (MyQttdDomain * domain);
 
+int               myqttd_domain_session_count (MyQttdDomain * domain);
+
+int               myqttd_domain_subs_count (MyQttdDomain * domain);
+
+long              myqttd_domain_msgs_in (MyQttdDomain * domain);
+
+long              myqttd_domain_msgs_out (MyQttdDomain * domain);
+
+axl_bool          myqttd_domain_get_metrics (MyQttdDomain * domain, 
+					     MyQttMetrics * snapshot,
+					     axl_bool       reset);
+
+axl_bool          myqttd_domain_get_metrics_all (MyQttdCtx    * ctx,
+						 MyQttMetrics * snapshot,
+						 axl_bool       reset);
+
+/* internal API */
+axl_bool          __myqttd_domain_conn_reserve (MyQttdDomain * domain, int limit, int * connections);
+
+void              __myqttd_domain_conn_release (MyQttdDomain * domain, axl_bool has_session);
+
+void              __myqttd_domain_stats_update (MyQttdDomain * domain, int sessions, long msgs_in);
+
+void              __myqttd_domain_sys_topics_start (MyQttdCtx * ctx, axlNode * node);
+
+axl_bool          __myqttd_domain_is_sys_topic (MyQttdCtx * ctx, const char * topic_name);
+
 MyQttdUsers     * myqttd_domain_get_users_backend (MyQttdDomain * domain);
 
 void              myqttd_domain_cleanup (MyQttdCtx * ctx);
@@ -269,6 +269,26 @@ typedef MyQttPublishCodes (*MyQttdOnPublish) (MyQttdCtx * ctx,       MyQttdDomai
 					      MyQttCtx  * myqtt_ctx, MyQttConn    * conn, 
 					      MyQttMsg  * msg,       axlPointer     user_data);
 
+/** 
+ * @brief Handler called when a command sent by another myqttd
+ * process (parent or child) is received by the current process.
+ *
+ * This handler is used by:
+ *
+ * - \ref myqttd_process_add_on_command
+ *
+ * Commands are sent with \ref myqttd_process_send_command and they
+ * are used to keep process local state (caches) in sync across the
+ * processes running (for example, to invalidate ACLs cached).
+ *
+ * @param ctx The context where the command was received.
+ *
+ * @param command The command received.
+ *
+ * @param user_data User defined pointer passed in into the function once it gets called.
+ */
+typedef void (*MyQttdOnCommand) (MyQttdCtx * ctx, const char * command, axlPointer user_data);
+
 /** 
  * @brief Handler definition for the set of functions that allows
  * MyQttd server to startup listeners.
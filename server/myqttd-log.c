@@ -42,10 +42,403 @@
 #include <myqttd.h>
 #include <stdlib.h>
 #include <syslog.h>
+#include <sys/uio.h>
 
 /* local include */
 #include <myqttd-ctx-private.h>
 
+/** 
+ * @internal Number of log sinks handled by the log writer (general,
+ * error, access and myqtt).
+ */
+#define MYQTTD_LOG_SINKS        4
+
+/** 
+ * @internal Size of the buffer where each sink accumulates log lines
+ * until the log writer flushes them.
+ */
+#define MYQTTD_LOG_BUFFER_SIZE  262144
+
+/** 
+ * @internal Max amount of bytes read from a child log pipe and
+ * written to the log file in a single operation.
+ */
+#define MYQTTD_LOG_TRANSFER_SIZE 32768
+
+/** 
+ * @internal Size of the stack buffer used to format a log line
+ * (larger lines are allocated).
+ */
+#define MYQTTD_LOG_LINE_SIZE    2048
+
+/** 
+ * @internal Asynchronous log writer: log lines are appended to a per
+ * sink buffer (a memcpy under a short lock) and a background thread
+ * writes them to the log descriptors every flush period (or before if
+ * the buffer gets half full).
+ */
+struct _MyQttdLogWriter {
+	MyQttdCtx    * ctx;
+	MyQttMutex     mutex;
+	MyQttCond      cond;
+	MyQttThread    thread;
+	axl_bool       exiting;
+
+	/* only one flush runs at a time (writer thread, sync or log
+	 * reopen): others wait on flush_cond until it finishes */
+	axl_bool       flushing;
+	MyQttCond      flush_cond;
+
+	/* logs are being closed/reopened: nothing is written (content
+	 * stays buffered) until they are available again */
+	axl_bool       paused;
+
+	/* content pending to be written and spare buffers swapped by
+	 * the writer thread */
+	char         * pending[MYQTTD_LOG_SINKS];
+	int            pending_size[MYQTTD_LOG_SINKS];
+	char         * spare[MYQTTD_LOG_SINKS];
+
+	/* flush period in microseconds */
+	long           flush_period;
+
+	/* rate limiting: max lines per second and sink (0 means no
+	 * limit), lines accepted in the current second and lines
+	 * dropped pending to be reported */
+	int            max_lines;
+	long           window;
+	int            lines[MYQTTD_LOG_SINKS];
+	int            dropped[MYQTTD_LOG_SINKS];
+};
+
+/** 
+ * @internal Maps the log type into the sink index used by the log
+ * writer.
+ */
+int __myqttd_log_sink_index (LogReportType type)
+{
+	switch (type) {
+	case LOG_REPORT_ERROR:
+	case LOG_REPORT_WARNING:
+		return 1;
+	case LOG_REPORT_ACCESS:
+		return 2;
+	case LOG_REPORT_MYQTT:
+		return 3;
+	default:
+		return 0;
+	} /* end switch */
+}
+
+/** 
+ * @internal Returns the descriptor currently configured for the
+ * provided sink.
+ */
+int __myqttd_log_sink_descriptor (MyQttdCtx * ctx, int sink)
+{
+	switch (sink) {
+	case 1:
+		return ctx->error_log;
+	case 2:
+		return ctx->access_log;
+	case 3:
+		return ctx->myqtt_log;
+	default:
+		return ctx->general_log;
+	} /* end switch */
+}
+
+/** 
+ * @internal Writes all pending content (and a notification about
+ * lines dropped by rate limiting). Must be called with the writer
+ * mutex acquired; it is released while writing. If another flush is
+ * in progress, waits for it to finish first so spare buffers are
+ * never swapped twice. Nothing is written while the writer is paused
+ * (logs being reopened), so descriptors are only used while they are
+ * open.
+ */
+void __myqttd_log_writer_flush (MyQttdLogWriter * writer)
+{
+	struct iovec   vec[2];
+	char           notice[128];
+	char         * content;
+	int            size;
+	int            dropped;
+	int            sink;
+	int            log;
+
+	while (writer->flushing)
+		MYQTT_COND_WAIT (&writer->flush_cond, &writer->mutex);
+	if (writer->paused)
+		return;
+	writer->flushing = axl_true;
+
+	for (sink = 0; sink < MYQTTD_LOG_SINKS; sink++) {
+		if (writer->pending_size[sink] == 0 && writer->dropped[sink] == 0)
+			continue;
+
+		/* swap buffers so producers keep appending while we
+		 * write */
+		content                     = writer->pending[sink];
+		size                        = writer->pending_size[sink];
+		dropped                     = writer->dropped[sink];
+		writer->pending[sink]       = writer->spare[sink];
+		writer->pending_size[sink]  = 0;
+		writer->dropped[sink]       = 0;
+		writer->spare[sink]         = NULL;
+		log                         = __myqttd_log_sink_descriptor (writer->ctx, sink);
+		myqtt_mutex_unlock (&writer->mutex);
+
+		/* write notice and content in a single call */
+		vec[0].iov_base = notice;
+		vec[0].iov_len  = 0;
+		if (dropped > 0) 
+			vec[0].iov_len = snprintf (notice, sizeof (notice), "[%d] %d log lines dropped (max-lines-per-second reached)\n", 
+						   getpid (), dropped);
+		vec[1].iov_base = content;
+		vec[1].iov_len  = size;
+		if (log >= 0 && writev (log, vec, 2) == -1) {
+			/* nothing to do: there is no log to report */
+		} /* end if */
+
+		myqtt_mutex_lock (&writer->mutex);
+		writer->spare[sink] = content;
+	} /* end for */
+
+	writer->flushing = axl_false;
+	myqtt_cond_broadcast (&writer->flush_cond);
+
+	return;
+}
+
+/** 
+ * @internal Log writer thread.
+ */
+axlPointer __myqttd_log_writer_run (MyQttdLogWriter * writer)
+{
+	myqtt_mutex_lock (&writer->mutex);
+	while (! writer->exiting) {
+		myqtt_cond_timedwait (&writer->cond, &writer->mutex, writer->flush_period);
+		__myqttd_log_writer_flush (writer);
+	} /* end while */
+
+	/* write content still pending */
+	__myqttd_log_writer_flush (writer);
+	myqtt_mutex_unlock (&writer->mutex);
+
+	return NULL;
+}
+
+/** 
+ * @internal Appends the provided log line into the sink buffer.
+ */
+void __myqttd_log_writer_push (MyQttdLogWriter * writer, int sink, const char * line, int length)
+{
+	long now;
+	int  log;
+
+	myqtt_mutex_lock (&writer->mutex);
+
+	/* apply rate limiting (never to errors) */
+	if (writer->max_lines > 0 && sink != 1) {
+		now = (long) time (NULL);
+		if (now != writer->window) {
+			writer->window = now;
+			memset (writer->lines, 0, sizeof (writer->lines));
+		} /* end if */
+
+		if (writer->lines[sink] >= writer->max_lines) {
+			writer->dropped[sink]++;
+			myqtt_mutex_unlock (&writer->mutex);
+			return;
+		} /* end if */
+		writer->lines[sink]++;
+	} /* end if */
+
+	if (length > MYQTTD_LOG_BUFFER_SIZE) {
+		/* line larger than the buffer: write pending content
+		 * and then the line taking the flush turn (so logs
+		 * are not closed meanwhile), without holding the
+		 * mutex while writing */
+		__myqttd_log_writer_flush (writer);
+		while (writer->flushing || writer->paused)
+			MYQTT_COND_WAIT (&writer->flush_cond, &writer->mutex);
+		writer->flushing = axl_true;
+		log              = __myqttd_log_sink_descriptor (writer->ctx, sink);
+		myqtt_mutex_unlock (&writer->mutex);
+
+		if (log >= 0 && write (log, line, length) == -1) {
+			/* nothing to do: there is no log to report */
+		} /* end if */
+
+		myqtt_mutex_lock (&writer->mutex);
+		writer->flushing = axl_false;
+		myqtt_cond_broadcast (&writer->flush_cond);
+		myqtt_mutex_unlock (&writer->mutex);
+		return;
+	} /* end if */
+
+	while ((writer->pending_size[sink] + length) > MYQTTD_LOG_BUFFER_SIZE) {
+		/* writer thread is not keeping up: flush from here
+		 * to keep memory bounded (or wait for logs to be
+		 * reopened) */
+		if (writer->paused) {
+			MYQTT_COND_WAIT (&writer->flush_cond, &writer->mutex);
+		} else
+			__myqttd_log_writer_flush (writer);
+	} /* end while */
+
+	memcpy (writer->pending[sink] + writer->pending_size[sink], line, length);
+	writer->pending_size[sink] += length;
+
+	/* wake up the writer if the buffer is getting full */
+	if (writer->pending_size[sink] > (MYQTTD_LOG_BUFFER_SIZE / 2))
+		myqtt_cond_signal (&writer->cond);
+
+	myqtt_mutex_unlock (&writer->mutex);
+	return;
+}
+
+/** 
+ * @internal Releases log writer buffers.
+ */
+void __myqttd_log_writer_free (MyQttdLogWriter * writer)
+{
+	int sink;
+
+	for (sink = 0; sink < MYQTTD_LOG_SINKS; sink++) {
+		axl_free (writer->pending[sink]);
+		axl_free (writer->spare[sink]);
+	} /* end for */
+	axl_free (writer);
+	return;
+}
+
+/** 
+ * @internal Starts (or reconfigures) the asynchronous log writer
+ * according to <log-reporting> settings.
+ */
+void __myqttd_log_writer_start (MyQttdCtx * ctx, axlNode * node)
+{
+	MyQttdLogWriter * writer = ctx->log_writer;
+	int               sink;
+	long              flush_period = 200;
+	int               max_lines    = 0;
+
+	/* get configuration */
+	if (HAS_ATTR (node, "flush-period"))
+		flush_period = atoi (ATTR_VALUE (node, "flush-period"));
+	if (flush_period <= 0)
+		flush_period = 200;
+	if (HAS_ATTR (node, "max-lines-per-second"))
+		max_lines    = atoi (ATTR_VALUE (node, "max-lines-per-second"));
+
+	if (writer) {
+		/* already running (log reopen), just reconfigure */
+		myqtt_mutex_lock (&writer->mutex);
+		writer->flush_period = flush_period * 1000;
+		writer->max_lines    = max_lines;
+		myqtt_mutex_unlock (&writer->mutex);
+		return;
+	} /* end if */
+
+	writer = axl_new (MyQttdLogWriter, 1);
+	if (writer == NULL) {
+		error ("unable to allocate log writer, logs will be written synchronously");
+		return;
+	} /* end if */
+	writer->ctx          = ctx;
+	writer->flush_period = flush_period * 1000;
+	writer->max_lines    = max_lines;
+	for (sink = 0; sink < MYQTTD_LOG_SINKS; sink++) {
+		writer->pending[sink] = axl_new (char, MYQTTD_LOG_BUFFER_SIZE);
+		writer->spare[sink]   = axl_new (char, MYQTTD_LOG_BUFFER_SIZE);
+		if (writer->pending[sink] == NULL || writer->spare[sink] == NULL) {
+			error ("unable to allocate log writer buffers, logs will be written synchronously");
+			__myqttd_log_writer_free (writer);
+			return;
+		} /* end if */
+	} /* end for */
+	myqtt_mutex_create (&writer->mutex);
+	myqtt_cond_create (&writer->cond);
+	myqtt_cond_create (&writer->flush_cond);
+
+	if (! myqtt_thread_create (&writer->thread, (MyQttThreadFunc) __myqttd_log_writer_run, writer, MYQTT_THREAD_CONF_END)) {
+		error ("unable to start log writer thread, logs will be written synchronously");
+		myqtt_mutex_destroy (&writer->mutex);
+		myqtt_cond_destroy (&writer->cond);
+		myqtt_cond_destroy (&writer->flush_cond);
+		__myqttd_log_writer_free (writer);
+		return;
+	} /* end if */
+
+	msg ("log writer started (flush-period=%ld ms, max-lines-per-second=%d)", flush_period, max_lines);
+	ctx->log_writer = writer;
+	return;
+}
+
+/** 
+ * @internal Writes pending content and pauses the log writer so log
+ * descriptors can be closed and reopened (see
+ * __myqttd_log_writer_resume).
+ */
+void __myqttd_log_writer_pause (MyQttdCtx * ctx)
+{
+	MyQttdLogWriter * writer = ctx->log_writer;
+
+	if (writer == NULL)
+		return;
+	myqtt_mutex_lock (&writer->mutex);
+	/* no flush is running once this returns */
+	__myqttd_log_writer_flush (writer);
+	writer->paused = axl_true;
+	myqtt_mutex_unlock (&writer->mutex);
+	return;
+}
+
+/** 
+ * @internal Resumes the log writer once logs were reopened, writing
+ * the content buffered meanwhile.
+ */
+void __myqttd_log_writer_resume (MyQttdCtx * ctx)
+{
+	MyQttdLogWriter * writer = ctx->log_writer;
+
+	if (writer == NULL)
+		return;
+	myqtt_mutex_lock (&writer->mutex);
+	writer->paused = axl_false;
+	myqtt_cond_broadcast (&writer->flush_cond);
+	myqtt_cond_signal (&writer->cond);
+	myqtt_mutex_unlock (&writer->mutex);
+	return;
+}
+
+/** 
+ * @internal Stops the log writer thread writing all pending content.
+ */
+void __myqttd_log_writer_stop (MyQttdCtx * ctx)
+{
+	MyQttdLogWriter * writer = ctx->log_writer;
+
+	if (writer == NULL)
+		return;
+
+	/* signal writer to finish and wait for it */
+	myqtt_mutex_lock (&writer->mutex);
+	writer->exiting = axl_true;
+	myqtt_cond_signal (&writer->cond);
+	myqtt_mutex_unlock (&writer->mutex);
+	myqtt_thread_destroy (&writer->thread, axl_false);
+
+	ctx->log_writer = NULL;
+	myqtt_mutex_destroy (&writer->mutex);
+	myqtt_cond_destroy (&writer->cond);
+	myqtt_cond_destroy (&writer->flush_cond);
+	__myqttd_log_writer_free (writer);
+	return;
+}
+
 /** 
  * @brief Init the myqttd log module.
  */
@@ -124,6 +517,10 @@ void myqttd_log_init (MyQttdCtx * ctx)
 		msg ("opened log: %s", ATTR_VALUE (node, "file"));
 	} /* end if */
 	node      = axl_node_get_parent (node);
+
+	/* check for asynchronous log writing */
+	if (HAS_ATTR_VALUE (node, "async", "yes")) 
+		__myqttd_log_writer_start (ctx, node);
 	
 	return;
 }
@@ -173,7 +570,7 @@ axl_bool __myqttd_log_manager_transfer_content (MyQttdLoop * loop,
 {
 	int     size;
 	int     size_written;
-	char    buffer[4097];
+	char    buffer[MYQTTD_LOG_TRANSFER_SIZE];
 	int     output_sink = PTR_TO_INT (ptr);
 
 	switch (output_sink) {
@@ -196,14 +593,13 @@ axl_bool __myqttd_log_manager_transfer_content (MyQttdLoop * loop,
 	} /* end switch */
 
 	/* read content */
-	size = read (descriptor, buffer, 4096);
+	size = read (descriptor, buffer, MYQTTD_LOG_TRANSFER_SIZE);
 			
 	/* check closed socket (child process finished) */
 	if (size <= 0) 
 		return axl_false;
 			
 	/* transfer content to the associated socket */
-	buffer[size] = 0;
 	size_written = write (output_sink, buffer, size);
 	if (size_written != size) {
 		error ("failed to write log received from child, content differs (%d != %d), error was: %s", 
@@ -296,19 +692,19 @@ void      myqttd_log_manager_register (MyQttdCtx * ctx,
  * @internal macro that allows to report a message to the particular
  * log, appending date information.
  */
-void REPORT (axl_bool use_syslog, LogReportType type, int log, const char * message, va_list args, const char * file, int line) 
+void REPORT (MyQttdCtx * ctx, LogReportType type, int log, const char * message, va_list args, const char * file, int line) 
 {
 	/* get myqttd context */
 	time_t             time_val;
-	char             * time_str;
+	char               time_str[32];
+	char               buffer[MYQTTD_LOG_LINE_SIZE];
 	char             * string;
-	char             * string2;
 	char             * result;
 	int                length;
 	int                length2;
-	int                total;
+	va_list            copy;
 
-	if (use_syslog) {
+	if (ctx->use_syslog) {
 		string = axl_strdup_printfv (message, args);
 		if (string == NULL)
 			return;
@@ -333,52 +729,51 @@ void REPORT (axl_bool use_syslog, LogReportType type, int log, const char * mess
 
 	/* create timestamp */
 	time_val = time (NULL);
-	time_str = axl_strdup (ctime (&time_val));
-	if (time_str == NULL)
+	if (ctime_r (&time_val, time_str) == NULL)
 		return;
 	time_str [strlen (time_str) - 1] = 0;
 
-	/* write stamp */
-	string = axl_strdup_printf ("%s [%d] (%s:%d) ", time_str, getpid (), file, line);
-	axl_free (time_str);
-	if (string == NULL)
+	/* write stamp and message into the local buffer: only
+	 * allocate when the line doesn't fit */
+	result  = buffer;
+	length  = snprintf (buffer, MYQTTD_LOG_LINE_SIZE, "%s [%d] (%s:%d) ", time_str, getpid (), file, line);
+	if (length < 0 || length >= MYQTTD_LOG_LINE_SIZE)
 		return;
-	length = strlen (string);
-
-	/* create message */
-	string2 = axl_strdup_printfv (message, args);
-	if (string2 == NULL) {
-		axl_free (string);
+	va_copy (copy, args);
+	length2 = vsnprintf (buffer + length, MYQTTD_LOG_LINE_SIZE - length, message, copy);
+	va_end (copy);
+	if (length2 < 0)
 		return;
-	}
-
-	length2 = strlen (string2);
 
-	/* build final log message */
-	total  = length + length2 + 1;
-	result = axl_new (char, total + 1);
-	if (result == NULL) {
-		axl_free (string);
-		axl_free (string2);
-		return;
-	}
-
-	memcpy (result, string, length);
-	memcpy (result + length, string2, length2);
-	memcpy (result + length + length2, "\n", 1);
+	if ((length + length2 + 1) >= MYQTTD_LOG_LINE_SIZE) {
+		/* line too long, build it into memory */
+		result = axl_new (char, length + length2 + 2);
+		if (result == NULL)
+			return;
+		memcpy (result, buffer, length);
+		va_copy (copy, args);
+		vsnprintf (result + length, length2 + 1, message, copy);
+		va_end (copy);
+	} /* end if */
+	length += length2;
+	result[length] = '\n';
+	length++;
 
-	axl_free (string);
-	axl_free (string2);
-	
-	/* write content: do it in a single operation to avoid mixing
-	 * content from different logs at the log file. */
-	if (write (log, result, total) == -1) {
-		axl_free (result);
-		return;
-	}
+	if (ctx->log_writer) {
+		/* asynchronous write */
+		__myqttd_log_writer_push (ctx->log_writer, __myqttd_log_sink_index (type), result, length);
+	} else {
+		/* write content: do it in a single operation to avoid
+		 * mixing content from different logs at the log
+		 * file. */
+		if (write (log, result, length) == -1) {
+			/* nothing to do: there is no log to report */
+		} /* end if */
+	} /* end if */
 	
 	/* release memory used */
-	axl_free (result);
+	if (result != buffer)
+		axl_free (result);
 	return;
 } 
 
@@ -401,19 +796,19 @@ void myqttd_log_report (MyQttdCtx   * ctx,
 {
 	/* according to the type received report */
 	if ((type & LOG_REPORT_GENERAL) == LOG_REPORT_GENERAL) 
-		REPORT (ctx->use_syslog, LOG_REPORT_GENERAL, ctx->general_log, message, args, file, line);
+		REPORT (ctx, LOG_REPORT_GENERAL, ctx->general_log, message, args, file, line);
 	
 	/* handle error and warning through the same log file */
 	if ((type & LOG_REPORT_ERROR) == LOG_REPORT_ERROR) 
-		REPORT (ctx->use_syslog, LOG_REPORT_ERROR, ctx->error_log, message, args, file, line);
+		REPORT (ctx, LOG_REPORT_ERROR, ctx->error_log, message, args, file, line);
 	if ((type & LOG_REPORT_WARNING) == LOG_REPORT_WARNING) 
-		REPORT (ctx->use_syslog, LOG_REPORT_WARNING, ctx->error_log, message, args, file, line);
+		REPORT (ctx, LOG_REPORT_WARNING, ctx->error_log, message, args, file, line);
 	
 	if ((type & LOG_REPORT_ACCESS) == LOG_REPORT_ACCESS) 
-		REPORT (ctx->use_syslog, LOG_REPORT_ACCESS, ctx->access_log, message, args, file, line);
+		REPORT (ctx, LOG_REPORT_ACCESS, ctx->access_log, message, args, file, line);
 
 	if ((type & LOG_REPORT_MYQTT) == LOG_REPORT_MYQTT) {
-		REPORT (ctx->use_syslog, LOG_REPORT_MYQTT, ctx->myqtt_log, message, args, file, line);
+		REPORT (ctx, LOG_REPORT_MYQTT, ctx->myqtt_log, message, args, file, line);
 	}
 	return;
 }
@@ -451,6 +846,10 @@ void __myqttd_log_close (MyQttdCtx * ctx)
 		return;
 	}
 
+	/* write content pending and stop writing until logs are
+	 * opened again (see __myqttd_log_reopen) */
+	__myqttd_log_writer_pause (ctx);
+
 	/* close the general log */
 	if (ctx->general_log >= 0)
 		close (ctx->general_log);
@@ -483,6 +882,9 @@ void __myqttd_log_reopen (MyQttdCtx * ctx)
 	/* call to open again */
 	myqttd_log_init (ctx);
 
+	/* write content buffered meanwhile */
+	__myqttd_log_writer_resume (ctx);
+
 	msg ("Log reopening finished..");
 
 	return;
@@ -494,6 +896,9 @@ void __myqttd_log_reopen (MyQttdCtx * ctx)
  */
 void myqttd_log_cleanup (MyQttdCtx * ctx)
 {
+	/* stop log writer */
+	__myqttd_log_writer_stop (ctx);
+
 	/* call to close current logs */
 	__myqttd_log_close (ctx);
 
@@ -49,6 +49,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/un.h>
+#include <fcntl.h>
 
 
 /** 
@@ -108,6 +109,47 @@ void myqttd_process_init         (MyQttdCtx * ctx, axl_bool reinit)
 }
 
 
+/** 
+ * @internal Adds the control connection of the child provided to the
+ * single parent loop that attends commands sent by all childs. The
+ * loop watches a copy of the control socket (because it closes the
+ * descriptors it watches) and holds a reference to the child until
+ * the control connection is closed (see myqttd_process_parent_notify).
+ *
+ * Must be called with child_process_mutex held.
+ */
+void __myqttd_process_watch_child_commands (MyQttdCtx * ctx, MyQttdChild * child)
+{
+	int descriptor;
+
+	/* create the loop on first use */
+	if (ctx->child_commands == NULL) {
+		ctx->child_commands = myqttd_loop_create (ctx);
+		if (ctx->child_commands == NULL) {
+			error ("PARENT: unable to create loop to watch child commands, commands from child pid=%d will be ignored", child->pid);
+			return;
+		} /* end if */
+	} /* end if */
+	if (ctx->child_commands_watched == NULL)
+		ctx->child_commands_watched = axl_list_new (axl_list_always_return_1, (axlDestroyFunc) myqttd_child_unref);
+
+	descriptor = dup (child->child_connection);
+	if (descriptor == -1) {
+		error ("PARENT: unable to dup control connection (%d) of child pid=%d, commands from it will be ignored (code %d): %s",
+		       child->child_connection, child->pid, errno, myqtt_errno_get_last_error ());
+		return;
+	} /* end if */
+
+	if (! myqttd_child_ref (child)) {
+		myqtt_close_socket (descriptor);
+		return;
+	} /* end if */
+	axl_list_append (ctx->child_commands_watched, child);
+
+	myqttd_loop_watch_descriptor (ctx->child_commands, descriptor, myqttd_process_parent_notify, child, NULL);
+	return;
+}
+
 axlPointer __myqttd_process_finished (MyQttdCtx * ctx)
 {
 	MyQttCtx        * myqtt_ctx = ctx->myqtt_ctx;
@@ -350,112 +392,429 @@ axl_bool __myqttd_process_create_parent_connection (MyQttdChild * child)
 }
 
 /** 
- * @internal Function used to send the provided socket to the provided
- * child.
+ * @internal Version of the binary handoff format used to pass
+ * connections from the parent to its childs. Bump it every time
+ * MyQttdHandoffHeader or MyQttdHandoffRecord changes.
+ */
+#define MYQTTD_HANDOFF_VERSION     2
+
+/** 
+ * @internal Max length (including trailing \0) for each string
+ * transferred inside a handoff record.
+ */
+#define MYQTTD_HANDOFF_MAX_STRING  1024
+
+/** 
+ * @internal Reports if records with the provided command carry a
+ * socket. Commands sent between processes ('c') are plain records.
+ */
+#define MYQTTD_HANDOFF_HAS_SOCKET(command) ((command) != 'c')
+
+/** 
+ * @internal Header sent at the beginning of each handoff message. It
+ * is followed by count MyQttdHandoffRecord, each one carrying a
+ * socket (see MYQTTD_HANDOFF_HAS_SOCKET) associated, in the same
+ * order, to the sockets passed in the SCM_RIGHTS array.
+ */
+typedef struct _MyQttdHandoffHeader {
+	unsigned char    version;
+	unsigned char    count;
+	/* bytes of records following this header */
+	unsigned short   size;
+} MyQttdHandoffHeader;
+
+/** 
+ * @internal Fixed part of a handoff record. It is followed by the
+ * strings serverName, remote_host, remote_port and remote_host_ip,
+ * each one including its trailing \0 and with the length reported in
+ * lengths[]. A 0 length means NULL.
+ */
+typedef struct _MyQttdHandoffRecord {
+	unsigned char    command;
+	unsigned char    handle_reply;
+	unsigned char    has_tls;
+	unsigned char    fix_server_name;
+	unsigned short   lengths[4];
+} MyQttdHandoffRecord;
+
+/** 
+ * @internal Creates a handoff object holding the socket to be passed
+ * to a child and the binary record that describes it.
  *
- * @param socket The socket to be send.
+ * @param socket The socket to be passed. The handoff takes ownership
+ * of it. Use -1 for commands that carry no socket ('c').
  *
- * @param child The child child where to send the new socket.
+ * @param command 'n' to notify a new connection, 's' to close that
+ * socket in the child process (already owned by the child due to
+ * fork), 'c' to run the command provided in serverName.
  *
- * @param ancillary_data Data to be sent along with the
- * socket. Standard data is "s" to close that socket in the child
- * process and "n" to notify a new connection.
+ * @param handle_reply Reply handling indication for the child.
  *
- * @return If the socket was sent.
+ * @param serverName The serverName to be configured (optional).
+ *
+ * @param conn The connection being passed, used to get remote
+ * host/port and tls status (optional).
+ *
+ * @return A newly allocated handoff or NULL if it fails.
  */
-axl_bool myqttd_process_send_socket (MYQTT_SOCKET     socket, 
-					 MyQttdChild * child, 
-					 const char      * ancillary_data, 
-					 int               size)
+MyQttdHandoff * myqttd_process_handoff_new (MYQTT_SOCKET     socket,
+					    char             command,
+					    axl_bool         handle_reply,
+					    const char     * serverName,
+					    MyQttConn      * conn)
 {
-	struct msghdr        msg;
-	int                * int_ptr;
-	char                 ccmsg[CMSG_SPACE(sizeof(socket))];
+	MyQttdHandoff       * handoff;
+	MyQttdHandoffRecord   record;
+	const char          * strings[4];
+	int                   iterator;
+	int                   length;
+	char                * aux;
+
+	memset (&record, 0, sizeof (MyQttdHandoffRecord));
+	record.command         = command;
+	record.handle_reply    = handle_reply ? 1 : 0;
+	record.has_tls         = (conn && conn->tls_on) ? 1 : 0;
+	record.fix_server_name = (conn && axl_cmp (serverName, myqtt_conn_get_server_name (conn))) ? 1 : 0;
+
+	strings[0] = serverName;
+	strings[1] = conn ? myqtt_conn_get_host (conn) : NULL;
+	strings[2] = conn ? myqtt_conn_get_port (conn) : NULL;
+	strings[3] = conn ? myqtt_conn_get_host_ip (conn) : NULL;
+
+	length     = sizeof (MyQttdHandoffRecord);
+	for (iterator = 0; iterator < 4; iterator++) {
+		if (strings[iterator] == NULL)
+			continue;
+		record.lengths[iterator] = strlen (strings[iterator]) + 1;
+		if (record.lengths[iterator] > MYQTTD_HANDOFF_MAX_STRING)
+			return NULL;
+		length += record.lengths[iterator];
+	} /* end for */
+
+	handoff = axl_new (MyQttdHandoff, 1);
+	if (handoff == NULL)
+		return NULL;
+	handoff->record = axl_new (char, length);
+	if (handoff->record == NULL) {
+		axl_free (handoff);
+		return NULL;
+	} /* end if */
 
-	struct cmsghdr     * cmsg;
-	struct iovec         vec; 
+	/* encode record */
+	memcpy (handoff->record, &record, sizeof (MyQttdHandoffRecord));
+	aux = handoff->record + sizeof (MyQttdHandoffRecord);
+	for (iterator = 0; iterator < 4; iterator++) {
+		if (record.lengths[iterator] == 0)
+			continue;
+		memcpy (aux, strings[iterator], record.lengths[iterator]);
+		aux += record.lengths[iterator];
+	} /* end for */
+
+	handoff->record_size = length;
+	handoff->socket      = socket;
+	handoff->command     = command;
+
+	return handoff;
+}
 
-	/* send at least one byte */
-	const char         * str = ancillary_data ? ancillary_data : "#"; 
-	int                  rv;
+/** 
+ * @internal Releases the handoff object, closing the socket if it is
+ * still owned by the handoff.
+ */
+void            myqttd_process_handoff_free (MyQttdHandoff * handoff)
+{
+	if (handoff == NULL)
+		return;
+	if (handoff->socket > 0)
+		myqtt_close_socket (handoff->socket);
+	axl_free (handoff->record);
+	axl_free (handoff);
+	return;
+}
+
+/** 
+ * @internal Sends a single batch (that must fit into a single
+ * message) to the child.
+ */
+axl_bool __myqttd_process_send_batch (MyQttdChild    * child,
+				      MyQttdHandoff ** handoffs,
+				      int              count,
+				      int              size)
+{
+	struct msghdr         msg;
+	struct iovec          vec[MYQTTD_HANDOFF_MAX_FDS + 1];
+	char                  ccmsg[CMSG_SPACE (sizeof (int) * MYQTTD_HANDOFF_MAX_FDS)];
+	struct cmsghdr      * cmsg;
+	MyQttdHandoffHeader   header;
+	int                 * fds;
+	int                   fds_count = 0;
+	int                   iterator;
+	axl_bool              rv;
 #if ! defined(SHOW_FORMAT_BUGS)
-	MyQttdCtx      * ctx = child->ctx;
+	MyQttdCtx           * ctx = child->ctx;
 #endif
 
+	/* configure header */
+	header.version = MYQTTD_HANDOFF_VERSION;
+	header.count   = count;
+	header.size    = size;
+
 	/* clear structures */
 	memset (&msg, 0, sizeof (struct msghdr));
+	memset (ccmsg, 0, sizeof (ccmsg));
+
+	/* header and records are sent as is, without copying them */
+	vec[0].iov_base = (char *) &header;
+	vec[0].iov_len  = sizeof (MyQttdHandoffHeader);
+	for (iterator = 0; iterator < count; iterator++) {
+		vec[iterator + 1].iov_base = handoffs[iterator]->record;
+		vec[iterator + 1].iov_len  = handoffs[iterator]->record_size;
+	} /* end for */
+	msg.msg_iov            = vec;
+	msg.msg_iovlen         = count + 1;
+
+	for (iterator = 0; iterator < count; iterator++) {
+		if (MYQTTD_HANDOFF_HAS_SOCKET (handoffs[iterator]->command))
+			fds_count++;
+	} /* end for */
+
+	/* only records with sockets use the SCM_RIGHTS array */
+	if (fds_count > 0) {
+		msg.msg_control        = ccmsg;
+		msg.msg_controllen     = CMSG_SPACE (sizeof (int) * fds_count);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level       = SOL_SOCKET;
+		cmsg->cmsg_type        = SCM_RIGHTS;
+		cmsg->cmsg_len         = CMSG_LEN (sizeof (int) * fds_count);
+		fds                    = (int *) CMSG_DATA(cmsg);
+		fds_count              = 0;
+		for (iterator = 0; iterator < count; iterator++) {
+			if (MYQTTD_HANDOFF_HAS_SOCKET (handoffs[iterator]->command))
+				fds[fds_count++] = handoffs[iterator]->socket;
+		} /* end for */
+
+		msg.msg_controllen     = cmsg->cmsg_len;
+	} /* end if */
+	msg.msg_flags          = 0;
 
-	/* configure destination */
-	msg.msg_namelen        = 0;
+	rv = (sendmsg (child->child_connection, &msg, 0) != -1);
+	if (rv) {
+		msg ("PARENT: %d record(s) with %d socket(s) sent via %d (%d bytes), closing..", 
+		     count, fds_count, child->child_connection, size);
+	} else {
+		error ("PARENT: Failed to send %d record(s) with %d socket(s), error code %d, textual was: %s", 
+		       count, fds_count, errno, myqtt_errno_get_error (errno));
+	} /* end if */
 
-	vec.iov_base   = (char *) str;
-	vec.iov_len    = ancillary_data == NULL ? 1 : size;
-	msg.msg_iov    = &vec;
-	msg.msg_iovlen = 1;
+	/* sockets are now owned by the child (or lost due to the
+	 * failure): close our copy */
+	for (iterator = 0; iterator < count; iterator++) {
+		if (handoffs[iterator]->socket >= 0)
+			myqtt_close_socket (handoffs[iterator]->socket);
+		handoffs[iterator]->socket = -1;
+	} /* end for */
 
-	msg.msg_control        = ccmsg;
-	msg.msg_controllen     = sizeof(ccmsg);
+	return rv;
+}
 
-	cmsg = CMSG_FIRSTHDR(&msg);
-	cmsg->cmsg_level       = SOL_SOCKET;
-	cmsg->cmsg_type        = SCM_RIGHTS;
-	cmsg->cmsg_len         = CMSG_LEN(sizeof(socket));
-	int_ptr                = (int*)CMSG_DATA(cmsg);
-	(*int_ptr)             = socket;
-
-	msg.msg_controllen     = cmsg->cmsg_len;
-	msg.msg_flags = 0;
-	
-	rv = (sendmsg (child->child_connection, &msg, 0) != -1);
-	if (rv)  {
-		msg ("PARENT: Socket %d sent to child via %d (ancillary data: %s), closing (status: %d)..", 
-		     socket, child->child_connection, ancillary_data, rv);
-		/* close the socket  */
-		myqtt_close_socket (socket); 
-	} else {
-		error ("PARENT: Failed to send socket, error code %d, textual was: %s", rv, myqtt_errno_get_error (errno));
-	}
+/** 
+ * @internal Function used to send the provided set of sockets to the
+ * provided child, grouping as many as possible into a single sendmsg
+ * call (up to MYQTTD_HANDOFF_MAX_FDS).
+ *
+ * Sockets are always closed by this function (because they were
+ * sent or because there was a failure). Handoff objects are not
+ * released.
+ *
+ * @param child The child child where to send the sockets.
+ *
+ * @param handoffs Array of handoffs to send.
+ *
+ * @param count Number of handoffs in the array.
+ *
+ * @return axl_true if all sockets were sent, otherwise axl_false.
+ */
+axl_bool myqttd_process_send_sockets (MyQttdChild    * child,
+				      MyQttdHandoff ** handoffs,
+				      int              count)
+{
+	int       start  = 0;
+	int       items;
+	int       size;
+	axl_bool  result = axl_true;
+
+	while (start < count) {
+		/* collect records that fit into a single message */
+		items = 0;
+		size  = 0;
+		while ((start + items) < count && items < MYQTTD_HANDOFF_MAX_FDS &&
+		       (sizeof (MyQttdHandoffHeader) + size + handoffs[start + items]->record_size) <= MYQTTD_HANDOFF_BUFFER_SIZE) {
+			size += handoffs[start + items]->record_size;
+			items++;
+		} /* end while */
+
+		if (! __myqttd_process_send_batch (child, handoffs + start, items, size))
+			result = axl_false;
+
+		start += items;
+	} /* end while */
 	
-	return rv;
+	return result;
 }
 
 /** 
- * @brief Allows to receive a socket from the parent on the child
- * provided. In the case the function works, the socket references is
- * updated with the socket descriptor.
+ * @internal Queues the provided handoff to be sent to the child. If
+ * there is no other thread sending sockets to this child, the caller
+ * becomes the sender and flushes the queue (including all handoffs
+ * queued by other threads in the meantime) until it is empty, so a
+ * burst of connections is passed with a few sendmsg calls without
+ * adding latency.
  *
- * @param socket A reference where to set socket received. It cannot be NULL.
- * @param child Child receiving the socket. 
+ * The function takes ownership of the handoff.
+ *
+ * @return axl_false if the caller flushed the queue and some of the
+ * sockets couldn't be sent, otherwise axl_true.
+ */
+axl_bool myqttd_process_queue_socket (MyQttdChild * child, MyQttdHandoff * handoff)
+{
+	MyQttdHandoff * batch[MYQTTD_HANDOFF_MAX_FDS];
+	int             count;
+	int             iterator;
+	axl_bool        result = axl_true;
+
+	myqtt_mutex_lock (&child->mutex);
+	if (child->handoff_pending == NULL)
+		child->handoff_pending = axl_list_new (axl_list_always_return_1, (axlDestroyFunc) myqttd_process_handoff_free);
+	axl_list_append (child->handoff_pending, handoff);
+
+	/* another thread is sending, it will pick our handoff */
+	if (child->handoff_flushing) {
+		myqtt_mutex_unlock (&child->mutex);
+		return axl_true;
+	} /* end if */
+	child->handoff_flushing = axl_true;
+
+	while (axl_list_length (child->handoff_pending) > 0) {
+		/* take next batch */
+		count = 0;
+		while (count < MYQTTD_HANDOFF_MAX_FDS && axl_list_length (child->handoff_pending) > 0) {
+			batch[count] = axl_list_get_first (child->handoff_pending);
+			axl_list_unlink_first (child->handoff_pending);
+			count++;
+		} /* end while */
+		myqtt_mutex_unlock (&child->mutex);
+
+		/* send without holding the lock */
+		if (! myqttd_process_send_sockets (child, batch, count))
+			result = axl_false;
+		for (iterator = 0; iterator < count; iterator++)
+			myqttd_process_handoff_free (batch[iterator]);
+
+		myqtt_mutex_lock (&child->mutex);
+	} /* end while */
+
+	child->handoff_flushing = axl_false;
+	myqtt_mutex_unlock (&child->mutex);
+
+	return result;
+}
+
+/** 
+ * @internal Sends the provided socket to the child with the 's'
+ * command (close it, it is already owned by the child due to
+ * fork). The socket is closed in all cases.
+ */
+axl_bool __myqttd_process_send_close_socket (MyQttdChild * child, MYQTT_SOCKET socket)
+{
+	MyQttdHandoff * handoff;
+	axl_bool        result;
+
+	handoff = myqttd_process_handoff_new (socket, 's', axl_false, NULL, NULL);
+	if (handoff == NULL) {
+		myqtt_close_socket (socket);
+		return axl_false;
+	} /* end if */
+
+	result = myqttd_process_send_sockets (child, &handoff, 1);
+	myqttd_process_handoff_free (handoff);
+
+	return result;
+}
+
+/** 
+ * @internal Reads the remaining bytes of a handoff message that was
+ * not fully received by the first recvmsg.
+ */
+axl_bool __myqttd_process_receive_remaining (MyQttdChild * child, char * buffer, int received, int expected)
+{
+	int bytes;
+
+	while (received < expected) {
+		bytes = recv (child->child_connection, buffer + received, expected - received, 0);
+		if (bytes <= 0) {
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			return axl_false;
+		} /* end if */
+		received += bytes;
+	} /* end while */
+
+	return axl_true;
+}
+
+/** 
+ * @brief Allows to receive a set of sockets from the parent on the
+ * child provided. In the case the function works, the handoffs array
+ * is filled with the sockets received and their records decoded
+ * (strings point into the buffer provided).
+ *
+ * @param child Child receiving the sockets.
+ *
+ * @param buffer Buffer of MYQTTD_HANDOFF_BUFFER_SIZE bytes where the
+ * message is received.
+ *
+ * @param handoffs Array of MYQTTD_HANDOFF_MAX_FDS items to be filled.
+ *
+ * @param count Reference where the number of handoffs is reported.
  *
  * @return The function returns axl_false in the case of failure,
  * otherwise axl_true is returned.
  */
-axl_bool myqttd_process_receive_socket (MYQTT_SOCKET    * _socket, 
-					    MyQttdChild  * child, 
-					    char            ** ancillary_data, 
-					    int              * size)
+axl_bool myqttd_process_receive_sockets (MyQttdChild    * child,
+					   char           * buffer,
+					   MyQttdHandoff  * handoffs,
+					   int            * count)
 {
-	struct msghdr    msg;
-	struct iovec     iov;
-	char             buf[1024];
-	int              status;
-	char             ccmsg[CMSG_SPACE(sizeof(int))];
-	struct           cmsghdr *cmsg;
-	MyQttdCtx  * ctx;
+	struct msghdr         msg;
+	struct iovec          iov;
+	int                   status;
+	char                  ccmsg[CMSG_SPACE (sizeof (int) * MYQTTD_HANDOFF_MAX_FDS)];
+	struct cmsghdr      * cmsg;
+	MyQttdHandoffHeader   header;
+	MyQttdHandoffRecord   record;
+	MyQttdCtx           * ctx;
+	int                 * fds = NULL;
+	int                   fds_count = 0;
+	int                   fds_used = 0;
+	axl_bool              missing_socket = axl_false;
+	int                   iterator;
+	int                   field;
+	int                   offset;
+	const char         ** strings[4];
 
 	/* variables for error reporting */
-	MYQTT_SOCKET    temp;
-	int              soft_limit, hard_limit;
+	MYQTT_SOCKET          temp;
+	int                   soft_limit, hard_limit;
 
-	int            * int_ptr;
-	
-	v_return_val_if_fail (_socket && child, axl_false);
+	v_return_val_if_fail (child && buffer && handoffs && count, axl_false);
 
 	/* get context reference */
-	ctx = child->ctx;
-	
-	iov.iov_base = buf;
-	iov.iov_len = 1023;
+	ctx      = child->ctx;
+	(*count) = 0;
+
+	iov.iov_base = buffer;
+	iov.iov_len  = MYQTTD_HANDOFF_BUFFER_SIZE;
 
 	memset (&msg, 0, sizeof (struct msghdr));	
 	msg.msg_name       = 0;
@@ -469,62 +828,133 @@ axl_bool myqttd_process_receive_socket (MYQTT_SOCKET    * _socket,
 	if (status == -1) {
 		error ("Failed to receive socket, recvmsg failed, error was: (code %d) %s",
 		       errno, myqtt_errno_get_last_error ());
-		(*_socket) = -1;
+		return axl_false;
+	} /* end if */
+	if (status == 0) {
+		/* remote process closed the control connection */
+		msg ("Control connection closed by remote process (socket: %d)", child->child_connection);
 		return axl_false;
 	} /* end if */
 
+	/* get sockets received, if any: messages only carrying
+	 * commands have no control message */
 	cmsg = CMSG_FIRSTHDR(&msg);
-	if (cmsg == NULL) {
-		/* check first if we have support to create more sockets */
-		temp = socket (AF_INET, SOCK_STREAM, 0);
-		if (temp == MYQTT_INVALID_SOCKET) {
-			/* we have received our socket limit */
-			myqtt_conf_get (MYQTTD_MYQTT_CTX(ctx), MYQTT_SOFT_SOCK_LIMIT, &soft_limit);
-			myqtt_conf_get (MYQTTD_MYQTT_CTX(ctx), MYQTT_HARD_SOCK_LIMIT, &hard_limit);
-		
-			error ("Unable to receive socket from parent, droping socket connection, reached process limit: soft-limit=%d, hard-limit=%d\n",
-			       soft_limit, hard_limit);
-		} else {
-			error ("Received empty control message from parent (status: %d), unable to receive socket (code %d): %s",
-			       status, errno, myqtt_errno_get_last_error ());
-			error ("Reached socket process limit?");
-		} /* end if */
+	if (cmsg != NULL) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			error ("Unexpected control message of unknown type %d, failed to receive socket", 
+			       cmsg->cmsg_type);
+			return axl_false;
+		}
 
-		(*_socket) = -1;
-		if (ancillary_data)
-			(*ancillary_data) = NULL;
-		if (size)
-			(*size) = 0;
-		return axl_false;
-	}
+		fds       = (int *) CMSG_DATA(cmsg);
+		fds_count = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+	} /* end if */
+	if (msg.msg_flags & MSG_CTRUNC) 
+		error ("Control message truncated, some sockets were lost (received %d)", fds_count);
 
-	if (cmsg->cmsg_type != SCM_RIGHTS) {
-		error ("Unexpected control message of unknown type %d, failed to receive socket", 
-		       cmsg->cmsg_type);
-		(*_socket) = -1;
-		return axl_false;
-	}
+	/* check header */
+	if (status < (int) sizeof (MyQttdHandoffHeader)) {
+		error ("Received handoff message too short (%d bytes)", status);
+		goto close_fds;
+	} /* end if */
+	memcpy (&header, buffer, sizeof (MyQttdHandoffHeader));
+	if (header.version != MYQTTD_HANDOFF_VERSION || header.count > MYQTTD_HANDOFF_MAX_FDS || 
+	    (sizeof (MyQttdHandoffHeader) + header.size) > MYQTTD_HANDOFF_BUFFER_SIZE) {
+		error ("Received unexpected handoff header (version=%d, count=%d, size=%d) for %d sockets",
+		       header.version, header.count, header.size, fds_count);
+		goto close_fds;
+	} /* end if */
 
-	/* report data received on the message */
-	if (size)
-		(*size)   = status;
-	if (ancillary_data) {
-		(*ancillary_data) = axl_new (char, status + 1);
-		memcpy (*ancillary_data, iov.iov_base, status);
-	}
+	/* get the rest of the message if it was not received
+	 * completely */
+	if (! __myqttd_process_receive_remaining (child, buffer, status, sizeof (MyQttdHandoffHeader) + header.size)) {
+		error ("Failed to receive complete handoff message (%d bytes), error was: (code %d) %s",
+		       (int) sizeof (MyQttdHandoffHeader) + header.size, errno, myqtt_errno_get_last_error ());
+		goto close_fds;
+	} /* end if */
+
+	/* decode records */
+	offset = sizeof (MyQttdHandoffHeader);
+	for (iterator = 0; iterator < header.count; iterator++) {
+		if ((offset + (int) sizeof (MyQttdHandoffRecord)) > (int) (sizeof (MyQttdHandoffHeader) + header.size))
+			break;
+		memcpy (&record, buffer + offset, sizeof (MyQttdHandoffRecord));
+		offset += sizeof (MyQttdHandoffRecord);
+
+		memset (&handoffs[iterator], 0, sizeof (MyQttdHandoff));
+		handoffs[iterator].socket          = -1;
+		if (MYQTTD_HANDOFF_HAS_SOCKET (record.command)) {
+			if (fds_used == fds_count) {
+				missing_socket = axl_true;
+				break;
+			} /* end if */
+			handoffs[iterator].socket  = fds[fds_used++];
+		} /* end if */
+		handoffs[iterator].command         = record.command;
+		handoffs[iterator].handle_reply    = record.handle_reply;
+		handoffs[iterator].has_tls         = record.has_tls;
+		handoffs[iterator].fix_server_name = record.fix_server_name;
+
+		strings[0] = &handoffs[iterator].serverName;
+		strings[1] = &handoffs[iterator].remote_host;
+		strings[2] = &handoffs[iterator].remote_port;
+		strings[3] = &handoffs[iterator].remote_host_ip;
+		for (field = 0; field < 4; field++) {
+			if (record.lengths[field] == 0)
+				continue;
+			if ((offset + record.lengths[field]) > (int) (sizeof (MyQttdHandoffHeader) + header.size) ||
+			    buffer[offset + record.lengths[field] - 1] != 0) 
+				break;
+			(*strings[field]) = buffer + offset;
+			offset += record.lengths[field];
+		} /* end for */
+		if (field != 4)
+			break;
+	} /* end for */
+
+	if (iterator != header.count) {
+		if (missing_socket) {
+			/* check first if we have support to create more sockets */
+			temp = socket (AF_INET, SOCK_STREAM, 0);
+			if (temp == MYQTT_INVALID_SOCKET) {
+				/* we have received our socket limit */
+				myqtt_conf_get (MYQTTD_MYQTT_CTX(ctx), MYQTT_SOFT_SOCK_LIMIT, &soft_limit);
+				myqtt_conf_get (MYQTTD_MYQTT_CTX(ctx), MYQTT_HARD_SOCK_LIMIT, &hard_limit);
+		
+				error ("Unable to receive socket from parent, droping socket connection, reached process limit: soft-limit=%d, hard-limit=%d\n",
+				       soft_limit, hard_limit);
+			} else {
+				myqtt_close_socket (temp);
+				error ("Received %d socket(s) for %d handoff record(s) (status: %d), unable to receive socket (code %d): %s",
+				       fds_count, header.count, status, errno, myqtt_errno_get_last_error ());
+				error ("Reached socket process limit?");
+			} /* end if */
+		} else
+			error ("Received malformed handoff record at position %d (of %d)", iterator, header.count);
+		goto close_fds;
+	} /* end if */
 
-	/* set socket received */
-	int_ptr    = (int *) CMSG_DATA(cmsg);
-	(*_socket) = (*int_ptr);
+	if (fds_used != fds_count) {
+		error ("Received %d socket(s) but handoff records only use %d", fds_count, fds_used);
+		goto close_fds;
+	} /* end if */
 
-	msg ("Process received socket %d, checking to send received signal...", (*_socket));
+	msg ("Process received %d record(s) with %d socket(s)", header.count, fds_count);
+	(*count) = header.count;
 	return axl_true;
+
+ close_fds:
+	for (iterator = 0; iterator < fds_count; iterator++)
+		myqtt_close_socket (fds[iterator]);
+	return axl_false;
 }
 
 /** 
  * @internal Function used to create an string that represents the
  * status of the MQTT session so the receiving process can reconstruct
- * the connection.
+ * the connection. It is only used to build the child init string:
+ * connections passed to a running child use the binary handoff
+ * record (see myqttd_process_handoff_new).
  */
 char * myqttd_process_connection_status_string (axl_bool          handle_reply,
 						const char      * serverName,
@@ -562,24 +992,23 @@ void myqttd_process_send_connection_to_child (MyQttdCtx    * ctx,
 					      MyQttMsg     * msg)
 {
 	MYQTT_SOCKET        client_socket;
-	char              * conn_status;
-
-	/* build connection status string */
-	conn_status = myqttd_process_connection_status_string (handle_reply, 
-							       serverName,
-							       conn->tls_on,
-							       /* notify if we have to fix the serverName */
-							       axl_cmp (serverName, myqtt_conn_get_server_name (conn)),
-							       /* get host, port and host ip */
-							       myqtt_conn_get_host (conn), myqtt_conn_get_port (conn), 
-							       myqtt_conn_get_host_ip (conn),
-							       /* if proxied, skip recover on child */
-							       myqttd_conn_mgr_proxy_on_parent (conn));
-	
-	msg ("Sending connection to child already created, ancillary data ('%s') size: %d", conn_status, (int) strlen (conn_status));
+	MyQttdHandoff     * handoff;
 
 	/* socket that is know handled by the child process */
 	client_socket = myqtt_conn_get_socket (conn);
+
+	/* build handoff record */
+	handoff = myqttd_process_handoff_new (client_socket, 'n', handle_reply, serverName, conn);
+	if (handoff == NULL) {
+		error ("PARENT: Unable to build handoff record for socket (%d) to child pid %d, closing connection",
+		       client_socket, child->pid);
+		myqtt_conn_shutdown (conn);
+		return;
+	} /* end if */
+	
+	msg ("Sending connection to child already created, handoff record size: %d", handoff->record_size);
+
+	/* socket is now owned by the handoff */
 	myqtt_conn_set_close_socket (conn, axl_false);
 
 	/* unwatch the connection from the parent to avoid receiving
@@ -588,22 +1017,13 @@ void myqttd_process_send_connection_to_child (MyQttdCtx    * ctx,
 	myqtt_reader_unwatch_connection (CONN_CTX (conn), conn, NULL, NULL);
 
 	/* send the socket descriptor to the child to avoid holding a
-	   bucket in the parent */
-	if (! myqttd_process_send_socket (client_socket, child, conn_status, strlen (conn_status))) {
+	   bucket in the parent (grouped with other connections being
+	   sent at the same time) */
+	if (! myqttd_process_queue_socket (child, handoff)) {
 		error ("PARENT: Something failed while sending socket (%d) to child pid %d already created, error (code %d): %s",
 		       client_socket, child->pid, errno, myqtt_errno_get_last_error ());
+	} /* end if */
 
-		/* release ancillary data */
-		axl_free (conn_status);
-
-		/* close connection */
-		myqtt_conn_shutdown (conn);
-		return;
-	}
-
-	/* release ancillary data */
-	axl_free (conn_status);
-	
 	/* terminate the connection */
 	myqtt_conn_shutdown (conn);
 
@@ -618,40 +1038,31 @@ axl_bool myqttd_process_send_proxy_connection_to_child (MyQttdCtx        * ctx,
 							const char       * serverName, 
 							MyQttMsg         * msg)
 {
-	char    * conn_status;
+	MyQttdHandoff     * handoff;
 
-	/* build connection status string */
-	conn_status = myqttd_process_connection_status_string (handle_reply, 
-							       serverName,
-							       conn->tls_on,
-							       /* notify if we have to fix the serverName */
-							       axl_cmp (serverName, myqtt_conn_get_server_name (conn)),
-							       /* host and port */
-							       myqtt_conn_get_host (conn), myqtt_conn_get_port (conn),
-							       myqtt_conn_get_host_ip (conn),
-							       /* if proxied, skip recover on child */
-							       myqttd_conn_mgr_proxy_on_parent (conn));
+	/* build handoff record */
+	handoff = myqttd_process_handoff_new (client_socket, 'n', handle_reply, serverName, conn);
+	if (handoff == NULL) {
+		error ("PARENT: (PROXY) Unable to build handoff record for socket (%d) to child pid %d, closing connection",
+		       client_socket, child->pid);
+		myqtt_conn_shutdown (conn);
+		myqtt_close_socket (client_socket);
+		return axl_false;
+	} /* end if */
 	
-	msg ("PARENT: (PROXY) Sending connection to child already created, ancillary data ('%s') size: %d", conn_status, (int) strlen (conn_status));
+	msg ("PARENT: (PROXY) Sending connection to child already created, handoff record size: %d", handoff->record_size);
 
 	/* send the socket descriptor to the child to avoid holding a
 	   bucket in the parent */
-	if (! myqttd_process_send_socket (client_socket, child, conn_status, strlen (conn_status))) {
+	if (! myqttd_process_queue_socket (child, handoff)) {
 		error ("PARENT: Something failed while sending socket (%d) to child pid %d already created, error (code %d): %s",
 		       client_socket, child->pid, errno, myqtt_errno_get_last_error ());
 
-		/* release ancillary data */
-		axl_free (conn_status);
-
-		/* close connection */
+		/* close connection (socket already closed) */
 		myqtt_conn_shutdown (conn);
-		myqtt_close_socket (client_socket);
 		return axl_false;
 	}
 
-	/* release ancillary data */
-	axl_free (conn_status);
-
 	/* report ok operation */
 	return axl_true;
 }
@@ -794,47 +1205,25 @@ void     myqttd_process_connection_recover_status (char            * conn_status
 	return;
 }
 
-MyQttConn * __myqttd_process_handle_connection_received (MyQttdCtx      * ctx, 
-							 MyQttdChild    * child,
-							 MYQTT_SOCKET     _socket, 
-							 char           * conn_status)
+/** 
+ * @internal Creates and registers on the child the connection
+ * described by the handoff received from the parent.
+ */
+MyQttConn * __myqttd_process_register_handoff (MyQttdCtx      * ctx, 
+					       MyQttdChild    * child,
+					       MyQttdHandoff  * handoff)
 {
-	axl_bool           handle_reply       = axl_false;
-	const char       * serverName         = NULL;
 	MyQttConn        * conn               = NULL;
-	int                has_tls            = 0;
 	MyQttMsg         * msg                = NULL;
-	int                fix_server_name    = 0;
-	const char       * remote_host        = NULL;
-	const char       * remote_port        = NULL;
-	const char       * remote_host_ip     = NULL;
-
-	/* check connection status after continue */
-	if (conn_status == NULL || strlen (conn_status) == 0) {
-		error ("CHILD: internal server error, received conn_status string NULL or empty, socket=%d, unable to initialize connection on child",
-		       _socket);
-		myqtt_close_socket (_socket);
-		return NULL;
-	} /* end if */
+	MYQTT_SOCKET       _socket            = handoff->socket;
 
-	/* call to recover data from string */
-	msg ("CHILD: processing conn_status received: [%s]", conn_status);
-	myqttd_process_connection_recover_status (conn_status, 
-						  &handle_reply,
-						  &serverName,
-						  &has_tls,
-						  &remote_host,
-						  &remote_port,
-						  &remote_host_ip,
-						  &fix_server_name);
-
-	msg ("CHILD: Received conn_status: handle_reply=%d, serverName=%s, has_tls=%d, fix_server_name=%d, remote_host=%s, remote_port=%s, remote_host_ip=%s",
-	     handle_reply,
-	     serverName ? serverName : "",
-	     has_tls, fix_server_name,
-	     remote_host ? remote_host : "", 
-	     remote_port ? remote_port : "",
-	     remote_host_ip ? remote_host_ip : "");
+	msg ("CHILD: Received handoff: handle_reply=%d, serverName=%s, has_tls=%d, fix_server_name=%d, remote_host=%s, remote_port=%s, remote_host_ip=%s",
+	     handoff->handle_reply,
+	     handoff->serverName ? handoff->serverName : "",
+	     handoff->has_tls, handoff->fix_server_name,
+	     handoff->remote_host ? handoff->remote_host : "", 
+	     handoff->remote_port ? handoff->remote_port : "",
+	     handoff->remote_host_ip ? handoff->remote_host_ip : "");
 
 	/* create a connection and register it on local myqtt
 	   reader */
@@ -845,36 +1234,36 @@ MyQttConn * __myqttd_process_handle_connection_received (MyQttdCtx      * ctx,
 	}
 
 	/* setup host and port manually */
-	if (remote_host && remote_port) {
+	if (handoff->remote_host && handoff->remote_port) {
 		/* call to setup host and port */
-		myqtt_conn_set_host_and_port (conn, remote_host, remote_port, remote_host_ip);
+		myqtt_conn_set_host_and_port (conn, handoff->remote_host, handoff->remote_port, handoff->remote_host_ip);
 	}
 
 	/* notify about the connection received and setup serverName
 	 * if required by the parent server */
 	msg ("CHILD: New connection id=%d (%s:%s) accepted on child pid=%d", 
 	     myqtt_conn_get_id (conn), myqtt_conn_get_host (conn), myqtt_conn_get_port (conn), getpid ());
-	if (fix_server_name && serverName) {
+	if (handoff->fix_server_name && handoff->serverName) {
 		msg ("CHILD: setting connection-id=%d serverName=%s as indicated by parent process", 
-		     myqtt_conn_get_id (conn), serverName);
+		     myqtt_conn_get_id (conn), handoff->serverName);
 		/* setup server name */
-		myqtt_conn_set_server_name (conn, serverName);
+		myqtt_conn_set_server_name (conn, handoff->serverName);
 	} /* end if */
 
 	/* set TLS status */
-	if (has_tls > 0) {
+	if (handoff->has_tls > 0) {
 		conn->tls_on = axl_true;
 		msg ("CHILD: flagging the connection to have tls enabled (for domain activation, fake TLS socket), conn-id=%d (%d)",
 		     myqtt_conn_get_id (conn), conn->tls_on);
 	} 
 
-	if (handle_reply) {
+	if (handoff->handle_reply) {
 		/* handle reply here */
 
 	}
 
 	/* call to register */
-	if (! __myqttd_process_common_new_connection (ctx, conn, handle_reply, serverName, msg)) {
+	if (! __myqttd_process_common_new_connection (ctx, conn, handoff->handle_reply, handoff->serverName, msg)) {
 		/* nullify conn on error */
 		conn = NULL;
 	}
@@ -884,9 +1273,211 @@ MyQttConn * __myqttd_process_handle_connection_received (MyQttdCtx      * ctx,
 	return conn;
 }
 
+MyQttConn * __myqttd_process_handle_connection_received (MyQttdCtx      * ctx, 
+							 MyQttdChild    * child,
+							 MYQTT_SOCKET     _socket, 
+							 char           * conn_status)
+{
+	MyQttdHandoff      handoff;
+	int                handle_reply       = axl_false;
+	int                has_tls            = 0;
+	int                fix_server_name    = 0;
+
+	/* check connection status after continue */
+	if (conn_status == NULL || strlen (conn_status) == 0) {
+		error ("CHILD: internal server error, received conn_status string NULL or empty, socket=%d, unable to initialize connection on child",
+		       _socket);
+		myqtt_close_socket (_socket);
+		return NULL;
+	} /* end if */
+
+	/* call to recover data from string */
+	memset (&handoff, 0, sizeof (MyQttdHandoff));
+	msg ("CHILD: processing conn_status received: [%s]", conn_status);
+	myqttd_process_connection_recover_status (conn_status, 
+						  &handle_reply,
+						  &handoff.serverName,
+						  &has_tls,
+						  &handoff.remote_host,
+						  &handoff.remote_port,
+						  &handoff.remote_host_ip,
+						  &fix_server_name);
+
+	handoff.socket          = _socket;
+	handoff.command         = 'n';
+	handoff.handle_reply    = handle_reply;
+	handoff.has_tls         = has_tls;
+	handoff.fix_server_name = fix_server_name;
+
+	return __myqttd_process_register_handoff (ctx, child, &handoff);
+}
+
+/** 
+ * @internal Sends the provided command to the process at the other
+ * side of the control connection of the child provided.
+ */
+axl_bool __myqttd_process_send_command_to (MyQttdChild * child, const char * command)
+{
+	MyQttdHandoff * handoff;
+#if ! defined(SHOW_FORMAT_BUGS)
+	MyQttdCtx     * ctx = child->ctx;
+#endif
+
+	/* commands are plain records, no descriptor is passed */
+	handoff = myqttd_process_handoff_new (-1, 'c', axl_false, command, NULL);
+	if (handoff == NULL) {
+		error ("Unable to send command '%s' to process, failed to build handoff record", command);
+		return axl_false;
+	} /* end if */
+
+	/* serialized with handoffs sent to this child */
+	return myqttd_process_queue_socket (child, handoff);
+}
+
+/** 
+ * @internal Collects childs to send a command skipping the origin
+ * child (a reference to it must not be released from its own loop
+ * thread).
+ */
+axl_bool __myqttd_process_command_childs_build (axlPointer _pid, axlPointer _child, axlPointer _origin, axlPointer _result)
+{
+	MyQttdChild * child = _child;
+
+	if (child != _origin && myqttd_child_ref (child))
+		axl_list_append (_result, child);
+
+	return axl_false; /* do not stop foreach process */
+}
+
+/** 
+ * @internal Sends the command to all childs but the one provided
+ * (the child that originated the command, if any).
+ */
+axl_bool __myqttd_process_send_command_to_childs (MyQttdCtx * ctx, MyQttdChild * origin, const char * command)
+{
+	axlList     * childs;
+	int           iterator;
+	axl_bool      result = axl_true;
+
+	childs = axl_list_new (axl_list_always_return_1, (axlDestroyFunc) myqttd_child_unref);
+	if (childs == NULL)
+		return axl_false;
+
+	MYQTTD_PROCESS_LOCK_CHILD ();
+	axl_hash_foreach2 (ctx->child_process, __myqttd_process_command_childs_build, origin, childs);
+	MYQTTD_PROCESS_UNLOCK_CHILD ();
+
+	for (iterator = 0; iterator < axl_list_length (childs); iterator++) {
+		if (! __myqttd_process_send_command_to (axl_list_get_nth (childs, iterator), command))
+			result = axl_false;
+	} /* end for */
+	axl_list_free (childs);
+
+	return result;
+}
+
+/** 
+ * @internal Runs the command received from another process, calling
+ * all on command handlers. In the parent process the command is also
+ * relayed to the rest of childs.
+ */
+void __myqttd_process_run_command (MyQttdCtx * ctx, MyQttdChild * origin, const char * command)
+{
+	MyQttdOnCommandData * data;
+	int                   iterator;
+
+	if (command == NULL || command[0] == 0)
+		return;
+
+	msg ("%s: received command '%s'", ctx->child ? "CHILD" : "PARENT", command);
+
+	iterator = 0;
+	while (iterator < axl_list_length (ctx->on_command_handlers)) {
+		data = axl_list_get_nth (ctx->on_command_handlers, iterator);
+		if (data != NULL && data->on_command != NULL)
+			data->on_command (ctx, command, data->user_data);
+		iterator++;
+	} /* end while */
+
+	/* relay command to the rest of childs */
+	if (ctx->child == NULL)
+		__myqttd_process_send_command_to_childs (ctx, origin, command);
+
+	return;
+}
+
+/** 
+ * @brief Allows to register a handler that is called each time a
+ * command sent by another myqttd process is received (see \ref
+ * myqttd_process_send_command).
+ *
+ * @param ctx The context where the handler is registered.
+ *
+ * @param on_command The handler to be called.
+ *
+ * @param user_data A user defined pointer that will be passed in to
+ * the handler.
+ */
+void              myqttd_process_add_on_command (MyQttdCtx       * ctx,
+						 MyQttdOnCommand   on_command,
+						 axlPointer        user_data)
+{
+	MyQttdOnCommandData * data;
+
+	if (ctx == NULL || on_command == NULL)
+		return;
+
+	data = axl_new (MyQttdOnCommandData, 1);
+	if (data == NULL)
+		return;
+	data->on_command = on_command;
+	data->user_data  = user_data;
+
+	/* add the handler */
+	myqtt_mutex_lock (&ctx->data_mutex);
+	axl_list_append (ctx->on_command_handlers, data);
+	myqtt_mutex_unlock (&ctx->data_mutex);
+
+	return;
+}
+
+/** 
+ * @brief Sends the provided command to the rest of myqttd processes
+ * running, using the control connection between the parent and each
+ * child. When called from a child, the command is sent to the parent
+ * which relays it to the rest of childs. When called from the parent,
+ * it is sent to all childs.
+ *
+ * The command is not notified to the calling process (it is
+ * expected to apply it locally). Handlers registered with \ref
+ * myqttd_process_add_on_command are called in each process
+ * receiving the command.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param command The command to be sent (a short string).
+ *
+ * @return axl_true if the command was sent to all processes,
+ * otherwise axl_false is returned.
+ */
+axl_bool          myqttd_process_send_command (MyQttdCtx  * ctx,
+					       const char * command)
+{
+	if (ctx == NULL || command == NULL || command[0] == 0)
+		return axl_false;
+
+	/* child: send to the parent */
+	if (ctx->child)
+		return __myqttd_process_send_command_to (ctx->child, command);
+
+	/* parent: send to all childs */
+	return __myqttd_process_send_command_to_childs (ctx, NULL, command);
+}
+
 /** 
  * @internal Function called each time a notification from the parent
- * is received on the child.
+ * is received on the child (or a command sent by a child is received
+ * on the parent).
  */
 axl_bool myqttd_process_parent_notify (MyQttdLoop * loop, 
 					   MyQttdCtx  * ctx,
@@ -894,50 +1485,74 @@ axl_bool myqttd_process_parent_notify (MyQttdLoop * loop,
 					   axlPointer       ptr, 
 					   axlPointer       ptr2)
 {
-	int                _socket         = -1;
-	MyQttdChild  * child          = (MyQttdChild *) ptr;
-	char             * ancillary_data = NULL;
+	MyQttdChild      * child          = (MyQttdChild *) ptr;
 	const char       * label          = ctx->child ? "CHILD" : "PARENT";
+	char               buffer[MYQTTD_HANDOFF_BUFFER_SIZE];
+	MyQttdHandoff      handoffs[MYQTTD_HANDOFF_MAX_FDS];
+	int                count          = 0;
+	int                iterator;
 	
 	msg ("%s: notification on control connection, read content", label);
 
-	/* receive socket */
-	if (! myqttd_process_receive_socket (&_socket, child, &ancillary_data, NULL)) {
+	/* receive sockets */
+	if (! myqttd_process_receive_sockets (child, buffer, handoffs, &count)) {
 		error ("%s: Failed to received socket..", label);
+		if (ctx->child == NULL) {
+			/* parent: release the reference held while
+			 * watching this child (see
+			 * __myqttd_process_watch_child_commands) */
+			MYQTTD_PROCESS_LOCK_CHILD ();
+			axl_list_remove_ptr (ctx->child_commands_watched, child);
+			MYQTTD_PROCESS_UNLOCK_CHILD ();
+		} /* end if */
 		return axl_false; /* close parent notification socket */
 	}
 
-	/* check content received */
-	if (ancillary_data == NULL || strlen (ancillary_data) == 0 || _socket <= 0) {
-		error ("%s: Ancillary data is null (%p) or empty or socket returned is not valid (%d)",
-		       label, ancillary_data, _socket);
-		goto release_content;
-	}
+	for (iterator = 0; iterator < count; iterator++) {
+		/* process commands received (they carry no socket) */
+		if (handoffs[iterator].command == 'c') {
+			__myqttd_process_run_command (ctx, child, handoffs[iterator].serverName);
+			continue;
+		} /* end if */
 
-	/* process commands received from the parent */
-	if (ancillary_data[0] == 's') {
-		/* close the connection received. This command signals
-		   that the socket notified is already owned by the
-		   current process (due to fork call) but the parent
-		   still send us this socket to avoid having a file
-		   descriptor used bucket. */
-		wrn ("%s: closing socket=%d because it is already owned by the child process (due to fork call)", label, _socket);
-	} else if (ancillary_data[0] == 'n') {
-		/* received notification if a new, unknown connection,
-		   register it */
-		msg ("%s: Received socket %d, and ancillary_data[0]='%c' (processing)", 
-		     label, _socket, ancillary_data[0]);
-		__myqttd_process_handle_connection_received (ctx, child, _socket, ancillary_data + 1);
-		_socket = -1; /* avoid socket be closed */
-	} else {
-		msg ("%s: Unknown command, socket received (%d), ancillary data: %s", 
-		     label, _socket, ancillary_data);
-	}
+		/* check content received */
+		if (handoffs[iterator].socket <= 0) {
+			error ("%s: socket returned is not valid (%d)", label, handoffs[iterator].socket);
+			continue;
+		} /* end if */
 
-	/* release data received */
- release_content:
-	axl_free (ancillary_data);
-	myqtt_close_socket (_socket);
+		/* a child only sends commands to the parent */
+		if (ctx->child == NULL) {
+			error ("%s: Unexpected command '%c' received from child pid=%d, closing socket received (%d)", 
+			       label, handoffs[iterator].command, child->pid, handoffs[iterator].socket);
+			myqtt_close_socket (handoffs[iterator].socket);
+			continue;
+		} /* end if */
+
+		/* process commands received from the parent */
+		if (handoffs[iterator].command == 's') {
+			/* close the connection received. This command
+			   signals that the socket notified is already
+			   owned by the current process (due to fork
+			   call) but the parent still send us this
+			   socket to avoid having a file descriptor
+			   used bucket. */
+			wrn ("%s: closing socket=%d because it is already owned by the child process (due to fork call)", 
+			     label, handoffs[iterator].socket);
+			myqtt_close_socket (handoffs[iterator].socket);
+		} else if (handoffs[iterator].command == 'n') {
+			/* received notification if a new, unknown
+			   connection, register it (socket is now owned
+			   by the connection) */
+			msg ("%s: Received socket %d, and command='%c' (processing)", 
+			     label, handoffs[iterator].socket, handoffs[iterator].command);
+			__myqttd_process_register_handoff (ctx, child, &handoffs[iterator]);
+		} else {
+			msg ("%s: Unknown command '%c', socket received (%d), closing", 
+			     label, handoffs[iterator].command, handoffs[iterator].socket);
+			myqtt_close_socket (handoffs[iterator].socket);
+		} /* end if */
+	} /* end for */
 
 	return axl_true; /* don't close descriptor */
 }
@@ -1388,10 +2003,12 @@ void myqttd_process_create_child (MyQttdCtx           * ctx,
 		 * Send the socket descriptor to the child to avoid
 		 * holding a bucket in the parent.
 		 */
-		if (! proxy_on_parent && ! myqttd_process_send_socket (client_socket, child, "s", 1)) {
+		if (! proxy_on_parent && ! __myqttd_process_send_close_socket (child, client_socket)) {
 			error ("PARENT: Unable to send socket associated to the connection that originated the child process");
 			MYQTTD_PROCESS_UNLOCK_CHILD ();
 
+			/* socket already closed */
+			myqtt_conn_set_close_socket (conn, axl_false);
 			myqtt_conn_shutdown (conn);
 			myqttd_child_unref (child);
 			return;
@@ -1413,6 +2030,10 @@ void myqttd_process_create_child (MyQttdCtx           * ctx,
 				      /* data and destroy func */
 				      child, (axlDestroyFunc) myqttd_child_unref);
 
+		/* watch commands sent by the child (see
+		 * myqttd_process_send_command) */
+		__myqttd_process_watch_child_commands (ctx, child);
+
 		/* update number of childs running this domain */
 		/* def->childs_running++; */
 
@@ -1428,6 +2049,11 @@ void myqttd_process_create_child (MyQttdCtx           * ctx,
 	/* reconfigure pids */
 	ctx->pid = getpid ();
 
+	/* log writer thread is not available in this process (only
+	 * the thread calling fork survives): write logs directly
+	 * until exec */
+	ctx->log_writer = NULL;
+
 	/* release connections received from parent (including
 	   sockets) */
 	msg ("CHILD: calling to release all (parent) connections but conn-id=%d", 
@@ -1752,6 +2378,13 @@ MyQttdChild * myqttd_process_child_by_id (MyQttdCtx * ctx, int pid)
  */
 void myqttd_process_cleanup      (MyQttdCtx * ctx)
 {
+	/* stop watching child commands (loop thread is finished
+	 * before releasing the childs it references) */
+	myqttd_loop_close (ctx->child_commands, axl_true);
+	ctx->child_commands = NULL;
+	axl_list_free (ctx->child_commands_watched);
+	ctx->child_commands_watched = NULL;
+
 	myqtt_mutex_destroy (&ctx->child_process_mutex);
 	axl_hash_free (ctx->child_process);
 	return;
@@ -43,6 +43,18 @@
 
 #include <myqttd.h>
 
+/** 
+ * @internal Max number of sockets that are passed from the parent to
+ * a child on a single sendmsg call (SCM_RIGHTS array).
+ */
+#define MYQTTD_HANDOFF_MAX_FDS     32
+
+/** 
+ * @internal Max size of a single handoff message (header plus all
+ * records).
+ */
+#define MYQTTD_HANDOFF_BUFFER_SIZE 16384
+
 void              myqttd_process_init         (MyQttdCtx * ctx, 
 					       axl_bool        reinit);
 
@@ -66,6 +78,13 @@ void              myqttd_process_check_for_finish (MyQttdCtx * ctx);
 
 void              myqttd_process_cleanup      (MyQttdCtx * ctx);
 
+void              myqttd_process_add_on_command (MyQttdCtx       * ctx,
+						 MyQttdOnCommand   on_command,
+						 axlPointer        user_data);
+
+axl_bool          myqttd_process_send_command (MyQttdCtx  * ctx,
+					       const char * command);
+
 /* internal API */
 axl_bool myqttd_process_parent_notify (MyQttdLoop    * loop, 
 				       MyQttdCtx     * ctx,
@@ -103,9 +122,24 @@ void             myqttd_process_connection_recover_status (char            * anc
 							   const char     ** remote_host_ip,
 							   int             * has_tls);
 
-axl_bool myqttd_process_send_socket (MYQTT_SOCKET     socket, 
-				     MyQttdChild    * child, 
-				     const char     * ancillary_data, 
-				     int              size);
+MyQttdHandoff  * myqttd_process_handoff_new  (MYQTT_SOCKET     socket,
+					       char             command,
+					       axl_bool         handle_reply,
+					       const char     * serverName,
+					       MyQttConn      * conn);
+
+void             myqttd_process_handoff_free (MyQttdHandoff  * handoff);
+
+axl_bool         myqttd_process_send_sockets (MyQttdChild    * child,
+					      MyQttdHandoff ** handoffs,
+					      int              count);
+
+axl_bool         myqttd_process_queue_socket (MyQttdChild    * child,
+					      MyQttdHandoff  * handoff);
+
+axl_bool         myqttd_process_receive_sockets (MyQttdChild    * child,
+						 char           * buffer,
+						 MyQttdHandoff  * handoffs,
+						 int            * count);
 
 #endif
@@ -45,6 +45,12 @@
 #include <myqtt-ctx-private.h>
 #include <myqtt-conn-private.h>
 
+/** 
+ * @internal Max pause (microseconds) applied at once to a connection
+ * that exceeds publish rate limits.
+ */
+#define MYQTTD_RATE_LIMIT_MAX_PAUSE 5000000
+
 void __myqttd_run_log_handler (MyQttCtx         * _ctx,
 			       const char       * file,
 			       int                line,
@@ -264,6 +270,67 @@ MyQttConn * __myqttd_run_start_mqtt_listener (MyQttdCtx * ctx, MyQttCtx * my_ctx
 }
 
 
+/** 
+ * @internal Removes the listener from the listeners started once it
+ * is closed.
+ */
+void __myqttd_run_listener_closed (MyQttConn * conn, axlPointer _ctx)
+{
+	MyQttdCtx  * ctx = _ctx;
+	const char * key = myqtt_conn_get_data (conn, "myqttd:listener");
+
+	if (ctx->is_exiting || ctx->listeners == NULL || key == NULL)
+		return;
+
+	if (myqtt_hash_lookup (ctx->listeners, (axlPointer) key) == conn)
+		myqtt_hash_remove (ctx->listeners, (axlPointer) key);
+	return;
+}
+
+/** 
+ * @internal Collects listeners started that are not declared in the
+ * configuration loaded.
+ */
+axl_bool __myqttd_run_listener_removed (axlPointer key, axlPointer data, axlPointer declared, axlPointer removed)
+{
+	if (! axl_hash_exists (declared, key))
+		axl_list_append (removed, axl_strdup (key));
+	return axl_false; /* do not stop */
+}
+
+/** 
+ * @internal Gets protocol and bind address declared by the provided
+ * <port> node and returns the key (proto:bind-addr:port) used to
+ * record the listener started. Protocol is part of the key so
+ * listeners with different protocols are not confused on reload.
+ */
+char * __myqttd_run_listener_key (axlNode * port, const char ** proto, const char ** bind_addr)
+{
+	int port_val;
+
+	/* get bind addr */
+	(*bind_addr) = ATTR_VALUE (port, "bind-addr");
+	/* check protocol that must be running in the declared port */
+	(*proto)     = ATTR_VALUE (port, "proto");
+	port_val     = myqtt_support_strtod (axl_node_get_content (port, NULL), NULL);
+
+	if ((*proto) == NULL) {
+		/* No 'proto' declaration, try to figure out which protocol we should run here. 
+		   For now, declare protocol as default */
+		(*proto) = "mqtt";
+		if (port_val == 1883)
+			(*proto) = "mqtt"; /* this is not needed, but for completeness */
+		else if (port_val == 8883)
+			(*proto) = "mqtt-tls";
+	} /* end if */
+
+	/* set default value */
+	if ((*bind_addr) == NULL)
+		(*bind_addr) = "0.0.0.0";
+
+	return axl_strdup_printf ("%s:%s:%s", (*proto), (*bind_addr), axl_node_get_content (port, NULL));
+}
+
 axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc)
 {
 	axl_bool           at_least_one_listener = axl_false;
@@ -272,7 +339,10 @@ axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc)
 	MyQttCtx         * myqtt_ctx = myqttd_ctx_get_myqtt_ctx (ctx);
 	const char       * proto;
 	const char       * bind_addr;
-	int                port_val;
+	char             * key;
+	axlHash          * declared;
+	axlList          * removed;
+	int                iterator;
 
 	/* refrence to the listener activator */
 	MyQttdListenerActivatorData * activator;
@@ -283,38 +353,56 @@ axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc)
 		return axl_true;
 
 	/* add default listener activator */
-	myqttd_ctx_add_listener_activator (ctx, "mqtt", __myqttd_run_start_mqtt_listener, NULL);
+	if (! ctx->started)
+		myqttd_ctx_add_listener_activator (ctx, "mqtt", __myqttd_run_start_mqtt_listener, NULL);
+
+	/* listeners started (proto:bind-addr:port => listener) so a
+	 * reload only starts/stops listeners that changed */
+	if (ctx->listeners == NULL)
+		ctx->listeners = myqtt_hash_new_full (axl_hash_string, axl_hash_equal_string, axl_free, NULL);
+	declared = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+
+	/* collect listeners declared */
+	port = axl_doc_get (doc, "/myqtt/global-settings/ports/port");
+	while (port != NULL) {
+		key = __myqttd_run_listener_key (port, &proto, &bind_addr);
+		axl_hash_insert_full (declared, key, axl_free, NULL, NULL);
+
+		/* get the next port */
+		port = axl_node_get_next_called (port, "port");
+	} /* end while */
+
+	/* stop listeners no longer declared (reload) before starting
+	 * new ones so a port can be moved to a different protocol */
+	removed = axl_list_new (axl_list_always_return_1, axl_free);
+	myqtt_hash_foreach2 (ctx->listeners, __myqttd_run_listener_removed, declared, removed);
+	for (iterator = 0; iterator < axl_list_length (removed); iterator++) {
+		key           = axl_list_get_nth (removed, iterator);
+		conn_listener = myqtt_hash_lookup (ctx->listeners, key);
+		msg ("stopping listener at %s (no longer declared)", key);
+		myqtt_hash_remove (ctx->listeners, key);
+		myqtt_conn_shutdown (conn_listener);
+	} /* end for */
+	axl_list_free (removed);
+	axl_hash_free (declared);
 
 	/* get ports to be allocated */
 	port = axl_doc_get (doc, "/myqtt/global-settings/ports/port");
 	while (port != NULL) {
 
-		/* get bind addr */
-		bind_addr = ATTR_VALUE (port, "bind-addr");
-		/* check protocol that must be running in the declared port */
-		proto     = ATTR_VALUE (port, "proto");
-		port_val  = myqtt_support_strtod (axl_node_get_content (port, NULL), NULL);
-
-		if (proto == NULL) {
-			/* No 'proto' declaration, try to figure out which protocol we should run here. 
-			   For now, declare protocol as default */
-			proto = "mqtt";
-			if (port_val == 1883)
-				proto = "mqtt"; /* this is not needed, but for completeness */
-			else if (port_val == 8883)
-				proto = "mqtt-tls";
+		/* check if the listener is already running */
+		key = __myqttd_run_listener_key (port, &proto, &bind_addr);
+		if (myqtt_hash_exists (ctx->listeners, key)) {
+			at_least_one_listener = axl_true;
+			goto next;
 		} /* end if */
-
-		/* set default value */
-		if (bind_addr == NULL)
-			bind_addr = "0.0.0.0";
 		
 		/* check if proto is defined in the list of
 		   listener activators */
 		activator = myqtt_hash_lookup (ctx->listener_activators, (axlPointer) proto);
 		if (activator == NULL) {
-			wrn ("No listener activator was found for proto %s, skipping starting listener at %s:%d",
-			     proto, bind_addr ? bind_addr : "", port_val);
+			wrn ("No listener activator was found for proto %s, skipping starting listener at %s:%s",
+			     proto, bind_addr, axl_node_get_content (port, NULL));
 			goto next;
 		} /* end if */
 
@@ -333,8 +421,13 @@ axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc)
 			goto next;
 		} /* end if */
 		
+		/* record listener started */
+		myqtt_hash_replace (ctx->listeners, axl_strdup (key), conn_listener);
+		myqtt_conn_set_data_full (conn_listener, "myqttd:listener", axl_strdup (key), NULL, axl_free);
+		myqtt_conn_set_on_close (conn_listener, axl_false, __myqttd_run_listener_closed, ctx);
+
 		msg ("started listener at %s:%s (id: %d, socket: %d, proto: %s)...",
-		     bind_addr ? bind_addr : "0.0.0.0",
+		     bind_addr,
 		     axl_node_get_content (port, NULL),
 		     myqtt_conn_get_id (conn_listener), myqtt_conn_get_socket (conn_listener), proto);
 		
@@ -342,6 +435,8 @@ axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc)
 		 * created */
 		at_least_one_listener = axl_true;
 	next:
+		axl_free (key);
+
 		/* get the next port */
 		port = axl_node_get_next_called (port, "port");
 		
@@ -389,6 +484,30 @@ void myqtt_run_load_domain (MyQttdCtx * ctx, axlDoc * doc, axlNode * node)
 	return;
 }
 
+/** 
+ * @internal Disables domains that are not declared in the provided
+ * configuration.
+ */
+axl_bool __myqttd_run_domain_removed (axlPointer _name, axlPointer _domain, axlPointer _ctx, axlPointer _doc)
+{
+	MyQttdCtx    * ctx    = _ctx;
+	MyQttdDomain * domain = _domain;
+	axlNode      * node   = axl_doc_get (_doc, "/myqtt/myqtt-domains/domain");
+
+	while (node) {
+		if (HAS_ATTR_VALUE (node, "name", domain->name))
+			return axl_false; /* still declared */
+		node = axl_node_get_next_called (node, "domain");
+	} /* end while */
+
+	if (domain->is_active) {
+		msg ("Domain %s is no longer declared, disabling it", domain->name);
+		domain->is_active = axl_false;
+	} /* end if */
+
+	return axl_false; /* do not stop */
+}
+
 axl_bool myqttd_run_domains_load (MyQttdCtx * ctx, axlDoc * doc)
 {
 	axlNode * node;
@@ -407,6 +526,11 @@ axl_bool myqttd_run_domains_load (MyQttdCtx * ctx, axlDoc * doc)
 		/* next next domain node */
 		node = axl_node_get_next_called (node, "domain");
 	} /* end if while */
+
+	/* on reload, disable domains no longer declared (they are
+	 * kept so connections already accepted keep working) */
+	if (ctx->started)
+		myqtt_hash_foreach2 (ctx->domains, __myqttd_run_domain_removed, ctx, doc);
 	
 	/* reached this point, everything was ok */
 	return axl_true;
@@ -428,6 +552,13 @@ MyQttPublishCodes __myqttd_run_on_publish_msg (MyQttCtx * myqtt_ctx, MyQttConn *
 	if (ctx->is_exiting)
 		return MYQTT_PUBLISH_OK; /* skip notification */
 
+	/* only myqttd is allowed to publish on $SYS topics */
+	if (__myqttd_domain_is_sys_topic (ctx, myqtt_msg_get_topic (msg))) {
+		wrn ("%s : DISCARD id %d (%s:%s) -> [%s] : publishing on $SYS topics is not allowed", domain->name,
+		     myqtt_msg_get_id (msg), myqtt_conn_get_host (conn), myqtt_conn_get_port (conn), myqtt_msg_get_topic (msg));
+		return MYQTT_PUBLISH_DISCARD;
+	} /* end if */
+
 	while (iterator < axl_list_length (ctx->on_publish_handlers)) {
 		/* next data */
 		data = axl_list_get_nth (ctx->on_publish_handlers, iterator);
@@ -451,6 +582,9 @@ MyQttPublishCodes __myqttd_run_on_publish_msg (MyQttCtx * myqtt_ctx, MyQttConn *
 		iterator++;
 	} /* end while */
 
+	/* account message accepted */
+	__myqttd_domain_stats_update (domain, 0, 1);
+
 	msg ("PUB id %d (%s:%s) -> [%s] (qos %d, size %d, total %d, domain: %s) : ok", myqtt_msg_get_id (msg), 
 	     myqtt_conn_get_host (conn), myqtt_conn_get_port (conn), myqtt_msg_get_topic (msg),
 	     myqtt_msg_get_qos (msg), myqtt_msg_get_app_msg_size (msg), myqtt_msg_get_payload_size (msg), domain->name);
@@ -532,6 +666,120 @@ axl_bool __myqttd_run_on_unsubscribe_msg (MyQttCtx * myqtt_ctx, MyQttConn * conn
 	return axl_true; /* always accept unsuback */
 }
 
+/** 
+ * @internal Takes amount tokens from the provided bucket (refilled at
+ * rate tokens per second up to burst). The bucket is allowed to get
+ * into debt so the caller is not rejected.
+ *
+ * @return Microseconds to wait until the bucket is in positive again
+ * (0 if there is no need to wait).
+ */
+long __myqttd_run_token_bucket_take (MyQttdTokenBucket * bucket, int rate, int burst, int amount)
+{
+	struct timeval now;
+	struct timeval diff;
+
+	if (rate <= 0)
+		return 0;
+	if (burst <= 0)
+		burst = rate;
+
+	gettimeofday (&now, NULL);
+	if (bucket->stamp.tv_sec == 0) {
+		/* first use: bucket full */
+		bucket->tokens = burst;
+	} else {
+		/* refill according to the time elapsed */
+		myqtt_timeval_substract (&now, &bucket->stamp, &diff);
+		bucket->tokens += ((double) diff.tv_sec + ((double) diff.tv_usec / 1000000)) * rate;
+		if (bucket->tokens > burst)
+			bucket->tokens = burst;
+	} /* end if */
+	bucket->stamp   = now;
+	bucket->tokens -= amount;
+
+	if (bucket->tokens >= 0)
+		return 0;
+	return (long) ((- bucket->tokens) * 1000000 / rate);
+}
+
+/** 
+ * @internal Event used to resume reading from a connection throttled
+ * by publish rate limits.
+ */
+axl_bool __myqttd_run_resume_conn (MyQttCtx * myqtt_ctx, axlPointer _conn, axlPointer user_data)
+{
+	MyQttConn * conn = _conn;
+
+	/* unblock and restart reader to watch the connection again */
+	myqtt_conn_block (conn, axl_false);
+	myqtt_conn_unref (conn, "rate-limit");
+
+	return axl_true; /* remove event */
+}
+
+/** 
+ * @internal Applies per client and per domain publish rate limits.
+ * When they are exceeded, reading from the connection is paused
+ * (rather than closing it) until enough tokens are available.
+ */
+void __myqttd_run_check_rate_limits (MyQttdDomain * domain, MyQttConn * conn, MyQttMsg * msg)
+{
+	MyQttdCtx           * ctx      = domain->ctx;
+	MyQttdDomainSetting * settings = domain->settings;
+	MyQttdConnRateLimit * limit;
+	long                  wait     = 0;
+	long                  value;
+	int                   size     = myqtt_msg_get_payload_size (msg);
+
+	/* per client limits: only accessed from the reader */
+	if (settings->client_msg_rate > 0 || settings->client_byte_rate > 0) {
+		limit = myqtt_conn_get_data (conn, "myqttd:rl");
+		if (limit == NULL) {
+			limit = axl_new (MyQttdConnRateLimit, 1);
+			if (limit == NULL)
+				return;
+			myqtt_conn_set_data_full (conn, "myqttd:rl", limit, NULL, axl_free);
+		} /* end if */
+		wait  = __myqttd_run_token_bucket_take (&limit->msgs, settings->client_msg_rate, settings->client_msg_burst, 1);
+		value = __myqttd_run_token_bucket_take (&limit->bytes, settings->client_byte_rate, settings->client_byte_burst, size);
+		if (value > wait)
+			wait = value;
+	} /* end if */
+
+	/* per domain limits */
+	if (settings->domain_msg_rate > 0 || settings->domain_byte_rate > 0) {
+		myqtt_mutex_lock (&domain->stats_mutex);
+		value = __myqttd_run_token_bucket_take (&domain->msg_bucket, settings->domain_msg_rate, settings->domain_msg_burst, 1);
+		if (value > wait)
+			wait = value;
+		value = __myqttd_run_token_bucket_take (&domain->byte_bucket, settings->domain_byte_rate, settings->domain_byte_burst, size);
+		if (value > wait)
+			wait = value;
+		myqtt_mutex_unlock (&domain->stats_mutex);
+	} /* end if */
+
+	if (wait == 0 || myqtt_conn_is_blocked (conn))
+		return;
+
+	/* do not pause for too long at once */
+	if (wait > MYQTTD_RATE_LIMIT_MAX_PAUSE)
+		wait = MYQTTD_RATE_LIMIT_MAX_PAUSE;
+
+	wrn ("%s : rate limit reached for client-id=%s conn-id=%d ip=%s, pausing reads for %ld ms",
+	     domain->name, myqttd_ensure_str (myqtt_conn_get_client_id (conn)), conn->id, myqtt_conn_get_host (conn), wait / 1000);
+
+	/* block reads: flag is set directly because we are inside the
+	 * reader (myqtt_conn_block would wait for the reader to
+	 * restart), the event unblocks it through myqtt_conn_block */
+	if (! myqtt_conn_ref (conn, "rate-limit"))
+		return;
+	conn->is_blocked = axl_true;
+	myqtt_thread_pool_new_event (domain->myqtt_ctx, wait, __myqttd_run_resume_conn, conn, NULL);
+
+	return;
+}
+
 axl_bool __myqttd_run_on_header_msg (MyQttCtx * myqtt_ctx, MyQttConn * conn, MyQttMsg * msg, axlPointer _domain)
 {
 	MyQttdDomain        * domain   = _domain;
@@ -545,6 +793,10 @@ axl_bool __myqttd_run_on_header_msg (MyQttCtx * myqtt_ctx, MyQttConn * conn, MyQ
 				return axl_false; /* avoid message reception and close connection */
 			} /* end if */
 		} /* end if */
+
+		/* check publish rate limits */
+		if (domain->settings && myqtt_msg_get_type (msg) == MYQTT_PUBLISH) 
+			__myqttd_run_check_rate_limits (domain, conn, msg);
 	} /* end if */
 
 	return axl_true; /* report message accepted */
@@ -662,6 +914,9 @@ void __myqttd_init_domain_context (MyQttdCtx * ctx, MyQttdDomain * domain)
 		myqtt_color_log_enable (domain->myqtt_ctx, myqtt_color_log_is_enabled (ctx->myqtt_ctx));
 	}
 
+	/* collect metrics as it is done in parent */
+	myqtt_metrics_enable (domain->myqtt_ctx, myqtt_metrics_is_enabled (ctx->myqtt_ctx));
+
 	/* configure storage path */
 	msg ("Setting storage path=%s for domain=%s", domain->storage_path, domain->name);
 	if (! myqtt_storage_set_path (domain->myqtt_ctx, domain->storage_path, 4096)) {
@@ -871,13 +1126,19 @@ void __myqttd_run_on_connection_close (MyQttConn * conn, axlPointer _data)
 	     
 	     /* report domain selected and connections handled at this point */
 	     domain->name,
-	     myqttd_domain_conn_count (domain));
+	     myqttd_domain_conn_count (domain) - 1);
+
+	/* release connection slot and session accounted */
+	__myqttd_domain_conn_release (domain, ! conn->clean_session);
 
 	/* remove here connection from client_ids */
 	myqtt_mutex_lock (&domain->myqtt_ctx->client_ids_m);
 	axl_hash_remove (domain->myqtt_ctx->client_ids, (axlPointer) myqtt_conn_get_client_id (conn));
 	myqtt_mutex_unlock (&domain->myqtt_ctx->client_ids_m);
 
+	/* release objects retired while this connection was running */
+	__myqttd_ctx_retire_unref (ctx, PTR_TO_INT (myqtt_conn_get_data (conn, "myqttd:epoch")));
+
 	return;
 }
 
@@ -892,6 +1153,7 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 {
 
 	int         connections;
+	int         conn_limit;
 	MyQttConn * conn2;
 	int         retry;
 	int         conn_status;
@@ -926,23 +1188,11 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 
 	/*** PHASE 1: check connections to the domain ***/
 	/* msg ("Checking domain=%s initialized=%d, use-settings=%s", domain->name, domain->initialized, domain->use_settings ? domain->use_settings : "");*/
+	conn_limit = 0;
 	if (domain->initialized && domain->use_settings) {
 		if (domain->settings) {
-			/* get current connections (plus 1, as we are simulating handling it) */
-			connections = myqttd_domain_conn_count_all (domain) + 1;
-			
-			/* msg ("Connections: %d/%d (%s -- %p)", connections, domain->settings->conn_limit,
-			   domain->use_settings, domain->settings);  */
-
 			/* checking limits, but only when they are bigger than -1 and 0 */
-			if (domain->settings->conn_limit > 0 && connections > domain->settings->conn_limit) {
-				error ("Login failed for username=%s client-id=%s server-name=%s ip=%s : Connection rejected for username=%s client-id=%s server-name=%s domain=%s settings=%s : connection limit reached %d/%d",
-				       username ? username : "", client_id ? client_id : "", server_Name ? server_Name : "", myqtt_conn_get_host (conn),
-				       myqttd_ensure_str (username), myqttd_ensure_str (client_id), myqttd_ensure_str (server_Name), domain->name, 
-				       domain->use_settings, connections, domain->settings->conn_limit);
-
-				return MYQTT_CONNACK_REFUSED;
-			} /* end if */
+			conn_limit = domain->settings->conn_limit;
 		} else {
 			/* report failure in configuration */
 			wrn ("Found domain %s with settings configured %s but it wasn't found (did you miss to define it or to point to it properly)",
@@ -950,6 +1200,19 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 		} /* end if */
 	} /* end if */
 
+	/* check and account the connection at once (so concurrent
+	 * CONNECT requests cannot go beyond the limit): the slot is
+	 * released by __myqttd_run_on_connection_close or below if
+	 * the connection is not finally accepted */
+	if (! __myqttd_domain_conn_reserve (domain, conn_limit, &connections)) {
+		error ("Login failed for username=%s client-id=%s server-name=%s ip=%s : Connection rejected for username=%s client-id=%s server-name=%s domain=%s settings=%s : connection limit reached %d/%d",
+		       username ? username : "", client_id ? client_id : "", server_Name ? server_Name : "", myqtt_conn_get_host (conn),
+		       myqttd_ensure_str (username), myqttd_ensure_str (client_id), myqttd_ensure_str (server_Name), domain->name, 
+		       domain->use_settings, connections, conn_limit);
+
+		return MYQTT_CONNACK_REFUSED;
+	} /* end if */
+
 	/*** PHASE 3: update client id hashes ***/
 	/* register client identifier */
 	myqtt_mutex_lock (&domain->myqtt_ctx->client_ids_m);
@@ -1003,6 +1266,9 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 			/* release lock for now, and wait a bit, to reacquire it again */
 			myqtt_mutex_unlock (&domain->myqtt_ctx->client_ids_m);
 
+			/* release connection slot */
+			__myqttd_domain_conn_release (domain, axl_false);
+
 			return MYQTT_CONNACK_IDENTIFIER_REJECTED;
 		} /* end if */
 
@@ -1024,6 +1290,7 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 		myqtt_mutex_unlock (&domain->myqtt_ctx->client_ids_m);
 
 	        error ("ERROR: failed to allocate copy for incoming connection, rejecting connection");
+		__myqttd_domain_conn_release (domain, axl_false);
 		return MYQTT_CONNACK_SERVER_UNAVAILABLE;
 	} /* end if */
 
@@ -1041,6 +1308,7 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 			       username ? username : "", client_id ? client_id : "", server_Name ? server_Name : "", myqtt_conn_get_host (conn),
 			       conn2->client_identifier);
 
+			__myqttd_domain_conn_release (domain, axl_false);
 			return MYQTT_CONNACK_SERVER_UNAVAILABLE;
 		} /* end if */
 	} /* end if */
@@ -1050,6 +1318,14 @@ MyQttConnAckTypes    myqttd_run_send_connection_to_domain (MyQttdCtx      * ctx,
 	axl_hash_remove (myqtt_ctx->client_ids, conn2->client_identifier);
 	myqtt_mutex_unlock (&myqtt_ctx->client_ids_m);
 
+	/* account session (released by the connection close handler) */
+	if (! conn2->clean_session)
+		__myqttd_domain_stats_update (domain, 1, 0);
+
+	/* account the connection so objects retired by a reload are
+	 * kept until it is closed (released by the close handler) */
+	myqtt_conn_set_data (conn2, "myqttd:epoch", INT_TO_PTR (__myqttd_ctx_retire_ref (ctx)));
+
 	/* setup a connection close handler to have notifications to
 	 * the log and possible other modules */
 	myqtt_conn_set_on_close (conn2, axl_true, __myqttd_run_on_connection_close, domain);
@@ -1100,8 +1376,21 @@ MyQttConnAckTypes  myqttd_run_handle_on_connect (MyQttCtx * myqtt_ctx, MyQttConn
 	MyQttConnAckTypes    codes;
 	char         * conn_host;
 
+	/* auth time */
+	long long      stamp = -1;
+
+	/* retire epoch (auth may read objects replaced by a reload) */
+	int            epoch;
+
+	epoch = __myqttd_ctx_retire_ref (ctx);
+
+	if (myqtt_metrics_is_enabled (myqtt_ctx))
+		stamp = myqtt_metrics_now ();
+
 	/* find the domain that can handle this connection and do the AUTH operation at once */
 	domain = myqttd_domain_find_by_indications (ctx, conn, username, client_id, password, server_Name);
+	if (stamp >= 0)
+		stamp = myqtt_metrics_now () - stamp;
 	if (domain == NULL) {
 		/* define error label according to the values provided */
 		error_label = "no domain was found to handle request";
@@ -1128,7 +1417,8 @@ MyQttConnAckTypes  myqttd_run_handle_on_connect (MyQttCtx * myqtt_ctx, MyQttConn
 		/* call to pause if we have to wait */
 		if (pause_value > 0)
 			myqttd_sleep (ctx, pause_value * 1000000);
-		
+
+		__myqttd_ctx_retire_unref (ctx, epoch);
 		return MYQTT_CONNACK_IDENTIFIER_REJECTED;
 	} /* end if */
 
@@ -1154,9 +1444,15 @@ MyQttConnAckTypes  myqttd_run_handle_on_connect (MyQttCtx * myqtt_ctx, MyQttConn
 		 * myqttd_run_send_connection_to_domain */
 		
 		axl_free (conn_host);
+		__myqttd_ctx_retire_unref (ctx, epoch);
 		return codes;
 	} /* end if */
 
+	/* account auth time into the domain selected (the same time
+	 * is also accounted into myqtt_ctx by the engine) */
+	if (stamp >= 0)
+		myqtt_metrics_record (domain->myqtt_ctx, MYQTT_METRIC_AUTH, stamp);
+
 	/* reached this point, the connecting user is enabled and authenticated */
 	msg ("CONNECT accepted for username=%s client-id=%s server-name=%s conn-id=%d clean-session=%d will=%d ip=%s : domain=%s, connections=%d",
 	     myqttd_ensure_str (username), 
@@ -1175,6 +1471,7 @@ MyQttConnAckTypes  myqttd_run_handle_on_connect (MyQttCtx * myqtt_ctx, MyQttConn
 
 	/* release reference */
 	axl_free (conn_host);
+	__myqttd_ctx_retire_unref (ctx, epoch);
 	
 	/* report connection accepted */
 	return codes;
@@ -1211,41 +1508,161 @@ void __myqttd_run_get_value_by_node (MyQttdCtx * ctx, axlNode * node, const char
 	return;
 }
 
+/** 
+ * @internal Installs the provided settings (default settings if name
+ * is NULL) in the case they are different from the settings currently
+ * running. Settings in use are never modified: the new object is
+ * swapped in and the old one is retired (it may be still read by
+ * other threads) so settings can be read without locking.
+ */
+void __myqttd_run_setting_swap (MyQttdCtx * ctx, const char * name, MyQttdDomainSetting * setting)
+{
+	MyQttdDomainSetting * old;
+
+	/* get current settings */
+	if (name)
+		old = myqtt_hash_lookup (ctx->domain_settings, (axlPointer) name);
+	else
+		old = ctx->default_setting;
+
+	if (old && memcmp (old, setting, sizeof (MyQttdDomainSetting)) == 0) {
+		/* nothing changed */
+		axl_free (setting);
+		return;
+	} /* end if */
+
+	/* install new settings */
+	if (name)
+		myqtt_hash_replace_full (ctx->domain_settings, axl_strdup (name), axl_free, setting, NULL);
+	else
+		ctx->default_setting = setting;
+
+	if (old) {
+		msg ("domain-setting %s updated", name ? name : "global-settings");
+		__myqttd_ctx_retire (ctx, old, axl_free);
+	} /* end if */
+
+	return;
+}
+
+/** 
+ * @internal Collects names of settings installed that are no longer
+ * declared at the provided configuration.
+ */
+axl_bool __myqttd_run_setting_find_removed (axlPointer key, axlPointer data, axlPointer _doc, axlPointer _removed)
+{
+	axlDoc   * doc     = _doc;
+	axlList  * removed = _removed;
+	axlNode  * node;
+
+	node = axl_doc_get (doc, "/myqtt/domain-settings/domain-setting");
+	while (node != NULL) {
+		if (axl_cmp (ATTR_VALUE (node, "name"), key))
+			return axl_false; /* still declared, keep iterating */
+		node = axl_node_get_next_called (node, "domain-setting");
+	} /* end while */
+
+	axl_list_append (removed, axl_strdup (key));
+	return axl_false; /* keep iterating */
+}
+
+/** 
+ * @internal Drops references to removed settings from domains.
+ */
+axl_bool __myqttd_run_setting_unref_domains (axlPointer key, axlPointer data, axlPointer setting)
+{
+	MyQttdDomain * domain = data;
+
+	if (domain->settings == setting)
+		domain->settings = NULL;
+	return axl_false; /* keep iterating */
+}
+
+/** 
+ * @internal Removes settings that are no longer declared. They are
+ * retired like replaced settings (see __myqttd_run_setting_swap)
+ * because they may still be read by other threads.
+ */
+void __myqttd_run_setting_remove_missing (MyQttdCtx * ctx, axlDoc * doc)
+{
+	axlList             * removed;
+	const char          * name;
+	MyQttdDomainSetting * old;
+	int                   iterator;
+
+	removed = axl_list_new (axl_list_always_return_1, axl_free);
+	if (removed == NULL)
+		return;
+
+	/* collect first: the hash can't be modified while iterating */
+	myqtt_hash_foreach2 (ctx->domain_settings, __myqttd_run_setting_find_removed, doc, removed);
+
+	iterator = 0;
+	while (iterator < axl_list_length (removed)) {
+		name = axl_list_get_nth (removed, iterator);
+		old  = myqtt_hash_lookup (ctx->domain_settings, (axlPointer) name);
+		myqtt_hash_remove (ctx->domain_settings, (axlPointer) name);
+
+		/* domains still pointing to it run without settings */
+		if (ctx->domains)
+			myqtt_hash_foreach (ctx->domains, __myqttd_run_setting_unref_domains, old);
+
+		msg ("domain-setting %s removed", name);
+		__myqttd_ctx_retire (ctx, old, axl_free);
+		iterator++;
+	} /* end while */
+	axl_list_free (removed);
+
+	return;
+}
+
 axl_bool myqttd_run_domain_settings_load (MyQttdCtx * ctx, axlDoc * doc)
 {
 	axlNode             * node;
 	MyQttdDomainSetting * setting;
+	MyQttdDomainSetting * defaults;
 	const char          * name;
 
-	/* default settings */
-	if (! ctx->default_setting)
-		ctx->default_setting = axl_new (MyQttdDomainSetting, 1);
+	/* settings are loaded into new objects that are swapped in
+	 * (see __myqttd_run_setting_swap) */
+	defaults = axl_new (MyQttdDomainSetting, 1);
+	if (defaults == NULL)
+		return axl_false;
 	if (! ctx->domain_settings)
 		ctx->domain_settings = myqtt_hash_new (axl_hash_string, axl_hash_equal_string);
 
 	/* require auth */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/require-auth", "boolean", &(ctx->default_setting->require_auth), axl_true);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/require-auth", "boolean", &(defaults->require_auth), axl_true);
 	/* restrict-ids */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/restrict-ids", "boolean", &(ctx->default_setting->restrict_ids), axl_false);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/restrict-ids", "boolean", &(defaults->restrict_ids), axl_false);
 
 	/* drop-conn-same-client-id */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/drop-conn-same-client-id", "boolean", &(ctx->default_setting->drop_conn_same_client_id), axl_false);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/drop-conn-same-client-id", "boolean", &(defaults->drop_conn_same_client_id), axl_false);
 
 	/* disable-wildcard-support */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/disable-wildcard-support", "boolean", &(ctx->default_setting->disable_wildcard_support), axl_false);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/disable-wildcard-support", "boolean", &(defaults->disable_wildcard_support), axl_false);
 
 	/* conn-limit */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/conn-limit", "int", &(ctx->default_setting->conn_limit), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/conn-limit", "int", &(defaults->conn_limit), -1);
 	/* message-size-limit */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/message-size-limit", "int", &(ctx->default_setting->message_size_limit), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/message-size-limit", "int", &(defaults->message_size_limit), -1);
 	/* storage-messages-limit */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/storage-messages-limit", "int", &(ctx->default_setting->storage_messages_limit), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/storage-messages-limit", "int", &(defaults->storage_messages_limit), -1);
 	/* storage-quota-limit */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/storage-quota-limit", "int", &(ctx->default_setting->storage_quota_limit), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/storage-quota-limit", "int", &(defaults->storage_quota_limit), -1);
 	/* month-message-quota */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/month-message-quota", "int", &(ctx->default_setting->month_message_quota), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/month-message-quota", "int", &(defaults->month_message_quota), -1);
 	/* day-message-quota */
-	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/day-message-quota", "int", &(ctx->default_setting->day_message_quota), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/day-message-quota", "int", &(defaults->day_message_quota), -1);
+	/* publish rate limits: msgs/s and bytes/s (with burst) per client and per domain */
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/client-msg-rate", "int", &(defaults->client_msg_rate), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/client-msg-burst", "int", &(defaults->client_msg_burst), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/client-byte-rate", "int", &(defaults->client_byte_rate), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/client-byte-burst", "int", &(defaults->client_byte_burst), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/domain-msg-rate", "int", &(defaults->domain_msg_rate), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/domain-msg-burst", "int", &(defaults->domain_msg_burst), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/domain-byte-rate", "int", &(defaults->domain_byte_rate), -1);
+	__myqttd_run_get_value (ctx, doc, "/myqtt/domain-settings/global-settings/domain-byte-burst", "int", &(defaults->domain_byte_burst), -1);
 
 	/* get first definition */
 	node = axl_doc_get (doc, "/myqtt/domain-settings/domain-setting");
@@ -1259,58 +1676,77 @@ axl_bool myqttd_run_domain_settings_load (MyQttdCtx * ctx, axlDoc * doc)
 			continue;
 		} /* end if */
 
-		/* get name and store this setting */
-		setting = (MyQttdDomainSetting *) myqtt_hash_lookup (ctx->domain_settings, (axlPointer) name);
-
 		/* create setting storage */
-		if (setting == NULL) {
-			/* create node */
-			setting = axl_new (MyQttdDomainSetting, 1);
-			if (setting == NULL)
-				break;
-
-			/* save setting into hash */
-			myqtt_hash_replace_full (ctx->domain_settings, (axlPointer) name, NULL, setting, axl_free);
-		} /* end if */
+		setting = axl_new (MyQttdDomainSetting, 1);
+		if (setting == NULL)
+			break;
 
 		/* require auth */
 		__myqttd_run_get_value_by_node (ctx, node, "require-auth", "boolean", &(setting->require_auth),
-						ctx->default_setting->require_auth);
+						defaults->require_auth);
 		/* restrict-ids */
 		__myqttd_run_get_value_by_node (ctx, node, "restrict-ids", "boolean", &(setting->restrict_ids),
-						ctx->default_setting->restrict_ids);
+						defaults->restrict_ids);
 		/* drop-conn-same-client-id */
 		__myqttd_run_get_value_by_node (ctx, node, "drop-conn-same-client-id", "boolean", &(setting->drop_conn_same_client_id),
-						ctx->default_setting->drop_conn_same_client_id);
+						defaults->drop_conn_same_client_id);
 		/* disable-wildcard-support */
 		__myqttd_run_get_value_by_node (ctx, node, "disable-wildcard-support", "boolean", &(setting->disable_wildcard_support),
-						ctx->default_setting->disable_wildcard_support);
+						defaults->disable_wildcard_support);
 		/* conn-limit */
 		__myqttd_run_get_value_by_node (ctx, node, "conn-limit", "int", &(setting->conn_limit),
-						ctx->default_setting->conn_limit);
+						defaults->conn_limit);
 		/* message-size-limit */
 		__myqttd_run_get_value_by_node (ctx, node, "message-size-limit", "int", &(setting->message_size_limit),
-						ctx->default_setting->message_size_limit);
+						defaults->message_size_limit);
 		/* storage-messages-limit */
 		__myqttd_run_get_value_by_node (ctx, node, "storage-messages-limit", "int", &(setting->storage_messages_limit),
-						ctx->default_setting->storage_messages_limit);
+						defaults->storage_messages_limit);
 		
 		/* storage-quota-limit (meastured in KB: all values configured will be multiplied by 1024) */
 		__myqttd_run_get_value_by_node (ctx, node, "storage-quota-limit", "int", &(setting->storage_quota_limit),
-						ctx->default_setting->storage_quota_limit);
+						defaults->storage_quota_limit);
 
 		/* month-message-quota : number of messages allowed per month */
 		__myqttd_run_get_value_by_node (ctx, node, "month-message-quota", "int", &(setting->month_message_quota),
-						ctx->default_setting->month_message_quota);
+						defaults->month_message_quota);
 		
 		/* day-message-quota : number of messages allowed per month */
 		__myqttd_run_get_value_by_node (ctx, node, "day-message-quota", "int", &(setting->day_message_quota),
-						ctx->default_setting->day_message_quota);
+						defaults->day_message_quota);
+
+		/* publish rate limits: msgs/s and bytes/s (with burst)
+		 * per client and for the whole domain */
+		__myqttd_run_get_value_by_node (ctx, node, "client-msg-rate", "int", &(setting->client_msg_rate),
+						defaults->client_msg_rate);
+		__myqttd_run_get_value_by_node (ctx, node, "client-msg-burst", "int", &(setting->client_msg_burst),
+						defaults->client_msg_burst);
+		__myqttd_run_get_value_by_node (ctx, node, "client-byte-rate", "int", &(setting->client_byte_rate),
+						defaults->client_byte_rate);
+		__myqttd_run_get_value_by_node (ctx, node, "client-byte-burst", "int", &(setting->client_byte_burst),
+						defaults->client_byte_burst);
+		__myqttd_run_get_value_by_node (ctx, node, "domain-msg-rate", "int", &(setting->domain_msg_rate),
+						defaults->domain_msg_rate);
+		__myqttd_run_get_value_by_node (ctx, node, "domain-msg-burst", "int", &(setting->domain_msg_burst),
+						defaults->domain_msg_burst);
+		__myqttd_run_get_value_by_node (ctx, node, "domain-byte-rate", "int", &(setting->domain_byte_rate),
+						defaults->domain_byte_rate);
+		__myqttd_run_get_value_by_node (ctx, node, "domain-byte-burst", "int", &(setting->domain_byte_burst),
+						defaults->domain_byte_burst);
+
+		/* install setting (only if it changed) */
+		__myqttd_run_setting_swap (ctx, name, setting);
 
 		/* get next module */
 		node = axl_node_get_next_called (node, "domain-setting");
 	} /* end while */
 
+	/* install default settings */
+	__myqttd_run_setting_swap (ctx, NULL, defaults);
+
+	/* remove settings no longer declared (reload) */
+	__myqttd_run_setting_remove_missing (ctx, doc);
+
 	return axl_true; /* domains loaded */
 }
 
@@ -1420,6 +1856,12 @@ int  myqttd_run_config    (MyQttdCtx * ctx)
 	} /* end if */
 #endif 
 
+	/* enable metrics (counters and latency histograms) when
+	 * requested by configuration (disabled by default) */
+	node = axl_doc_get (doc, "/myqtt/global-settings/metrics");
+	if (node && myqttd_config_is_attr_positive (ctx, node, "value"))
+		myqtt_metrics_enable (myqtt_ctx, axl_true);
+
 	/* now load all modules found */
 	myqttd_run_load_modules (ctx, doc);
 
@@ -1438,6 +1880,11 @@ int  myqttd_run_config    (MyQttdCtx * ctx)
 	if (! myqttd_run_domains_load (ctx, doc))
 		return axl_false;
 
+	/* start $SYS statistics topics publication (if configured) */
+	node = axl_doc_get (doc, "/myqtt/global-settings/sys-topics");
+	if (node != NULL)
+		__myqttd_domain_sys_topics_start (ctx, node);
+
 	/* now install auth handler to accept conections and to
 	 * redirect them to the right domain */
 	myqtt_ctx_set_on_connect (ctx->myqtt_ctx, myqttd_run_handle_on_connect, ctx);
@@ -1454,6 +1901,12 @@ int  myqttd_run_config    (MyQttdCtx * ctx)
  */
 void myqttd_run_cleanup (MyQttdCtx * ctx)
 {
+	MyQttHash * listeners = ctx->listeners;
+
+	/* release listeners table (connections are owned by the
+	 * myqtt context) */
+	ctx->listeners = NULL;
+	myqtt_hash_destroy (listeners);
 	return;
 }
 
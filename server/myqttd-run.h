@@ -74,5 +74,7 @@ axl_bool myqttd_run_check_no_load_module (MyQttdCtx  * ctx,
 /*** private API ***/
 axl_bool myqttd_run_domain_settings_load (MyQttdCtx * ctx, axlDoc * doc);
 axl_bool myqttd_run_domains_load         (MyQttdCtx * ctx, axlDoc * doc);
+axl_bool myqttd_run_config_start_listeners (MyQttdCtx * ctx, axlDoc * doc);
+long     __myqttd_run_token_bucket_take  (MyQttdTokenBucket * bucket, int rate, int burst, int amount);
 
 #endif
@@ -72,6 +72,17 @@ typedef struct _MyQttdModule MyQttdModule;
  */
 typedef struct _MyQttdChild  MyQttdChild;
 
+/** 
+ * @internal Type representing a connection being passed from the
+ * parent process to a child process.
+ */
+typedef struct _MyQttdHandoff MyQttdHandoff;
+
+/** 
+ * @internal Token bucket used to implement publish rate limits.
+ */
+typedef struct _MyQttdTokenBucket MyQttdTokenBucket;
+
 /** 
  * @brief Type representing a loop watching a set of files. See \ref myqttd_loop.
  */
@@ -130,6 +141,32 @@ typedef enum {
 	MYQTTD_DATE_ITEM_MONTH = 2,
 } MyQttdDateItem;
 
+/** 
+ * @brief Format used to store passwords checked by \ref
+ * myqttd_users_verify_password. Stored values starting with
+ * <b>$pbkdf2-sha256$</b> are always checked as salted PBKDF2 hashes
+ * no matter the format declared.
+ */
+typedef enum {
+	/** 
+	 * @brief Password stored as is (clear text).
+	 */
+	MYQTTD_PASSWORD_PLAIN = 0,
+	/** 
+	 * @brief Password stored as MD5 digest (as reported by myqtt_tls_get_digest).
+	 */
+	MYQTTD_PASSWORD_MD5   = 1,
+	/** 
+	 * @brief Password stored as SHA1 digest (as reported by myqtt_tls_get_digest).
+	 */
+	MYQTTD_PASSWORD_SHA1  = 2,
+} MyQttdPasswordFormat;
+
+/** 
+ * @internal Entry of the cache of recently verified credentials.
+ */
+typedef struct _MyQttdVerifyEntry MyQttdVerifyEntry;
+
 
 #endif
 
@@ -40,6 +40,28 @@
  */
 #include <myqttd.h>
 #include <myqttd-ctx-private.h>
+#include <ctype.h>
+
+#if defined(ENABLE_TLS_SUPPORT)
+#include <myqtt-tls.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#endif
+
+/** 
+ * @internal Max amount of credentials kept by the cache of recently
+ * verified passwords.
+ */
+#define MYQTTD_USERS_VERIFY_CACHE_SIZE  1024
+
+/** 
+ * @internal Prefix, default iterations and sizes used for salted
+ * PBKDF2 (HMAC-SHA256) passwords.
+ */
+#define MYQTTD_USERS_PBKDF2_PREFIX      "$pbkdf2-sha256$"
+#define MYQTTD_USERS_PBKDF2_ITERATIONS  10000
+#define MYQTTD_USERS_PBKDF2_SALT_SIZE   16
+#define MYQTTD_USERS_PBKDF2_SIZE        32
 
 /** 
  * \defgroup myqttd_users MyQttD Users: authentication engine for MyQttD broker
@@ -342,6 +364,384 @@ void          myqttd_users_free (MyQttdUsers * users) {
 	return;
 }
 
+/** 
+ * @internal Compares both strings in a time that only depends on
+ * their length.
+ */
+axl_bool __myqttd_users_secure_cmp (const char * a, const char * b, axl_bool ignore_case)
+{
+	int           len_a;
+	int           len_b;
+	int           iterator;
+	unsigned char diff;
+	unsigned char char_a;
+	unsigned char char_b;
+
+	if (a == NULL || b == NULL)
+		return axl_false;
+
+	len_a = strlen (a);
+	len_b = strlen (b);
+	diff  = (len_a != len_b);
+
+	for (iterator = 0; iterator < len_a; iterator++) {
+		char_a = a[iterator];
+		/* when lengths differ, keep comparing to spend same time */
+		char_b = b[iterator % (len_b > 0 ? len_b : 1)];
+		if (ignore_case) {
+			char_a = toupper (char_a);
+			char_b = toupper (char_b);
+		} /* end if */
+		diff |= char_a ^ char_b;
+	} /* end for */
+
+	return diff == 0;
+}
+
+/** 
+ * @brief Compares the provided strings in constant time (it only
+ * depends on their length), to be used to check credentials.
+ *
+ * @param a First string to compare.
+ *
+ * @param b Second string to compare.
+ *
+ * @return axl_true if both strings are equal, otherwise axl_false
+ * is returned (also if any of them is NULL).
+ */
+axl_bool      myqttd_users_secure_cmp (const char * a, const char * b)
+{
+	return __myqttd_users_secure_cmp (a, b, axl_false);
+}
+
+#if defined(ENABLE_TLS_SUPPORT)
+char * __myqttd_users_to_hex (const unsigned char * buffer, int size)
+{
+	char * result;
+	int    iterator;
+
+	result = axl_new (char, (size * 2) + 1);
+	if (result == NULL)
+		return NULL;
+	for (iterator = 0; iterator < size; iterator++)
+		sprintf (result + (iterator * 2), "%02x", buffer[iterator]);
+
+	return result;
+}
+
+int __myqttd_users_from_hex (const char * hex, int hex_size, unsigned char * buffer, int size)
+{
+	int          iterator = 0;
+	unsigned int value;
+	char         aux[3];
+
+	if ((hex_size % 2) != 0 || (hex_size / 2) > size)
+		return -1;
+
+	aux[2] = 0;
+	while (iterator < (hex_size / 2)) {
+		aux[0] = hex[iterator * 2];
+		aux[1] = hex[(iterator * 2) + 1];
+		if (! isxdigit (aux[0]) || ! isxdigit (aux[1]))
+			return -1;
+		sscanf (aux, "%x", &value);
+		buffer[iterator] = value;
+		iterator++;
+	} /* end while */
+
+	return iterator;
+}
+
+/** 
+ * @internal Checks the password against a stored value with the
+ * format: $pbkdf2-sha256$<iterations>$<salt hex>$<hash hex>
+ */
+axl_bool __myqttd_users_pbkdf2_check (const char * stored, const char * password)
+{
+	const char    * salt;
+	const char    * hash;
+	int             iterations;
+	unsigned char   salt_bin[64];
+	unsigned char   result[64];
+	int             salt_size;
+	int             hash_size;
+	char          * result_hex;
+	axl_bool        equal;
+
+	/* get iterations, salt and hash */
+	stored     = stored + strlen (MYQTTD_USERS_PBKDF2_PREFIX);
+	iterations = atoi (stored);
+	salt       = strchr (stored, '$');
+	if (iterations <= 0 || salt == NULL)
+		return axl_false;
+	salt++;
+	hash       = strchr (salt, '$');
+	if (hash == NULL)
+		return axl_false;
+	hash++;
+
+	salt_size  = __myqttd_users_from_hex (salt, hash - salt - 1, salt_bin, sizeof (salt_bin));
+	hash_size  = strlen (hash) / 2;
+	if (salt_size <= 0 || hash_size <= 0 || hash_size > sizeof (result))
+		return axl_false;
+
+	if (! PKCS5_PBKDF2_HMAC (password, strlen (password), salt_bin, salt_size, iterations, EVP_sha256 (), hash_size, result))
+		return axl_false;
+
+	result_hex = __myqttd_users_to_hex (result, hash_size);
+	equal      = __myqttd_users_secure_cmp (result_hex, hash, axl_true);
+	axl_free (result_hex);
+
+	return equal;
+}
+#endif
+
+/** 
+ * @brief Creates a salted hash for the provided password that can be
+ * stored by auth backends and checked with \ref
+ * myqttd_users_verify_password.
+ *
+ * @param password The password to hash.
+ *
+ * @param iterations PBKDF2 iterations to use (-1 or 0 to use
+ * default value: 10000).
+ *
+ * @return A newly allocated string with the format
+ * $pbkdf2-sha256$<iterations>$<salt hex>$<hash hex> or NULL if it
+ * fails (or the server was built without TLS support).
+ */
+char        * myqttd_users_password_hash (const char * password, int iterations)
+{
+#if defined(ENABLE_TLS_SUPPORT)
+	unsigned char   salt[MYQTTD_USERS_PBKDF2_SALT_SIZE];
+	unsigned char   hash[MYQTTD_USERS_PBKDF2_SIZE];
+	char          * salt_hex;
+	char          * hash_hex;
+	char          * result;
+
+	if (password == NULL)
+		return NULL;
+	if (iterations <= 0)
+		iterations = MYQTTD_USERS_PBKDF2_ITERATIONS;
+
+	if (RAND_bytes (salt, sizeof (salt)) != 1)
+		return NULL;
+	if (! PKCS5_PBKDF2_HMAC (password, strlen (password), salt, sizeof (salt), iterations, EVP_sha256 (), sizeof (hash), hash))
+		return NULL;
+
+	salt_hex = __myqttd_users_to_hex (salt, sizeof (salt));
+	hash_hex = __myqttd_users_to_hex (hash, sizeof (hash));
+	result   = axl_strdup_printf ("%s%d$%s$%s", MYQTTD_USERS_PBKDF2_PREFIX, iterations, salt_hex, hash_hex);
+	axl_free (salt_hex);
+	axl_free (hash_hex);
+
+	return result;
+#else
+	return NULL;
+#endif
+}
+
+void __myqttd_users_verify_entry_free (axlPointer _entry)
+{
+	MyQttdVerifyEntry * entry = _entry;
+
+	axl_free (entry->key);
+	axl_free (entry->fingerprint);
+	axl_free (entry);
+	return;
+}
+
+void __myqttd_users_verify_unlink (MyQttdCtx * ctx, MyQttdVerifyEntry * entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		ctx->verify_head  = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		ctx->verify_tail  = entry->prev;
+	entry->prev = NULL;
+	entry->next = NULL;
+	return;
+}
+
+void __myqttd_users_verify_push (MyQttdCtx * ctx, MyQttdVerifyEntry * entry)
+{
+	entry->next = ctx->verify_head;
+	entry->prev = NULL;
+	if (ctx->verify_head)
+		ctx->verify_head->prev = entry;
+	ctx->verify_head = entry;
+	if (ctx->verify_tail == NULL)
+		ctx->verify_tail = entry;
+	return;
+}
+
+/** 
+ * @internal Keyed digest of the password, used to remember it was
+ * verified without keeping it. ctx->verify_mutex must be held.
+ */
+char * __myqttd_users_verify_fingerprint (MyQttdCtx * ctx, const char * password)
+{
+#if defined(ENABLE_TLS_SUPPORT)
+	unsigned char   secret[16];
+	char          * aux;
+	char          * result;
+
+	/* init secret used by this process */
+	if (ctx->verify_secret[0] == 0) {
+		if (RAND_bytes (secret, sizeof (secret)) != 1)
+			return NULL;
+		aux = __myqttd_users_to_hex (secret, sizeof (secret));
+		memcpy (ctx->verify_secret, aux, 32);
+		axl_free (aux);
+	} /* end if */
+
+	aux    = axl_strdup_printf ("%s%s", ctx->verify_secret, password);
+	result = myqtt_tls_get_digest (MYQTT_SHA1, aux);
+	axl_free (aux);
+	return result;
+#else
+	return NULL;
+#endif
+}
+
+/** 
+ * @internal Releases the cache of verified credentials.
+ */
+void __myqttd_users_verify_cache_free (MyQttdCtx * ctx)
+{
+	myqtt_mutex_lock (&ctx->verify_mutex);
+	axl_hash_free (ctx->verify_cache);
+	ctx->verify_cache = NULL;
+	ctx->verify_head  = NULL;
+	ctx->verify_tail  = NULL;
+	myqtt_mutex_unlock (&ctx->verify_mutex);
+	return;
+}
+
+/** 
+ * @brief Checks the password presented by a user against the value
+ * stored by an auth backend, using constant time comparisons.
+ *
+ * Stored values starting with <b>$pbkdf2-sha256$</b> (see \ref
+ * myqttd_users_password_hash) are checked as salted PBKDF2 hashes no
+ * matter the format provided. Because this is expensive, credentials
+ * successfully verified are remembered (in a bounded LRU keeping a
+ * keyed digest, never the password) so reconnects from the same user
+ * skip the key derivation.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param user_key A string identifying the user inside the backend
+ * (for example domain + client id + username), used by the cache.
+ *
+ * @param stored The password as stored by the backend.
+ *
+ * @param password The password presented by the user.
+ *
+ * @param format Format used to store the password.
+ *
+ * @return axl_true if the password matches, otherwise axl_false.
+ */
+axl_bool      myqttd_users_verify_password (MyQttdCtx            * ctx,
+					    const char           * user_key,
+					    const char           * stored,
+					    const char           * password,
+					    MyQttdPasswordFormat   format)
+{
+#if defined(ENABLE_TLS_SUPPORT)
+	char              * digest;
+	char              * key;
+	char              * fingerprint;
+	MyQttdVerifyEntry * entry;
+	axl_bool            result;
+#endif
+
+	if (ctx == NULL || stored == NULL || password == NULL)
+		return axl_false;
+
+#if defined(ENABLE_TLS_SUPPORT)
+	if (axl_memcmp (stored, MYQTTD_USERS_PBKDF2_PREFIX, strlen (MYQTTD_USERS_PBKDF2_PREFIX))) {
+		/* check if it was recently verified */
+		key = axl_strdup_printf ("%s\n%s", user_key ? user_key : "", stored);
+		myqtt_mutex_lock (&ctx->verify_mutex);
+		fingerprint = __myqttd_users_verify_fingerprint (ctx, password);
+		entry       = ctx->verify_cache ? axl_hash_get (ctx->verify_cache, key) : NULL;
+		if (entry && myqttd_users_secure_cmp (entry->fingerprint, fingerprint)) {
+			/* move it to the head */
+			__myqttd_users_verify_unlink (ctx, entry);
+			__myqttd_users_verify_push (ctx, entry);
+			myqtt_mutex_unlock (&ctx->verify_mutex);
+
+			axl_free (key);
+			axl_free (fingerprint);
+			return axl_true;
+		} /* end if */
+		myqtt_mutex_unlock (&ctx->verify_mutex);
+
+		/* not found, run key derivation */
+		result = __myqttd_users_pbkdf2_check (stored, password);
+		if (! result || fingerprint == NULL) {
+			axl_free (key);
+			axl_free (fingerprint);
+			return result;
+		} /* end if */
+
+		/* remember it */
+		myqtt_mutex_lock (&ctx->verify_mutex);
+		if (ctx->verify_cache == NULL) {
+			myqtt_mutex_unlock (&ctx->verify_mutex);
+			axl_free (key);
+			axl_free (fingerprint);
+			return result;
+		} /* end if */
+		entry = axl_hash_get (ctx->verify_cache, key);
+		if (entry) {
+			axl_free (entry->fingerprint);
+			entry->fingerprint = fingerprint;
+			axl_free (key);
+			__myqttd_users_verify_unlink (ctx, entry);
+		} else {
+			entry              = axl_new (MyQttdVerifyEntry, 1);
+			entry->key         = key;
+			entry->fingerprint = fingerprint;
+			axl_hash_insert_full (ctx->verify_cache, entry->key, NULL, entry, __myqttd_users_verify_entry_free);
+		} /* end if */
+		__myqttd_users_verify_push (ctx, entry);
+
+		/* drop least recently used */
+		while (axl_hash_items (ctx->verify_cache) > MYQTTD_USERS_VERIFY_CACHE_SIZE) {
+			entry = ctx->verify_tail;
+			__myqttd_users_verify_unlink (ctx, entry);
+			axl_hash_remove (ctx->verify_cache, entry->key);
+		} /* end while */
+		myqtt_mutex_unlock (&ctx->verify_mutex);
+
+		return result;
+	} /* end if */
+#endif
+
+	switch (format) {
+	case MYQTTD_PASSWORD_PLAIN:
+		return myqttd_users_secure_cmp (stored, password);
+#if defined(ENABLE_TLS_SUPPORT)
+	case MYQTTD_PASSWORD_MD5:
+	case MYQTTD_PASSWORD_SHA1:
+		digest = myqtt_tls_get_digest (format == MYQTTD_PASSWORD_MD5 ? MYQTT_MD5 : MYQTT_SHA1, password);
+		result = __myqttd_users_secure_cmp (stored, digest, axl_true);
+		axl_free (digest);
+		return result;
+#endif
+	default:
+		break;
+	} /* end switch */
+
+	error ("Unable to verify password, format %d not supported (TLS support is required for digests)", format);
+	return axl_false;
+}
+
 /** 
  * @}
  */
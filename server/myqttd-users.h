@@ -72,6 +72,19 @@ axl_bool      myqttd_users_register_backend (MyQttdCtx          * ctx,
 					     axlPointer           extensionPtr4);
 
 void          myqttd_users_free (MyQttdUsers * users);
+
+axl_bool      myqttd_users_verify_password (MyQttdCtx            * ctx,
+					    const char           * user_key,
+					    const char           * stored,
+					    const char           * password,
+					    MyQttdPasswordFormat   format);
+
+axl_bool      myqttd_users_secure_cmp      (const char * a, const char * b);
+
+char        * myqttd_users_password_hash   (const char * password, int iterations);
+
+/* internal API */
+void          __myqttd_users_verify_cache_free (MyQttdCtx * ctx);
 					     
 
 #endif
@@ -254,6 +254,12 @@ axl_bool  myqttd_init (MyQttdCtx   * ctx,
 /** 
  * @brief Function that performs a reload operation for the current
  * myqttd instance (represented by the provided MyQttdCtx).
+ *
+ * Reload is incremental: only domain settings that changed are
+ * replaced (new objects are swapped in so running connections keep
+ * reading consistent values), domains are updated or disabled if no
+ * longer declared, and only listeners added or removed are
+ * started/stopped. Connections already accepted stay up.
  * 
  * @param ctx The myqttd context representing a running instance
  * that must reload.
@@ -293,6 +299,10 @@ void     myqttd_reload_config       (MyQttdCtx * ctx, int value)
 		if (! myqttd_run_domains_load (ctx, doc))
 			error ("Failed to reload domain settings");
 
+		/* start/stop listeners that changed */
+		if (! myqttd_run_config_start_listeners (ctx, doc))
+			error ("Failed to reload listeners");
+
 		/* release document loaded */
 		axl_doc_free (doc);
 	} /* end if */
@@ -324,6 +334,10 @@ void myqttd_exit (MyQttdCtx * ctx,
 	msg ("Stopping time tracking event id %ld (MyQttCtx: %p)..", ctx->time_tracking_event_id, ctx);
 	myqtt_thread_pool_remove_event (ctx->myqtt_ctx, ctx->time_tracking_event_id);
 
+	/* stop $SYS topics publication */
+	if (ctx->sys_topics_event_id != 0)
+		myqtt_thread_pool_remove_event (ctx->myqtt_ctx, ctx->sys_topics_event_id);
+
 	/* check to kill childs */
 	myqttd_process_kill_childs (ctx);
 
@@ -1824,6 +1838,8 @@ long         myqttd_get_day (void)
  *   - \ref myqttd_configuring_log_files
  *   - \ref myqttd_configure_system_paths
  *   - \ref myqttd_configure_splitting
+ *   - \ref myqttd_sys_topics
+ *   - \ref myqttd_usdt_tracing
  *
  * <b>Section 3: MyQttD module management</b> 
  *
@@ -1835,6 +1851,7 @@ long         myqttd_get_day (void)
  *
  *   - \ref myqttd_mod_auth_xml    "4.1 mod-auth-xml: Authentication and Acls plugin supported on XML files for MyQttd broker "
  *   - \ref myqttd_mod_tls    "4.2 mod-ssl: SSL/TLS support for MyQttD (secure connections)"
+ *   - \ref myqttd_mod_prometheus    "4.3 mod-prometheus: Prometheus metrics endpoint for MyQttD"
  *
  * \section configuring_myqttd 2.1 MyQttD configuration
  * 
@@ -1914,6 +1931,16 @@ long         myqttd_get_day (void)
  *
  *    \htmlinclude domain-settings-standard.xml-tmp
  *
+ *    Publish rates can be limited per client (<b>client-msg-rate</b>,
+ *    <b>client-byte-rate</b>) and for the whole domain
+ *    (<b>domain-msg-rate</b>, <b>domain-byte-rate</b>), measured in
+ *    messages or bytes per second. Each one accepts a burst setting
+ *    (<b>client-msg-burst</b>, <b>client-byte-burst</b>,
+ *    <b>domain-msg-burst</b>, <b>domain-byte-burst</b>) with the
+ *    amount that can be published at once (by default, same as the
+ *    rate). When a limit is exceeded, the connection is not closed:
+ *    MyQttD stops reading from it until the rate is back to the limit.
+ *
  *
  *  </li>
  *  <li><b>&lt;myqtt-domains></b>: The last section includes all domains that are recognized by your MyQttd server. Each domain can have a separate storage location, a separate user's database and a different domain-settings configuration. Here is an example:
@@ -2044,6 +2071,19 @@ long         myqttd_get_day (void)
  *
  * \htmlinclude log-reporting.syslog.xml-tmp
  *
+ * When logging to files, it is possible to make MyQttD to write
+ * logs through a background writer thread by declaring
+ * <b>async="yes"</b> at the <b>&lt;log-reporting></b> node. In
+ * that case, log lines are accumulated into memory and flushed in
+ * batches every <b>flush-period</b> milliseconds (200 by default)
+ * or earlier if enough content is accumulated. Optionally, the
+ * amount of lines written per second on each log can be limited
+ * with <b>max-lines-per-second</b> (0, no limit, by
+ * default). Lines discarded are reported into the log with the
+ * amount dropped. Error lines are never discarded:
+ *
+ * \htmlinclude log-reporting.async.xml-tmp
+ *
  * \section myqttd_configure_system_paths 2.7 Alter default myqttd base system paths
  *
  * By default MyQttD has 3 built-in system paths used to locate
@@ -2096,6 +2136,62 @@ long         myqttd_get_day (void)
  *
  * \htmlinclude include-from-dir.xml-tmp
  *
+ * \section myqttd_sys_topics 2.9 Broker statistics ($SYS topics)
+ *
+ * MyQttD can publish broker statistics on every domain as retained
+ * topics, so operators can watch them with any MQTT client. To
+ * enable it, add the following into the &lt;global-settings> node:
+ *
+ * \code
+ * &lt;sys-topics interval="10" prefix="$SYS/broker" />
+ * \endcode
+ *
+ * Every <b>interval</b> seconds, each domain gets the following
+ * topics (under <b>prefix</b>) updated with its own values:
+ *
+ *   - <b>clients/connected</b>, <b>subscriptions/count</b>
+ *   - <b>messages/received/per-second</b>, <b>messages/sent/per-second</b>
+ *   - <b>bytes/received/per-second</b>, <b>bytes/sent/per-second</b>
+ *   - <b>retained/count</b>, <b>storage/backlog</b> (messages stored pending to be released)
+ *   - <b>threads/running</b>, <b>threads/busy</b>, <b>threads/pending-tasks</b>
+ *   - <b>sequencer/queue-depth</b>
+ *
+ * Use the optional <b>topics</b> attribute to select which ones are
+ * published (clients, subscriptions, messages, bytes, retained,
+ * storage, threads, sequencer), for example: topics="clients,messages".
+ * Message and byte rates require metrics enabled (&lt;metrics value="yes" />, disabled by default).
+ *
+ * Values are taken from counters maintained by the engine, so
+ * publishing them does not inspect connections or storage. Clients
+ * are not allowed to publish under the configured prefix; to
+ * restrict who can read them, use your auth backend acls.
+ *
+ * \section myqttd_usdt_tracing 2.10 Tracing MyQttD with static tracepoints (USDT)
+ *
+ * When latency problems must be investigated in production, debug
+ * log is too expensive. Instead, libMyQtt can be built with static
+ * tracepoints (USDT probes, requires sys/sdt.h, usually provided by
+ * systemtap-sdt-dev or systemtap-sdt-devel packages):
+ *
+ * \code
+ * >> ./configure --enable-usdt
+ * \endcode
+ *
+ * Probes cost a nop instruction when nothing is attached. They are
+ * registered under the <b>myqtt</b> provider: conn_open, conn_close,
+ * frame_received, ack_received, publish_dispatch, publish_done,
+ * subscriber_enqueue, socket_write, storage_store and storage_release
+ * (see lib/myqtt-probes.h for their arguments).
+ *
+ * Sample bpftrace scripts are provided at doc/bpftrace/ (publish
+ * latency, packets received, socket writes, storage and connections):
+ *
+ * \code
+ * >> bpftrace -p $(pidof myqttd) doc/bpftrace/publish-latency.bt
+ * \endcode
+ *
+ * They can also be used with perf (perf buildid-cache --add libmyqtt-1.0.so, then perf record -e sdt_myqtt:publish_dispatch).
+ *
  * \section myqttd_modules_configuration 3.1 MyQttD modules configuration
  * 
  * Modules loaded by myqttd are found at the directories
@@ -3025,6 +3121,7 @@ long         myqttd_get_day (void)
  * - \ref myqtt_client_manual_topic_match
  * - \ref myqtt_client_manual_ping
  * - \ref myqtt_client_manual_transport_selection
+ * - \ref myqtt_client_manual_bench
  *
  * \section myqtt_client_manual_intro Introduction
  *
@@ -3098,4 +3195,33 @@ long         myqttd_get_day (void)
  *
  * \endcode
  * 
+ * \section myqtt_client_manual_bench Benchmarking and load testing a server
+ *
+ * Use <b>--bench</b> to run a load generator against a server. It
+ * opens the configured number of publisher and subscriber
+ * connections; publishers send messages during the provided duration
+ * embedding a send timestamp, so subscribers can measure end-to-end
+ * latency. Once done, throughput, latency percentiles and error
+ * counts are reported:
+ *
+ * \code
+ * >> myqtt-client --host localhost --port 1883 --bench --bench-publishers 4 --bench-subscribers 2 --bench-qos 0,1 --bench-duration 30
+ * \endcode
+ *
+ * Available options are:
+ *
+ * - <b>--bench-publishers</b> and <b>--bench-subscribers</b>: number of connections of each type (1 by default).
+ * - <b>--bench-topic</b>: publish topic, where %d is replaced by the publisher number (myqtt/bench/%d by default).
+ * - <b>--bench-sub-topic</b>: topic filter used by subscribers (myqtt/bench/# by default).
+ * - <b>--bench-payload</b>: payload size in bytes (64 by default).
+ * - <b>--bench-qos</b>: QoS levels used in turns by each publisher, for example 0,1,2 (0 by default).
+ * - <b>--bench-rate</b>: target msgs/sec for each publisher (0 by default: as fast as possible).
+ * - <b>--bench-duration</b>: seconds publishing (10 by default).
+ * - <b>--bench-report</b>: text (default) or json.
+ *
+ * Connections are created with clean session and client ids built
+ * from <b>--client-id</b> (myqtt-bench by default). The command exits
+ * with an error code if any connection, publish or reception error
+ * is found.
+ *
  */
@@ -3080,6 +3080,7 @@ axl_bool  test_19 (void) {
 #if defined(ENABLE_MYSQL_SUPPORT)
 /* prototype to be able to use test function from mod-auth-mysql */
 void __mod_auth_mysql_run_query_for_test (MyQttdCtx * ctx, const char * query);
+axl_bool __mod_auth_mysql_pool_stats_for_test (MyQttdCtx * ctx, int * size, int * max_size, long * created, long * reused);
 
 axl_bool  test_20 (void) {
 
@@ -3090,6 +3091,10 @@ axl_bool  test_20 (void) {
 	int               sub_result;
 	MyQttAsyncQueue * queue;
 	MyQttConnOpts   * opts;
+	int               pool_size;
+	int               pool_max;
+	long              pool_created;
+	long              pool_reused;
 
 	printf ("Test 20: info: \n");
 	printf ("Test 20: info: \n");
@@ -3367,6 +3372,17 @@ axl_bool  test_20 (void) {
 
 	myqtt_conn_close (conn);
 
+	/* check queries were run over pooled connections */
+	if (! __mod_auth_mysql_pool_stats_for_test (ctx, &pool_size, &pool_max, &pool_created, &pool_reused)) {
+		printf ("ERROR: expected to find connection pool for mod-auth-mysql dsn..\n");
+		return axl_false;
+	} /* end if */
+	printf ("Test 20: pool stats: conns=%d/%d, created=%ld, reused=%ld\n", pool_size, pool_max, pool_created, pool_reused);
+	if (pool_size > pool_max || pool_created > pool_max || pool_reused <= 0) {
+		printf ("ERROR: expected connections to be reused by the pool..\n");
+		return axl_false;
+	} /* end if */
+
 	printf ("Test 20: finishing context..\n");
 	myqtt_exit_ctx (myqtt_ctx, axl_true);
 
@@ -3623,182 +3639,1896 @@ axl_bool test_22 (void) {
 }
 
 
-#define CHECK_TEST(name) if (run_test_name == NULL || axl_cmp (run_test_name, name))
+axl_bool test_23 (void) {
 
-typedef axl_bool (* MyQttTestHandler) (void);
+	MyQttdCtx       * ctx;
+	MyQttdChild       child;
+	MyQttdHandoff   * handoffs[40];
+	MyQttdHandoff     received[MYQTTD_HANDOFF_MAX_FDS];
+	char              buffer[MYQTTD_HANDOFF_BUFFER_SIZE];
+	int               pair[2];
+	int               count;
+	int               total = 0;
+	int               iterator;
+	char            * serverName;
+	char              command;
 
-/** 
- * @brief Helper handler that allows to execute the function provided
- * with the message associated.
- * @param function The handler to be called (test)
- * @param message The message value.
- */
-int run_test (MyQttTestHandler function, const char * message) {
+	/* create a local socket pair to simulate parent -> child
+	 * control connection */
+	ctx = myqttd_ctx_new ();
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+		printf ("Test 23: unable to create socket pair, errno=%d\n", errno);
+		return axl_false;
+	} /* end if */
+
+	memset (&child, 0, sizeof (MyQttdChild));
+	child.ctx              = ctx;
+	child.child_connection = pair[0];
+
+	/* build 40 handoffs (more than can be sent in a single
+	 * message), every fifth one is a command without socket */
+	for (iterator = 0; iterator < 40; iterator++) {
+		serverName = axl_strdup_printf ("domain-%d.local", iterator);
+		if (iterator % 5 == 4)
+			handoffs[iterator] = myqttd_process_handoff_new (-1, 'c', axl_false, serverName, NULL);
+		else
+			handoffs[iterator] = myqttd_process_handoff_new (dup (0), iterator % 2 ? 'n' : 's', iterator % 3 == 0, serverName, NULL);
+		axl_free (serverName);
+		if (handoffs[iterator] == NULL) {
+			printf ("Test 23: failed to create handoff %d\n", iterator);
+			return axl_false;
+		} /* end if */
+	} /* end for */
 
-	printf ("--- --: starting %s\n", message);
+	printf ("Test 23: sending 40 sockets in batches..\n");
+	if (! myqttd_process_send_sockets (&child, handoffs, 40)) {
+		printf ("Test 23: failed to send sockets..\n");
+		return axl_false;
+	} /* end if */
 
-	if (function ()) {
-		printf ("%s [   OK   ]\n", message);
-	} else {
-		printf ("%s [ FAILED ]\n", message);
-		exit (-1);
-	}
-	return 0;
-}
+	/* now receive on the other side */
+	child.child_connection = pair[1];
+	while (total < 40) {
+		if (! myqttd_process_receive_sockets (&child, buffer, received, &count)) {
+			printf ("Test 23: failed to receive sockets (received %d so far)..\n", total);
+			return axl_false;
+		} /* end if */
+		if (count != 32 && count != 8) {
+			printf ("Test 23: expected to receive batches of 32 and 8 sockets, but received %d\n", count);
+			return axl_false;
+		} /* end if */
 
+		for (iterator = 0; iterator < count; iterator++) {
+			serverName = axl_strdup_printf ("domain-%d.local", total);
+			if (! axl_cmp (received[iterator].serverName, serverName)) {
+				printf ("Test 23: expected serverName %s but found %s\n", serverName, received[iterator].serverName);
+				return axl_false;
+			} /* end if */
+			axl_free (serverName);
+
+			command = total % 5 == 4 ? 'c' : (total % 2 ? 'n' : 's');
+			if (received[iterator].command != command ||
+			    received[iterator].handle_reply != (command != 'c' && total % 3 == 0) ||
+			    received[iterator].remote_host != NULL) {
+				printf ("Test 23: unexpected values found at record %d\n", total);
+				return axl_false;
+			} /* end if */
 
-#ifdef AXL_OS_UNIX
-void __block_test (int _signal) 
-{
-	MyQttAsyncQueue * queue;
-	char * cmd;
-	int    _value; 
+			if (command == 'c') {
+				/* commands carry no socket */
+				if (received[iterator].socket != -1) {
+					printf ("Test 23: expected no socket for command at record %d but found %d\n", total, received[iterator].socket);
+					return axl_false;
+				} /* end if */
+			} else {
+				if (received[iterator].socket <= 0 || fcntl (received[iterator].socket, F_GETFD) == -1) {
+					printf ("Test 23: received invalid socket %d at record %d\n", received[iterator].socket, total);
+					return axl_false;
+				} /* end if */
+				close (received[iterator].socket);
+			} /* end if */
 
-	signal (_signal, __block_test);
+			total++;
+		} /* end for */
+	} /* end while */
 
-	printf ("******\n");
-	printf ("****** Received a signal=%d (the regression test is failing): pid %d..locking..!!!\n", _signal, myqtt_getpid ());
-	printf ("******\n");
+	/* release handoffs (sockets already closed) */
+	for (iterator = 0; iterator < 40; iterator++)
+		myqttd_process_handoff_free (handoffs[iterator]);
 
-	/* block the caller */
-	queue = myqtt_async_queue_new ();
-	myqtt_async_queue_pop (queue);
-	
-	
-	cmd = axl_strdup_printf ("gdb -ex \"attach %d\"", (int) myqtt_getpid ());
-	_value = system (cmd);
-	printf ("Gdb finished with %d\n", _value);
-	axl_free (cmd); 
-	signal (_signal, __block_test);
-	return;
-}
-#endif
+	/* now a message only carrying commands (no SCM_RIGHTS) */
+	printf ("Test 23: sending commands without sockets..\n");
+	child.child_connection = pair[0];
+	handoffs[0] = myqttd_process_handoff_new (-1, 'c', axl_false, "test-23:command-1", NULL);
+	handoffs[1] = myqttd_process_handoff_new (-1, 'c', axl_false, "test-23:command-2", NULL);
+	if (! myqttd_process_send_sockets (&child, handoffs, 2)) {
+		printf ("Test 23: failed to send commands..\n");
+		return axl_false;
+	} /* end if */
+	myqttd_process_handoff_free (handoffs[0]);
+	myqttd_process_handoff_free (handoffs[1]);
 
+	child.child_connection = pair[1];
+	if (! myqttd_process_receive_sockets (&child, buffer, received, &count)) {
+		printf ("Test 23: failed to receive commands..\n");
+		return axl_false;
+	} /* end if */
+	if (count != 2 || received[0].command != 'c' || received[0].socket != -1 || received[1].socket != -1 ||
+	    ! axl_cmp (received[0].serverName, "test-23:command-1") || ! axl_cmp (received[1].serverName, "test-23:command-2")) {
+		printf ("Test 23: unexpected commands received (count=%d)\n", count);
+		return axl_false;
+	} /* end if */
 
-/** 
- * @brief General regression test to check all features inside myqtt
- */
-int main (int argc, char ** argv)
-{
-	char * run_test_name = NULL;
+	close (pair[0]);
+	close (pair[1]);
+	myqttd_ctx_free (ctx);
 
-	/* install default handling to get notification about
-	 * segmentation faults */
-#ifdef AXL_OS_UNIX
-	signal (SIGSEGV, __block_test);
-	signal (SIGABRT, __block_test);
-#endif
+	return axl_true;
+}
 
-	printf ("** MyQtt: A high performance open source MQTT implementation\n");
-	printf ("** Copyright (C) 2016 Advanced Software Production Line, S.L.\n**\n");
-	printf ("** Regression tests: %s \n",
-		VERSION);
-	printf ("** To gather information about time performance you can use:\n**\n");
-	printf ("**     time ./test_01 [--help] [--debug] [--no-unmap] [--run-test=NAME]\n**\n");
-	printf ("** To gather information about memory consumed (and leaks) use:\n**\n");
-	printf ("**     >> libtool --mode=execute valgrind --leak-check=yes --show-reachable=yes --error-limit=no ./test_01 [--debug]\n**\n");
-	printf ("** Providing --run-test=NAME will run only the provided regression test.\n");
-	printf ("** Available tests: test_00, test_01, test_02, test_03, test_03a, test_04, test_05\n");
-	printf ("**                  test_06, test_07, test_08, test_09, test_10, test_10a, test_10b, test_11\n");
-	printf ("**                  test_12, test_13, test_14, test_15, test_16, test_17\n");
-	printf ("**\n");
-	printf ("** Report bugs to:\n**\n");
-	printf ("**     <myqtt@lists.aspl.es> MyQtt Mailing list\n**\n");
+axl_bool test_24 (void) {
+	MyQttdCtx       * ctx;
+	MyQttConn       * conn;
+	MyQttdDomain    * domain;
+	MyQttAsyncQueue * queue;
+	int               iterator;
+	int               sub_result;
 
-	/* uncomment the following four lines to get debug */
-	while (argc > 0) {
-		if (axl_cmp (argv[argc], "--help")) 
-			exit (0);
-		if (axl_cmp (argv[argc], "--debug")) 
-			test_common_enable_debug = axl_true;
-	
-		if (argv[argc] && axl_memcmp (argv[argc], "--run-test", 10)) {
-			run_test_name = argv[argc] + 11;
-			printf ("INFO: running test: %s\n", run_test_name);
-		}
-		argc--;
+	/* call to init the base library and close it */
+	printf ("Test 24: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 24: failed to start library and server engine..\n");
+		return axl_false;
 	} /* end if */
 
-	/* run tests */
-	CHECK_TEST("test_00")
-	run_test (test_00, "Test 00: basic context initialization");
+	/* connect and subscribe twice to the same topic (only one
+	 * subscription must be accounted) */
+	conn = common_connect_and_subscribe (NULL, "test_02", "myqtt/test", MYQTT_QOS_0, axl_false);
+	if (conn == NULL) {
+		printf ("Test 24: unable to connect to the domain..\n");
+		return axl_false;
+	} /* end if */
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test", 0, &sub_result)) {
+		printf ("Test 24: unable to subscribe, sub_result=%d..\n", sub_result);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_01")
-	run_test (test_01, "Test 01: basic domain initialization (selecting one domain based on connection settings)");
+	domain = myqttd_domain_find_by_name (ctx, "test_01.context");
+	if (myqttd_domain_conn_count (domain) != 1 || myqttd_domain_subs_count (domain) != 1 || myqttd_domain_session_count (domain) != 0) {
+		printf ("Test 24: expected 1 connection, 1 subscription and 0 sessions but found %d, %d, %d\n",
+			myqttd_domain_conn_count (domain), myqttd_domain_subs_count (domain), myqttd_domain_session_count (domain));
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_02")
-	run_test (test_02, "Test 02: sending 50 messages with 50 connections subscribed (2500 messages received)");
+	/* publish and receive */
+	queue = common_configure_reception (conn);
+	if (! common_send_msg (conn, "myqtt/test", "This is an application message", MYQTT_QOS_0)) {
+		printf ("Test 24: unable to send message\n");
+		return axl_false;
+	} /* end if */
+	if (! common_receive_and_check (queue, "myqtt/test", "This is an application message", MYQTT_QOS_0, axl_false)) {
+		printf ("Test 24: expected to receive different message..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_async_queue_unref (queue);
 
-	CHECK_TEST("test_03")
-	run_test (test_03, "Test 03: domain selection (working with two domains based on client_id selection)");
+	/* delivery is accounted once publish finishes */
+	iterator = 0;
+	while (iterator < 100 && myqttd_domain_msgs_out (domain) != 1) {
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
 
-	CHECK_TEST("test_03a")
-	run_test (test_03a, "Test 03-a: connection client_id recovery on conn shutdown");
+	if (myqttd_domain_msgs_in (domain) != 1 || myqttd_domain_msgs_out (domain) != 1) {
+		printf ("Test 24: expected 1 message in and 1 message out but found %ld, %ld\n",
+			myqttd_domain_msgs_in (domain), myqttd_domain_msgs_out (domain));
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_04")
-	run_test (test_04, "Test 04: domain selection (working with two domains based on user/password selection)");
+	/* close connection: counters must go back (close
+	 * notification is asynchronous, so wait a bit) */
+	common_close_conn_and_ctx (conn);
+	iterator = 0;
+	while (iterator < 100 && (myqttd_domain_conn_count (domain) != 0 || myqttd_domain_subs_count (domain) != 0)) {
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
 
-	CHECK_TEST("test_05")
-	run_test (test_05, "Test 05: domain selection (testing right users with wrong passwords)");
+	if (myqttd_domain_conn_count (domain) != 0 || myqttd_domain_subs_count (domain) != 0) {
+		printf ("Test 24: expected 0 connections and 0 subscriptions after close but found %d, %d\n",
+			myqttd_domain_conn_count (domain), myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_06")
-	run_test (test_06, "Test 06: check loading domain settings");
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
 
-	CHECK_TEST("test_07")
-	run_test (test_07, "Test 07: testing connection limits to a domain");
+axl_bool test_25 (void) {
+	MyQttdTokenBucket bucket;
+	long              wait;
+	int               iterator;
 
-	CHECK_TEST("test_08")
-	run_test (test_08, "Test 08: test message size limit to a domain");
+	/* bucket with 10 tokens/s and burst 20: first 20 takes must
+	 * not wait */
+	memset (&bucket, 0, sizeof (MyQttdTokenBucket));
+	for (iterator = 0; iterator < 20; iterator++) {
+		wait = __myqttd_run_token_bucket_take (&bucket, 10, 20, 1);
+		if (wait != 0) {
+			printf ("Test 25: expected no wait at take %d but found %ld\n", iterator, wait);
+			return axl_false;
+		} /* end if */
+	} /* end for */
 
-	/* test following error */
-	/* Aug 28 18:11:13 node01 myqttd[14820]: **ERROR**: (myqtt) myqtt-reader.c:111: Requested to read an utf-8 string of length 12332 but limit is 48 */
-	/* send sending big messages */
+	/* next take goes into debt: about 100ms to recover */
+	wait = __myqttd_run_token_bucket_take (&bucket, 10, 20, 1);
+	if (wait <= 0 || wait > 100000) {
+		printf ("Test 25: expected to wait up to 100ms but found %ld\n", wait);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_09")
-	run_test (test_09, "Test 09: check storage quota enforcement (amount of messages that can be saved on disk)");
+	/* wait for the bucket to refill some tokens */
+	myqtt_sleep (300000);
+	wait = __myqttd_run_token_bucket_take (&bucket, 10, 20, 1);
+	if (wait != 0) {
+		printf ("Test 25: expected no wait after refill but found %ld\n", wait);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_10")
-	run_test (test_10, "Test 10: checking client id (<drop-conn-same-client-id value=\"no\" />)");
+	/* bytes: burst defaults to rate when not configured */
+	memset (&bucket, 0, sizeof (MyQttdTokenBucket));
+	if (__myqttd_run_token_bucket_take (&bucket, 1000, 0, 1000) != 0) {
+		printf ("Test 25: expected to accept 1000 bytes with default burst\n");
+		return axl_false;
+	} /* end if */
+	wait = __myqttd_run_token_bucket_take (&bucket, 1000, 0, 500);
+	if (wait < 400000 || wait > 500000) {
+		printf ("Test 25: expected to wait about 500ms but found %ld\n", wait);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_10a")
-	run_test (test_10a, "Test 10-a: checking client id (<drop-conn-same-client-id value=\"no\" />)");
+	/* no rate means no limit */
+	if (__myqttd_run_token_bucket_take (&bucket, 0, 0, 1000000) != 0) {
+		printf ("Test 25: expected no limit with rate 0\n");
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_10b")
-	run_test (test_10b, "Test 10-b: check clean session and removed subscribed options");
+	return axl_true;
+}
 
-#if defined(ENABLE_TLS_SUPPORT)
-	CHECK_TEST("test_11")
-	run_test (test_11, "Test 11: checking domain activation when connected with TLS (hostname == domain name)");
-#endif
+axl_bool test_26 (void) {
+	MyQttdCtx           * ctx;
+	MyQttdDomainSetting * basic;
+	MyQttdDomainSetting * standard;
+	MyQttdDomainSetting * defaults;
+	MyQttdDomainSetting * setting;
+	MyQttdDomain        * domain;
+	axlDoc              * doc;
+	axlError            * err = NULL;
+	const char          * config = "<myqtt><domain-settings><domain-setting name='basic'><conn-limit value='5' /></domain-setting></domain-settings></myqtt>";
 
-#if defined(ENABLE_WEBSOCKET_SUPPORT)
-	CHECK_TEST("test_12")
-	run_test (test_12, "Test 12: checking domain activation when connected with WebSocket (hostname == domain name)");
+	/* call to init the base library and close it */
+	printf ("Test 26: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 26: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_13")
-	run_test (test_13, "Test 13: checking domain activation when connected with WebSocket TLS (hostname == domain name)");
-#endif
+	basic    = myqtt_hash_lookup (ctx->domain_settings, "basic");
+	standard = myqtt_hash_lookup (ctx->domain_settings, "standard");
+	defaults = ctx->default_setting;
+	if (basic == NULL || standard == NULL || defaults == NULL) {
+		printf ("Test 26: expected to find settings loaded\n");
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_14")
-	run_test (test_14, "Test 14: checks that authentication fails when provided right hostname but wrong credentials");
+	/* reload same configuration: nothing must be replaced */
+	myqttd_reload_config (ctx, 0);
+	if (myqtt_hash_lookup (ctx->domain_settings, "basic") != basic ||
+	    myqtt_hash_lookup (ctx->domain_settings, "standard") != standard ||
+	    ctx->default_setting != defaults) {
+		printf ("Test 26: expected settings to be kept after reloading same configuration\n");
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_15")
-	run_test (test_15, "Test 15: test auth fails when no backend is enabled");
+	/* load a configuration changing basic settings */
+	doc = axl_doc_parse (config, -1, &err);
+	if (doc == NULL) {
+		printf ("Test 26: failed to parse config: %s\n", axl_error_get (err));
+		axl_error_free (err);
+		return axl_false;
+	} /* end if */
+	if (! myqttd_run_domain_settings_load (ctx, doc)) {
+		printf ("Test 26: failed to load settings\n");
+		return axl_false;
+	} /* end if */
+	axl_doc_free (doc);
 
-	CHECK_TEST("test_16")
-	run_test (test_16, "Test 16: check wildcard subscription can be disabled globally or at certain domain or for a certain user");
+	/* basic must be a new object, old one still readable */
+	setting = myqtt_hash_lookup (ctx->domain_settings, "basic");
+	if (setting == NULL || setting == basic || setting->conn_limit != 5) {
+		printf ("Test 26: expected new basic settings with conn-limit=5\n");
+		return axl_false;
+	} /* end if */
+	if (basic->conn_limit != 50) {
+		printf ("Test 26: retired settings were modified (conn-limit=%d)\n", basic->conn_limit);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_17")
-	run_test (test_17, "Test 17: check anonymous authentication with mod-auth-xml");
+	/* standard is no longer declared: removed from settings and
+	 * from domains using it, but retired (still readable) */
+	if (myqtt_hash_lookup (ctx->domain_settings, "standard") != NULL) {
+		printf ("Test 26: expected standard settings to be removed\n");
+		return axl_false;
+	} /* end if */
+	domain = myqttd_domain_find_by_name (ctx, "test_02.context");
+	if (domain == NULL || domain->settings != NULL) {
+		printf ("Test 26: expected test_02.context to have no settings after standard was removed\n");
+		return axl_false;
+	} /* end if */
+	if (standard->conn_limit != 10) {
+		printf ("Test 26: retired settings were modified (conn-limit=%d)\n", standard->conn_limit);
+		return axl_false;
+	} /* end if */
 
-	CHECK_TEST("test_18")
-	run_test (test_18, "Test 18: check global acls with mod-auth-xml");
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
 
-	CHECK_TEST("test_19")
-	run_test (test_19, "Test 19: check user acls with mod-auth-xml");
+	return axl_true;
+}
 
-#if defined(ENABLE_MYSQL_SUPPORT)
-	CHECK_TEST("test_20")
+#if defined(ENABLE_TLS_SUPPORT)
+axl_bool test_27 (void) {
+	MyQttdCtx           * ctx;
+	char                * hash;
+	char                * digest;
+	int                   iterator;
+
+	/* call to init the base library and close it */
+	printf ("Test 27: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 27: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* constant time compare */
+	if (! myqttd_users_secure_cmp ("password", "password") ||
+	    myqttd_users_secure_cmp ("password", "passwor") ||
+	    myqttd_users_secure_cmp ("password", "passwordd") ||
+	    myqttd_users_secure_cmp ("password", "Password") ||
+	    myqttd_users_secure_cmp ("password", NULL)) {
+		printf ("Test 27: secure compare failed\n");
+		return axl_false;
+	} /* end if */
+
+	/* plain and digest formats */
+	digest = myqtt_tls_get_digest (MYQTT_MD5, "secret");
+	if (! myqttd_users_verify_password (ctx, "user", "secret", "secret", MYQTTD_PASSWORD_PLAIN) ||
+	    myqttd_users_verify_password (ctx, "user", "secret", "secreT", MYQTTD_PASSWORD_PLAIN) ||
+	    ! myqttd_users_verify_password (ctx, "user", digest, "secret", MYQTTD_PASSWORD_MD5) ||
+	    myqttd_users_verify_password (ctx, "user", digest, digest, MYQTTD_PASSWORD_MD5)) {
+		printf ("Test 27: plain/md5 password verification failed\n");
+		return axl_false;
+	} /* end if */
+	axl_free (digest);
+
+	/* salted hashes */
+	hash = myqttd_users_password_hash ("secret", 1000);
+	if (hash == NULL || ! axl_memcmp (hash, "$pbkdf2-sha256$1000$", 20)) {
+		printf ("Test 27: expected to create salted hash, found: %s\n", hash);
+		return axl_false;
+	} /* end if */
+
+	/* check it several times (second and later served from cache) */
+	iterator = 0;
+	while (iterator < 3) {
+		if (! myqttd_users_verify_password (ctx, "user", hash, "secret", MYQTTD_PASSWORD_PLAIN)) {
+			printf ("Test 27: expected to verify salted hash (iteration %d)\n", iterator);
+			return axl_false;
+		} /* end if */
+		if (myqttd_users_verify_password (ctx, "user", hash, "secret2", MYQTTD_PASSWORD_PLAIN)) {
+			printf ("Test 27: expected to reject wrong password (iteration %d)\n", iterator);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	if (axl_hash_items (ctx->verify_cache) != 1) {
+		printf ("Test 27: expected one verified entry, found %d\n", axl_hash_items (ctx->verify_cache));
+		return axl_false;
+	} /* end if */
+	axl_free (hash);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+
+	return axl_true;
+}
+#endif
+
+axl_bool test_28 (void) {
+	MyQttdCtx       * ctx;
+	MyQttConn       * conn;
+	MyQttdDomain    * domain;
+	MyQttAsyncQueue * queue;
+	MyQttMetrics    * metrics;
+	MyQttHistogram  * hist;
+	int               iterator;
+
+	/* call to init the base library and close it */
+	printf ("Test 28: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 28: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* connect, subscribe, publish and receive */
+	conn = common_connect_and_subscribe (NULL, "test_02", "myqtt/test", MYQTT_QOS_0, axl_false);
+	if (conn == NULL) {
+		printf ("Test 28: unable to connect to the domain..\n");
+		return axl_false;
+	} /* end if */
+	queue = common_configure_reception (conn);
+	if (! common_send_msg (conn, "myqtt/test", "This is an application message", MYQTT_QOS_0)) {
+		printf ("Test 28: unable to send message\n");
+		return axl_false;
+	} /* end if */
+	if (! common_receive_and_check (queue, "myqtt/test", "This is an application message", MYQTT_QOS_0, axl_false)) {
+		printf ("Test 28: expected to receive different message..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_async_queue_unref (queue);
+
+	/* publish time and messages out are accounted once publish
+	 * finishes */
+	metrics = axl_new (MyQttMetrics, 1);
+	domain  = myqttd_domain_find_by_name (ctx, "test_01.context");
+	iterator = 0;
+	while (iterator < 100) {
+		if (! myqttd_domain_get_metrics (domain, metrics, axl_false)) {
+			printf ("Test 28: expected to get domain metrics but failed..\n");
+			return axl_false;
+		} /* end if */
+		if (metrics->histograms[MYQTT_METRIC_PUBLISH].count == 1 && metrics->counters[MYQTT_METRIC_MSGS_OUT] == 3)
+			break;
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
+
+	/* SUBSCRIBE + PUBLISH in, CONNACK + SUBACK + PUBLISH out
+	 * (CONNECT is received by the main context) */
+	if (metrics->counters[MYQTT_METRIC_MSGS_IN] != 2 || metrics->counters[MYQTT_METRIC_MSGS_OUT] != 3) {
+		printf ("Test 28: expected 2 messages in and 3 messages out but found %lld, %lld\n",
+			metrics->counters[MYQTT_METRIC_MSGS_IN], metrics->counters[MYQTT_METRIC_MSGS_OUT]);
+		return axl_false;
+	} /* end if */
+	if (metrics->counters[MYQTT_METRIC_BYTES_IN] <= 0 || metrics->counters[MYQTT_METRIC_BYTES_OUT] <= 0) {
+		printf ("Test 28: expected bytes in and out to be accounted\n");
+		return axl_false;
+	} /* end if */
+
+	hist = &metrics->histograms[MYQTT_METRIC_PUBLISH];
+	if (hist->count != 1 || myqtt_metrics_percentile (hist, 0.99) > hist->max || hist->min > hist->max) {
+		printf ("Test 28: expected 1 publish accounted but found count=%lld, min=%lld, max=%lld, p99=%lld\n",
+			hist->count, hist->min, hist->max, myqtt_metrics_percentile (hist, 0.99));
+		return axl_false;
+	} /* end if */
+
+	if (metrics->histograms[MYQTT_METRIC_AUTH].count != 1 || metrics->histograms[MYQTT_METRIC_SEQUENCER].count < 2) {
+		printf ("Test 28: expected 1 auth and at least 2 sequencer waits but found %lld, %lld\n",
+			metrics->histograms[MYQTT_METRIC_AUTH].count, metrics->histograms[MYQTT_METRIC_SEQUENCER].count);
+		return axl_false;
+	} /* end if */
+
+	/* server wide metrics: auth must be accounted only once */
+	memset (metrics, 0, sizeof (MyQttMetrics));
+	if (! myqttd_domain_get_metrics_all (ctx, metrics, axl_true)) {
+		printf ("Test 28: expected to get server metrics but failed..\n");
+		return axl_false;
+	} /* end if */
+	if (metrics->histograms[MYQTT_METRIC_AUTH].count != 1 || metrics->counters[MYQTT_METRIC_MSGS_IN] != 3 || metrics->counters[MYQTT_METRIC_MSGS_OUT] != 3) {
+		printf ("Test 28: expected 1 auth, 3 messages in and 3 out but found %lld, %lld, %lld\n",
+			metrics->histograms[MYQTT_METRIC_AUTH].count, metrics->counters[MYQTT_METRIC_MSGS_IN], metrics->counters[MYQTT_METRIC_MSGS_OUT]);
+		return axl_false;
+	} /* end if */
+
+	/* metrics were reset */
+	if (! myqttd_domain_get_metrics (domain, metrics, axl_false)) {
+		printf ("Test 28: expected to get domain metrics but failed..\n");
+		return axl_false;
+	} /* end if */
+	if (metrics->counters[MYQTT_METRIC_MSGS_IN] != 0 || metrics->histograms[MYQTT_METRIC_PUBLISH].count != 0) {
+		printf ("Test 28: expected metrics to be reset but found %lld messages in, %lld publish\n",
+			metrics->counters[MYQTT_METRIC_MSGS_IN], metrics->histograms[MYQTT_METRIC_PUBLISH].count);
+		return axl_false;
+	} /* end if */
+	axl_free (metrics);
+
+	/* finish server */
+	common_close_conn_and_ctx (conn);
+	myqttd_exit (ctx, axl_true, axl_true);
+
+	return axl_true;
+}
+
+axl_bool test_29 (void) {
+	MyQttdCtx       * ctx;
+	MyQttConn       * conn;
+	MyQttdDomain    * domain;
+	MyQttAsyncQueue * queue;
+	MyQttMsg        * msg;
+	int               iterator;
+
+	/* call to init the base library and close it */
+	printf ("Test 29: init library and server engine (using test_23.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_23.conf");
+	if (ctx == NULL) {
+		printf ("Test 29: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* connect and subscribe to $SYS clients topic */
+	conn = common_connect_and_subscribe (NULL, "test_02", "$SYS/broker/clients/connected", MYQTT_QOS_0, axl_false);
+	if (conn == NULL) {
+		printf ("Test 29: unable to connect to the domain..\n");
+		return axl_false;
+	} /* end if */
+	queue = common_configure_reception (conn);
+
+	/* clients are not allowed to publish on $SYS topics */
+	if (! common_send_msg (conn, "$SYS/broker/clients/connected", "1000", MYQTT_QOS_0)) {
+		printf ("Test 29: unable to send message\n");
+		return axl_false;
+	} /* end if */
+
+	/* next statistics (published every second) must report this
+	 * connection (skipping retained values from previous runs) */
+	iterator = 0;
+	while (axl_true) {
+		msg = myqtt_async_queue_timedpop (queue, 3000000);
+		if (msg == NULL) {
+			printf ("Test 29: expected to receive $SYS statistics but nothing was received..\n");
+			return axl_false;
+		} /* end if */
+		if (! axl_cmp (myqtt_msg_get_topic (msg), "$SYS/broker/clients/connected") ||
+		    axl_cmp ((const char *) myqtt_msg_get_app_msg (msg), "1000")) {
+			printf ("Test 29: received unexpected [%s] = %s\n",
+				myqtt_msg_get_topic (msg), (const char *) myqtt_msg_get_app_msg (msg));
+			return axl_false;
+		} /* end if */
+		if (axl_cmp ((const char *) myqtt_msg_get_app_msg (msg), "1")) {
+			myqtt_msg_unref (msg);
+			break;
+		} /* end if */
+		myqtt_msg_unref (msg);
+
+		iterator++;
+		if (iterator == 3) {
+			printf ("Test 29: expected to receive [$SYS/broker/clients/connected] = 1\n");
+			return axl_false;
+		} /* end if */
+	} /* end while */
+	myqtt_async_queue_unref (queue);
+
+	/* statistics are retained */
+	domain = myqttd_domain_find_by_name (ctx, "test_01.context");
+	if (myqtt_storage_retained_count (domain->myqtt_ctx) < 1) {
+		printf ("Test 29: expected to find retained $SYS topics but found %d\n", myqtt_storage_retained_count (domain->myqtt_ctx));
+		return axl_false;
+	} /* end if */
+
+	/* finish server */
+	common_close_conn_and_ctx (conn);
+	myqttd_exit (ctx, axl_true, axl_true);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Sends an HTTP GET request to the provided port and
+ * returns the entire reply received (or NULL if it fails).
+ */
+char * test_30_http_get (MyQttdCtx * ctx, const char * port, const char * path)
+{
+	MYQTT_SOCKET   session;
+	axlError     * err = NULL;
+	char         * request;
+	char         * reply;
+	int            size   = 65536;
+	int            length = 0;
+	int            result;
+
+	session = myqtt_conn_sock_connect (MYQTTD_MYQTT_CTX (ctx), "127.0.0.1", port, NULL, &err);
+	if (session == -1) {
+		printf ("Test 30: unable to connect to %s: %s\n", port, axl_error_get (err));
+		axl_error_free (err);
+		return NULL;
+	} /* end if */
+
+	request = axl_strdup_printf ("GET %s HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n", path);
+	if (send (session, request, strlen (request), 0) != strlen (request)) {
+		printf ("Test 30: unable to send request\n");
+		axl_free (request);
+		myqtt_close_socket (session);
+		return NULL;
+	} /* end if */
+	axl_free (request);
+
+	/* read until the server closes the connection */
+	reply = axl_new (char, size + 1);
+	while (length < size) {
+		result = recv (session, reply + length, size - length, 0);
+		if (result <= 0)
+			break;
+		length += result;
+	} /* end while */
+	myqtt_close_socket (session);
+
+	return reply;
+}
+
+axl_bool test_30 (void) {
+	MyQttdCtx       * ctx;
+	MyQttConn       * conn;
+	MyQttdDomain    * domain;
+	MyQttAsyncQueue * queue;
+	MyQttMetrics    * metrics;
+	char            * reply;
+	int               iterator;
+	MYQTT_SOCKET      slow;
+	axlError        * err = NULL;
+	struct timeval    start;
+	struct timeval    stop;
+	struct timeval    diff;
+
+	/* call to init the base library and close it */
+	printf ("Test 30: init library and server engine (using test_24.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_24.conf");
+	if (ctx == NULL) {
+		printf ("Test 30: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* check modules enabled to ensure it was loaded */
+	if (! myqttd_module_exists_by_name (ctx, "mod-prometheus")) {
+		printf ("Test 30: expected to find mod-prometheus module loaded...\n");
+		return axl_false;
+	} /* end if */
+
+	/* connect, subscribe, publish and receive */
+	conn = common_connect_and_subscribe (NULL, "test_02", "myqtt/test", MYQTT_QOS_0, axl_false);
+	if (conn == NULL) {
+		printf ("Test 30: unable to connect to the domain..\n");
+		return axl_false;
+	} /* end if */
+	queue = common_configure_reception (conn);
+	if (! common_send_msg (conn, "myqtt/test", "This is an application message", MYQTT_QOS_0)) {
+		printf ("Test 30: unable to send message\n");
+		return axl_false;
+	} /* end if */
+	if (! common_receive_and_check (queue, "myqtt/test", "This is an application message", MYQTT_QOS_0, axl_false)) {
+		printf ("Test 30: expected to receive different message..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_async_queue_unref (queue);
+
+	/* publish time is accounted once publish finishes */
+	metrics  = axl_new (MyQttMetrics, 1);
+	domain   = myqttd_domain_find_by_name (ctx, "test_01.context");
+	iterator = 0;
+	while (iterator < 100) {
+		if (myqttd_domain_get_metrics (domain, metrics, axl_false) && metrics->histograms[MYQTT_METRIC_PUBLISH].count == 1)
+			break;
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
+	axl_free (metrics);
+
+	/* scrape metrics */
+	reply = test_30_http_get (ctx, "9605", "/metrics");
+	if (reply == NULL)
+		return axl_false;
+	if (! axl_memcmp (reply, "HTTP/1.0 200 OK", 15) ||
+	    strstr (reply, "text/plain; version=0.0.4") == NULL ||
+	    strstr (reply, "myqttd_domain_connections{domain=\"test_01.context\"} 1\n") == NULL ||
+	    strstr (reply, "myqttd_domain_subscriptions{domain=\"test_01.context\"} 1\n") == NULL ||
+	    strstr (reply, "myqttd_domain_publish_received_total{domain=\"test_01.context\"} 1\n") == NULL ||
+	    strstr (reply, "myqttd_thread_pool_threads{domain=\"_server\",state=\"running\"}") == NULL ||
+	    strstr (reply, "myqttd_thread_pool_pending_tasks{domain=\"_server\"}") == NULL ||
+	    strstr (reply, "myqttd_domain_publish_sent_total{domain=\"test_01.context\"} 1\n") == NULL ||
+	    strstr (reply, "myqttd_child_processes 0\n") == NULL ||
+	    strstr (reply, "myqttd_domain_message_quota{domain=\"test_01.context\",period=\"day\"}") == NULL ||
+	    strstr (reply, "# TYPE myqtt_server_msgs_in_total counter\n") == NULL ||
+	    strstr (reply, "myqtt_msgs_in_total{domain=\"test_01.context\"}") == NULL ||
+	    strstr (reply, "\nmyqtt_msgs_in_total ") != NULL ||
+	    strstr (reply, "# TYPE myqtt_publish_latency_seconds histogram\n") == NULL ||
+	    strstr (reply, "myqtt_publish_latency_seconds_bucket{le=\"+Inf\"} 1\n") == NULL ||
+	    strstr (reply, "myqtt_publish_latency_seconds_count 1\n") == NULL) {
+		printf ("Test 30: expected to find different metrics, received:\n%s\n", reply);
+		axl_free (reply);
+		return axl_false;
+	} /* end if */
+	axl_free (reply);
+
+	/* anything else is not found */
+	reply = test_30_http_get (ctx, "9605", "/other");
+	if (reply == NULL)
+		return axl_false;
+	if (! axl_memcmp (reply, "HTTP/1.0 404", 12)) {
+		printf ("Test 30: expected to receive 404 reply but received:\n%s\n", reply);
+		axl_free (reply);
+		return axl_false;
+	} /* end if */
+	axl_free (reply);
+
+	/* a client connected without sending its request must not
+	 * block other scrapes */
+	slow = myqtt_conn_sock_connect (MYQTTD_MYQTT_CTX (ctx), "127.0.0.1", "9605", NULL, &err);
+	if (slow == -1) {
+		printf ("Test 30: unable to connect slow client: %s\n", axl_error_get (err));
+		axl_error_free (err);
+		return axl_false;
+	} /* end if */
+	myqtt_sleep (100000);
+	gettimeofday (&start, NULL);
+	reply = test_30_http_get (ctx, "9605", "/metrics");
+	gettimeofday (&stop, NULL);
+	myqtt_close_socket (slow);
+	if (reply == NULL)
+		return axl_false;
+	if (! axl_memcmp (reply, "HTTP/1.0 200 OK", 15)) {
+		printf ("Test 30: expected to receive metrics while another client is connected but received:\n%s\n", reply);
+		axl_free (reply);
+		return axl_false;
+	} /* end if */
+	axl_free (reply);
+	myqtt_timeval_substract (&stop, &start, &diff);
+	if (diff.tv_sec >= 1) {
+		printf ("Test 30: scrape was blocked by slow client (%d.%06d secs)\n", (int) diff.tv_sec, (int) diff.tv_usec);
+		return axl_false;
+	} /* end if */
+
+	/* finish server */
+	common_close_conn_and_ctx (conn);
+	myqttd_exit (ctx, axl_true, axl_true);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Counts lines found in the provided file containing the
+ * provided text.
+ */
+int test_31_count_lines (const char * file, const char * text)
+{
+	FILE * handle;
+	char   line[1024];
+	int    count = 0;
+
+	handle = fopen (file, "r");
+	if (handle == NULL)
+		return -1;
+	while (fgets (line, sizeof (line), handle)) {
+		if (strstr (line, text))
+			count++;
+	} /* end while */
+	fclose (handle);
+
+	return count;
+}
+
+MyQttdCtx * test_31_ctx = NULL;
+
+axlPointer test_31_producer (axlPointer _id)
+{
+	MyQttdCtx * ctx = test_31_ctx;
+	int         id  = PTR_TO_INT (_id);
+	int         iterator;
+
+	for (iterator = 0; iterator < 2000; iterator++) 
+		msg ("test_31 producer %d line %d", id, iterator);
+
+	return NULL;
+}
+
+void test_31_remove_logs (void)
+{
+	unlink ("test_25.main.log");
+	unlink ("test_25.error.log");
+	unlink ("test_25.access.log");
+	unlink ("test_25.myqtt.log");
+	return;
+}
+
+axl_bool test_31 (void) {
+	MyQttdCtx       * ctx;
+	MyQttThread       threads[4];
+	int               iterator;
+	int               count;
+	int               canary;
+
+	test_31_remove_logs ();
+
+	/* call to init the base library and close it */
+	printf ("Test 31: init library and server engine (using test_25.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_25.conf");
+	if (ctx == NULL) {
+		printf ("Test 31: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+	if (ctx->log_writer == NULL) {
+		printf ("Test 31: expected to find asynchronous log writer running..\n");
+		return axl_false;
+	} /* end if */
+
+	/* write from several threads while logs are reopened */
+	test_31_ctx = ctx;
+	for (iterator = 0; iterator < 4; iterator++) {
+		if (! myqtt_thread_create (&threads[iterator], (MyQttThreadFunc) test_31_producer, INT_TO_PTR (iterator), MYQTT_THREAD_CONF_END)) {
+			printf ("Test 31: failed to create producer thread..\n");
+			return axl_false;
+		} /* end if */
+	} /* end for */
+
+	for (iterator = 0; iterator < 20; iterator++) {
+		__myqttd_log_reopen (ctx);
+
+		/* take (and release) the next descriptor so a
+		 * recycled number is used by something else */
+		canary = open ("test_25.canary", O_CREAT | O_TRUNC | O_WRONLY, 0600);
+		if (canary >= 0)
+			close (canary);
+		myqtt_sleep (5000);
+	} /* end for */
+
+	for (iterator = 0; iterator < 4; iterator++) 
+		myqtt_thread_destroy (&threads[iterator], axl_false);
+
+	/* write everything pending */
+	__myqttd_log_reopen (ctx);
+
+	count = test_31_count_lines ("test_25.main.log", "test_31 producer");
+	printf ("Test 31: found %d lines written (expected 8000)\n", count);
+	if (count != 8000) {
+		printf ("Test 31: expected to find 8000 lines at test_25.main.log but found %d..\n", count);
+		return axl_false;
+	} /* end if */
+
+	/* nothing must go to other descriptors */
+	count = test_31_count_lines ("test_25.canary", "test_31 producer");
+	if (count > 0) {
+		printf ("Test 31: found %d log lines written to a recycled descriptor..\n", count);
+		return axl_false;
+	} /* end if */
+	unlink ("test_25.canary");
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+	test_31_remove_logs ();
+
+	return axl_true;
+}
+
+axl_bool test_32 (void) {
+	MyQttdCtx       * ctx;
+	axlNode         * node;
+	int               iterator;
+	int               count;
+
+	test_31_remove_logs ();
+
+	/* call to init the base library and close it */
+	printf ("Test 32: init library and server engine (using test_25.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_25.conf");
+	if (ctx == NULL) {
+		printf ("Test 32: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* configure 100 lines per second and apply it (reopen
+	 * reconfigures the running writer) */
+	node = axl_doc_get (myqttd_config_get (ctx), "/myqtt/global-settings/log-reporting");
+	axl_node_set_attribute (node, "max-lines-per-second", "100");
+	__myqttd_log_reopen (ctx);
+
+	for (iterator = 0; iterator < 500; iterator++) {
+		msg ("test_32 general line %d", iterator);
+		error ("test_32 error line %d", iterator);
+	} /* end for */
+
+	/* write everything pending */
+	__myqttd_log_reopen (ctx);
+
+	/* general log is limited (the burst may cross a second
+	 * boundary, so up to two windows are accepted, and other
+	 * server messages share the same window) */
+	count = test_31_count_lines ("test_25.main.log", "test_32 general line");
+	printf ("Test 32: general lines written %d of 500\n", count);
+	if (count < 50 || count > 200) {
+		printf ("Test 32: expected to find between 50 and 200 general lines but found %d..\n", count);
+		return axl_false;
+	} /* end if */
+	if (test_31_count_lines ("test_25.main.log", "log lines dropped (max-lines-per-second reached)") < 1) {
+		printf ("Test 32: expected to find dropped lines notice at test_25.main.log..\n");
+		return axl_false;
+	} /* end if */
+
+	/* errors are never limited */
+	count = test_31_count_lines ("test_25.error.log", "test_32 error line");
+	if (count != 500) {
+		printf ("Test 32: expected to find 500 error lines but found %d..\n", count);
+		return axl_false;
+	} /* end if */
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+	test_31_remove_logs ();
+
+	return axl_true;
+}
+
+/** 
+ * @internal Waits until the domain reports the provided amount of
+ * subscriptions (or the wait expires).
+ */
+int test_33_wait_subs (MyQttdDomain * domain, int expected)
+{
+	int iterator = 0;
+
+	while (iterator < 100 && myqttd_domain_subs_count (domain) != expected) {
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
+
+	return myqttd_domain_subs_count (domain);
+}
+
+axl_bool test_33 (void) {
+	MyQttdCtx       * ctx;
+	MyQttCtx        * myqtt_ctx;
+	MyQttConn       * conn;
+	MyQttdDomain    * domain;
+	int               sub_result;
+	int               iterator;
+	char            * topic = NULL;
+	char            * path;
+	unsigned int      hash_size;
+	unsigned int      denied_hash;
+	FILE            * handle;
+
+	/* cleanup test_33 storage */
+	if (system ("rm -rf reg-test-01/storage/test_33") != 0) {
+		printf ("ERROR: failed to initialize test..\n");
+		return axl_false;
+	} /* end if */
+
+	/* call to init the base library and close it */
+	printf ("Test 33: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 33: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	myqtt_ctx = common_init_ctx ();
+	if (! myqtt_init_ctx (myqtt_ctx)) {
+		printf ("Error: unable to initialize MyQtt library..\n");
+		return axl_false;
+	} /* end if */
+
+	/* connect with session (clean_session = axl_false) */
+	conn = myqtt_conn_new (myqtt_ctx, "test_33", axl_false, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+
+	/* subscribe twice to the same topic and to a wildcard topic */
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test", 0, &sub_result) ||
+	    ! myqtt_conn_sub (conn, 10, "myqtt/test", 0, &sub_result) ||
+	    ! myqtt_conn_sub (conn, 10, "myqtt/#", 0, &sub_result)) {
+		printf ("Test 33: unable to subscribe, sub_result=%d..\n", sub_result);
+		return axl_false;
+	} /* end if */
+
+	domain = myqttd_domain_find_by_name (ctx, "test_01.context");
+	if (test_33_wait_subs (domain, 2) != 2) {
+		printf ("Test 33: expected 2 subscriptions but found %d\n", myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
+
+	/* find a topic that is stored in a different hash directory
+	 * and block that directory so storage fails */
+	hash_size = domain->myqtt_ctx->storage_path_hash_size;
+	for (iterator = 0; iterator < 100; iterator++) {
+		axl_free (topic);
+		topic       = axl_strdup_printf ("myqtt/denied/%d", iterator);
+		denied_hash = axl_hash_string (topic) % hash_size;
+		if (denied_hash != (axl_hash_string ("myqtt/test") % hash_size) && 
+		    denied_hash != (axl_hash_string ("myqtt/#") % hash_size))
+			break;
+	} /* end for */
+	path   = axl_strdup_printf ("reg-test-01/storage/test_33/subs/%u", denied_hash);
+	handle = fopen (path, "w");
+	if (handle == NULL) {
+		printf ("Test 33: unable to create %s to make storage fail..\n", path);
+		return axl_false;
+	} /* end if */
+	fclose (handle);
+
+	/* subscription must be denied (storage failed) and not
+	 * accounted */
+	sub_result = 0;
+	if (myqtt_conn_sub (conn, 10, topic, 0, &sub_result) && sub_result != MYQTT_QOS_DENIED) {
+		printf ("Test 33: expected subscription to %s to be denied but found sub_result=%d..\n", topic, sub_result);
+		return axl_false;
+	} /* end if */
+	unlink (path);
+	axl_free (path);
+	axl_free (topic);
+
+	if (test_33_wait_subs (domain, 2) != 2) {
+		printf ("Test 33: expected 2 subscriptions after denied subscription but found %d\n", myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
+
+	/* unsubscribe wildcard topic */
+	if (! myqtt_conn_unsub (conn, "myqtt/#", 10)) {
+		printf ("Test 33: unable to unsubscribe..\n");
+		return axl_false;
+	} /* end if */
+	if (test_33_wait_subs (domain, 1) != 1) {
+		printf ("Test 33: expected 1 subscription after unsubscribe but found %d\n", myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
+
+	/* close connection: subscriptions are no longer installed */
+	myqtt_conn_close (conn);
+	if (test_33_wait_subs (domain, 0) != 0) {
+		printf ("Test 33: expected 0 subscriptions after close but found %d\n", myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
+
+	/* reconnect: session recovery restores the subscription */
+	conn = myqtt_conn_new (myqtt_ctx, "test_33", axl_false, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+	if (test_33_wait_subs (domain, 1) != 1) {
+		printf ("Test 33: expected 1 subscription restored from session but found %d\n", myqttd_domain_subs_count (domain));
+		return axl_false;
+	} /* end if */
+	if (myqttd_domain_session_count (domain) != 1) {
+		printf ("Test 33: expected 1 session but found %d\n", myqttd_domain_session_count (domain));
+		return axl_false;
+	} /* end if */
+
+	myqtt_conn_close (conn);
+	myqtt_exit_ctx (myqtt_ctx, axl_true);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+	if (system ("rm -rf reg-test-01/storage/test_33") != 0) 
+		printf ("Test 33: failed to cleanup storage..\n");
+		
+	return axl_true;
+}
+
+/** 
+ * @internal Publishes count messages with the provided size through
+ * conn and checks they are all received in order at queue, while
+ * checking the server side connection (client_id) gets paused.
+ */
+axl_bool test_34_publish_and_check (MyQttdCtx * ctx, MyQttdDomain * domain, MyQttConn * conn, MyQttAsyncQueue * queue, 
+				    const char * client_id, int count, int size, long min_elapsed)
+{
+	MyQttConn      * srv_conn;
+	MyQttMsg       * msg;
+	char           * payload;
+	char             prefix[32];
+	int              iterator;
+	axl_bool         paused = axl_false;
+	struct timeval   start;
+	struct timeval   stop;
+	struct timeval   diff;
+	long             elapsed;
+
+	payload = axl_new (char, size + 1);
+	memset (payload, 'a', size);
+
+	gettimeofday (&start, NULL);
+	for (iterator = 0; iterator < count; iterator++) {
+		/* place the message number at the beginning */
+		snprintf (prefix, sizeof (prefix), "%05d", iterator);
+		memcpy (payload, prefix, 5);
+		if (! myqtt_conn_pub (conn, "myqtt/test", payload, size, MYQTT_QOS_0, axl_false, 0)) {
+			printf ("Test 34: unable to publish message %d..\n", iterator);
+			return axl_false;
+		} /* end if */
+	} /* end for */
+	axl_free (payload);
+
+	/* server side connection must get paused */
+	myqtt_mutex_lock (&domain->myqtt_ctx->client_ids_m);
+	srv_conn = axl_hash_get (domain->myqtt_ctx->client_ids, (axlPointer) client_id);
+	if (srv_conn)
+		myqtt_conn_ref (srv_conn, "test_34");
+	myqtt_mutex_unlock (&domain->myqtt_ctx->client_ids_m);
+	if (srv_conn == NULL) {
+		printf ("Test 34: unable to find server side connection for %s..\n", client_id);
+		return axl_false;
+	} /* end if */
+
+	/* receive all messages in order */
+	for (iterator = 0; iterator < count; iterator++) {
+		if (myqtt_conn_is_blocked (srv_conn))
+			paused = axl_true;
+
+		msg = myqtt_async_queue_timedpop (queue, 10000000);
+		if (msg == NULL) {
+			printf ("Test 34: message %d wasn't received (lost while paused?)..\n", iterator);
+			return axl_false;
+		} /* end if */
+
+		snprintf (prefix, sizeof (prefix), "%05d", iterator);
+		if (myqtt_msg_get_app_msg_size (msg) != size || memcmp (myqtt_msg_get_app_msg (msg), prefix, 5)) {
+			printf ("Test 34: expected to receive message %d with size %d but found size %d..\n", 
+				iterator, size, myqtt_msg_get_app_msg_size (msg));
+			return axl_false;
+		} /* end if */
+		myqtt_msg_unref (msg);
+	} /* end for */
+	gettimeofday (&stop, NULL);
+	myqtt_timeval_substract (&stop, &start, &diff);
+	elapsed = diff.tv_sec * 1000000 + diff.tv_usec;
+
+	printf ("Test 34: received %d messages (%d bytes) in %ld ms (paused seen=%d)\n", count, size, elapsed / 1000, paused);
+	if (! paused) {
+		printf ("Test 34: expected to find server side connection paused by rate limits..\n");
+		return axl_false;
+	} /* end if */
+	if (elapsed < min_elapsed) {
+		printf ("Test 34: expected reception to take at least %ld ms but took %ld ms..\n", min_elapsed / 1000, elapsed / 1000);
+		return axl_false;
+	} /* end if */
+
+	/* connection resumed (__myqttd_run_resume_conn) */
+	iterator = 0;
+	while (iterator < 100 && myqtt_conn_is_blocked (srv_conn)) {
+		myqtt_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (myqtt_conn_is_blocked (srv_conn) || ! myqtt_conn_is_ok (srv_conn, axl_false)) {
+		printf ("Test 34: expected server side connection to be resumed and running..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_conn_unref (srv_conn, "test_34");
+
+	return axl_true;
+}
+
+axl_bool test_34 (void) {
+	MyQttdCtx       * ctx;
+	MyQttConn       * conn;
+	MyQttConn       * conn2;
+	MyQttdDomain    * domain;
+	MyQttAsyncQueue * queue;
+
+	/* call to init the base library and close it */
+	printf ("Test 34: init library and server engine (using test_02.conf)..\n");
+	ctx       = common_init_ctxd (NULL, "test_02.conf");
+	if (ctx == NULL) {
+		printf ("Test 34: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	domain = myqttd_domain_find_by_name (ctx, "test_01.context");
+	if (domain == NULL || domain->settings == NULL) {
+		printf ("Test 34: expected to find domain test_01.context with settings..\n");
+		return axl_false;
+	} /* end if */
+
+	/* subscriber and publisher */
+	conn = common_connect_and_subscribe (NULL, "test_02", "myqtt/test", MYQTT_QOS_0, axl_false);
+	if (conn == NULL) {
+		printf ("Test 34: unable to connect to the domain..\n");
+		return axl_false;
+	} /* end if */
+	queue = common_configure_reception (conn);
+
+	conn2 = myqtt_conn_new (myqtt_conn_get_ctx (conn), "test_02_0", axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn2, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+
+	/* message rate: 50 msgs/s with a burst of 10, so 100
+	 * messages need at least (100 - 10) / 50 = 1.8 seconds */
+	domain->settings->client_msg_rate   = 50;
+	domain->settings->client_msg_burst  = 10;
+	if (! test_34_publish_and_check (ctx, domain, conn2, queue, "test_02_0", 100, 32, 1500000))
+		return axl_false;
+
+	/* byte rate: 20000 bytes/s, so 20 messages of 2000 bytes
+	 * need at least (40000 - 20000) / 20000 = 1 second */
+	domain->settings->client_msg_rate   = 0;
+	domain->settings->client_msg_burst  = 0;
+	domain->settings->client_byte_rate  = 20000;
+	domain->settings->client_byte_burst = 20000;
+	if (! test_34_publish_and_check (ctx, domain, conn2, queue, "test_02_0", 20, 2000, 800000))
+		return axl_false;
+	domain->settings->client_byte_rate  = 0;
+	domain->settings->client_byte_burst = 0;
+
+	myqtt_async_queue_unref (queue);
+	myqtt_conn_close (conn2);
+	common_close_conn_and_ctx (conn);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
+
+#define CHECK_TEST(name) if (run_test_name == NULL || axl_cmp (run_test_name, name))
+
+typedef axl_bool (* MyQttTestHandler) (void);
+
+/** 
+ * @brief Helper handler that allows to execute the function provided
+ * with the message associated.
+ * @param function The handler to be called (test)
+ * @param message The message value.
+ */
+int run_test (MyQttTestHandler function, const char * message) {
+
+	printf ("--- --: starting %s\n", message);
+
+	if (function ()) {
+		printf ("%s [   OK   ]\n", message);
+	} else {
+		printf ("%s [ FAILED ]\n", message);
+		exit (-1);
+	}
+	return 0;
+}
+
+
+#ifdef AXL_OS_UNIX
+void __block_test (int _signal) 
+{
+	MyQttAsyncQueue * queue;
+	char * cmd;
+	int    _value; 
+
+	signal (_signal, __block_test);
+
+	printf ("******\n");
+	printf ("****** Received a signal=%d (the regression test is failing): pid %d..locking..!!!\n", _signal, myqtt_getpid ());
+	printf ("******\n");
+
+	/* block the caller */
+	queue = myqtt_async_queue_new ();
+	myqtt_async_queue_pop (queue);
+	
+	
+	cmd = axl_strdup_printf ("gdb -ex \"attach %d\"", (int) myqtt_getpid ());
+	_value = system (cmd);
+	printf ("Gdb finished with %d\n", _value);
+	axl_free (cmd); 
+	signal (_signal, __block_test);
+	return;
+}
+#endif
+
+
+/** 
+ * @brief General regression test to check all features inside myqtt
+ */
+#if defined(ENABLE_MYSQL_SUPPORT)
+/* prototypes to be able to use test functions from mod-auth-mysql */
+void __mod_auth_mysql_run_query_keep_acls_for_test (MyQttdCtx * ctx, const char * query);
+void __mod_auth_mysql_acl_config_for_test (MyQttdCtx * ctx, long ttl, const char * invalidate_topic);
+
+/** 
+ * @internal Prepares test_20.context with default accept policy and
+ * the test_20_02 user.
+ */
+void test_35_prepare (MyQttdCtx * ctx)
+{
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM domain");
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM user");
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM domain_acl");
+	__mod_auth_mysql_run_query_for_test (ctx, "INSERT INTO domain (name, is_active, default_acl) VALUES ('test_20.context', 1, 1)");
+	__mod_auth_mysql_run_query_for_test (ctx, "INSERT INTO user (domain_id,clientid,require_auth, is_active, allow_mqtt, allow_mqtt_ws, allow_mqtt_tls, allow_mqtt_wss) VALUES ((SELECT id FROM domain WHERE name = 'test_20.context'), 'test_20_02', 0, 1, 1, 1, 1, 1)");
+	return;
+}
+
+/** 
+ * @internal Reports if a QoS 2 publish on the provided topic is
+ * accepted (using a new connection each time because denied
+ * publications may close it).
+ */
+axl_bool test_35_publish (MyQttCtx * myqtt_ctx, const char * topic)
+{
+	MyQttConn * conn;
+	axl_bool    result;
+
+	conn = myqtt_conn_new (myqtt_ctx, "test_20_02", axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		myqtt_conn_close (conn);
+		return axl_false;
+	} /* end if */
+
+	result = myqtt_conn_pub (conn, topic, "this is a test", 14, MYQTT_QOS_2, axl_false, 10);
+	myqtt_conn_close (conn);
+	return result;
+}
+
+#define TEST_35_DENY_ACL "INSERT INTO domain_acl (domain_id, is_active, topic_filter, publish, action_if_matches) VALUES ((SELECT id FROM domain WHERE name = 'test_20.context'), '1', 'myqtt/denied/+', '1', '3')"
+
+axl_bool test_35 (void) {
+	MyQttdCtx       * ctx;
+	MyQttCtx        * myqtt_ctx;
+
+	printf ("Test 35: init library and server engine..\n");
+	ctx       = common_init_ctxd (NULL, "test_20.conf");
+	if (ctx == NULL) {
+		printf ("Test 35: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* cache acls for 2 seconds */
+	__mod_auth_mysql_acl_config_for_test (ctx, 2, NULL);
+	test_35_prepare (ctx);
+
+	myqtt_ctx = common_init_ctx ();
+	if (! myqtt_init_ctx (myqtt_ctx)) {
+		printf ("Error: unable to initialize MyQtt library..\n");
+		return axl_false;
+	} /* end if */
+
+	/* load acls (no acl: accepted) */
+	printf ("Test 35: publishing before adding deny acl..\n");
+	if (! test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be accepted before adding the deny acl..\n");
+		return axl_false;
+	} /* end if */
+
+	/* add acl without invalidating cached acls */
+	__mod_auth_mysql_run_query_keep_acls_for_test (ctx, TEST_35_DENY_ACL);
+
+	printf ("Test 35: publishing with acls cached..\n");
+	if (! test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be accepted while acls are cached (acl-ttl not working)..\n");
+		return axl_false;
+	} /* end if */
+
+	/* wait acl-ttl to expire */
+	printf ("Test 35: waiting acl-ttl to expire..\n");
+	sleep (3);
+	if (test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be denied once acl-ttl expired..\n");
+		return axl_false;
+	} /* end if */
+
+	/* other topics still accepted */
+	if (! test_35_publish (myqtt_ctx, "myqtt/allowed/topic")) {
+		printf ("ERROR: expected publish to be accepted on topics not matching the deny acl..\n");
+		return axl_false;
+	} /* end if */
+
+	myqtt_exit_ctx (myqtt_ctx, axl_true);
+
+	/* restore defaults */
+	__mod_auth_mysql_acl_config_for_test (ctx, 60, NULL);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
+
+axl_bool test_36 (void) {
+	MyQttdCtx       * ctx;
+	MyQttCtx        * myqtt_ctx;
+	MyQttdChild       child;
+	MyQttdHandoff   * handoff;
+	int               pair[2];
+
+	printf ("Test 36: init library and server engine..\n");
+	ctx       = common_init_ctxd (NULL, "test_20.conf");
+	if (ctx == NULL) {
+		printf ("Test 36: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	/* cache acls for long, invalidated through a topic */
+	__mod_auth_mysql_acl_config_for_test (ctx, 3600, "myqtt/acl/reload");
+	test_35_prepare (ctx);
+
+	myqtt_ctx = common_init_ctx ();
+	if (! myqtt_init_ctx (myqtt_ctx)) {
+		printf ("Error: unable to initialize MyQtt library..\n");
+		return axl_false;
+	} /* end if */
+
+	/* load acls and add a deny acl without invalidating them */
+	if (! test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be accepted before adding the deny acl..\n");
+		return axl_false;
+	} /* end if */
+	__mod_auth_mysql_run_query_keep_acls_for_test (ctx, TEST_35_DENY_ACL);
+	if (! test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be accepted while acls are cached..\n");
+		return axl_false;
+	} /* end if */
+
+	/* publish on the invalidation topic */
+	printf ("Test 36: publishing on acl-invalidate-topic..\n");
+	if (! test_35_publish (myqtt_ctx, "myqtt/acl/reload")) {
+		printf ("ERROR: expected publish on acl-invalidate-topic to be accepted..\n");
+		return axl_false;
+	} /* end if */
+	if (test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be denied after publishing on acl-invalidate-topic..\n");
+		return axl_false;
+	} /* end if */
+
+	/* now remove the acl (deny is still cached) and invalidate
+	 * through the command a child sends to the parent */
+	__mod_auth_mysql_run_query_keep_acls_for_test (ctx, "DELETE FROM domain_acl");
+	if (test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be denied while acls are cached..\n");
+		return axl_false;
+	} /* end if */
+
+	if (socketpair (AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+		printf ("Test 36: unable to create socket pair, errno=%d\n", errno);
+		return axl_false;
+	} /* end if */
+	memset (&child, 0, sizeof (MyQttdChild));
+	child.ctx              = ctx;
+
+	/* child side: send the command */
+	printf ("Test 36: sending acl invalidation from child to parent..\n");
+	child.child_connection = pair[0];
+	handoff = myqttd_process_handoff_new (-1, 'c', axl_false, "mod-auth-mysql:acl-invalidate", NULL);
+	if (! myqttd_process_send_sockets (&child, &handoff, 1)) {
+		printf ("Test 36: failed to send command..\n");
+		return axl_false;
+	} /* end if */
+	myqttd_process_handoff_free (handoff);
+
+	/* parent side: receive and run it */
+	child.child_connection = pair[1];
+	if (! myqttd_process_parent_notify (NULL, ctx, pair[1], &child, NULL)) {
+		printf ("Test 36: parent failed to receive command from child..\n");
+		return axl_false;
+	} /* end if */
+	close (pair[0]);
+	close (pair[1]);
+
+	if (! test_35_publish (myqtt_ctx, "myqtt/denied/topic")) {
+		printf ("ERROR: expected publish to be accepted after acl invalidation sent by child..\n");
+		return axl_false;
+	} /* end if */
+
+	myqtt_exit_ctx (myqtt_ctx, axl_true);
+
+	/* restore defaults */
+	__mod_auth_mysql_acl_config_for_test (ctx, 60, NULL);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
+
+/* prototypes to be able to use usage test functions from mod-auth-mysql */
+long __mod_auth_mysql_run_query_as_long_for_test (MyQttdCtx * ctx, const char * query);
+void __mod_auth_mysql_usage_config_for_test (MyQttdCtx * ctx, long flush_period, long flush_count);
+int  __mod_auth_mysql_usage_inc_for_test (MyQttdCtx * ctx, MyQttdDomain * domain, int user_id, axl_bool check_quota,
+					  long * day_usage, long * month_usage);
+void __mod_auth_mysql_usage_flush_for_test (MyQttdCtx * ctx);
+
+/** 
+ * @internal Checks the day (or month) usage written in the database
+ * for the user provided.
+ */
+axl_bool test_37_check_usage (MyQttdCtx * ctx, int user_id, const char * column, long expected, const char * label)
+{
+	char * query;
+	long   value;
+
+	query = axl_strdup_printf ("SELECT %s FROM user_msg_tracking WHERE user_id = %d", column, user_id);
+	value = __mod_auth_mysql_run_query_as_long_for_test (ctx, query);
+	axl_free (query);
+
+	if (value != expected) {
+		printf ("ERROR: %s: expected %s=%ld in the database but found %ld\n", label, column, expected, value);
+		return axl_false;
+	} /* end if */
+	return axl_true;
+}
+
+/** 
+ * @internal Accounts count messages for the user without checking
+ * quotas.
+ */
+axl_bool test_37_inc (MyQttdCtx * ctx, MyQttdDomain * domain, int user_id, int count)
+{
+	long day_usage, month_usage;
+
+	while (count > 0) {
+		if (__mod_auth_mysql_usage_inc_for_test (ctx, domain, user_id, axl_false, &day_usage, &month_usage) != 0) {
+			printf ("ERROR: expected message to be accounted..\n");
+			return axl_false;
+		} /* end if */
+		count--;
+	} /* end while */
+	return axl_true;
+}
+
+axl_bool test_37 (void) {
+	MyQttdCtx           * ctx;
+	MyQttdDomain          domain;
+	MyQttdDomainSetting   setting;
+	MyQttdChild           child;
+	int                   user_id;
+	long                  day_usage;
+	long                  month_usage;
+	char                * query;
+
+	printf ("Test 37: init library and server engine..\n");
+	ctx       = common_init_ctxd (NULL, "test_20.conf");
+	if (ctx == NULL) {
+		printf ("Test 37: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	test_35_prepare (ctx);
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM user_msg_tracking");
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM user_msg_tracking_history");
+	__mod_auth_mysql_run_query_for_test (ctx, "DELETE FROM user_msg_month_history");
+	user_id = __mod_auth_mysql_run_query_as_long_for_test (ctx, "SELECT id FROM user WHERE clientid = 'test_20_02'");
+	if (user_id <= 0) {
+		printf ("ERROR: expected to find test_20_02 user..\n");
+		return axl_false;
+	} /* end if */
+
+	/* domain without quotas */
+	memset (&setting, 0, sizeof (MyQttdDomainSetting));
+	memset (&domain, 0, sizeof (MyQttdDomain));
+	domain.settings = &setting;
+
+	/* flush after 3 increments */
+	printf ("Test 37: checking usage-flush-count..\n");
+	__mod_auth_mysql_usage_config_for_test (ctx, 3600, 3);
+	if (! test_37_inc (ctx, &domain, user_id, 2))
+		return axl_false;
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 0, "before reaching usage-flush-count"))
+		return axl_false;
+	if (! test_37_inc (ctx, &domain, user_id, 1))
+		return axl_false;
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 3, "after reaching usage-flush-count"))
+		return axl_false;
+
+	/* flush every second */
+	printf ("Test 37: checking usage-flush-period..\n");
+	__mod_auth_mysql_usage_config_for_test (ctx, 1, 1000);
+	if (! test_37_inc (ctx, &domain, user_id, 2))
+		return axl_false;
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 3, "before usage-flush-period"))
+		return axl_false;
+	sleep (3);
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 5, "after usage-flush-period"))
+		return axl_false;
+
+	/* failed writes are kept for the next flush */
+	printf ("Test 37: checking usage is written again after a failed flush..\n");
+	__mod_auth_mysql_usage_config_for_test (ctx, 3600, 1000);
+	if (! test_37_inc (ctx, &domain, user_id, 2))
+		return axl_false;
+	__mod_auth_mysql_run_query_for_test (ctx, "RENAME TABLE user_msg_tracking TO user_msg_tracking_test_37");
+	__mod_auth_mysql_usage_flush_for_test (ctx);
+	__mod_auth_mysql_run_query_for_test (ctx, "RENAME TABLE user_msg_tracking_test_37 TO user_msg_tracking");
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 5, "after failed flush"))
+		return axl_false;
+	__mod_auth_mysql_usage_flush_for_test (ctx);
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 7, "after retrying flush"))
+		return axl_false;
+
+	/* quotas: messages up to the quota are accepted */
+	printf ("Test 37: checking quotas at the exact boundary..\n");
+	setting.day_message_quota   = 10;
+	setting.month_message_quota = 1000;
+	day_usage = 0;
+	while (day_usage < 10) {
+		if (__mod_auth_mysql_usage_inc_for_test (ctx, &domain, user_id, axl_true, &day_usage, &month_usage) != 0) {
+			printf ("ERROR: expected message to be accepted (day usage %ld, quota 10)..\n", day_usage);
+			return axl_false;
+		} /* end if */
+	} /* end while */
+	if (__mod_auth_mysql_usage_inc_for_test (ctx, &domain, user_id, axl_true, &day_usage, &month_usage) != 1 || day_usage != 11) {
+		printf ("ERROR: expected day quota to be reached (day usage %ld)..\n", day_usage);
+		return axl_false;
+	} /* end if */
+	setting.day_message_quota   = 1000;
+	setting.month_message_quota = 10;
+	if (__mod_auth_mysql_usage_inc_for_test (ctx, &domain, user_id, axl_true, &day_usage, &month_usage) != 2 || month_usage != 11) {
+		printf ("ERROR: expected month quota to be reached (month usage %ld)..\n", month_usage);
+		return axl_false;
+	} /* end if */
+	__mod_auth_mysql_usage_flush_for_test (ctx);
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 10, "after reaching quotas"))
+		return axl_false;
+
+	/* day change in a child: only writes its pending usage */
+	printf ("Test 37: checking day change in childs..\n");
+	if (! test_37_inc (ctx, &domain, user_id, 1))
+		return axl_false;
+	memset (&child, 0, sizeof (MyQttdChild));
+	ctx->child = &child;
+	myqttd_ctx_notify_date_change (ctx, 1, MYQTTD_DATE_ITEM_DAY);
+	myqttd_ctx_notify_date_change (ctx, 1, MYQTTD_DATE_ITEM_MONTH);
+	ctx->child = NULL;
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 11, "after day change in child"))
+		return axl_false;
+	if (__mod_auth_mysql_run_query_as_long_for_test (ctx, "SELECT COUNT(*) FROM user_msg_tracking_history") != 0 ||
+	    __mod_auth_mysql_run_query_as_long_for_test (ctx, "SELECT COUNT(*) FROM user_msg_month_history") != 0) {
+		printf ("ERROR: expected no usage history recorded by childs..\n");
+		return axl_false;
+	} /* end if */
+
+	/* day and month change in the main process */
+	printf ("Test 37: checking day and month change in the main process..\n");
+	myqttd_ctx_notify_date_change (ctx, 1, MYQTTD_DATE_ITEM_DAY);
+	if (! test_37_check_usage (ctx, user_id, "current_day_usage", 0, "after day change"))
+		return axl_false;
+	if (! test_37_check_usage (ctx, user_id, "current_month_usage", 11, "after day change"))
+		return axl_false;
+	query = axl_strdup_printf ("SELECT day_usage FROM user_msg_tracking_history WHERE user_id = %d", user_id);
+	if (__mod_auth_mysql_run_query_as_long_for_test (ctx, "SELECT COUNT(*) FROM user_msg_tracking_history") != 1 ||
+	    __mod_auth_mysql_run_query_as_long_for_test (ctx, query) != 11) {
+		printf ("ERROR: expected a single day history record with 11 messages..\n");
+		return axl_false;
+	} /* end if */
+	axl_free (query);
+
+	myqttd_ctx_notify_date_change (ctx, 1, MYQTTD_DATE_ITEM_MONTH);
+	if (! test_37_check_usage (ctx, user_id, "current_month_usage", 0, "after month change"))
+		return axl_false;
+	if (__mod_auth_mysql_run_query_as_long_for_test (ctx, "SELECT COUNT(*) FROM user_msg_month_history") != 1) {
+		printf ("ERROR: expected a single month history record..\n");
+		return axl_false;
+	} /* end if */
+
+	/* usage is read again after the reset */
+	if (__mod_auth_mysql_usage_inc_for_test (ctx, &domain, user_id, axl_true, &day_usage, &month_usage) != 0 || day_usage != 1 || month_usage != 1) {
+		printf ("ERROR: expected usage to be read again after reset (day usage %ld, month usage %ld)..\n", day_usage, month_usage);
+		return axl_false;
+	} /* end if */
+
+	/* restore defaults */
+	__mod_auth_mysql_usage_config_for_test (ctx, 5, 1000);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
+#endif
+
+/** 
+ * @internal Reports if a QoS 2 publish on the provided topic is
+ * accepted by mod-auth-xml acls configured for test_38 (denied
+ * publications close the connection).
+ */
+axl_bool test_38_publish (MyQttCtx * myqtt_ctx, const char * topic)
+{
+	MyQttConn * conn;
+	axl_bool    result;
+
+	conn = myqtt_conn_new (myqtt_ctx, "test_38", axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		myqtt_conn_close (conn);
+		return axl_false;
+	} /* end if */
+
+	result = myqtt_conn_pub (conn, topic, "this is a test", 14, MYQTT_QOS_2, axl_false, 10) && myqtt_conn_is_ok (conn, axl_false);
+	myqtt_conn_close (conn);
+	return result;
+}
+
+axl_bool test_38 (void) {
+	MyQttdCtx       * ctx;
+	MyQttCtx        * myqtt_ctx;
+	const char      * allowed[] = {"myqtt/rw/topic", "myqtt/wr/topic", 
+				       "myqtt/wild/a/other", "myqtt/wild/a/b/topic",
+				       "myqtt/order/other", 
+				       "myqtt/first/denied", "myqtt/first/a/b",
+				       "myqtt/not-declared", NULL};
+	const char      * denied[]  = {"myqtt/r/topic", 
+				       "myqtt/wild/a/topic", "myqtt/deep/a", "myqtt/deep/a/b/c",
+				       "myqtt/order/denied", NULL};
+	int               iterator;
+
+	printf ("Test 38: init library and server engine..\n");
+	ctx       = common_init_ctxd (NULL, "test_26.conf");
+	if (ctx == NULL) {
+		printf ("Test 38: failed to start library and server engine..\n");
+		return axl_false;
+	} /* end if */
+
+	myqtt_ctx = common_init_ctx ();
+	if (! myqtt_init_ctx (myqtt_ctx)) {
+		printf ("Error: unable to initialize MyQtt library..\n");
+		return axl_false;
+	} /* end if */
+
+	/* "rw"/"wr" modes, wildcards not matching, first declared acl
+	 * (wildcard before exact) and topics without acls */
+	iterator = 0;
+	while (allowed[iterator]) {
+		printf ("Test 38: checking publish on %s is allowed..\n", allowed[iterator]);
+		if (! test_38_publish (myqtt_ctx, allowed[iterator])) {
+			printf ("ERROR: expected publish on %s to be allowed..\n", allowed[iterator]);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* "r" mode, wildcard acls (+ and #) and first declared acl
+	 * (exact before wildcard) */
+	iterator = 0;
+	while (denied[iterator]) {
+		printf ("Test 38: checking publish on %s is denied..\n", denied[iterator]);
+		if (test_38_publish (myqtt_ctx, denied[iterator])) {
+			printf ("ERROR: expected publish on %s to be denied..\n", denied[iterator]);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	myqtt_exit_ctx (myqtt_ctx, axl_true);
+
+	/* finish server */
+	myqttd_exit (ctx, axl_true, axl_true);
+		
+	return axl_true;
+}
+
+int main (int argc, char ** argv)
+{
+	char * run_test_name = NULL;
+
+	/* install default handling to get notification about
+	 * segmentation faults */
+#ifdef AXL_OS_UNIX
+	signal (SIGSEGV, __block_test);
+	signal (SIGABRT, __block_test);
+#endif
+
+	printf ("** MyQtt: A high performance open source MQTT implementation\n");
+	printf ("** Copyright (C) 2016 Advanced Software Production Line, S.L.\n**\n");
+	printf ("** Regression tests: %s \n",
+		VERSION);
+	printf ("** To gather information about time performance you can use:\n**\n");
+	printf ("**     time ./test_01 [--help] [--debug] [--no-unmap] [--run-test=NAME]\n**\n");
+	printf ("** To gather information about memory consumed (and leaks) use:\n**\n");
+	printf ("**     >> libtool --mode=execute valgrind --leak-check=yes --show-reachable=yes --error-limit=no ./test_01 [--debug]\n**\n");
+	printf ("** Providing --run-test=NAME will run only the provided regression test.\n");
+	printf ("** Available tests: test_00, test_01, test_02, test_03, test_03a, test_04, test_05\n");
+	printf ("**                  test_06, test_07, test_08, test_09, test_10, test_10a, test_10b, test_11\n");
+	printf ("**                  test_12, test_13, test_14, test_15, test_16, test_17\n");
+	printf ("**\n");
+	printf ("** Report bugs to:\n**\n");
+	printf ("**     <myqtt@lists.aspl.es> MyQtt Mailing list\n**\n");
+
+	/* uncomment the following four lines to get debug */
+	while (argc > 0) {
+		if (axl_cmp (argv[argc], "--help")) 
+			exit (0);
+		if (axl_cmp (argv[argc], "--debug")) 
+			test_common_enable_debug = axl_true;
+	
+		if (argv[argc] && axl_memcmp (argv[argc], "--run-test", 10)) {
+			run_test_name = argv[argc] + 11;
+			printf ("INFO: running test: %s\n", run_test_name);
+		}
+		argc--;
+	} /* end if */
+
+	/* run tests */
+	CHECK_TEST("test_00")
+	run_test (test_00, "Test 00: basic context initialization");
+
+	CHECK_TEST("test_01")
+	run_test (test_01, "Test 01: basic domain initialization (selecting one domain based on connection settings)");
+
+	CHECK_TEST("test_02")
+	run_test (test_02, "Test 02: sending 50 messages with 50 connections subscribed (2500 messages received)");
+
+	CHECK_TEST("test_03")
+	run_test (test_03, "Test 03: domain selection (working with two domains based on client_id selection)");
+
+	CHECK_TEST("test_03a")
+	run_test (test_03a, "Test 03-a: connection client_id recovery on conn shutdown");
+
+	CHECK_TEST("test_04")
+	run_test (test_04, "Test 04: domain selection (working with two domains based on user/password selection)");
+
+	CHECK_TEST("test_05")
+	run_test (test_05, "Test 05: domain selection (testing right users with wrong passwords)");
+
+	CHECK_TEST("test_06")
+	run_test (test_06, "Test 06: check loading domain settings");
+
+	CHECK_TEST("test_07")
+	run_test (test_07, "Test 07: testing connection limits to a domain");
+
+	CHECK_TEST("test_08")
+	run_test (test_08, "Test 08: test message size limit to a domain");
+
+	/* test following error */
+	/* Aug 28 18:11:13 node01 myqttd[14820]: **ERROR**: (myqtt) myqtt-reader.c:111: Requested to read an utf-8 string of length 12332 but limit is 48 */
+	/* send sending big messages */
+
+	CHECK_TEST("test_09")
+	run_test (test_09, "Test 09: check storage quota enforcement (amount of messages that can be saved on disk)");
+
+	CHECK_TEST("test_10")
+	run_test (test_10, "Test 10: checking client id (<drop-conn-same-client-id value=\"no\" />)");
+
+	CHECK_TEST("test_10a")
+	run_test (test_10a, "Test 10-a: checking client id (<drop-conn-same-client-id value=\"no\" />)");
+
+	CHECK_TEST("test_10b")
+	run_test (test_10b, "Test 10-b: check clean session and removed subscribed options");
+
+#if defined(ENABLE_TLS_SUPPORT)
+	CHECK_TEST("test_11")
+	run_test (test_11, "Test 11: checking domain activation when connected with TLS (hostname == domain name)");
+#endif
+
+#if defined(ENABLE_WEBSOCKET_SUPPORT)
+	CHECK_TEST("test_12")
+	run_test (test_12, "Test 12: checking domain activation when connected with WebSocket (hostname == domain name)");
+
+	CHECK_TEST("test_13")
+	run_test (test_13, "Test 13: checking domain activation when connected with WebSocket TLS (hostname == domain name)");
+#endif
+
+	CHECK_TEST("test_14")
+	run_test (test_14, "Test 14: checks that authentication fails when provided right hostname but wrong credentials");
+
+	CHECK_TEST("test_15")
+	run_test (test_15, "Test 15: test auth fails when no backend is enabled");
+
+	CHECK_TEST("test_16")
+	run_test (test_16, "Test 16: check wildcard subscription can be disabled globally or at certain domain or for a certain user");
+
+	CHECK_TEST("test_17")
+	run_test (test_17, "Test 17: check anonymous authentication with mod-auth-xml");
+
+	CHECK_TEST("test_18")
+	run_test (test_18, "Test 18: check global acls with mod-auth-xml");
+
+	CHECK_TEST("test_19")
+	run_test (test_19, "Test 19: check user acls with mod-auth-xml");
+
+#if defined(ENABLE_MYSQL_SUPPORT)
+	CHECK_TEST("test_20")
 	run_test (test_20, "Test 20: check auth mysql backend ");
 
 	CHECK_TEST("test_21")
@@ -3808,6 +5538,58 @@ int main (int argc, char ** argv)
 	CHECK_TEST("test_22")
 	run_test (test_22, "Test 22: time tracking (day and month change) ");
 
+	CHECK_TEST("test_23")
+	run_test (test_23, "Test 23: binary socket handoff between parent and child (batched SCM_RIGHTS)");
+
+	CHECK_TEST("test_24")
+	run_test (test_24, "Test 24: per-domain connection, session, subscription and message counters");
+
+	CHECK_TEST("test_25")
+	run_test (test_25, "Test 25: token buckets used by publish rate limits");
+
+	CHECK_TEST("test_26")
+	run_test (test_26, "Test 26: incremental reload of domain settings");
+
+#if defined(ENABLE_TLS_SUPPORT)
+	CHECK_TEST("test_27")
+	run_test (test_27, "Test 27: password verification (constant time compare, salted hashes, cache)");
+#endif
+
+	CHECK_TEST("test_28")
+	run_test (test_28, "Test 28: metrics counters and latency histograms per domain");
+
+	CHECK_TEST("test_29")
+	run_test (test_29, "Test 29: $SYS statistics topics");
+
+	CHECK_TEST("test_30")
+	run_test (test_30, "Test 30: mod-prometheus metrics endpoint");
+
+	CHECK_TEST("test_31")
+	run_test (test_31, "Test 31: asynchronous log writer: logs reopened while several threads log");
+
+	CHECK_TEST("test_32")
+	run_test (test_32, "Test 32: asynchronous log writer: max-lines-per-second drops lines (never errors)");
+
+	CHECK_TEST("test_33")
+	run_test (test_33, "Test 33: subscriptions accounted once installed (denied, unsubscribed and restored from session)");
+
+	CHECK_TEST("test_34")
+	run_test (test_34, "Test 34: publish rate limits pause and resume connections without losing messages");
+
+#if defined(ENABLE_MYSQL_SUPPORT)
+	CHECK_TEST("test_35")
+	run_test (test_35, "Test 35: mod-auth-mysql acls are cached for acl-ttl seconds");
+
+	CHECK_TEST("test_36")
+	run_test (test_36, "Test 36: mod-auth-mysql acl-invalidate-topic and acl invalidation sent by childs");
+
+	CHECK_TEST("test_37")
+	run_test (test_37, "Test 37: mod-auth-mysql write-behind message usage, quotas and day/month changes");
+#endif
+
+	CHECK_TEST("test_38")
+	run_test (test_38, "Test 38: mod-auth-xml acl modes, wildcard acls and declaration order");
+
 	/* check support to limit amount of subscriptions a user can
 	 * do */
 
@@ -0,0 +1,810 @@
+/* 
+ *  MyQtt: A high performance open source MQTT implementation
+ *  Copyright (C) 2016 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build MQTT enabled solutions contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         C/ Antonio Suarez Nº 10, 
+ *         Edificio Alius A, Despacho 102
+ *         Alcalá de Henares 28802 (Madrid)
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/mqtt
+ *                        http://www.aspl.es/myqtt
+ */
+
+#include <myqtt.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifdef AXL_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+/** 
+ * MyQtt performance regression suite (myqtt-perf)
+ *
+ * Runs a set of scenario based micro and macro benchmarks against a
+ * listener started inside this process, reporting results into a
+ * machine readable xml file that can be compared with a baseline
+ * from a previous run:
+ *
+ * >> ./myqtt-perf --output=perf.xml
+ * >> ./myqtt-perf --baseline=perf.xml --threshold=10
+ *
+ * Each result is identified by scenario and metric and flagged
+ * whether higher or lower values are better, so comparison reports
+ * a regression when a result gets worse than the threshold
+ * percentage (10% by default).
+ */
+
+/* listener and client contexts used by the suite */
+MyQttCtx   * server_ctx;
+MyQttCtx   * client_ctx;
+
+const char * listener_host   = "localhost";
+const char * listener_port   = "1939";
+
+axl_bool     perf_enable_debug = axl_false;
+
+/* scale factor: --quick runs 10 times less iterations */
+int          perf_scale        = 10;
+int          perf_fanout_subs  = 10000;
+int          perf_sessions     = 100000;
+
+typedef struct _PerfResult {
+	const char * scenario;
+	const char * metric;
+	double       value;
+	axl_bool     higher_better;
+} PerfResult;
+
+#define PERF_MAX_RESULTS 64
+
+PerfResult   results[PERF_MAX_RESULTS];
+int          results_count = 0;
+
+/* counter used to wait for messages received by the listener
+ * (on_publish) or by subscribers (on_msg) */
+MyQttMutex        counter_mutex;
+long              counter;
+long              counter_target;
+MyQttAsyncQueue * counter_queue;
+
+long long perf_now (void)
+{
+	struct timeval stamp;
+
+	gettimeofday (&stamp, NULL);
+	return ((long long) stamp.tv_sec * 1000000) + stamp.tv_usec;
+}
+
+double perf_secs (long long started)
+{
+	double secs = (double) (perf_now () - started) / 1000000;
+
+	/* avoid divisions by zero */
+	if (secs <= 0)
+		return 0.000001;
+	return secs;
+}
+
+void perf_record (const char * scenario, const char * metric, double value, axl_bool higher_better)
+{
+	if (results_count == PERF_MAX_RESULTS) {
+		printf ("ERROR: max results reached (%d), unable to record %s.%s\n", PERF_MAX_RESULTS, scenario, metric);
+		return;
+	} /* end if */
+
+	results[results_count].scenario      = scenario;
+	results[results_count].metric        = metric;
+	results[results_count].value         = value;
+	results[results_count].higher_better = higher_better;
+	results_count++;
+
+	printf ("      %s.%s = %.2f (%s is better)\n", scenario, metric, value, higher_better ? "higher" : "lower");
+	return;
+}
+
+void perf_counter_reset (long target)
+{
+	/* release pending notifications */
+	while (myqtt_async_queue_items (counter_queue) > 0)
+		myqtt_async_queue_pop (counter_queue);
+
+	myqtt_mutex_lock (&counter_mutex);
+	counter        = 0;
+	counter_target = target;
+	myqtt_mutex_unlock (&counter_mutex);
+	return;
+}
+
+void perf_counter_inc (void)
+{
+	myqtt_mutex_lock (&counter_mutex);
+	counter++;
+	if (counter == counter_target)
+		myqtt_async_queue_push (counter_queue, INT_TO_PTR (1));
+	myqtt_mutex_unlock (&counter_mutex);
+	return;
+}
+
+axl_bool perf_counter_wait (int seconds)
+{
+	if (myqtt_async_queue_timedpop (counter_queue, seconds * 1000000) != NULL)
+		return axl_true;
+
+	myqtt_mutex_lock (&counter_mutex);
+	printf ("ERROR: timeout while waiting for %ld events (received %ld)\n", counter_target, counter);
+	myqtt_mutex_unlock (&counter_mutex);
+	return axl_false;
+}
+
+MyQttPublishCodes perf_on_publish (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg, axlPointer user_data)
+{
+	/* parse scenario: count and skip relay */
+	if (axl_memcmp (myqtt_msg_get_topic (msg), "perf/parse", 10)) {
+		perf_counter_inc ();
+		return MYQTT_PUBLISH_DISCARD;
+	} /* end if */
+
+	return MYQTT_PUBLISH_OK;
+}
+
+void perf_on_msg (MyQttCtx * ctx, MyQttConn * conn, MyQttMsg * msg, axlPointer user_data)
+{
+	perf_counter_inc ();
+	return;
+}
+
+MyQttCtx * perf_init_ctx (const char * storage_path)
+{
+	MyQttCtx * ctx;
+
+	/* call to init the base library */
+	ctx = myqtt_ctx_new ();
+	if (! myqtt_init_ctx (ctx)) {
+		printf ("ERROR: unable to initialize MyQtt library..\n");
+		return NULL;
+	} /* end if */
+
+	/* enable log if requested by the user */
+	if (perf_enable_debug) {
+		myqtt_log_enable (ctx, axl_true);
+		myqtt_color_log_enable (ctx, axl_true);
+	} /* end if */
+
+	if (storage_path)
+		myqtt_storage_set_path (ctx, storage_path, 4096);
+
+	return ctx;
+}
+
+MyQttConn * perf_connect (const char * client_id)
+{
+	MyQttConn * conn;
+
+	conn = myqtt_conn_new (client_ctx, client_id, axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s (client id %s)..\n", listener_host, listener_port, client_id);
+		myqtt_conn_close (conn);
+		return NULL;
+	} /* end if */
+
+	return conn;
+}
+
+int perf_latency_cmp (const void * a, const void * b)
+{
+	long la = *((const long *) a);
+	long lb = *((const long *) b);
+
+	return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/** 
+ * @brief Topic filter matching throughput.
+ */
+axl_bool perf_topic_match (void)
+{
+	const char * filters[] = {"perf/+/status", "perf/#", "perf/a/b/c/d", "+/+/+/+", "sport/tennis/+/ranking", "#", "a/b/c", NULL};
+	const char * topics[]  = {"perf/a/status", "perf/a/b/c/d", "sport/tennis/player1/ranking", "other/topic/for/test", NULL};
+	long         iterations = 100000 * perf_scale;
+	long         iterator;
+	long         matches    = 0;
+	int          filter;
+	int          topic;
+	long long    started;
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < iterations) {
+		filter = iterator % 7;
+		topic  = iterator % 4;
+		if (myqtt_reader_topic_filter_match (topics[topic], filters[filter]))
+			matches++;
+		iterator++;
+	} /* end while */
+
+	if (matches == 0) {
+		printf ("ERROR: expected to find some matches\n");
+		return axl_false;
+	} /* end if */
+
+	perf_record ("topic_match", "ops_sec", iterations / perf_secs (started), axl_true);
+	return axl_true;
+}
+
+/** 
+ * @brief PUBLISH frame encode rate.
+ */
+axl_bool perf_encode (void)
+{
+	unsigned char   payload[64];
+	unsigned char * msg;
+	int             size;
+	long            iterations = 20000 * perf_scale;
+	long            iterator;
+	long long       started;
+
+	memset (payload, 'x', 64);
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < iterations) {
+		msg = myqtt_msg_build (client_ctx, MYQTT_PUBLISH, axl_false, MYQTT_QOS_1, axl_false, &size,
+				       MYQTT_PARAM_UTF8_STRING, 14, "perf/encode/64",
+				       MYQTT_PARAM_16BIT_INT, (int) (iterator % 65535) + 1,
+				       MYQTT_PARAM_BINARY_PAYLOAD, 64, payload,
+				       MYQTT_PARAM_END);
+		if (msg == NULL || size == 0) {
+			printf ("ERROR: failed to build PUBLISH message..\n");
+			return axl_false;
+		} /* end if */
+		myqtt_msg_free_build (client_ctx, msg, size);
+		iterator++;
+	} /* end while */
+
+	perf_record ("encode", "msgs_sec", iterations / perf_secs (started), axl_true);
+	return axl_true;
+}
+
+/** 
+ * @brief PUBLISH frame parse rate at the listener (reader path),
+ * feeding pre-built frames in big chunks.
+ */
+axl_bool perf_parse (void)
+{
+	MyQttConn     * conn;
+	unsigned char   payload[64];
+	unsigned char * frame;
+	unsigned char * chunk;
+	int             frame_size;
+	int             frames_per_chunk = 1000;
+	long            chunks = 20 * perf_scale;
+	long            iterator;
+	long long       started;
+	axl_bool        result;
+
+	conn = perf_connect ("perf-parse");
+	if (conn == NULL)
+		return axl_false;
+
+	/* build chunk with frames */
+	memset (payload, 'x', 64);
+	frame = myqtt_msg_build (client_ctx, MYQTT_PUBLISH, axl_false, MYQTT_QOS_0, axl_false, &frame_size,
+				 MYQTT_PARAM_UTF8_STRING, 13, "perf/parse/64",
+				 MYQTT_PARAM_BINARY_PAYLOAD, 64, payload,
+				 MYQTT_PARAM_END);
+	if (frame == NULL) {
+		printf ("ERROR: failed to build PUBLISH message..\n");
+		return axl_false;
+	} /* end if */
+	chunk = axl_new (unsigned char, frame_size * frames_per_chunk);
+	iterator = 0;
+	while (iterator < frames_per_chunk) {
+		memcpy (chunk + (iterator * frame_size), frame, frame_size);
+		iterator++;
+	} /* end while */
+	myqtt_msg_free_build (client_ctx, frame, frame_size);
+
+	perf_counter_reset (chunks * frames_per_chunk);
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < chunks) {
+		if (! myqtt_msg_send_raw (conn, chunk, frame_size * frames_per_chunk)) {
+			printf ("ERROR: failed to send chunk %ld..\n", iterator);
+			break;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	result = perf_counter_wait (60);
+	if (result) {
+		perf_record ("parse", "frames_sec", (chunks * frames_per_chunk) / perf_secs (started), axl_true);
+		perf_record ("parse", "mbytes_sec", ((double) chunks * frames_per_chunk * frame_size) / (1024 * 1024) / perf_secs (started), axl_true);
+	} /* end if */
+
+	axl_free (chunk);
+	myqtt_conn_close (conn);
+	return result;
+}
+
+/** 
+ * @brief Fan-out of one publisher to many subscribers (10k by
+ * default, limited by max open files allowed).
+ */
+axl_bool perf_fanout (void)
+{
+	MyQttConn    ** subs;
+	MyQttConn     * pub;
+	int             subs_count = perf_fanout_subs;
+	int             msgs       = 100;
+	int             iterator;
+	int             sub_result;
+	char          * client_id;
+	unsigned char   payload[64];
+	long long       started;
+	axl_bool        result     = axl_false;
+#ifdef AXL_OS_UNIX
+	struct rlimit   limit;
+
+	/* each subscriber requires two sockets inside this process */
+	if (getrlimit (RLIMIT_NOFILE, &limit) == 0) {
+		if (limit.rlim_cur < (rlim_t) (subs_count * 2 + 100)) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit (RLIMIT_NOFILE, &limit);
+			getrlimit (RLIMIT_NOFILE, &limit);
+		} /* end if */
+		if (limit.rlim_cur < (rlim_t) (subs_count * 2 + 100)) {
+			subs_count = (limit.rlim_cur - 100) / 2;
+			printf ("      (max open files is %d, limiting fan-out to %d subscribers)\n", (int) limit.rlim_cur, subs_count);
+		} /* end if */
+	} /* end if */
+#endif
+	if (subs_count < 1) {
+		printf ("ERROR: not enough file descriptors to run fan-out scenario..\n");
+		return axl_false;
+	} /* end if */
+
+	subs = axl_new (MyQttConn *, subs_count);
+
+	/* connect subscribers */
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < subs_count) {
+		client_id      = axl_strdup_printf ("perf-fanout-%d", iterator);
+		subs[iterator] = perf_connect (client_id);
+		axl_free (client_id);
+		if (subs[iterator] == NULL)
+			goto release;
+
+		myqtt_conn_set_on_msg (subs[iterator], perf_on_msg, NULL);
+		if (! myqtt_conn_sub (subs[iterator], 10, "perf/fanout", MYQTT_QOS_0, &sub_result)) {
+			printf ("ERROR: failed to subscribe (subscriber %d)..\n", iterator);
+			goto release;
+		} /* end if */
+		iterator++;
+	} /* end while */
+	perf_record ("fanout", "connect_sub_sec", subs_count / perf_secs (started), axl_true);
+
+	pub = perf_connect ("perf-fanout-pub");
+	if (pub == NULL)
+		goto release;
+
+	/* publish and wait for all deliveries */
+	memset (payload, 'x', 64);
+	perf_counter_reset ((long) subs_count * msgs);
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < msgs) {
+		if (! myqtt_conn_pub (pub, "perf/fanout", payload, 64, MYQTT_QOS_0, axl_false, 0)) {
+			printf ("ERROR: failed to publish fan-out message %d..\n", iterator);
+			break;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	result = perf_counter_wait (120);
+	if (result)
+		perf_record ("fanout", "deliveries_sec", ((double) subs_count * msgs) / perf_secs (started), axl_true);
+
+	myqtt_conn_close (pub);
+
+ release:
+	iterator = 0;
+	while (iterator < subs_count) {
+		if (subs[iterator])
+			myqtt_conn_close (subs[iterator]);
+		iterator++;
+	} /* end while */
+	axl_free (subs);
+
+	return result;
+}
+
+/** 
+ * @brief QoS 1 publish round-trip latency (PUBLISH -> PUBACK).
+ */
+axl_bool perf_qos1_rtt (void)
+{
+	MyQttConn     * conn;
+	unsigned char   payload[64];
+	int             iterations = 200 * perf_scale;
+	int             iterator;
+	long          * latencies;
+	long long       started;
+	long long       stamp;
+
+	conn = perf_connect ("perf-qos1-rtt");
+	if (conn == NULL)
+		return axl_false;
+
+	latencies = axl_new (long, iterations);
+	memset (payload, 'x', 64);
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < iterations) {
+		stamp = perf_now ();
+		if (! myqtt_conn_pub (conn, "perf/qos1", payload, 64, MYQTT_QOS_1, axl_false, 10)) {
+			printf ("ERROR: failed to publish QoS 1 message %d..\n", iterator);
+			axl_free (latencies);
+			myqtt_conn_close (conn);
+			return axl_false;
+		} /* end if */
+		latencies[iterator] = (long) (perf_now () - stamp);
+		iterator++;
+	} /* end while */
+
+	perf_record ("qos1_rtt", "msgs_sec", iterations / perf_secs (started), axl_true);
+
+	qsort (latencies, iterations, sizeof (long), perf_latency_cmp);
+	perf_record ("qos1_rtt", "p50_usecs", latencies[(int) ((iterations - 1) * 0.5)], axl_false);
+	perf_record ("qos1_rtt", "p99_usecs", latencies[(int) ((iterations - 1) * 0.99)], axl_false);
+
+	axl_free (latencies);
+	myqtt_conn_close (conn);
+	return axl_true;
+}
+
+/** 
+ * @brief Storage store/release rate for QoS 1 messages.
+ */
+axl_bool perf_storage (void)
+{
+	MyQttConn     * conn;
+	unsigned char   payload[64];
+	int             iterations = 500 * perf_scale;
+	int             iterator;
+	axlPointer    * handles;
+	long long       started;
+
+	conn = perf_connect ("perf-storage");
+	if (conn == NULL)
+		return axl_false;
+
+	handles = axl_new (axlPointer, iterations);
+	memset (payload, 'x', 64);
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < iterations) {
+		handles[iterator] = myqtt_storage_store_msg (client_ctx, conn, (iterator % 65535) + 1, MYQTT_QOS_1, payload, 64);
+		if (handles[iterator] == NULL) {
+			printf ("ERROR: failed to store message %d..\n", iterator);
+			break;
+		} /* end if */
+		iterator++;
+	} /* end while */
+	if (iterator == iterations)
+		perf_record ("storage", "store_sec", iterations / perf_secs (started), axl_true);
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < iterations && handles[iterator]) {
+		myqtt_storage_release_msg (client_ctx, conn, handles[iterator], payload, 64);
+		iterator++;
+	} /* end while */
+	if (iterator == iterations)
+		perf_record ("storage", "release_sec", iterations / perf_secs (started), axl_true);
+
+	axl_free (handles);
+	myqtt_conn_close (conn);
+	return iterator == iterations;
+}
+
+/** 
+ * @brief Cold start: time to load storage with many sessions (100k
+ * by default), each one with a subscription.
+ */
+axl_bool perf_cold_start (void)
+{
+	MyQttCtx  * ctx;
+	int         iterator;
+	int         loaded;
+	char        client_id[64];
+	char        topic[64];
+	long long   started;
+
+	if (system ("rm -rf .myqtt-perf/cold > /dev/null 2>&1"))
+		printf ("WARNING: failed to clean .myqtt-perf/cold\n");
+
+	/* create sessions */
+	ctx = perf_init_ctx (".myqtt-perf/cold");
+	if (ctx == NULL)
+		return axl_false;
+
+	started  = perf_now ();
+	iterator = 0;
+	while (iterator < perf_sessions) {
+		snprintf (client_id, 64, "perf-cold-%d", iterator);
+		snprintf (topic, 64, "perf/cold/%d", iterator);
+		if (! myqtt_storage_init_offline (ctx, client_id, MYQTT_STORAGE_ALL) ||
+		    ! myqtt_storage_sub_offline (ctx, client_id, topic, MYQTT_QOS_0)) {
+			printf ("ERROR: failed to create session %s..\n", client_id);
+			myqtt_exit_ctx (ctx, axl_true);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+	perf_record ("cold_start", "create_sessions_sec", perf_sessions / perf_secs (started), axl_true);
+	myqtt_exit_ctx (ctx, axl_true);
+
+	/* now load them into a fresh context */
+	ctx = perf_init_ctx (".myqtt-perf/cold");
+	if (ctx == NULL)
+		return axl_false;
+
+	started = perf_now ();
+	loaded  = myqtt_storage_load (ctx);
+	perf_record ("cold_start", "load_secs", perf_secs (started), axl_false);
+	myqtt_exit_ctx (ctx, axl_true);
+
+	if (system ("rm -rf .myqtt-perf/cold > /dev/null 2>&1"))
+		printf ("WARNING: failed to clean .myqtt-perf/cold\n");
+
+	if (loaded != perf_sessions) {
+		printf ("ERROR: expected to load %d subscriptions but found %d..\n", perf_sessions, loaded);
+		return axl_false;
+	} /* end if */
+
+	return axl_true;
+}
+
+axl_bool perf_write_results (const char * file)
+{
+	FILE * handle;
+	int    iterator;
+
+	handle = fopen (file, "w");
+	if (handle == NULL) {
+		printf ("ERROR: unable to open %s to write results..\n", file);
+		return axl_false;
+	} /* end if */
+
+	fprintf (handle, "<myqtt-perf version='%s' stamp='%ld'>\n", VERSION, (long) time (NULL));
+	iterator = 0;
+	while (iterator < results_count) {
+		fprintf (handle, "  <result scenario='%s' metric='%s' value='%.4f' better='%s' />\n",
+			 results[iterator].scenario, results[iterator].metric, results[iterator].value,
+			 results[iterator].higher_better ? "higher" : "lower");
+		iterator++;
+	} /* end while */
+	fprintf (handle, "</myqtt-perf>\n");
+	fclose (handle);
+
+	printf ("** Results written to: %s\n", file);
+	return axl_true;
+}
+
+/** 
+ * @brief Compares current results with the provided baseline,
+ * returning axl_false if any result regressed more than threshold
+ * percentage.
+ */
+axl_bool perf_compare (const char * file, double threshold)
+{
+	axlDoc    * doc;
+	axlNode   * node;
+	axlError  * error = NULL;
+	int         iterator;
+	double      baseline;
+	double      change;
+	axl_bool    regressed;
+	axl_bool    result = axl_true;
+
+	doc = axl_doc_parse_from_file (file, &error);
+	if (doc == NULL) {
+		printf ("ERROR: unable to load baseline %s: %s\n", file, axl_error_get (error));
+		axl_error_free (error);
+		return axl_false;
+	} /* end if */
+
+	printf ("** Comparing with baseline: %s (threshold %.2f%%)\n", file, threshold);
+	iterator = 0;
+	while (iterator < results_count) {
+		/* find result in baseline */
+		node = axl_doc_get (doc, "/myqtt-perf/result");
+		while (node) {
+			if (axl_cmp (ATTR_VALUE (node, "scenario"), results[iterator].scenario) &&
+			    axl_cmp (ATTR_VALUE (node, "metric"), results[iterator].metric))
+				break;
+			node = axl_node_get_next_called (node, "result");
+		} /* end while */
+
+		if (node == NULL) {
+			printf ("   %-20s %-20s %14.2f (not found in baseline)\n", results[iterator].scenario, results[iterator].metric, results[iterator].value);
+			iterator++;
+			continue;
+		} /* end if */
+
+		baseline = strtod (ATTR_VALUE (node, "value"), NULL);
+		change   = baseline != 0 ? ((results[iterator].value - baseline) * 100) / baseline : 0;
+
+		/* check if it got worse beyond threshold */
+		if (results[iterator].higher_better)
+			regressed = change < -threshold;
+		else
+			regressed = change > threshold;
+
+		printf ("   %-20s %-20s %14.2f %14.2f %+8.2f%% %s\n", results[iterator].scenario, results[iterator].metric, 
+			baseline, results[iterator].value, change, regressed ? "REGRESSION" : "ok");
+		if (regressed)
+			result = axl_false;
+		iterator++;
+	} /* end while */
+
+	axl_doc_free (doc);
+	return result;
+}
+
+#define CHECK_SCENARIO(name) if (run_scenario_name == NULL || axl_cmp (run_scenario_name, name))
+
+typedef axl_bool (* MyQttPerfHandler) (void);
+
+/** 
+ * @brief Helper handler that allows to execute the scenario provided
+ * with the message associated.
+ */
+int run_scenario (MyQttPerfHandler function, const char * message) {
+
+	printf ("---- --: starting %s\n", message);
+
+	if (function ()) {
+		printf ("%s [   OK   ]\n", message);
+	} else {
+		printf ("%s [ FAILED ]\n", message);
+		exit (-1);
+	}
+	return 0;
+}
+
+int main (int argc, char ** argv)
+{
+	char      * run_scenario_name = NULL;
+	char      * output            = "myqtt-perf-results.xml";
+	char      * baseline          = NULL;
+	double      threshold         = 10;
+	MyQttConn * listener;
+
+	printf ("** MyQtt: A high performance open source MQTT implementation\n");
+	printf ("** Copyright (C) 2016 Advanced Software Production Line, S.L.\n**\n");
+	printf ("** Performance regression suite: %s \n", VERSION);
+	printf ("**\n");
+	printf ("**     ./myqtt-perf [--help] [--debug] [--quick] [--run-scenario=NAME] [--output=FILE]\n");
+	printf ("**                  [--baseline=FILE] [--threshold=PERCENT] [--fanout-subs=NUM] [--sessions=NUM]\n**\n");
+	printf ("** Available scenarios: topic_match, encode, parse, fanout, qos1_rtt, storage, cold_start\n");
+	printf ("** Providing --baseline=FILE compares results with a previous run, failing when\n");
+	printf ("** any result is worse than threshold percentage (10%% by default).\n");
+	printf ("**\n");
+
+	while (argc > 0) {
+		if (axl_cmp (argv[argc], "--help")) 
+			exit (0);
+		if (axl_cmp (argv[argc], "--debug")) 
+			perf_enable_debug = axl_true;
+		if (axl_cmp (argv[argc], "--quick")) 
+			perf_scale = 1;
+		if (argv[argc] && axl_memcmp (argv[argc], "--run-scenario=", 15))
+			run_scenario_name = argv[argc] + 15;
+		if (argv[argc] && axl_memcmp (argv[argc], "--output=", 9))
+			output = argv[argc] + 9;
+		if (argv[argc] && axl_memcmp (argv[argc], "--baseline=", 11))
+			baseline = argv[argc] + 11;
+		if (argv[argc] && axl_memcmp (argv[argc], "--threshold=", 12))
+			threshold = strtod (argv[argc] + 12, NULL);
+		if (argv[argc] && axl_memcmp (argv[argc], "--fanout-subs=", 14))
+			perf_fanout_subs = atoi (argv[argc] + 14);
+		if (argv[argc] && axl_memcmp (argv[argc], "--sessions=", 11))
+			perf_sessions = atoi (argv[argc] + 11);
+		argc--;
+	} /* end while */
+
+	/* --quick also reduces macro scenarios */
+	if (perf_scale == 1) {
+		perf_fanout_subs = perf_fanout_subs > 1000 ? 1000 : perf_fanout_subs;
+		perf_sessions    = perf_sessions > 10000 ? 10000 : perf_sessions;
+	} /* end if */
+
+	if (system ("rm -rf .myqtt-perf > /dev/null 2>&1"))
+		printf ("WARNING: failed to clean .myqtt-perf\n");
+
+	myqtt_mutex_create (&counter_mutex);
+	counter_queue = myqtt_async_queue_new ();
+
+	/* start listener and client contexts */
+	server_ctx = perf_init_ctx (".myqtt-perf/listener");
+	client_ctx = perf_init_ctx (".myqtt-perf/client");
+	if (server_ctx == NULL || client_ctx == NULL)
+		return -1;
+
+	myqtt_ctx_set_on_publish (server_ctx, perf_on_publish, NULL);
+	listener = myqtt_listener_new (server_ctx, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (listener, axl_false)) {
+		printf ("ERROR: failed to start listener at: %s:%s..\n", listener_host, listener_port);
+		return -1;
+	} /* end if */
+
+	CHECK_SCENARIO("topic_match")
+	run_scenario (perf_topic_match, "Perf topic_match: topic filter matching throughput");
+
+	CHECK_SCENARIO("encode")
+	run_scenario (perf_encode, "Perf encode: PUBLISH encode rate");
+
+	CHECK_SCENARIO("parse")
+	run_scenario (perf_parse, "Perf parse: PUBLISH parse rate at listener");
+
+	CHECK_SCENARIO("fanout")
+	run_scenario (perf_fanout, "Perf fanout: one publisher to many subscribers");
+
+	CHECK_SCENARIO("qos1_rtt")
+	run_scenario (perf_qos1_rtt, "Perf qos1_rtt: QoS 1 publish round trip latency");
+
+	CHECK_SCENARIO("storage")
+	run_scenario (perf_storage, "Perf storage: message store/release rate");
+
+	CHECK_SCENARIO("cold_start")
+	run_scenario (perf_cold_start, "Perf cold_start: storage load with many sessions");
+
+	/* release contexts */
+	myqtt_exit_ctx (client_ctx, axl_true);
+	myqtt_exit_ctx (server_ctx, axl_true);
+	myqtt_async_queue_unref (counter_queue);
+	myqtt_mutex_destroy (&counter_mutex);
+
+	if (! perf_write_results (output))
+		return -1;
+
+	if (baseline && ! perf_compare (baseline, threshold)) {
+		printf ("** Performance regression found against %s\n", baseline);
+		return -1;
+	} /* end if */
+
+	printf ("All performance scenarios finished OK!\n");
+	return 0;
+}
@@ -43,6 +43,7 @@
 
 #if defined(ENABLE_TLS_SUPPORT)
 #include <myqtt-tls.h>
+#include <openssl/ssl.h>
 #endif
 
 #if defined(ENABLE_WEBSOCKET_SUPPORT)
@@ -3757,6 +3758,481 @@ axl_bool test_18 (void) {
 	return axl_true;
 }
 
+/** 
+ * @internal Does a raw TLS handshake against the provided port,
+ * optionally offering the provided session, reporting if it was
+ * reused and returning the session negotiated.
+ */
+axl_bool test_18b_handshake (MyQttCtx * ctx, SSL_CTX * ssl_ctx, const char * port, SSL_SESSION * offer, 
+			     axl_bool * reused, SSL_SESSION ** session)
+{
+	MYQTT_SOCKET   sock;
+	SSL          * ssl;
+	int            timeout = 10;
+	axlError     * error   = NULL;
+
+	sock = myqtt_conn_sock_connect (ctx, listener_host, port, &timeout, &error);
+	if (sock == -1) {
+		printf ("ERROR: unable to connect to %s:%s: %s\n", listener_host, port, axl_error_get (error));
+		axl_error_free (error);
+		return axl_false;
+	} /* end if */
+	myqtt_conn_set_sock_block (sock, axl_true);
+
+	ssl = SSL_new (ssl_ctx);
+	SSL_set_fd (ssl, sock);
+	if (offer)
+		SSL_set_session (ssl, offer);
+
+	if (SSL_connect (ssl) != 1) {
+		printf ("ERROR: TLS handshake failed with %s:%s\n", listener_host, port);
+		SSL_free (ssl);
+		myqtt_close_socket (sock);
+		return axl_false;
+	} /* end if */
+
+	(*reused) = SSL_session_reused (ssl) == 1;
+	if (session)
+		(*session) = SSL_get1_session (ssl);
+
+	SSL_shutdown (ssl);
+	SSL_free (ssl);
+	myqtt_close_socket (sock);
+	return axl_true;
+}
+
+axl_bool test_18b (void) {
+
+	MyQttCtx           * ctx = init_ctx ();
+	SSL_CTX            * ssl_ctx;
+	SSL_SESSION        * session = NULL;
+	axl_bool             reused;
+
+	if (! ctx)
+		return axl_false;
+
+	printf ("Test 18-b: checking TLS session resumption is bound to the listener\n");
+
+	/* raw client (no verification), TLS 1.2 so the ticket is
+	 * available once the handshake finishes */
+	ssl_ctx = SSL_CTX_new (SSLv23_client_method ());
+	SSL_CTX_set_verify (ssl_ctx, SSL_VERIFY_NONE, NULL);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	SSL_CTX_set_max_proto_version (ssl_ctx, TLS1_2_VERSION);
+#endif
+
+	/* full handshake */
+	if (! test_18b_handshake (ctx, ssl_ctx, listener_tls_port, NULL, &reused, &session))
+		return axl_false;
+	if (reused || session == NULL) {
+		printf ("ERROR: expected a full handshake on first connection (reused=%d, session=%p)\n", reused, session);
+		return axl_false;
+	} /* end if */
+
+	/* same listener: must resume */
+	if (! test_18b_handshake (ctx, ssl_ctx, listener_tls_port, session, &reused, NULL))
+		return axl_false;
+	if (! reused) {
+		printf ("ERROR: expected session to be resumed on %s:%s\n", listener_host, listener_tls_port);
+		return axl_false;
+	} /* end if */
+	printf ("Test 18-b: session resumed on %s:%s\n", listener_host, listener_tls_port);
+
+	/* different listener: must be rejected (full handshake) */
+	if (! test_18b_handshake (ctx, ssl_ctx, "1912", session, &reused, NULL))
+		return axl_false;
+	if (reused) {
+		printf ("ERROR: expected session from %s to be rejected on %s:1912\n", listener_tls_port, listener_host);
+		return axl_false;
+	} /* end if */
+	printf ("Test 18-b: session rejected on %s:1912\n", listener_host);
+
+	SSL_SESSION_free (session);
+	SSL_CTX_free (ssl_ctx);
+
+	/* release context */
+	printf ("Test 18-b: releasing context\n");
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
+
+axl_bool test_18c (void) {
+
+	MyQttCtx           * ctx = init_ctx ();
+	MyQttConn          * conn;
+	MyQttConnOpts      * opts;
+	MyQttAsyncQueue    * queue;
+	MyQttMsg           * msg;
+	int                  sub_result;
+	int                  iterator;
+	char                 content[32];
+	struct timeval       start;
+	struct timeval       stop;
+	struct timeval       diff;
+	long                 max_gap = 0;
+	long                 gap;
+
+	if (! ctx)
+		return axl_false;
+
+	printf ("Test 18-c: checking burst of small PUBLISH packets over TLS is delivered without delays\n");
+
+	/* disable verification */
+	opts = myqtt_conn_opts_new ();
+	myqtt_tls_opts_ssl_peer_verify (opts, axl_false);
+
+	conn = myqtt_tls_conn_new (ctx, "test_18c", axl_true, 30, listener_host, listener_tls_port, opts, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: expected being able to connect to %s:%s..\n", listener_host, listener_tls_port);
+		return axl_false;
+	} /* end if */
+
+	/* subscribe to the topic we are publishing */
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test/18c", 0, &sub_result)) {
+		printf ("ERROR: unable to subscribe, myqtt_conn_sub () failed, sub_result=%d\n", sub_result);
+		return axl_false;
+	} /* end if */
+
+	queue = myqtt_async_queue_new ();
+	myqtt_conn_set_on_msg (conn, test_03_on_message, queue);
+
+	/* send the burst */
+	iterator = 0;
+	while (iterator < 300) {
+		snprintf (content, sizeof (content), "burst %d", iterator);
+		if (! myqtt_conn_pub (conn, "myqtt/test/18c", content, strlen (content), MYQTT_QOS_0, axl_false, 0)) {
+			printf ("ERROR: unable to publish message %d..\n", iterator);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* receive it, checking the gap between messages: any reader
+	 * wait with content already buffered shows up here as a
+	 * gap close to the reader wait period (500ms) */
+	iterator = 0;
+	gettimeofday (&start, NULL);
+	while (iterator < 300) {
+		msg = myqtt_async_queue_timedpop (queue, 3000000);
+		if (msg == NULL) {
+			printf ("ERROR: expected to receive message %d but timeout was found..\n", iterator);
+			return axl_false;
+		} /* end if */
+		myqtt_msg_unref (msg);
+
+		gettimeofday (&stop, NULL);
+		myqtt_timeval_substract (&stop, &start, &diff);
+		gap = diff.tv_sec * 1000000 + diff.tv_usec;
+		if (gap > max_gap)
+			max_gap = gap;
+		start = stop;
+
+		iterator++;
+	} /* end while */
+
+	printf ("Test 18-c: received %d messages, max gap between messages %.2f ms\n", iterator, (double) max_gap / (double) 1000);
+	if (max_gap > 250000) {
+		printf ("ERROR: expected max gap between messages below 250 ms but found %.2f ms\n", (double) max_gap / (double) 1000);
+		return axl_false;
+	} /* end if */
+
+	myqtt_async_queue_unref (queue);
+
+	/* close connection */
+	myqtt_conn_close (conn);
+
+	/* release context */
+	printf ("Test 18-c: releasing context\n");
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Waits until the handshake pool of the provided context
+ * reports no pending handshake and at least the provided number of
+ * failed handshakes.
+ */
+void test_18d_wait_idle (MyQttCtx * ctx, long min_failed)
+{
+	int  queued, running;
+	long completed, failed, rejected;
+	int  iterator = 0;
+
+	while (iterator < 40) {
+		myqtt_tls_handshake_stats (ctx, &queued, &running, &completed, &failed, &rejected);
+		if (queued == 0 && running == 0 && failed >= min_failed)
+			return;
+		myqtt_sleep (50000);
+		iterator++;
+	} /* end while */
+	return;
+}
+
+axl_bool test_18d (void) {
+
+	MyQttCtx           * ctx = init_ctx ();
+	MyQttConn          * listener;
+	MyQttConn          * conn;
+	MyQttConnOpts      * opts;
+	MyQttAsyncQueue    * queue;
+	MyQttMsg           * msg;
+	MYQTT_SOCKET         slow;
+	MYQTT_SOCKET         sock;
+	SSL_CTX            * ssl_ctx;
+	SSL                * ssl;
+	axlError           * error = NULL;
+	int                  timeout = 10;
+	int                  sub_result;
+	int                  queued, running;
+	long                 completed, failed, rejected;
+	const char         * listener_host = "127.0.0.1";
+	const char         * listener_port = "27892";
+
+	if (! ctx)
+		return axl_false;
+
+	printf ("Test 18-d: checking TLS handshake pool (opt-in, max handshakes and stats)\n");
+
+	/* disabled by default: nothing is reported */
+	myqtt_tls_handshake_stats (ctx, &queued, &running, &completed, &failed, &rejected);
+	if (queued != 0 || running != 0 || completed != 0 || failed != 0 || rejected != 0) {
+		printf ("ERROR: expected empty handshake stats before enabling the pool\n");
+		return axl_false;
+	} /* end if */
+
+	/* one worker, one handshake at a time */
+	if (! myqtt_tls_set_handshake_pool (ctx, 1, 1)) {
+		printf ("ERROR: unable to configure handshake pool\n");
+		return axl_false;
+	} /* end if */
+	if (myqtt_tls_set_handshake_pool (ctx, 2, 10)) {
+		printf ("ERROR: expected handshake pool to be configured only once\n");
+		return axl_false;
+	} /* end if */
+
+	listener = myqtt_tls_listener_new (ctx, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (listener, axl_false)) {
+		printf ("ERROR: failed to start TLS listener at: %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+	if (! myqtt_tls_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: unable to setup certificate for %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+
+	/* slow peer: sends the first byte of a record and keeps the
+	 * only worker waiting for the rest of its handshake */
+	slow = myqtt_conn_sock_connect (ctx, listener_host, listener_port, &timeout, &error);
+	if (slow == -1) {
+		printf ("ERROR: unable to connect to %s:%s: %s\n", listener_host, listener_port, axl_error_get (error));
+		return axl_false;
+	} /* end if */
+	if (send (slow, "\x16", 1, 0) != 1) {
+		printf ("ERROR: unable to send first handshake byte\n");
+		return axl_false;
+	} /* end if */
+	myqtt_sleep (20000);
+
+	/* this handshake must be rejected (too many in progress) */
+	ssl_ctx = SSL_CTX_new (SSLv23_client_method ());
+	SSL_CTX_set_verify (ssl_ctx, SSL_VERIFY_NONE, NULL);
+	sock    = myqtt_conn_sock_connect (ctx, listener_host, listener_port, &timeout, &error);
+	if (sock == -1) {
+		printf ("ERROR: unable to connect to %s:%s: %s\n", listener_host, listener_port, axl_error_get (error));
+		return axl_false;
+	} /* end if */
+	myqtt_conn_set_sock_block (sock, axl_true);
+	ssl = SSL_new (ssl_ctx);
+	SSL_set_fd (ssl, sock);
+	if (SSL_connect (ssl) == 1) {
+		printf ("ERROR: expected handshake to be rejected while the pool is full\n");
+		return axl_false;
+	} /* end if */
+	SSL_free (ssl);
+	myqtt_close_socket (sock);
+	SSL_CTX_free (ssl_ctx);
+
+	myqtt_tls_handshake_stats (ctx, &queued, &running, &completed, &failed, &rejected);
+	printf ("Test 18-d: after rejection queued=%d running=%d completed=%ld failed=%ld rejected=%ld\n",
+		queued, running, completed, failed, rejected);
+	if (rejected != 1) {
+		printf ("ERROR: expected 1 rejected handshake but found %ld\n", rejected);
+		return axl_false;
+	} /* end if */
+
+	/* drop the slow peer: its handshake fails */
+	myqtt_close_socket (slow);
+	test_18d_wait_idle (ctx, 1);
+
+	/* now a regular connection must go through the pool and
+	 * be watched again by the reader once done */
+	opts = myqtt_conn_opts_new ();
+	myqtt_tls_opts_ssl_peer_verify (opts, axl_false);
+	conn = myqtt_tls_conn_new (ctx, "test_18d", axl_true, 30, listener_host, listener_port, opts, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: expected being able to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test/18d", 0, &sub_result)) {
+		printf ("ERROR: unable to subscribe, myqtt_conn_sub () failed, sub_result=%d\n", sub_result);
+		return axl_false;
+	} /* end if */
+	queue = myqtt_async_queue_new ();
+	myqtt_conn_set_on_msg (conn, test_03_on_message, queue);
+
+	if (! myqtt_conn_pub (conn, "myqtt/test/18d", "pooled", 6, MYQTT_QOS_0, axl_false, 0)) {
+		printf ("ERROR: unable to publish message..\n");
+		return axl_false;
+	} /* end if */
+	msg = myqtt_async_queue_timedpop (queue, 5000000);
+	if (msg == NULL) {
+		printf ("ERROR: expected to receive message over pooled TLS connection but timeout was found..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_msg_unref (msg);
+	myqtt_async_queue_unref (queue);
+
+	myqtt_tls_handshake_stats (ctx, &queued, &running, &completed, &failed, &rejected);
+	printf ("Test 18-d: final queued=%d running=%d completed=%ld failed=%ld rejected=%ld\n",
+		queued, running, completed, failed, rejected);
+	if (queued != 0 || running != 0) {
+		printf ("ERROR: expected no pending handshake but found queued=%d running=%d\n", queued, running);
+		return axl_false;
+	} /* end if */
+	if (completed != 1 || failed != 1 || rejected != 1) {
+		printf ("ERROR: expected completed=1 failed=1 rejected=1\n");
+		return axl_false;
+	} /* end if */
+
+	/* close connection */
+	myqtt_conn_close (conn);
+
+	/* release context (stops the pool) */
+	printf ("Test 18-d: releasing context\n");
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Creates a TLS listener on the provided context, connects
+ * to it and round trips content of different sizes, reporting if
+ * kTLS was activated on the client connection.
+ */
+axl_bool test_18e_round_trip (MyQttCtx * ctx, const char * port, axl_bool * ktls_on)
+{
+	MyQttConn          * listener;
+	MyQttConn          * conn;
+	MyQttConnOpts      * opts;
+	MyQttAsyncQueue    * queue;
+	MyQttMsg           * msg;
+	char               * content;
+	int                  sub_result;
+	int                  sizes[] = {10, 4096, 40000, -1};
+	int                  iterator;
+	int                  pos;
+
+	listener = myqtt_tls_listener_new (ctx, "127.0.0.1", port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (listener, axl_false)) {
+		printf ("ERROR: failed to start TLS listener at: 127.0.0.1:%s..\n", port);
+		return axl_false;
+	} /* end if */
+	if (! myqtt_tls_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: unable to setup certificate for 127.0.0.1:%s..\n", port);
+		return axl_false;
+	} /* end if */
+
+	opts = myqtt_conn_opts_new ();
+	myqtt_tls_opts_ssl_peer_verify (opts, axl_false);
+	conn = myqtt_tls_conn_new (ctx, "test_18e", axl_true, 30, "127.0.0.1", port, opts, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: expected being able to connect to 127.0.0.1:%s..\n", port);
+		return axl_false;
+	} /* end if */
+	(*ktls_on) = myqtt_tls_is_ktls_on (conn);
+
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test/18e", MYQTT_QOS_1, &sub_result)) {
+		printf ("ERROR: unable to subscribe, myqtt_conn_sub () failed, sub_result=%d\n", sub_result);
+		return axl_false;
+	} /* end if */
+	queue = myqtt_async_queue_new ();
+	myqtt_conn_set_on_msg (conn, test_03_on_message, queue);
+
+	iterator = 0;
+	while (sizes[iterator] > 0) {
+		content = axl_new (char, sizes[iterator]);
+		for (pos = 0; pos < sizes[iterator]; pos++)
+			content[pos] = 'a' + ((pos + iterator) % 26);
+
+		if (! myqtt_conn_pub (conn, "myqtt/test/18e", content, sizes[iterator], 
+				      iterator % 2 ? MYQTT_QOS_1 : MYQTT_QOS_0, axl_false, 10)) {
+			printf ("ERROR: unable to publish %d bytes..\n", sizes[iterator]);
+			return axl_false;
+		} /* end if */
+
+		msg = myqtt_async_queue_timedpop (queue, 5000000);
+		if (msg == NULL) {
+			printf ("ERROR: expected to receive %d bytes but timeout was found..\n", sizes[iterator]);
+			return axl_false;
+		} /* end if */
+		if (myqtt_msg_get_app_msg_size (msg) != sizes[iterator] || 
+		    memcmp (myqtt_msg_get_app_msg (msg), content, sizes[iterator]) != 0) {
+			printf ("ERROR: content of %d bytes received differs (size %d)\n", 
+				sizes[iterator], myqtt_msg_get_app_msg_size (msg));
+			return axl_false;
+		} /* end if */
+		myqtt_msg_unref (msg);
+		axl_free (content);
+
+		iterator++;
+	} /* end while */
+
+	myqtt_async_queue_unref (queue);
+	myqtt_conn_close (conn);
+	return axl_true;
+}
+
+axl_bool test_18e (void) {
+
+	MyQttCtx           * ctx;
+	axl_bool             supported;
+	axl_bool             ktls_on;
+
+	printf ("Test 18-e: checking kTLS opt-in, its report and fallback\n");
+
+	/* disabled (default): never reported as active */
+	ctx = init_ctx ();
+	if (! ctx)
+		return axl_false;
+	if (! test_18e_round_trip (ctx, "27893", &ktls_on))
+		return axl_false;
+	if (ktls_on) {
+		printf ("ERROR: kTLS reported as active without enabling it\n");
+		return axl_false;
+	} /* end if */
+	myqtt_exit_ctx (ctx, axl_true);
+
+	/* enabled: content must round trip no matter if the kernel
+	 * or the cipher support it (fallback to OpenSSL) */
+	ctx = init_ctx ();
+	if (! ctx)
+		return axl_false;
+	supported = myqtt_tls_set_ktls (ctx, axl_true);
+	if (! test_18e_round_trip (ctx, "27894", &ktls_on))
+		return axl_false;
+	printf ("Test 18-e: kTLS supported by this build=%d, active on connection=%d\n", supported, ktls_on);
+	if (! supported && ktls_on) {
+		printf ("ERROR: kTLS reported as active but this build does not support it\n");
+		return axl_false;
+	} /* end if */
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
+
 axl_bool test_19 (void) {
 
 	MyQttCtx        * ctx = init_ctx ();
@@ -4011,6 +4487,27 @@ axl_bool test_19a (void) {
 	/* release queue */
 	myqtt_async_queue_unref (queue);
 
+	/* connect again with same serverName (SSL context prepared
+	 * is reused at the server side) */
+	printf ("Test 19-a: connect again requesting serverName: test19a.localhost\n");
+	myqtt_conn_close (conn);
+	opts = myqtt_conn_opts_new ();
+	myqtt_tls_opts_ssl_peer_verify (opts, axl_false);
+	myqtt_tls_opts_set_server_name (opts, "test19a.localhost");
+	conn = myqtt_tls_conn_new (ctx, NULL, axl_false, 30, listener_host, listener_tls_port, opts, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: expected being able to connect to %s:%s..\n", listener_host, listener_tls_port);
+		return axl_false;
+	} /* end if */
+
+	fingerprint = myqtt_tls_get_peer_ssl_digest (conn, MYQTT_SHA1);
+	if (!axl_cmp (fingerprint, ref)) {
+		printf ("ERROR: expected different finger (second connection): %s\n", ref);
+		printf ("ERROR:              but received: %s\n", fingerprint);
+		return axl_false;
+	}
+	axl_free (fingerprint); 
+
 	/* close connection */
 	myqtt_conn_close (conn);
 	myqtt_conn_close (conn2);
@@ -4202,6 +4699,145 @@ axl_bool test_20b (void) {
 
 	return axl_true;
 }
+
+MyQttConn * test_20c_connect (MyQttCtx * ctx, noPollCtx * nopoll_ctx, const char * client_id, 
+			      const char * topic, MyQttAsyncQueue * queue)
+{
+	noPollConn      * nopoll_conn;
+	MyQttConn       * conn;
+	int               sub_result;
+
+	nopoll_conn  = nopoll_conn_new (nopoll_ctx, listener_host, listener_websocket_port, NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_is_ok (nopoll_conn)) {
+		printf ("ERROR: failed to connect remote host through WebSocket..\n");
+		return NULL;
+	} /* end if */
+
+	conn = myqtt_web_socket_conn_new (ctx, client_id, axl_true, 30, nopoll_conn, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: expected being able to connect to %s:%s..\n", listener_host, listener_websocket_port);
+		return NULL;
+	} /* end if */
+
+	if (! myqtt_conn_sub (conn, 10, topic, 0, &sub_result)) {
+		printf ("ERROR: unable to subscribe, myqtt_conn_sub () failed, sub_result=%d\n", sub_result);
+		return NULL;
+	} /* end if */
+
+	myqtt_conn_set_on_msg (conn, test_03_on_message, queue);
+	return conn;
+}
+
+axl_bool test_20c (void) {
+
+	MyQttCtx        * ctx = init_ctx ();
+	MyQttConn       * slow;
+	MyQttConn       * fast;
+	noPollCtx       * nopoll_ctx;
+	MyQttAsyncQueue * slow_queue;
+	MyQttAsyncQueue * fast_queue;
+	MyQttMsg        * msg;
+	char            * content;
+	int               iterator;
+	struct timeval    start;
+	struct timeval    stop;
+	struct timeval    diff;
+
+	if (! ctx)
+		return axl_false;
+
+	printf ("Test 20-c: checking WebSocket slow reader does not delay other connections\n");
+
+	nopoll_ctx = nopoll_ctx_new ();
+	slow_queue = myqtt_async_queue_new ();
+	fast_queue = myqtt_async_queue_new ();
+
+	slow = test_20c_connect (ctx, nopoll_ctx, "test_20c_slow", "myqtt/test/20c/slow", slow_queue);
+	fast = test_20c_connect (ctx, nopoll_ctx, "test_20c_fast", "myqtt/test/20c/fast", fast_queue);
+	if (slow == NULL || fast == NULL)
+		return axl_false;
+
+	/* stop reading from the slow connection */
+	myqtt_conn_block (slow, axl_true);
+
+	/* send enough content to the slow reader to fill socket
+	 * buffers at the listener so its frames are left pending */
+	printf ("Test 20-c: sending 512 messages (16K each) to the slow reader\n");
+	content  = axl_new (char, 16384);
+	iterator = 0;
+	while (iterator < 512) {
+		memset (content, 'x', 16384);
+		snprintf (content, 16, "%d", iterator);
+		if (! myqtt_conn_pub (fast, "myqtt/test/20c/slow", content, 16384, MYQTT_QOS_0, axl_false, 0)) {
+			printf ("ERROR: unable to publish message %d..\n", iterator);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	/* now check the fast connection is still served */
+	gettimeofday (&start, NULL);
+	if (! myqtt_conn_pub (fast, "myqtt/test/20c/fast", "ping", 4, MYQTT_QOS_0, axl_false, 0)) {
+		printf ("ERROR: unable to publish message to fast connection..\n");
+		return axl_false;
+	} /* end if */
+	msg = myqtt_async_queue_timedpop (fast_queue, 10000000);
+	if (msg == NULL) {
+		printf ("ERROR: expected to receive message on fast connection but nothing was found..\n");
+		return axl_false;
+	} /* end if */
+	myqtt_msg_unref (msg);
+	gettimeofday (&stop, NULL);
+	myqtt_timeval_substract (&stop, &start, &diff);
+
+	printf ("Test 20-c: fast connection served in %.2f ms while slow reader is blocked\n", 
+		(double) (diff.tv_sec * 1000000 + diff.tv_usec) / (double) 1000);
+	if (diff.tv_sec >= 1) {
+		printf ("ERROR: expected fast connection to be served in less than 1 second\n");
+		return axl_false;
+	} /* end if */
+
+	/* resume reading: frames left pending must be completed
+	 * once, in order and without corruption */
+	myqtt_conn_block (slow, axl_false);
+	iterator = 0;
+	while (iterator < 512) {
+		msg = myqtt_async_queue_timedpop (slow_queue, 10000000);
+		if (msg == NULL) {
+			printf ("ERROR: expected to receive message %d on slow connection but nothing was found..\n", iterator);
+			return axl_false;
+		} /* end if */
+
+		if (myqtt_msg_get_app_msg_size (msg) != 16384 || atoi (myqtt_msg_get_app_msg (msg)) != iterator) {
+			printf ("ERROR: expected message %d (16384 bytes) but found message %d (%d bytes)\n", 
+				iterator, atoi (myqtt_msg_get_app_msg (msg)), myqtt_msg_get_app_msg_size (msg));
+			return axl_false;
+		} /* end if */
+		myqtt_msg_unref (msg);
+		iterator++;
+	} /* end while */
+	printf ("Test 20-c: slow reader received %d messages\n", iterator);
+
+	/* nothing else expected (no frame sent twice) */
+	msg = myqtt_async_queue_timedpop (slow_queue, 500000);
+	if (msg != NULL) {
+		printf ("ERROR: expected no more messages on slow connection but found: %d\n", atoi (myqtt_msg_get_app_msg (msg)));
+		return axl_false;
+	} /* end if */
+
+	axl_free (content);
+	myqtt_async_queue_unref (slow_queue);
+	myqtt_async_queue_unref (fast_queue);
+
+	myqtt_conn_close (slow);
+	myqtt_conn_close (fast);
+
+	/* release context (this already closes provided noPollCtx (nopoll_ctx) */
+	printf ("Test 20-c: releasing context\n");
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
 #endif
 
 axl_bool test_21 (void) {
@@ -4785,6 +5421,288 @@ void match_topic (const char * topic, const char * filter, axl_bool should_match
 	return;
 }
 
+/** 
+ * @internal Reports packet ids currently in use on the provided
+ * connection as a string ("1,2,3").
+ */
+char * test_25_pkgids (MyQttConn * conn)
+{
+	char * result = axl_strdup ("");
+	char * temp;
+	int    iterator = 0;
+
+	myqtt_mutex_lock (&conn->op_mutex);
+	while (conn->sent_pkgids && iterator < axl_list_length (conn->sent_pkgids)) {
+		temp   = result;
+		result = axl_strdup_printf ("%s%s%d", temp, iterator > 0 ? "," : "", 
+					    PTR_TO_INT (axl_list_get_nth (conn->sent_pkgids, iterator)));
+		axl_free (temp);
+		iterator++;
+	} /* end while */
+	myqtt_mutex_unlock (&conn->op_mutex);
+
+	return result;
+}
+
+/** 
+ * @internal Receives count messages from the queue, checking all
+ * items published with QoS >= min_qos were received.
+ */
+axl_bool test_25_receive (MyQttAsyncQueue * queue, MyQttPubItem * items, int count, int min_qos, const char * label)
+{
+	MyQttMsg * msg;
+	axl_bool   seen[6];
+	int        iterator;
+	int        received = 0;
+
+	memset (seen, 0, sizeof (seen));
+	while (received < count) {
+		msg = myqtt_async_queue_timedpop (queue, 3000000);
+		if (msg == NULL)
+			break;
+		iterator = 0;
+		while (iterator < count) {
+			if (myqtt_msg_get_app_msg_size (msg) == items[iterator].app_message_size &&
+			    memcmp (myqtt_msg_get_app_msg (msg), items[iterator].app_message, items[iterator].app_message_size) == 0)
+				seen[iterator] = axl_true;
+			iterator++;
+		} /* end while */
+		myqtt_msg_unref (msg);
+		received++;
+	} /* end while */
+
+	iterator = 0;
+	while (iterator < count) {
+		if (! seen[iterator] && (items[iterator].qos & ~MYQTT_QOS_SKIP_STORAGE) >= min_qos) {
+			printf ("ERROR: %s: expected to receive item %d (%s) but it wasn't found\n", 
+				label, iterator, (const char *) items[iterator].app_message);
+			return axl_false;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	return axl_true;
+}
+
+axl_bool test_25 (void)
+{
+	MyQttCtx        * ctx = init_ctx ();
+	MyQttCtx        * ctx2;
+	MyQttConn       * conn;
+	MyQttConn       * conn2;
+	MyQttAsyncQueue * queue;
+	MyQttPubBatch   * batch;
+	MyQttPubItem      items[6];
+	const char      * contents[] = {"batch qos 0 (a)", "batch qos 1 (a)", "batch qos 2 (a)",
+					"batch qos 0 (b)", "batch qos 1 (b)", "batch qos 2 (b)"};
+	int               iterator;
+	int               sub_result;
+	int               confirmed;
+	char            * first_ids;
+	char            * ids;
+
+	if (! ctx)
+		return axl_false;
+
+	printf ("Test 25: checking myqtt_conn_pub_batch and myqtt_conn_pub_batch_wait..\n");
+
+	conn = myqtt_conn_new (ctx, "test_25", axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+
+	if (! myqtt_conn_sub (conn, 10, "myqtt/test/25", MYQTT_QOS_2, &sub_result)) {
+		printf ("ERROR: unable to subscribe, myqtt_conn_sub () failed, sub_result=%d\n", sub_result);
+		return axl_false;
+	} /* end if */
+	queue = myqtt_async_queue_new ();
+	myqtt_conn_set_on_msg (conn, test_03_on_message, queue);
+
+	/* mixed QoS 0/1/2 items */
+	iterator = 0;
+	while (iterator < 6) {
+		items[iterator].topic_name       = "myqtt/test/25";
+		items[iterator].app_message      = (axlPointer) contents[iterator];
+		items[iterator].app_message_size = strlen (contents[iterator]);
+		items[iterator].qos              = iterator % 3;
+		items[iterator].retain           = axl_false;
+		iterator++;
+	} /* end while */
+
+	/* publish and wait */
+	batch = myqtt_conn_pub_batch (conn, items, 6, 10);
+	if (batch == NULL) {
+		printf ("ERROR: expected to queue batch but NULL was found\n");
+		return axl_false;
+	} /* end if */
+	first_ids = test_25_pkgids (conn);
+	if (! myqtt_conn_pub_batch_wait (batch, &confirmed) || confirmed != 6) {
+		printf ("ERROR: expected batch to be published (confirmed=%d)\n", confirmed);
+		return axl_false;
+	} /* end if */
+	if (! test_25_receive (queue, items, 6, 0, "batch with wait"))
+		return axl_false;
+	printf ("Test 25: batch published (packet ids: %s)\n", first_ids);
+
+	/* packet ids are released once the batch completes and
+	 * reused by the next one */
+	ids = test_25_pkgids (conn);
+	if (strlen (ids) != 0) {
+		printf ("ERROR: expected no packet id in use after batch completion but found: %s\n", ids);
+		return axl_false;
+	} /* end if */
+	axl_free (ids);
+
+	batch = myqtt_conn_pub_batch (conn, items, 6, 10);
+	if (batch == NULL) {
+		printf ("ERROR: expected to queue second batch but NULL was found\n");
+		return axl_false;
+	} /* end if */
+	ids = test_25_pkgids (conn);
+	if (! axl_cmp (ids, first_ids)) {
+		printf ("ERROR: expected packet ids to be reused (%s) but found: %s\n", first_ids, ids);
+		return axl_false;
+	} /* end if */
+	axl_free (ids);
+	if (! myqtt_conn_pub_batch_wait (batch, &confirmed) || confirmed != 6) {
+		printf ("ERROR: expected second batch to be published (confirmed=%d)\n", confirmed);
+		return axl_false;
+	} /* end if */
+	if (! test_25_receive (queue, items, 6, 0, "second batch"))
+		return axl_false;
+
+	/* wait_publish=0: confirmed once queued */
+	batch = myqtt_conn_pub_batch (conn, items, 6, 0);
+	if (batch == NULL) {
+		printf ("ERROR: expected to queue batch (wait_publish=0) but NULL was found\n");
+		return axl_false;
+	} /* end if */
+	if (! myqtt_conn_pub_batch_wait (batch, &confirmed) || confirmed != 6) {
+		printf ("ERROR: expected batch (wait_publish=0) to be confirmed once queued (confirmed=%d)\n", confirmed);
+		return axl_false;
+	} /* end if */
+	if (! test_25_receive (queue, items, 6, 1, "batch without wait"))
+		return axl_false;
+
+	/* failure to queue with the sequencer (on its own context
+	 * so nothing else uses that sequencer meanwhile) */
+	ctx2  = init_ctx ();
+	conn2 = myqtt_conn_new (ctx2, "test_25b", axl_true, 30, listener_host, listener_port, NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (conn2, axl_false)) {
+		printf ("ERROR: unable to connect to %s:%s..\n", listener_host, listener_port);
+		return axl_false;
+	} /* end if */
+	ctx2->myqtt_exit = axl_true;
+	batch = myqtt_conn_pub_batch (conn2, items, 6, 10);
+	ctx2->myqtt_exit = axl_false;
+	if (batch != NULL) {
+		printf ("ERROR: expected batch to fail when the sequencer rejects it\n");
+		return axl_false;
+	} /* end if */
+	if (myqtt_async_queue_timedpop (queue, 500000) != NULL) {
+		printf ("ERROR: expected no message to be published by a failed batch\n");
+		return axl_false;
+	} /* end if */
+
+	/* connection keeps working after the failure */
+	batch = myqtt_conn_pub_batch (conn2, items, 6, 10);
+	if (! myqtt_conn_pub_batch_wait (batch, &confirmed) || confirmed != 6) {
+		printf ("ERROR: expected batch after failure to be published (confirmed=%d)\n", confirmed);
+		return axl_false;
+	} /* end if */
+	if (! test_25_receive (queue, items, 6, 0, "batch after failure"))
+		return axl_false;
+
+	myqtt_conn_close (conn2);
+	myqtt_exit_ctx (ctx2, axl_true);
+
+	axl_free (first_ids);
+	myqtt_async_queue_unref (queue);
+	myqtt_conn_close (conn);
+
+	/* release context */
+	printf ("Test 25: releasing context\n");
+	myqtt_exit_ctx (ctx, axl_true);
+
+	return axl_true;
+}
+
+/** 
+ * @internal Gets the numeric value of the provided field from the
+ * json report produced by myqtt-client --bench.
+ */
+double test_26_field (const char * report, const char * field)
+{
+	char       * key   = axl_strdup_printf ("\"%s\": ", field);
+	const char * value = strstr (report, key);
+	double       result = -1;
+
+	if (value)
+		result = strtod (value + strlen (key), NULL);
+	axl_free (key);
+	return result;
+}
+
+axl_bool test_26 (void)
+{
+	char   * command;
+	char   * report;
+	double   published;
+	double   received;
+	double   recv_duration;
+	double   recv_rate;
+
+	printf ("Test 26: checking myqtt-client --bench mode (smoke test)..\n");
+
+	if (access ("../client/myqtt-client", X_OK) != 0) {
+		printf ("Test 26: ../client/myqtt-client not found (client not built), skipping\n");
+		return axl_true;
+	} /* end if */
+
+	/* run a short benchmark against the regression listener */
+	command = axl_strdup_printf ("../client/myqtt-client --host %s --port %s --bench --bench-publishers 2 --bench-subscribers 1 "
+				     "--bench-qos 0,1,2 --bench-rate 100 --bench-duration 1 --bench-report json > test_26.res",
+				     listener_host, listener_port);
+	if (system (command) != 0) {
+		printf ("ERROR: system(\"%s\") command failed\n", command);
+		return axl_false;
+	} /* end if */
+	axl_free (command);
+
+	report = myqtt_test_read_file ("test_26.res", NULL);
+	if (report == NULL) {
+		printf ("ERROR: unable to read benchmark report\n");
+		return axl_false;
+	} /* end if */
+	printf ("Test 26: report: %s", report);
+
+	published     = test_26_field (report, "published");
+	received      = test_26_field (report, "received");
+	recv_duration = test_26_field (report, "recv_duration");
+	recv_rate     = test_26_field (report, "recv_msgs_sec");
+	if (published <= 0 || received <= 0 || test_26_field (report, "pub_errors") != 0) {
+		printf ("ERROR: expected messages to be published and received without errors\n");
+		return axl_false;
+	} /* end if */
+
+	/* receive rate is measured until the last message received */
+	if (recv_duration <= 0 || recv_rate <= 0 || (recv_rate - (received / recv_duration)) > 1 || (received / recv_duration) - recv_rate > 1) {
+		printf ("ERROR: expected recv_msgs_sec (%.2f) to be received (%.0f) / recv_duration (%.3f)\n", 
+			recv_rate, received, recv_duration);
+		return axl_false;
+	} /* end if */
+	if (test_26_field (report, "p50") < 0) {
+		printf ("ERROR: expected latency percentiles in the report\n");
+		return axl_false;
+	} /* end if */
+
+	axl_free (report);
+	unlink ("test_26.res");
+
+	return axl_true;
+}
+
 axl_bool test_00_d (void)
 {
 
@@ -5410,6 +6328,18 @@ int main (int argc, char ** argv)
 	CHECK_TEST("test_18")
 	run_test (test_18, "Test 18: check TLS support"); 
 
+	CHECK_TEST("test_18b")
+	run_test (test_18b, "Test 18-b: check TLS session resumption on same listener and rejection on a different one"); 
+
+	CHECK_TEST("test_18c")
+	run_test (test_18c, "Test 18-c: check burst of small PUBLISH packets over TLS is delivered without reader delays"); 
+
+	CHECK_TEST("test_18d")
+	run_test (test_18d, "Test 18-d: check TLS handshake pool, max handshakes rejection and stats"); 
+
+	CHECK_TEST("test_18e")
+	run_test (test_18e, "Test 18-e: check kTLS report and content round trip with and without kTLS"); 
+
 	CHECK_TEST("test_19")
 	run_test (test_19, "Test 19: check TLS support (server side certificate auth: common CA)"); 
 
@@ -5424,6 +6354,9 @@ int main (int argc, char ** argv)
 
 	CHECK_TEST("test_20b")
 	run_test (test_20b, "Test 20-b: check WebSocket support (basic MQTT over wss://)"); 
+
+	CHECK_TEST("test_20c")
+	run_test (test_20c, "Test 20-c: check WebSocket slow reader does not delay other connections and pending frames are completed once"); 
 #endif
 
 	/* test close connection after publish... */
@@ -5442,6 +6375,12 @@ int main (int argc, char ** argv)
 	CHECK_TEST("test_24")
 	run_test (test_24, "Test 24: check clean session and removed subscribed options"); 
 
+	CHECK_TEST("test_25")
+	run_test (test_25, "Test 25: check publishing a batch of messages with mixed QoS (myqtt_conn_pub_batch)"); 
+
+	CHECK_TEST("test_26")
+	run_test (test_26, "Test 26: check myqtt-client --bench mode"); 
+
 #if defined(ENABLE_MOSQUITTO)
 	/* call to enable mosquitto library globally */
 	mosquitto_lib_init();
@@ -453,6 +453,13 @@ int main (int argc, char ** argv)
 	} /* end if */
 
 #if defined(ENABLE_TLS_SUPPORT)
+	/* enable session tickets so resumption can be checked */
+	unlink (".myqtt-listener-ticket.key");
+	if (! myqtt_tls_set_session_tickets (ctx, ".myqtt-listener-ticket.key", 3600)) {
+		printf ("ERROR: unable to enable TLS session tickets..\n");
+		exit (-1);
+	} /* end if */
+
 	/* start a TLS listener */
 	listener = myqtt_tls_listener_new (ctx, listener_host, listener_tls_port, NULL, NULL, NULL);
 	if (! myqtt_conn_is_ok (listener, axl_false)) {
@@ -466,6 +473,18 @@ int main (int argc, char ** argv)
 		exit (-1);
 	}
 
+	/* start a second TLS listener with the same certificate
+	 * (sessions from 1910 must not be resumed here) */
+	listener = myqtt_tls_listener_new (ctx, listener_host, "1912", NULL, NULL, NULL);
+	if (! myqtt_conn_is_ok (listener, axl_false)) {
+		printf ("ERROR: failed to start TLS listener at: %s:%s..\n", listener_host, "1912");
+		exit (-1);
+	} /* end if */
+	if (! myqtt_tls_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: unable to configure certificates for TLS myqtt..\n");
+		exit (-1);
+	}
+
 	/* create connection options */
 	opts     = myqtt_conn_opts_new ();
 
@@ -55,6 +55,21 @@
 #include <openssl/x509v3.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+#include <sys/stat.h>
+#if defined(AXL_OS_UNIX)
+#include <dirent.h>
+#include <poll.h>
+#endif
+
+/* kernel TLS is available (OpenSSL 3 built with ktls support) */
+#if defined(SSL_OP_ENABLE_KTLS) && defined(BIO_get_ktls_send)
+#define MYQTT_TLS_KTLS_SUPPORT 1
+#endif
 
 /* some keys to store handlers and its associate data */
 #define POST_CHECK        "tls:post-checks"
@@ -95,6 +110,21 @@ int myqtt_tls_log_ssl (MyQttCtx * ctx)
 }
 
 
+/** 
+ * @internal Returns an empty string for NULL values.
+ */
+#define MYQTT_TLS_STR(str) ((str) ? (str) : "")
+
+/** 
+ * @internal Keys used to protect session tickets during one rotation
+ * period.
+ */
+typedef struct _MyQttTlsTicketKey {
+	unsigned char name[16];
+	unsigned char aes_key[32];
+	unsigned char hmac_key[32];
+} MyQttTlsTicketKey;
+
 typedef struct _MyQttTlsCtx {
 
 	/* @internal Internal default handlers used to define the TLS
@@ -112,8 +142,88 @@ typedef struct _MyQttTlsCtx {
 	MyQttTlsFailureHandler              failure_handler;
 	axlPointer                          failure_handler_user_data;
 
+	/* SSL_CTX prepared for each serverName (see
+	 * __myqtt_tls_server_sni_callback) */
+	MyQttMutex                          sni_mutex;
+	axlHash                           * sni_cache;
+
+	/* session resumption: session ids cached through files
+	 * (shared by all processes) and stateless tickets whose
+	 * keys are derived from a shared secret */
+	MyQttMutex                          session_mutex;
+	char                              * session_cache_path;
+	int                                 session_cache_timeout;
+	int                                 session_cache_stored;
+	axl_bool                            session_tickets;
+	unsigned char                       ticket_secret[48];
+	int                                 ticket_rotation;
+	long                                ticket_period;
+	MyQttTlsTicketKey                   ticket_keys[2];
+	long                                sessions_resumed;
+	long                                sessions_full;
+
+	/* handshake worker pool: server side handshakes are run
+	 * here, out of the reader thread */
+	MyQttMutex                          handshake_mutex;
+	MyQttCond                           handshake_cond;
+	axlList                           * handshake_queue;
+	MyQttThread                       * handshake_threads;
+	int                                 handshake_workers;
+	int                                 handshake_max;
+	axl_bool                            handshake_configured;
+	axl_bool                            handshake_exit;
+	int                                 handshake_running;
+	long                                handshake_completed;
+	long                                handshake_failed;
+	long                                handshake_rejected;
+
+	/* kernel TLS requested (see myqtt_tls_set_ktls) */
+	axl_bool                            ktls;
+
 } MyQttTlsCtx;
 
+/** 
+ * @internal Default amount of server side handshakes (queued or
+ * running) accepted by the handshake pool.
+ */
+#define MYQTT_TLS_HANDSHAKE_MAX 1024
+
+/** 
+ * @internal Max number of waits (and its length in milliseconds) a
+ * handshake worker does for the peer before returning a connection
+ * whose handshake is still in progress to the reader.
+ */
+#define MYQTT_TLS_HANDSHAKE_ROUNDS 4
+#define MYQTT_TLS_HANDSHAKE_WAIT   50
+
+/** 
+ * @internal Size of the read buffer installed on TLS connections:
+ * the max plaintext carried by a TLS record, so a whole record is
+ * pulled on each SSL_read.
+ */
+#define MYQTT_TLS_READ_BUFFER 16384
+
+/** 
+ * @internal Ready to use SSL_CTX for a serverName, along with the
+ * files it was built from and their modification time.
+ */
+typedef struct _MyQttTlsSniEntry {
+	SSL_CTX * ssl_ctx;
+	char    * certificate;
+	char    * key;
+	char    * chain;
+	long      certificate_mtime;
+	long      key_mtime;
+	long      chain_mtime;
+	long      checked;
+} MyQttTlsSniEntry;
+
+/** 
+ * @internal Seconds after which files of a cached SSL_CTX are checked
+ * again for changes.
+ */
+#define MYQTT_TLS_SNI_CHECK_PERIOD 1
+
 int __myqtt_tls_handle_error (MyQttConn * conn, int res, const char * label, axl_bool * needs_retry)
 {
 	int ssl_err;
@@ -486,6 +596,59 @@ int __myqtt_tls_send (MyQttConn * conn, const unsigned char * buffer, int buffer
 
 
 
+/** 
+ * @internal Send handler used once records are encrypted by the
+ * kernel (kTLS): content is written as is into the socket.
+ */
+int __myqtt_tls_ktls_send (MyQttConn * conn, const unsigned char * buffer, int buffer_size)
+{
+	return send (conn->session, buffer, buffer_size, 0);
+}
+
+/** 
+ * @internal Requests kernel TLS on the provided SSL_CTX if it was
+ * enabled for this context.
+ */
+void __myqtt_tls_prepare_ktls (MyQttCtx * ctx, SSL_CTX * ssl_ctx)
+{
+#if defined(MYQTT_TLS_KTLS_SUPPORT)
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+	if (tls_ctx && tls_ctx->ktls && ssl_ctx)
+		SSL_CTX_set_options (ssl_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+	return;
+}
+
+/** 
+ * @internal Checks, once the handshake is completed, if the kernel
+ * took over record encryption, switching to plain socket sends in
+ * such case. OpenSSL already falls back to user space when the
+ * cipher or the kernel do not support it.
+ */
+void __myqtt_tls_ktls_check (MyQttCtx * ctx, MyQttConn * conn)
+{
+#if defined(MYQTT_TLS_KTLS_SUPPORT)
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+	axl_bool      ktls_send;
+	axl_bool      ktls_recv;
+
+	if (tls_ctx == NULL || ! tls_ctx->ktls || conn->ssl == NULL)
+		return;
+
+	ktls_send = BIO_get_ktls_send (SSL_get_wbio (conn->ssl));
+	ktls_recv = BIO_get_ktls_recv (SSL_get_rbio (conn->ssl));
+	myqtt_log (MYQTT_LEVEL_DEBUG, "kTLS status for conn-id=%d (cipher %s): send=%d, recv=%d",
+		   conn->id, SSL_get_cipher_name (conn->ssl), ktls_send, ktls_recv);
+
+	if (ktls_send) {
+		conn->send = __myqtt_tls_ktls_send;
+		myqtt_conn_set_data (conn, "tls:ktls", INT_TO_PTR (axl_true));
+	} /* end if */
+#endif
+	return;
+}
+
 axl_bool __myqtt_tls_session_setup (MyQttCtx * ctx, MyQttConn * conn, MyQttConnOpts * opts, axlPointer user_data)
 {
 	int        iterator;
@@ -517,6 +680,7 @@ axl_bool __myqtt_tls_session_setup (MyQttCtx * ctx, MyQttConn * conn, MyQttConnO
 		return axl_false;
 	} /* end if */
 	myqtt_conn_set_data_full (conn, "__my:co:ssl-ctx", conn->ssl_ctx, NULL, (axlDestroyFunc) SSL_CTX_free);
+	__myqtt_tls_prepare_ktls (ctx, conn->ssl_ctx);
 
 	/* check for client side SSL configuration */
 	if (! __myqtt_conn_set_ssl_client_options (ctx, conn, opts)) {
@@ -625,6 +789,10 @@ axl_bool __myqtt_tls_session_setup (MyQttCtx * ctx, MyQttConn * conn, MyQttConnO
 	/* configure default handlers */
 	conn->receive = __myqtt_tls_receive;
 	conn->send    = __myqtt_tls_send;
+	__myqtt_tls_ktls_check (ctx, conn);
+
+	/* pull whole records and serve small reads from memory */
+	myqtt_conn_set_read_buffer (conn, MYQTT_TLS_READ_BUFFER);
 	
 	myqtt_log ( MYQTT_LEVEL_DEBUG, "TLS I/O handlers configured");
 	conn->tls_on = axl_true;
@@ -632,6 +800,24 @@ axl_bool __myqtt_tls_session_setup (MyQttCtx * ctx, MyQttConn * conn, MyQttConnO
 	return axl_true;
 }
 
+/** 
+ * @internal Releases the TLS context associated to a MyQttCtx.
+ */
+void __myqtt_tls_ctx_free (axlPointer _tls_ctx)
+{
+	MyQttTlsCtx * tls_ctx = _tls_ctx;
+
+	axl_hash_free (tls_ctx->sni_cache);
+	myqtt_mutex_destroy (&tls_ctx->sni_mutex);
+	axl_free (tls_ctx->session_cache_path);
+	myqtt_mutex_destroy (&tls_ctx->session_mutex);
+	axl_list_free (tls_ctx->handshake_queue);
+	myqtt_mutex_destroy (&tls_ctx->handshake_mutex);
+	myqtt_cond_destroy (&tls_ctx->handshake_cond);
+	axl_free (tls_ctx);
+	return;
+}
+
 /** @internal reference to track if SSL_library_init was called () **/
 axl_bool __myqtt_tls_was_ssl_init = axl_false;
 
@@ -661,10 +847,16 @@ axl_bool      myqtt_tls_init (MyQttCtx * ctx)
 
 	/* create the tls context */
 	tls_ctx = axl_new (MyQttTlsCtx, 1);
+	myqtt_mutex_create (&tls_ctx->sni_mutex);
+	tls_ctx->sni_cache = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+	myqtt_mutex_create (&tls_ctx->session_mutex);
+	myqtt_mutex_create (&tls_ctx->handshake_mutex);
+	myqtt_cond_create (&tls_ctx->handshake_cond);
+	tls_ctx->handshake_queue = axl_list_new (axl_list_always_return_1, NULL);
 	myqtt_ctx_set_data_full (ctx,
 				  /* key and value */
 				  TLS_CTX, tls_ctx,
-				  NULL, axl_free);
+				  NULL, __myqtt_tls_ctx_free);
 
 	/* init ssl ciphers and engines (but only once even though we
 	   have several contexts running on the same process) */
@@ -1089,197 +1281,1257 @@ axl_bool __myqtt_tls_prepare_certificates (MyQttConn     * conn,
 }
 
 
-int __myqtt_tls_server_sni_callback (SSL * ssl, int *ad, void *arg)
+/** 
+ * @internal Builds the path of the file holding the session with the
+ * provided id.
+ */
+char * __myqtt_tls_session_file (MyQttTlsCtx * tls_ctx, const unsigned char * id, int id_len)
 {
-	MyQttConn   * conn       = (MyQttConn *) arg;
-	MyQttConn   * listener;
-	MyQttCtx    * ctx        = CONN_CTX (conn);
-	const char  * serverName = SSL_get_servername (ssl, TLSEXT_NAMETYPE_host_name);
-	MyQttTlsCtx * tls_ctx;
-	SSL_CTX     * old_context;
+	char name[(SSL_MAX_SSL_SESSION_ID_LENGTH * 2) + 1];
+	int  iterator;
 
-	/* additional variables */
-	char        * certificate = NULL;
-	char        * key         = NULL;
-	char        * chain       = NULL;
+	if (id_len <= 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+		return NULL;
+	for (iterator = 0; iterator < id_len; iterator++)
+		sprintf (name + (iterator * 2), "%02x", id[iterator]);
 
-	if (serverName) {
-		/* notify on serverName notified to let application level
-		   handling this: maybe he/she does not want to accept this
-		   serverName.  */
-		myqtt_log (MYQTT_LEVEL_DEBUG, "Received SNI server side notification with serverName=%s", serverName);
+	return myqtt_support_build_filename (tls_ctx->session_cache_path, name, NULL);
+}
 
-		
-		/* now try to locate a certificate with the provided name */
-		tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
-		if (tls_ctx == NULL) {
-			myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to accept SNI indication, TLS MyQtt api seems to be disabled, myqtt_ctx_get_data () reported NULL");
-			return SSL_TLSEXT_ERR_NOACK;
-		} /* end if */
-		
-		if (tls_ctx && tls_ctx->tls_certificate_handler) 
-			certificate = tls_ctx->tls_certificate_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
-		if (tls_ctx && tls_ctx->tls_private_key_handler) 
-			key         = tls_ctx->tls_private_key_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
-		if (tls_ctx && tls_ctx->tls_chain_handler) 
-			chain       = tls_ctx->tls_chain_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
-
-		if (certificate && key) {
-			/* get reference to old context */
-			old_context = conn->ssl_ctx;
+/** 
+ * @internal Removes expired sessions from the session cache
+ * directory.
+ */
+void __myqtt_tls_session_sweep (MyQttCtx * ctx, MyQttTlsCtx * tls_ctx)
+{
+#if defined(AXL_OS_UNIX)
+	DIR           * dir;
+	struct dirent * entry;
+	struct stat     info;
+	char          * path;
+	long            now = (long) time (NULL);
+
+	dir = opendir (tls_ctx->session_cache_path);
+	if (dir == NULL)
+		return;
+	while ((entry = readdir (dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+		path = myqtt_support_build_filename (tls_ctx->session_cache_path, entry->d_name, NULL);
+		if (stat (path, &info) == 0 && (now - (long) info.st_mtime) > tls_ctx->session_cache_timeout)
+			unlink (path);
+		axl_free (path);
+	} /* end while */
+	closedir (dir);
+#endif
+	return;
+}
 
-			/* create new ssl context to switch to */
-			listener       = myqtt_conn_get_listener (conn);
-			conn->ssl_ctx  = __myqtt_tls_conn_get_ssl_context (ctx, conn, listener ? listener->opts : NULL, axl_false);
-			if (conn->ssl_ctx == NULL) {
-				myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to create SSL context (__myqtt_conn_get_ssl_context failed)");
-				conn->ssl_ctx = old_context;
-				myqtt_conn_shutdown (conn);
-				return SSL_TLSEXT_ERR_NOACK;
-			} /* end if */
+/** 
+ * @internal New session created by a full handshake: store it so
+ * any process can resume it.
+ */
+int __myqtt_tls_session_new (SSL * ssl, SSL_SESSION * session)
+{
+	MyQttCtx            * ctx     = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+	MyQttTlsCtx         * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+	const unsigned char * id;
+	unsigned int          id_len;
+	unsigned char       * buffer;
+	unsigned char       * aux;
+	int                   size;
+	char                * path;
+	char                * temp;
+	FILE                * file;
+	axl_bool              sweep;
+
+	if (tls_ctx == NULL || tls_ctx->session_cache_path == NULL)
+		return 0;
 
-			if (! __myqtt_tls_prepare_certificates (conn, listener ? listener->opts : NULL, certificate, key, chain, NULL)) {
-				myqtt_log (MYQTT_LEVEL_CRITICAL, "Prepare certificates failed (__myqtt_tls_prepare_certificates), skiping connection accept");
-				conn->ssl_ctx = old_context;
-				myqtt_conn_shutdown (conn);
-				return SSL_TLSEXT_ERR_NOACK;
-			} /* end if */
+	id   = SSL_SESSION_get_id (session, &id_len);
+	path = __myqtt_tls_session_file (tls_ctx, id, id_len);
+	size = i2d_SSL_SESSION (session, NULL);
+	if (path == NULL || size <= 0) {
+		axl_free (path);
+		return 0;
+	} /* end if */
 
-			/* everything went ok, update references */
-			SSL_set_SSL_CTX (conn->ssl, conn->ssl_ctx);
-			
-			/* release previous context by setting the new */
-			myqtt_conn_set_data_full (conn, "__my:co:ssl-ctx", conn->ssl_ctx, NULL, (axlDestroyFunc) SSL_CTX_free);
+	buffer = axl_new (unsigned char, size);
+	aux    = buffer;
+	i2d_SSL_SESSION (session, &aux);
+
+	/* write and rename so readers never get a partial file */
+	temp = axl_strdup_printf ("%s.%d", path, getpid ());
+	file = fopen (temp, "wb");
+	if (file) {
+		if (fwrite (buffer, 1, size, file) == size && fclose (file) == 0)
+			rename (temp, path);
+		else
+			unlink (temp);
+	} /* end if */
+	axl_free (temp);
+	axl_free (buffer);
+	axl_free (path);
+
+	/* from time to time, remove expired sessions */
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	tls_ctx->session_cache_stored++;
+	sweep = (tls_ctx->session_cache_stored % 256) == 0;
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
+	if (sweep)
+		__myqtt_tls_session_sweep (ctx, tls_ctx);
+
+	/* no reference to session is kept */
+	return 0;
+}
 
-			axl_free (certificate);
-			axl_free (key);
-			axl_free (chain);
-		} /* end if */
+/** 
+ * @internal Session lookup for a client requesting to resume it.
+ */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+SSL_SESSION * __myqtt_tls_session_get (SSL * ssl, unsigned char * id, int id_len, int * copy)
+#else
+SSL_SESSION * __myqtt_tls_session_get (SSL * ssl, const unsigned char * id, int id_len, int * copy)
+#endif
+{
+	MyQttCtx            * ctx     = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+	MyQttTlsCtx         * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+	struct stat           info;
+	unsigned char       * buffer;
+	const unsigned char * aux;
+	SSL_SESSION         * session = NULL;
+	char                * path;
+	FILE                * file;
+
+	(*copy) = 0;
+	if (tls_ctx == NULL || tls_ctx->session_cache_path == NULL)
+		return NULL;
 
-		/* for now, set the serverName for this connection */
-		myqtt_log (MYQTT_LEVEL_DEBUG, "Calling to update connection's serverName to: %s", serverName);
-		myqtt_conn_set_server_name (conn, serverName);
+	path = __myqtt_tls_session_file (tls_ctx, id, id_len);
+	if (path == NULL || stat (path, &info) != 0 || info.st_size <= 0 || info.st_size > 65536) {
+		axl_free (path);
+		return NULL;
+	} /* end if */
 
+	/* drop expired sessions */
+	if (((long) time (NULL) - (long) info.st_mtime) > tls_ctx->session_cache_timeout) {
+		unlink (path);
+		axl_free (path);
+		return NULL;
 	} /* end if */
-		
 
-	return SSL_TLSEXT_ERR_OK;
+	file = fopen (path, "rb");
+	axl_free (path);
+	if (file == NULL)
+		return NULL;
+	buffer = axl_new (unsigned char, info.st_size);
+	if (fread (buffer, 1, info.st_size, file) == info.st_size) {
+		aux     = buffer;
+		session = d2i_SSL_SESSION (NULL, &aux, info.st_size);
+	} /* end if */
+	fclose (file);
+	axl_free (buffer);
+
+	return session;
 }
 
 /** 
- * @internal Function that prepares the TLS/SSL negotiation for every
- * incoming connection accepted.
+ * @internal Session removed (expired or invalidated).
  */
-void __myqtt_tls_accept_connection (MyQttCtx * ctx, MyQttConn * listener, MyQttConn * conn, MyQttConnOpts * opts, axlPointer user_data)
+void __myqtt_tls_session_remove (SSL_CTX * ssl_ctx, SSL_SESSION * session)
 {
-	const char * certificateFile  = NULL;
-	const char * privateKey       = NULL;
-	const char * chainCertificate = NULL;
-	const char * caCertificate    = NULL;
-	int          ssl_error;
-	int          result;
+	MyQttCtx            * ctx     = SSL_CTX_get_app_data (ssl_ctx);
+	MyQttTlsCtx         * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+	const unsigned char * id;
+	unsigned int          id_len;
+	char                * path;
 
-	/* init ssl ciphers and engines */
-	if (! myqtt_tls_init (ctx)) {
-		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to accept TLS connection, myqtt_tls_init () failed");
+	if (tls_ctx == NULL || tls_ctx->session_cache_path == NULL)
 		return;
+
+	id   = SSL_SESSION_get_id (session, &id_len);
+	path = __myqtt_tls_session_file (tls_ctx, id, id_len);
+	if (path)
+		unlink (path);
+	axl_free (path);
+	return;
+}
+
+/** 
+ * @internal Derives ticket keys for the provided rotation period
+ * from the shared secret, so every process gets the same keys
+ * without coordination.
+ */
+void __myqtt_tls_ticket_key_derive (MyQttTlsCtx * tls_ctx, long period, MyQttTlsTicketKey * key)
+{
+	unsigned char   result[EVP_MAX_MD_SIZE];
+	unsigned int    size;
+	char            label[64];
+
+	snprintf (label, sizeof (label), "myqtt-ticket-name-%ld", period);
+	HMAC (EVP_sha256 (), tls_ctx->ticket_secret, sizeof (tls_ctx->ticket_secret), (unsigned char *) label, strlen (label), result, &size);
+	memcpy (key->name, result, sizeof (key->name));
+
+	snprintf (label, sizeof (label), "myqtt-ticket-aes-%ld", period);
+	HMAC (EVP_sha256 (), tls_ctx->ticket_secret, sizeof (tls_ctx->ticket_secret), (unsigned char *) label, strlen (label), result, &size);
+	memcpy (key->aes_key, result, sizeof (key->aes_key));
+
+	snprintf (label, sizeof (label), "myqtt-ticket-hmac-%ld", period);
+	HMAC (EVP_sha256 (), tls_ctx->ticket_secret, sizeof (tls_ctx->ticket_secret), (unsigned char *) label, strlen (label), result, &size);
+	memcpy (key->hmac_key, result, sizeof (key->hmac_key));
+	return;
+}
+
+/** 
+ * @internal Selects the ticket key to be used and prepares the
+ * cipher context. Encrypts new tickets with the key of the current
+ * period and accepts tickets from the current and previous period
+ * (asking to renew the latter).
+ *
+ * @return 1 or 2 (renew) if a key was selected, 0 if the ticket key
+ * is unknown and -1 on failure, as expected by the ticket callback.
+ */
+int __myqtt_tls_ticket_key_select (SSL * ssl, unsigned char * key_name, unsigned char * iv, EVP_CIPHER_CTX * cipher_ctx, int enc, MyQttTlsTicketKey * key)
+{
+	MyQttCtx          * ctx     = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+	MyQttTlsCtx       * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+	long                period;
+	int                 result  = 0;
+
+	if (tls_ctx == NULL || ! tls_ctx->session_tickets)
+		return 0;
+
+	/* update keys when rotation period changes */
+	period = (long) time (NULL) / tls_ctx->ticket_rotation;
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	if (tls_ctx->ticket_period != period) {
+		__myqtt_tls_ticket_key_derive (tls_ctx, period, &tls_ctx->ticket_keys[0]);
+		__myqtt_tls_ticket_key_derive (tls_ctx, period - 1, &tls_ctx->ticket_keys[1]);
+		tls_ctx->ticket_period = period;
 	} /* end if */
 
-	if (conn->pending_ssl_accept) {
-		/* SSL already configured but pending to fully accept
-		   connection by doing the entire handshake */
-		myqtt_log (MYQTT_LEVEL_DEBUG, "Received connect over a connection (id %d) with TLS handshake pending to be finished, processing..",
-			    conn->id);
-		
-		/* get ssl error */
-		ssl_error = SSL_accept (conn->ssl);
-		if (ssl_error == -1) {
-			/* get error */
-			ssl_error = SSL_get_error (conn->ssl, -1);
-			
-			myqtt_log (MYQTT_LEVEL_WARNING, "accept function have failed (for listener side) ssl_error=%d : dumping error stack..", ssl_error);
- 
-			switch (ssl_error) {
-			case SSL_ERROR_WANT_READ:
-			        myqtt_log (MYQTT_LEVEL_WARNING, "still not prepared to continue because read wanted conn-id=%d (%p, session %d)",
-					   conn->id, conn, conn->session);
-				return;
-			case SSL_ERROR_WANT_WRITE:
-			        myqtt_log (MYQTT_LEVEL_WARNING, "still not prepared to continue because write wanted conn-id=%d (%p)",
-					   conn->id, conn);
-				return;
-			default:
-				break;
-			} /* end switch */
+	if (enc) {
+		/* new ticket */
+		(*key) = tls_ctx->ticket_keys[0];
+		result = 1;
+	} else if (memcmp (key_name, tls_ctx->ticket_keys[0].name, 16) == 0) {
+		(*key) = tls_ctx->ticket_keys[0];
+		result = 1;
+	} else if (memcmp (key_name, tls_ctx->ticket_keys[1].name, 16) == 0) {
+		/* valid but old key: ask to renew the ticket */
+		(*key) = tls_ctx->ticket_keys[1];
+		result = 2;
+	} /* end if */
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
 
-			/* TLS-fication process have failed */
-			myqtt_log (MYQTT_LEVEL_CRITICAL, "there was an error while accepting TLS connection");
-			myqtt_tls_log_ssl (ctx);
-			myqtt_conn_shutdown (conn);
-			return;
-		} /* end if */
+	if (result == 0)
+		return 0; /* unknown key, do a full handshake */
+
+	if (enc) {
+		if (RAND_bytes (iv, EVP_MAX_IV_LENGTH) != 1)
+			return -1;
+		memcpy (key_name, key->name, 16);
+		if (EVP_EncryptInit_ex (cipher_ctx, EVP_aes_256_cbc (), NULL, key->aes_key, iv) != 1)
+			return -1;
+	} else {
+		if (EVP_DecryptInit_ex (cipher_ctx, EVP_aes_256_cbc (), NULL, key->aes_key, iv) != 1)
+			return -1;
+	} /* end if */
+
+	return result;
+}
 
-		/* ssl accept */
-		conn->pending_ssl_accept = axl_false;
-		myqtt_conn_set_sock_block (conn->session, axl_false);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/** 
+ * @internal Ticket key callback (OpenSSL 3, EVP_MAC based).
+ */
+int __myqtt_tls_ticket_key_cb (SSL * ssl, unsigned char * key_name, unsigned char * iv, EVP_CIPHER_CTX * cipher_ctx, EVP_MAC_CTX * hmac_ctx, int enc)
+{
+	MyQttTlsTicketKey   key;
+	OSSL_PARAM          params[2];
+	int                 result;
+
+	result = __myqtt_tls_ticket_key_select (ssl, key_name, iv, cipher_ctx, enc, &key);
+	if (result <= 0)
+		return result;
 
-		result = SSL_get_verify_result (conn->ssl);
+	params[0] = OSSL_PARAM_construct_utf8_string (OSSL_MAC_PARAM_DIGEST, (char *) "SHA256", 0);
+	params[1] = OSSL_PARAM_construct_end ();
+	if (EVP_MAC_init (hmac_ctx, key.hmac_key, sizeof (key.hmac_key), params) != 1)
+		return -1;
+
+	return result;
+}
+#else
+/** 
+ * @internal Ticket key callback (HMAC_CTX based).
+ */
+int __myqtt_tls_ticket_key_cb (SSL * ssl, unsigned char * key_name, unsigned char * iv, EVP_CIPHER_CTX * cipher_ctx, HMAC_CTX * hmac_ctx, int enc)
+{
+	MyQttTlsTicketKey   key;
+	int                 result;
 
-		myqtt_log (MYQTT_LEVEL_DEBUG, "Completed TLS operation from %s:%s (conn id %d, ssl veriry result: %d)",
-			    conn->host, conn->port, conn->id, (int) result);
+	result = __myqtt_tls_ticket_key_select (ssl, key_name, iv, cipher_ctx, enc, &key);
+	if (result <= 0)
+		return result;
 
-		/* configure default handlers */
-		conn->receive = __myqtt_tls_receive;
-		conn->send    = __myqtt_tls_send;
+	if (HMAC_Init_ex (hmac_ctx, key.hmac_key, sizeof (key.hmac_key), EVP_sha256 (), NULL) != 1)
+		return -1;
 
-		/* call to check post ssl checks after SSL finalization */
-		if (ctx && ctx->post_ssl_check) {
-			if (! ((MyQttSslPostCheck) ctx->post_ssl_check) (ctx, conn, conn->ssl_ctx, conn->ssl, ctx->post_ssl_check_data)) {
-				/* TLS post check failed */
-				myqtt_log (MYQTT_LEVEL_CRITICAL, "TLS/SSL post check function failed, dropping connection");
-				myqtt_conn_shutdown (conn);
-				return;
-			} /* end if */
+	return result;
+}
+#endif
+
+/** 
+ * @internal Builds the session id context for the listener (local
+ * address and port where the connection was accepted) and the
+ * serverName provided, so a session is only resumed on the same
+ * listener and serverName where it was created. Local address is
+ * used (instead of listener references) because it is the same in
+ * every process sharing the session cache.
+ */
+unsigned int __myqtt_tls_session_id_context (MyQttConn * conn, const char * serverName, unsigned char * sid_ctx)
+{
+	unsigned char   digest[EVP_MAX_MD_SIZE];
+	unsigned int    size = 0;
+	char          * label;
+
+	label = axl_strdup_printf ("myqtt:%s:%s:%s",
+				   conn ? MYQTT_TLS_STR (myqtt_conn_get_local_addr (conn)) : "",
+				   conn ? MYQTT_TLS_STR (myqtt_conn_get_local_port (conn)) : "",
+				   serverName ? serverName : "");
+	if (label == NULL || EVP_Digest (label, strlen (label), digest, &size, EVP_sha256 (), NULL) != 1)
+		size = 0;
+	axl_free (label);
+
+	if (size > SSL_MAX_SID_CTX_LENGTH)
+		size = SSL_MAX_SID_CTX_LENGTH;
+	memcpy (sid_ctx, digest, size);
+	return size;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+/** 
+ * @internal Client hello callback: it is called before looking for
+ * the session to resume, so the session id context is updated with
+ * the serverName requested (sessions created for a serverName are
+ * not resumed with a different one).
+ */
+int __myqtt_tls_client_hello_cb (SSL * ssl, int * alert, void * arg)
+{
+	MyQttConn           * conn = arg;
+	const unsigned char * ext;
+	size_t                ext_len;
+	size_t                name_len;
+	char                  serverName[256];
+	unsigned char         sid_ctx[SSL_MAX_SID_CTX_LENGTH];
+	unsigned int          sid_ctx_len;
+
+	/* server_name extension: list length (2), type (1), name length (2), name */
+	serverName[0] = 0;
+	if (SSL_client_hello_get0_ext (ssl, TLSEXT_TYPE_server_name, &ext, &ext_len) && ext_len > 5 &&
+	    ext[2] == TLSEXT_NAMETYPE_host_name) {
+		name_len = (ext[3] << 8) | ext[4];
+		if ((name_len + 5) <= ext_len && name_len < sizeof (serverName)) {
+			memcpy (serverName, ext + 5, name_len);
+			serverName[name_len] = 0;
 		} /* end if */
+	} /* end if */
 
-		/* set this connection has TLS ok */
+	sid_ctx_len = __myqtt_tls_session_id_context (conn, serverName[0] ? serverName : NULL, sid_ctx);
+	if (sid_ctx_len > 0)
+		SSL_set_session_id_context (ssl, sid_ctx, sid_ctx_len);
 
-		/* reached this point, ensure tls is enabled on this
-		 * session */
-		conn->tls_on = axl_true;
+	return SSL_CLIENT_HELLO_SUCCESS;
+}
+#endif
+
+/** 
+ * @internal Configures session resumption on a server side SSL_CTX
+ * according to the settings of the context.
+ *
+ * @param conn The connection being accepted (its local address
+ * identifies the listener).
+ *
+ * @param serverName The serverName the SSL_CTX is prepared for or
+ * NULL for the listener SSL_CTX.
+ */
+void __myqtt_tls_prepare_sessions (MyQttCtx * ctx, SSL_CTX * ssl_ctx, MyQttConn * conn, const char * serverName)
+{
+	MyQttTlsCtx   * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+	unsigned char   sid_ctx[SSL_MAX_SID_CTX_LENGTH];
+	unsigned int    sid_ctx_len;
 
-		/* remove preread handler */
-		conn->preread_handler = NULL;
-		conn->preread_user_data = NULL;
+	if (tls_ctx == NULL || ssl_ctx == NULL)
 		return;
-	}
 
-	/* overwrite connection options with listener's options: very TLS especific */
-	if (listener->opts)
-		opts = listener->opts;
-	
-	/* 1) GET FROM OPTIONS: detect here if we have certificates provided through options */
-	myqtt_log (MYQTT_LEVEL_DEBUG, "Starting TLS process, options=%p, listener=%p", opts, listener);
-	
-	if (opts) {
-		certificateFile = opts->certificate;
-		privateKey      = opts->private_key;
+	/* required to resume sessions (also when peer verification is
+	 * enabled): the context is bound to the listener and
+	 * serverName so sessions are not resumed on others */
+	SSL_CTX_set_app_data (ssl_ctx, ctx);
+	sid_ctx_len = __myqtt_tls_session_id_context (conn, serverName, sid_ctx);
+	if (sid_ctx_len > 0)
+		SSL_CTX_set_session_id_context (ssl_ctx, sid_ctx, sid_ctx_len);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	/* the serverName is only known once the client hello is
+	 * received, update it before looking for sessions */
+	if (serverName == NULL)
+		SSL_CTX_set_client_hello_cb (ssl_ctx, __myqtt_tls_client_hello_cb, conn);
+#endif
+
+	if (tls_ctx->session_cache_path) {
+		/* SSL_CTX are not shared by all connections, so only
+		 * use the external cache */
+		SSL_CTX_set_session_cache_mode (ssl_ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+		SSL_CTX_set_timeout (ssl_ctx, tls_ctx->session_cache_timeout);
+		SSL_CTX_sess_set_new_cb (ssl_ctx, __myqtt_tls_session_new);
+		SSL_CTX_sess_set_get_cb (ssl_ctx, __myqtt_tls_session_get);
+		SSL_CTX_sess_set_remove_cb (ssl_ctx, __myqtt_tls_session_remove);
 	} /* end if */
 
-	if (certificateFile == NULL || privateKey == NULL) {
-		
-		/* 2) GET FROM LISTENER: get references to currently configured certificate file */
-		certificateFile = listener->certificate;
-		privateKey      = listener->private_key;
-		if (certificateFile == NULL || privateKey == NULL) {
-			/* 3) GET FROM STORE: check if the
-			 * certificate is already installed */
-			/* find a certicate according to the user name
-			   used or remote IP  */
-		}
+	if (tls_ctx->session_tickets) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		SSL_CTX_set_tlsext_ticket_key_evp_cb (ssl_ctx, __myqtt_tls_ticket_key_cb);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb (ssl_ctx, __myqtt_tls_ticket_key_cb);
+#endif
 	} /* end if */
-	
-	/* check certificates and private key */
+
+	return;
+}
+
+/** 
+ * @brief Enables server side TLS session cache (session ids) so
+ * clients reconnecting can resume their previous session skipping a
+ * full handshake.
+ *
+ * Sessions are stored as files inside the provided directory, so
+ * several processes can share the cache (a client can resume its
+ * session on any process using the same directory).
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param path The directory where sessions are stored (it is created
+ * if it does not exist). NULL disables the session cache.
+ *
+ * @param timeout Seconds a session can be resumed (-1 or 0 to use
+ * default value: 300).
+ *
+ * @return axl_true if the cache was configured, otherwise axl_false.
+ */
+axl_bool           myqtt_tls_set_session_cache           (MyQttCtx   * ctx,
+							  const char * path,
+							  int          timeout)
+{
+	MyQttTlsCtx * tls_ctx;
+
+	if (ctx == NULL || ! myqtt_tls_init (ctx))
+		return axl_false;
+	tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+#if defined(AXL_OS_UNIX)
+	if (path && mkdir (path, 0700) != 0 && errno != EEXIST) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to create TLS session cache directory %s, errno=%d : %s",
+			   path, errno, myqtt_errno_get_error (errno));
+		return axl_false;
+	} /* end if */
+#endif
+
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	axl_free (tls_ctx->session_cache_path);
+	tls_ctx->session_cache_path    = axl_strdup (path);
+	tls_ctx->session_cache_timeout = timeout > 0 ? timeout : 300;
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @brief Enables stateless session tickets (RFC 5077) for server side
+ * TLS connections.
+ *
+ * Ticket keys are derived from a secret stored in the provided file
+ * (created with random content if it does not exist) and rotated
+ * every <i>rotation</i> seconds, accepting tickets issued with the
+ * previous key. All processes using the same key file issue and
+ * accept the same tickets.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param key_file The file holding the secret (48 bytes). NULL
+ * disables session tickets.
+ *
+ * @param rotation Seconds each ticket key is used (-1 or 0 to use
+ * default value: 3600).
+ *
+ * @return axl_true if tickets were configured, otherwise axl_false.
+ */
+axl_bool           myqtt_tls_set_session_tickets         (MyQttCtx   * ctx,
+							  const char * key_file,
+							  int          rotation)
+{
+	MyQttTlsCtx   * tls_ctx;
+	unsigned char   secret[48];
+	FILE          * file;
+	int             fd;
+
+	if (ctx == NULL || ! myqtt_tls_init (ctx))
+		return axl_false;
+	tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+	if (key_file == NULL) {
+		tls_ctx->session_tickets = axl_false;
+		return axl_true;
+	} /* end if */
+
+	/* create the secret if it does not exist (only one process
+	 * wins) */
+	fd = open (key_file, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0) {
+		if (RAND_bytes (secret, sizeof (secret)) != 1 || write (fd, secret, sizeof (secret)) != sizeof (secret)) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to create TLS ticket key file %s", key_file);
+			close (fd);
+			unlink (key_file);
+			return axl_false;
+		} /* end if */
+		close (fd);
+	} /* end if */
+
+	file = fopen (key_file, "rb");
+	if (file == NULL || fread (secret, 1, sizeof (secret), file) != sizeof (secret)) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to read TLS ticket key file %s (expected %d bytes)", key_file, (int) sizeof (secret));
+		if (file)
+			fclose (file);
+		return axl_false;
+	} /* end if */
+	fclose (file);
+
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	memcpy (tls_ctx->ticket_secret, secret, sizeof (secret));
+	tls_ctx->ticket_rotation = rotation > 0 ? rotation : 3600;
+	tls_ctx->ticket_period   = -1;
+	tls_ctx->session_tickets = axl_true;
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @brief Reports the number of TLS handshakes completed at the
+ * server side that resumed a previous session (session id or ticket)
+ * and those that required a full handshake.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param resumed Optional reference to get resumed handshakes.
+ *
+ * @param full Optional reference to get full handshakes.
+ */
+void               myqtt_tls_session_stats               (MyQttCtx   * ctx,
+							  long       * resumed,
+							  long       * full)
+{
+	MyQttTlsCtx * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+
+	if (resumed)
+		(*resumed) = 0;
+	if (full)
+		(*full) = 0;
+	if (tls_ctx == NULL)
+		return;
+
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	if (resumed)
+		(*resumed) = tls_ctx->sessions_resumed;
+	if (full)
+		(*full) = tls_ctx->sessions_full;
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
+	return;
+}
+
+/** 
+ * @internal Takes an additional reference to the provided SSL_CTX.
+ */
+SSL_CTX * __myqtt_tls_ssl_ctx_ref (SSL_CTX * ssl_ctx)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	CRYPTO_add (&ssl_ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#else
+	SSL_CTX_up_ref (ssl_ctx);
+#endif
+	return ssl_ctx;
+}
+
+long __myqtt_tls_file_mtime (const char * path)
+{
+	struct stat info;
+
+	if (path == NULL || stat (path, &info) != 0)
+		return 0;
+	return (long) info.st_mtime;
+}
+
+void __myqtt_tls_sni_entry_free (axlPointer _entry)
+{
+	MyQttTlsSniEntry * entry = _entry;
+
+	SSL_CTX_free (entry->ssl_ctx);
+	axl_free (entry->certificate);
+	axl_free (entry->key);
+	axl_free (entry->chain);
+	axl_free (entry);
+	return;
+}
+
+/** 
+ * @internal Reports a new reference to the SSL_CTX cached for the
+ * provided key or NULL if it is not found or its files changed.
+ */
+SSL_CTX * __myqtt_tls_sni_cache_get (MyQttCtx * ctx, MyQttTlsCtx * tls_ctx, const char * cache_key)
+{
+	MyQttTlsSniEntry * entry;
+	SSL_CTX          * ssl_ctx = NULL;
+	long               now;
+
+	myqtt_mutex_lock (&tls_ctx->sni_mutex);
+	entry = axl_hash_get (tls_ctx->sni_cache, (axlPointer) cache_key);
+	if (entry) {
+		/* check files were not updated */
+		now = (long) time (NULL);
+		if ((now - entry->checked) >= MYQTT_TLS_SNI_CHECK_PERIOD) {
+			entry->checked = now;
+			if (entry->certificate_mtime != __myqtt_tls_file_mtime (entry->certificate) ||
+			    entry->key_mtime != __myqtt_tls_file_mtime (entry->key) ||
+			    entry->chain_mtime != __myqtt_tls_file_mtime (entry->chain)) {
+				myqtt_log (MYQTT_LEVEL_DEBUG, "Certificate files for %s were modified, reloading SSL context", cache_key);
+				axl_hash_remove (tls_ctx->sni_cache, (axlPointer) cache_key);
+				entry = NULL;
+			} /* end if */
+		} /* end if */
+
+		if (entry)
+			ssl_ctx = __myqtt_tls_ssl_ctx_ref (entry->ssl_ctx);
+	} /* end if */
+	myqtt_mutex_unlock (&tls_ctx->sni_mutex);
+
+	return ssl_ctx;
+}
+
+/** 
+ * @internal Stores the SSL_CTX prepared for the provided key (taking
+ * its own reference).
+ */
+void __myqtt_tls_sni_cache_set (MyQttCtx * ctx, MyQttTlsCtx * tls_ctx, const char * cache_key, SSL_CTX * ssl_ctx,
+				const char * certificate, const char * key, const char * chain)
+{
+	MyQttTlsSniEntry * entry;
+
+	entry                    = axl_new (MyQttTlsSniEntry, 1);
+	entry->ssl_ctx           = __myqtt_tls_ssl_ctx_ref (ssl_ctx);
+	entry->certificate       = axl_strdup (certificate);
+	entry->key               = axl_strdup (key);
+	entry->chain             = axl_strdup (chain);
+	entry->certificate_mtime = __myqtt_tls_file_mtime (certificate);
+	entry->key_mtime         = __myqtt_tls_file_mtime (key);
+	entry->chain_mtime       = __myqtt_tls_file_mtime (chain);
+	entry->checked           = (long) time (NULL);
+
+	myqtt_mutex_lock (&tls_ctx->sni_mutex);
+	axl_hash_remove (tls_ctx->sni_cache, (axlPointer) cache_key);
+	axl_hash_insert_full (tls_ctx->sni_cache, axl_strdup (cache_key), axl_free, entry, __myqtt_tls_sni_entry_free);
+	myqtt_mutex_unlock (&tls_ctx->sni_mutex);
+
+	return;
+}
+
+/** 
+ * @brief Removes all SSL contexts prepared for the serverNames
+ * received (SNI) so next handshakes call again to certificate
+ * handlers (see \ref myqtt_tls_listener_set_certificate_handlers).
+ *
+ * SSL contexts are created once for each serverName and reused by
+ * all connections, so certificate, key and chain files are only read
+ * once. Cached contexts are rebuilt automatically when any of these
+ * files is modified: use this function when the certificate handlers
+ * would report different files (for example, after reloading your
+ * configuration).
+ *
+ * @param ctx The context where the operation takes place.
+ */
+void               myqtt_tls_sni_cache_flush             (MyQttCtx * ctx)
+{
+	MyQttTlsCtx * tls_ctx;
+
+	if (ctx == NULL)
+		return;
+
+	tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+	if (tls_ctx == NULL)
+		return;
+
+	myqtt_mutex_lock (&tls_ctx->sni_mutex);
+	axl_hash_free (tls_ctx->sni_cache);
+	tls_ctx->sni_cache = axl_hash_new (axl_hash_string, axl_hash_equal_string);
+	myqtt_mutex_unlock (&tls_ctx->sni_mutex);
+
+	return;
+}
+
+int __myqtt_tls_server_sni_callback (SSL * ssl, int *ad, void *arg)
+{
+	MyQttConn   * conn       = (MyQttConn *) arg;
+	MyQttConn   * listener;
+	MyQttCtx    * ctx        = CONN_CTX (conn);
+	const char  * serverName = SSL_get_servername (ssl, TLSEXT_NAMETYPE_host_name);
+	MyQttTlsCtx * tls_ctx;
+	SSL_CTX     * old_context;
+	SSL_CTX     * ssl_ctx;
+	char        * cache_key;
+
+	/* additional variables */
+	char        * certificate = NULL;
+	char        * key         = NULL;
+	char        * chain       = NULL;
+
+	if (serverName) {
+		/* notify on serverName notified to let application level
+		   handling this: maybe he/she does not want to accept this
+		   serverName.  */
+		myqtt_log (MYQTT_LEVEL_DEBUG, "Received SNI server side notification with serverName=%s", serverName);
+
+		
+		/* now try to locate a certificate with the provided name */
+		tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+		if (tls_ctx == NULL) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to accept SNI indication, TLS MyQtt api seems to be disabled, myqtt_ctx_get_data () reported NULL");
+			return SSL_TLSEXT_ERR_NOACK;
+		} /* end if */
+
+		/* check for a context already prepared for this
+		 * serverName (on this listener, because its options
+		 * are used to create the context) */
+		listener  = myqtt_conn_get_listener (conn);
+		cache_key = axl_strdup_printf ("%s/%d/%s:%s", serverName, listener ? listener->id : -1,
+					       MYQTT_TLS_STR (myqtt_conn_get_local_addr (conn)),
+					       MYQTT_TLS_STR (myqtt_conn_get_local_port (conn)));
+		ssl_ctx   = __myqtt_tls_sni_cache_get (ctx, tls_ctx, cache_key);
+
+		if (ssl_ctx == NULL) {
+			if (tls_ctx->tls_certificate_handler) 
+				certificate = tls_ctx->tls_certificate_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
+			if (tls_ctx->tls_private_key_handler) 
+				key         = tls_ctx->tls_private_key_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
+			if (tls_ctx->tls_chain_handler) 
+				chain       = tls_ctx->tls_chain_handler (ctx, conn, serverName, tls_ctx->tls_handler_data);
+		} /* end if */
+
+		if (ssl_ctx == NULL && certificate && key) {
+			/* get reference to old context */
+			old_context = conn->ssl_ctx;
+
+			/* create new ssl context to switch to */
+			conn->ssl_ctx  = __myqtt_tls_conn_get_ssl_context (ctx, conn, listener ? listener->opts : NULL, axl_false);
+			if (conn->ssl_ctx == NULL) {
+				myqtt_log (MYQTT_LEVEL_CRITICAL, "Failed to create SSL context (__myqtt_conn_get_ssl_context failed)");
+				conn->ssl_ctx = old_context;
+				myqtt_conn_shutdown (conn);
+				goto release_and_fail;
+			} /* end if */
+
+			if (! __myqtt_tls_prepare_certificates (conn, listener ? listener->opts : NULL, certificate, key, chain, NULL)) {
+				myqtt_log (MYQTT_LEVEL_CRITICAL, "Prepare certificates failed (__myqtt_tls_prepare_certificates), skiping connection accept");
+				SSL_CTX_free (conn->ssl_ctx);
+				conn->ssl_ctx = old_context;
+				myqtt_conn_shutdown (conn);
+				goto release_and_fail;
+			} /* end if */
+
+			/* remember it for next handshakes with this serverName */
+			__myqtt_tls_prepare_sessions (ctx, conn->ssl_ctx, conn, serverName);
+			__myqtt_tls_prepare_ktls (ctx, conn->ssl_ctx);
+			ssl_ctx       = conn->ssl_ctx;
+			conn->ssl_ctx = old_context;
+			__myqtt_tls_sni_cache_set (ctx, tls_ctx, cache_key, ssl_ctx, certificate, key, chain);
+		} /* end if */
+
+		if (ssl_ctx) {
+			/* everything went ok, update references */
+			conn->ssl_ctx = ssl_ctx;
+			SSL_set_SSL_CTX (conn->ssl, conn->ssl_ctx);
+			
+			/* release previous context by setting the new */
+			myqtt_conn_set_data_full (conn, "__my:co:ssl-ctx", conn->ssl_ctx, NULL, (axlDestroyFunc) SSL_CTX_free);
+		} /* end if */
+
+		axl_free (cache_key);
+		axl_free (certificate);
+		axl_free (key);
+		axl_free (chain);
+
+		/* for now, set the serverName for this connection */
+		myqtt_log (MYQTT_LEVEL_DEBUG, "Calling to update connection's serverName to: %s", serverName);
+		myqtt_conn_set_server_name (conn, serverName);
+
+	} /* end if */
+		
+
+	return SSL_TLSEXT_ERR_OK;
+
+ release_and_fail:
+	axl_free (cache_key);
+	axl_free (certificate);
+	axl_free (key);
+	axl_free (chain);
+	return SSL_TLSEXT_ERR_NOACK;
+}
+
+/** 
+ * @internal Counts a completed server side handshake.
+ */
+void __myqtt_tls_session_count (MyQttCtx * ctx, axl_bool resumed)
+{
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+	if (tls_ctx == NULL)
+		return;
+	myqtt_mutex_lock (&tls_ctx->session_mutex);
+	if (resumed)
+		tls_ctx->sessions_resumed++;
+	else
+		tls_ctx->sessions_full++;
+	myqtt_mutex_unlock (&tls_ctx->session_mutex);
+	return;
+}
+
+/** 
+ * @internal Runs the pending server side handshake of the provided
+ * connection until it completes or needs more data.
+ *
+ * @return 1 if the handshake was completed, 0 if it must be called
+ * again when more data is available, -1 if it failed (connection is
+ * closed).
+ */
+int __myqtt_tls_accept_step (MyQttCtx * ctx, MyQttConn * conn)
+{
+	int          ssl_error;
+	int          result;
+
+	myqtt_log (MYQTT_LEVEL_DEBUG, "Received connect over a connection (id %d) with TLS handshake pending to be finished, processing..",
+		   conn->id);
+		
+	/* get ssl error */
+	ssl_error = SSL_accept (conn->ssl);
+	if (ssl_error <= 0) {
+		/* get error */
+		ssl_error = SSL_get_error (conn->ssl, ssl_error);
+			
+		myqtt_log (MYQTT_LEVEL_WARNING, "accept function have failed (for listener side) ssl_error=%d : dumping error stack..", ssl_error);
+ 
+		switch (ssl_error) {
+		case SSL_ERROR_WANT_READ:
+			myqtt_log (MYQTT_LEVEL_WARNING, "still not prepared to continue because read wanted conn-id=%d (%p, session %d)",
+				   conn->id, conn, conn->session);
+			return 0;
+		case SSL_ERROR_WANT_WRITE:
+			myqtt_log (MYQTT_LEVEL_WARNING, "still not prepared to continue because write wanted conn-id=%d (%p)",
+				   conn->id, conn);
+			return 0;
+		default:
+			break;
+		} /* end switch */
+
+		/* TLS-fication process have failed */
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "there was an error while accepting TLS connection");
+		myqtt_tls_log_ssl (ctx);
+		myqtt_conn_shutdown (conn);
+		return -1;
+	} /* end if */
+
+	/* ssl accept */
+	conn->pending_ssl_accept = axl_false;
+	myqtt_conn_set_sock_block (conn->session, axl_false);
+
+	/* update resumption stats */
+	__myqtt_tls_session_count (ctx, SSL_session_reused (conn->ssl));
+
+	result = SSL_get_verify_result (conn->ssl);
+
+	myqtt_log (MYQTT_LEVEL_DEBUG, "Completed TLS operation from %s:%s (conn id %d, ssl veriry result: %d)",
+		   conn->host, conn->port, conn->id, (int) result);
+
+	/* configure default handlers */
+	conn->receive = __myqtt_tls_receive;
+	conn->send    = __myqtt_tls_send;
+	__myqtt_tls_ktls_check (ctx, conn);
+
+	/* pull whole records and serve small reads from memory */
+	myqtt_conn_set_read_buffer (conn, MYQTT_TLS_READ_BUFFER);
+
+	/* call to check post ssl checks after SSL finalization */
+	if (ctx && ctx->post_ssl_check) {
+		if (! ((MyQttSslPostCheck) ctx->post_ssl_check) (ctx, conn, conn->ssl_ctx, conn->ssl, ctx->post_ssl_check_data)) {
+			/* TLS post check failed */
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "TLS/SSL post check function failed, dropping connection");
+			myqtt_conn_shutdown (conn);
+			return -1;
+		} /* end if */
+	} /* end if */
+
+	/* set this connection has TLS ok */
+
+	/* reached this point, ensure tls is enabled on this
+	 * session */
+	conn->tls_on = axl_true;
+
+	/* remove preread handler */
+	conn->preread_handler = NULL;
+	conn->preread_user_data = NULL;
+	return 1;
+}
+
+/** 
+ * @internal Waits (bounded by MYQTT_TLS_HANDSHAKE_WAIT) until the
+ * peer of a connection whose handshake is in progress lets us run the
+ * next step.
+ *
+ * @return axl_true if the next step can be run, otherwise axl_false.
+ */
+axl_bool __myqtt_tls_handshake_wait (MyQttConn * conn)
+{
+#if defined(AXL_OS_UNIX)
+	struct pollfd fds;
+
+	fds.fd      = conn->session;
+	fds.events  = SSL_want_write (conn->ssl) ? POLLOUT : POLLIN;
+	fds.revents = 0;
+	return poll (&fds, 1, MYQTT_TLS_HANDSHAKE_WAIT) > 0;
+#else
+	/* no wait: the reader will notify us */
+	return axl_false;
+#endif
+}
+
+/** 
+ * @internal Handshake worker: runs pending handshakes out of the
+ * reader thread.
+ */
+axlPointer __myqtt_tls_handshake_worker (axlPointer _ctx)
+{
+	MyQttCtx    * ctx     = _ctx;
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+	MyQttConn   * conn;
+	int           result;
+	int           rounds;
+
+	while (axl_true) {
+		/* get next connection */
+		myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+		while (axl_list_length (tls_ctx->handshake_queue) == 0 && ! tls_ctx->handshake_exit)
+			MYQTT_COND_WAIT (&tls_ctx->handshake_cond, &tls_ctx->handshake_mutex);
+		if (tls_ctx->handshake_exit) {
+			myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+			break;
+		} /* end if */
+		conn = axl_list_get_first (tls_ctx->handshake_queue);
+		axl_list_unlink_first (tls_ctx->handshake_queue);
+		tls_ctx->handshake_running++;
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+		/* run handshake, waiting a bit for the peer when it
+		 * needs more data so a whole handshake doesn't cost a
+		 * reader round trip per flight */
+		result = -1;
+		rounds = 0;
+		while (myqtt_conn_is_ok (conn, axl_false)) {
+			result = __myqtt_tls_accept_step (ctx, conn);
+			if (result != 0 || rounds++ == MYQTT_TLS_HANDSHAKE_ROUNDS || tls_ctx->handshake_exit)
+				break;
+			if (! __myqtt_tls_handshake_wait (conn))
+				break;
+		} /* end while */
+
+		myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+		tls_ctx->handshake_running--;
+		if (result == 1)
+			tls_ctx->handshake_completed++;
+		else if (result == -1)
+			tls_ctx->handshake_failed++;
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+		/* return the connection to the reader (completed,
+		 * waiting for more data or closed): the flag is
+		 * cleared by the reader itself */
+		__myqtt_reader_unblock_connection (ctx, conn);
+		myqtt_conn_unref (conn, "tls handshake");
+	} /* end while */
+
+	return NULL;
+}
+
+/** 
+ * @internal Stops handshake workers (installed as ctx cleanup).
+ */
+void __myqtt_tls_handshake_pool_stop (axlPointer _ctx)
+{
+	MyQttCtx    * ctx     = _ctx;
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+	MyQttConn   * conn;
+	int           iterator;
+
+	if (tls_ctx == NULL)
+		return;
+
+	myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+	tls_ctx->handshake_exit = axl_true;
+	myqtt_cond_broadcast (&tls_ctx->handshake_cond);
+	myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+	for (iterator = 0; iterator < tls_ctx->handshake_workers; iterator++)
+		myqtt_thread_destroy (&tls_ctx->handshake_threads[iterator], axl_false);
+	axl_free (tls_ctx->handshake_threads);
+	tls_ctx->handshake_threads = NULL;
+	tls_ctx->handshake_workers = 0;
+
+	/* release connections still queued and the queue */
+	while (axl_list_length (tls_ctx->handshake_queue) > 0) {
+		conn = axl_list_get_first (tls_ctx->handshake_queue);
+		axl_list_unlink_first (tls_ctx->handshake_queue);
+		myqtt_conn_unref (conn, "tls handshake");
+	} /* end while */
+	axl_list_free (tls_ctx->handshake_queue);
+	tls_ctx->handshake_queue = NULL;
+
+	return;
+}
+
+/** 
+ * @internal Starts handshake workers. tls_ctx->handshake_mutex must
+ * be held.
+ */
+void __myqtt_tls_handshake_pool_start (MyQttCtx * ctx, MyQttTlsCtx * tls_ctx, int workers)
+{
+	int iterator;
+
+	tls_ctx->handshake_threads = axl_new (MyQttThread, workers);
+	for (iterator = 0; iterator < workers; iterator++) {
+		if (! myqtt_thread_create (&tls_ctx->handshake_threads[iterator], __myqtt_tls_handshake_worker, ctx, MYQTT_THREAD_CONF_END)) {
+			myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to start TLS handshake worker, running %d workers", iterator);
+			break;
+		} /* end if */
+	} /* end for */
+	tls_ctx->handshake_workers = iterator;
+
+	if (iterator > 0)
+		myqtt_ctx_install_cleanup (ctx, __myqtt_tls_handshake_pool_stop);
+	return;
+}
+
+/** 
+ * @internal Queues the pending handshake of the provided connection
+ * into the handshake pool (if enabled with \ref
+ * myqtt_tls_set_handshake_pool). While queued or running, the
+ * connection is not watched by the reader.
+ *
+ * @return axl_true if the connection was queued (or closed because
+ * too many handshakes are pending), axl_false if the handshake must
+ * be done by the caller.
+ */
+axl_bool __myqtt_tls_handshake_queue (MyQttCtx * ctx, MyQttConn * conn)
+{
+	MyQttTlsCtx * tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+	if (tls_ctx == NULL || myqtt_is_exiting (ctx))
+		return axl_false;
+
+	myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+	if (tls_ctx->handshake_workers == 0 || tls_ctx->handshake_exit) {
+		/* pool disabled */
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+		return axl_false;
+	} /* end if */
+
+	if ((axl_list_length (tls_ctx->handshake_queue) + tls_ctx->handshake_running) >= tls_ctx->handshake_max) {
+		/* too many handshakes in progress, drop this one */
+		tls_ctx->handshake_rejected++;
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+		myqtt_log (MYQTT_LEVEL_WARNING, "Too many TLS handshakes in progress (max %d), closing conn-id=%d from %s:%s",
+			   tls_ctx->handshake_max, conn->id, conn->host, conn->port);
+		myqtt_conn_shutdown (conn);
+		return axl_true;
+	} /* end if */
+
+	if (! myqtt_conn_ref (conn, "tls handshake")) {
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+		return axl_true;
+	} /* end if */
+
+	/* stop watching this connection until the worker is done
+	 * with it (we are in the reader thread) */
+	conn->is_blocked = axl_true;
+	axl_list_append (tls_ctx->handshake_queue, conn);
+	myqtt_cond_signal (&tls_ctx->handshake_cond);
+	myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @brief Configures the pool of threads used to run server side TLS
+ * handshakes.
+ *
+ * By default, server side handshakes are run on the reader thread.
+ * Enabling the pool moves handshake cost (signatures, key exchange)
+ * to a dedicated set of workers. Connections are returned to the
+ * reader once their handshake completes (or when the peer is slow to
+ * send the next flight).
+ *
+ * This function must be called before accepting any TLS connection
+ * and can only be called once.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param workers Number of workers (-1 to use one per core, 0 to keep
+ * running handshakes on the reader thread).
+ *
+ * @param max_handshakes Max number of handshakes queued or running
+ * (-1 to use default value: 1024). New connections beyond this limit
+ * are closed.
+ *
+ * @return axl_true if the pool was configured, otherwise axl_false.
+ */
+axl_bool           myqtt_tls_set_handshake_pool          (MyQttCtx   * ctx,
+							  int          workers,
+							  int          max_handshakes)
+{
+	MyQttTlsCtx * tls_ctx;
+
+	if (ctx == NULL || ! myqtt_tls_init (ctx))
+		return axl_false;
+	tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+	myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+	if (tls_ctx->handshake_configured) {
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "TLS handshake pool already started, unable to reconfigure it");
+		return axl_false;
+	} /* end if */
+
+	tls_ctx->handshake_configured = axl_true;
+	tls_ctx->handshake_max        = max_handshakes > 0 ? max_handshakes : MYQTT_TLS_HANDSHAKE_MAX;
+	if (workers < 0) {
+#if defined(_SC_NPROCESSORS_ONLN)
+		workers = sysconf (_SC_NPROCESSORS_ONLN);
+#else
+		workers = 2;
+#endif
+		if (workers <= 0)
+			workers = 1;
+	} /* end if */
+	if (workers > 0)
+		__myqtt_tls_handshake_pool_start (ctx, tls_ctx, workers);
+	myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+
+	return axl_true;
+}
+
+/** 
+ * @brief Reports status of the TLS handshake pool (see \ref
+ * myqtt_tls_set_handshake_pool). All references are optional.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param queued Handshakes waiting for a worker (queue depth).
+ *
+ * @param running Handshakes being run by workers.
+ *
+ * @param completed Handshakes completed by the pool.
+ *
+ * @param failed Handshakes failed.
+ *
+ * @param rejected Connections closed because too many handshakes
+ * were in progress.
+ */
+void               myqtt_tls_handshake_stats             (MyQttCtx   * ctx,
+							  int        * queued,
+							  int        * running,
+							  long       * completed,
+							  long       * failed,
+							  long       * rejected)
+{
+	MyQttTlsCtx * tls_ctx = ctx ? myqtt_ctx_get_data (ctx, TLS_CTX) : NULL;
+
+	if (tls_ctx)
+		myqtt_mutex_lock (&tls_ctx->handshake_mutex);
+	if (queued)
+		(*queued)    = (tls_ctx && tls_ctx->handshake_queue) ? axl_list_length (tls_ctx->handshake_queue) : 0;
+	if (running)
+		(*running)   = tls_ctx ? tls_ctx->handshake_running : 0;
+	if (completed)
+		(*completed) = tls_ctx ? tls_ctx->handshake_completed : 0;
+	if (failed)
+		(*failed)    = tls_ctx ? tls_ctx->handshake_failed : 0;
+	if (rejected)
+		(*rejected)  = tls_ctx ? tls_ctx->handshake_rejected : 0;
+	if (tls_ctx)
+		myqtt_mutex_unlock (&tls_ctx->handshake_mutex);
+	return;
+}
+
+/** 
+ * @internal Function that prepares the TLS/SSL negotiation for every
+ * incoming connection accepted.
+ */
+void __myqtt_tls_accept_connection (MyQttCtx * ctx, MyQttConn * listener, MyQttConn * conn, MyQttConnOpts * opts, axlPointer user_data)
+{
+	const char * certificateFile  = NULL;
+	const char * privateKey       = NULL;
+	const char * chainCertificate = NULL;
+	const char * caCertificate    = NULL;
+
+	/* init ssl ciphers and engines */
+	if (! myqtt_tls_init (ctx)) {
+		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to accept TLS connection, myqtt_tls_init () failed");
+		return;
+	} /* end if */
+
+	if (conn->pending_ssl_accept) {
+		/* SSL already configured but pending to fully accept
+		   connection by doing the entire handshake: run it in
+		   the handshake pool if enabled */
+		if (__myqtt_tls_handshake_queue (ctx, conn))
+			return;
+		__myqtt_tls_accept_step (ctx, conn);
+		return;
+	}
+
+	/* overwrite connection options with listener's options: very TLS especific */
+	if (listener->opts)
+		opts = listener->opts;
+	
+	/* 1) GET FROM OPTIONS: detect here if we have certificates provided through options */
+	myqtt_log (MYQTT_LEVEL_DEBUG, "Starting TLS process, options=%p, listener=%p", opts, listener);
+	
+	if (opts) {
+		certificateFile = opts->certificate;
+		privateKey      = opts->private_key;
+	} /* end if */
+
+	if (certificateFile == NULL || privateKey == NULL) {
+		
+		/* 2) GET FROM LISTENER: get references to currently configured certificate file */
+		certificateFile = listener->certificate;
+		privateKey      = listener->private_key;
+		if (certificateFile == NULL || privateKey == NULL) {
+			/* 3) GET FROM STORE: check if the
+			 * certificate is already installed */
+			/* find a certicate according to the user name
+			   used or remote IP  */
+		}
+	} /* end if */
+	
+	/* check certificates and private key */
 	if (certificateFile == NULL || privateKey == NULL) {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "Unable to accept secure connection, certificate file %s and/or key file %s isn't defined",
 			    certificateFile ? certificateFile : "<not defined>", 
@@ -1303,6 +2555,10 @@ void __myqtt_tls_accept_connection (MyQttCtx * ctx, MyQttConn * listener, MyQttC
 	} /* end if */
 	myqtt_conn_set_data_full (conn, "__my:co:ssl-ctx", conn->ssl_ctx, NULL, (axlDestroyFunc) SSL_CTX_free);
 
+	/* configure session resumption */
+	__myqtt_tls_prepare_sessions (ctx, conn->ssl_ctx, conn, NULL);
+	__myqtt_tls_prepare_ktls (ctx, conn->ssl_ctx);
+
 	/* configure SNI callback */
 	SSL_CTX_set_tlsext_servername_callback (conn->ssl_ctx, __myqtt_tls_server_sni_callback);	
 	SSL_CTX_set_tlsext_servername_arg      (conn->ssl_ctx, conn); 
@@ -1536,6 +2792,61 @@ axl_bool           myqtt_tls_is_on                      (MyQttConn            *
 	return conn->tls_on;
 }
 
+/** 
+ * @brief Enables kernel TLS (kTLS) for connections created or
+ * accepted after this call (opt-in, disabled by default).
+ *
+ * Once the handshake completes, if the kernel supports the cipher
+ * negotiated, records are encrypted by the kernel and content is sent
+ * with plain socket writes (still through the connection sequencer,
+ * like any other content). Otherwise, the connection keeps working
+ * through OpenSSL. Use \ref myqtt_tls_is_ktls_on to check if it was
+ * activated on a connection.
+ *
+ * Requires Linux and OpenSSL 3 built with kTLS support.
+ *
+ * @param ctx The context where the operation takes place.
+ *
+ * @param enable axl_true to enable kTLS, axl_false to disable it.
+ *
+ * @return axl_true if the setting was applied, axl_false if kTLS is
+ * not supported by this build.
+ */
+axl_bool           myqtt_tls_set_ktls                    (MyQttCtx   * ctx,
+							  axl_bool     enable)
+{
+	MyQttTlsCtx * tls_ctx;
+
+	if (ctx == NULL || ! myqtt_tls_init (ctx))
+		return axl_false;
+	tls_ctx = myqtt_ctx_get_data (ctx, TLS_CTX);
+
+#if defined(MYQTT_TLS_KTLS_SUPPORT)
+	tls_ctx->ktls = enable;
+	return axl_true;
+#else
+	tls_ctx->ktls = axl_false;
+	if (enable)
+		myqtt_log (MYQTT_LEVEL_WARNING, "Unable to enable kTLS, not supported by this build");
+	return ! enable;
+#endif
+}
+
+/** 
+ * @brief Allows to check if records sent on the provided connection
+ * are encrypted by the kernel (see \ref myqtt_tls_set_ktls).
+ *
+ * @param conn The connection to check.
+ *
+ * @return axl_true if kTLS is active, otherwise axl_false.
+ */
+axl_bool           myqtt_tls_is_ktls_on                  (MyQttConn  * conn)
+{
+	if (conn == NULL)
+		return axl_false;
+	return PTR_TO_INT (myqtt_conn_get_data (conn, "tls:ktls"));
+}
+
 /** 
  * @brief Allows to configure a function that will be executed at the
  * end of the TLS process, before returning the connection to the
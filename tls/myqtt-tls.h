@@ -377,6 +377,36 @@ void              myqtt_tls_listener_set_certificate_handlers (MyQttCtx
 							       MyQttTlsChainCertificateFileLocator   chain_handler,
 							       axlPointer                            user_data);
 
+void               myqtt_tls_sni_cache_flush             (MyQttCtx * ctx);
+
+axl_bool           myqtt_tls_set_session_cache           (MyQttCtx   * ctx,
+							  const char * path,
+							  int          timeout);
+
+axl_bool           myqtt_tls_set_session_tickets         (MyQttCtx   * ctx,
+							  const char * key_file,
+							  int          rotation);
+
+void               myqtt_tls_session_stats               (MyQttCtx   * ctx,
+							  long       * resumed,
+							  long       * full);
+
+axl_bool           myqtt_tls_set_handshake_pool          (MyQttCtx   * ctx,
+							  int          workers,
+							  int          max_handshakes);
+
+void               myqtt_tls_handshake_stats             (MyQttCtx   * ctx,
+							  int        * queued,
+							  int        * running,
+							  long       * completed,
+							  long       * failed,
+							  long       * rejected);
+
+axl_bool           myqtt_tls_set_ktls                    (MyQttCtx   * ctx,
+							  axl_bool     enable);
+
+axl_bool           myqtt_tls_is_ktls_on                  (MyQttConn  * conn);
+
 void               myqtt_tls_opts_ssl_peer_verify        (MyQttConnOpts * opts, axl_bool verify);
 
 axl_bool           myqtt_tls_opts_set_ssl_certs          (MyQttConnOpts * opts, 
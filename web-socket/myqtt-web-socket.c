@@ -41,6 +41,34 @@
 #include <myqtt-listener-private.h>
 #include <myqtt-ctx-private.h>
 
+/** 
+ * @internal Size of the read buffer installed on WebSocket
+ * connections so each frame is pulled at once from noPoll and the
+ * small header reads are served from memory.
+ */
+#define MYQTT_WEB_SOCKET_READ_BUFFER 16384
+
+/** 
+ * @internal Frame handed to noPoll that still has bytes pending to
+ * be written. The send operation that queued it (identified by its
+ * token) is reported to retry (-2) until noPoll completes it.
+ */
+typedef struct _MyQttWebSocketSend {
+	/* token of the send operation owning the pending frame (0 if
+	 * none, MYQTT_WEB_SOCKET_NO_OWNER if queued by a tokenless
+	 * send) */
+	int                   token;
+	/* tokens whose frames were completed by another send
+	 * operation and still have to be reported to their owners */
+	axlList             * completed;
+} MyQttWebSocketSend;
+
+/** 
+ * @internal Owner of a pending frame queued by a tokenless send: it
+ * is completed by the next send operation and never reported.
+ */
+#define MYQTT_WEB_SOCKET_NO_OWNER -1
+
 /** 
  * \defgroup myqtt_websocket MyQtt WebSocket: support functions to create MQTT over WebSocket connections and listeners
  *
@@ -127,6 +155,19 @@
  * } 
  * 
  * \endcode
+ *
+ * \section myqtt_websocket_compression WebSocket compression (permessage-deflate)
+ *
+ * RFC 7692 permessage-deflate is not available for MQTT over
+ * WebSocket connections. The opening handshake, frame parsing and
+ * frame headers are handled by noPoll, which neither reports the
+ * Sec-WebSocket-Extensions offered by the client (so the extension
+ * cannot be negotiated) nor exposes the RSV1 bit that flags a
+ * compressed message (so compressed and plain messages cannot be
+ * told apart). Adding it requires extension support in noPoll
+ * first: once there, deflate/inflate would be done on each binary
+ * frame at __myqtt_web_socket_send / __myqtt_web_socket_receive,
+ * which already carry one whole MQTT packet per frame.
  * 
  */
 
@@ -211,39 +252,152 @@ int __myqtt_web_socket_receive (MyQttConn     * conn,
 	return result;
 }
 
+/** 
+ * @internal Removes the token from the completed list, reporting if
+ * it was found.
+ */
+axl_bool __myqtt_web_socket_take_completed (MyQttWebSocketSend * in_flight, int token)
+{
+	int iterator = 0;
+
+	while (iterator < axl_list_length (in_flight->completed)) {
+		if (PTR_TO_INT (axl_list_get_nth (in_flight->completed, iterator)) == token) {
+			axl_list_remove_at (in_flight->completed, iterator);
+			return axl_true;
+		} /* end if */
+		iterator++;
+	} /* end while */
+
+	return axl_false;
+}
+
 /** 
  * @internal Function used to send content from the associated
- * websocket connection
+ * websocket connection. Each send operation is sent as a single
+ * binary frame without waiting for it to be flushed: bytes that
+ * cannot be written are kept by noPoll as pending writes and -2 is
+ * returned so the caller retries later (with the same token) without
+ * holding ws:mutex. Until that frame is completed, no other frame is
+ * started.
  */
-int __myqtt_web_socket_send (MyQttConn            * conn,
-			     const unsigned char  * buffer,
-			     int                    buffer_len)
+int __myqtt_web_socket_send_token (MyQttConn            * conn,
+				   int                    token,
+				   const unsigned char  * buffer,
+				   int                    buffer_len)
 {
-	noPollConn  * _conn = myqtt_conn_get_data (conn, "__my:ws:conn");
-	MyQttCtx    * ctx;
-	MyQttMutex  * mutex;
-	int           result;
+	noPollConn         * _conn = myqtt_conn_get_data (conn, "__my:ws:conn");
+	MyQttCtx           * ctx;
+	MyQttMutex         * mutex;
+	MyQttWebSocketSend * in_flight;
+	int                  result;
 
 	/* get a reference to the context */
 	ctx = conn->ctx;
 
 	/* get mutex */
-	mutex = myqtt_conn_get_data (conn, "ws:mutex");
-	if (mutex == NULL) {
+	mutex     = myqtt_conn_get_data (conn, "ws:mutex");
+	in_flight = myqtt_conn_get_data (conn, "ws:send");
+	if (mutex == NULL || in_flight == NULL) {
 		myqtt_log (MYQTT_LEVEL_CRITICAL, "unable to find mutex to protect noPoll WebSocket object to read data");
 		return -1;
 	} /* end if */
 
 	/* acquire lock, operate and release */
 	myqtt_mutex_lock (mutex);
-	result = nopoll_conn_send_text (_conn, (const char *) buffer, buffer_len);
 
-	/* ensure we have written all bytes but limit operation to 2 seconds */
-	result = nopoll_conn_flush_writes (_conn, 2000000, result);
+	/* complete previous frame before sending a new one */
+	if (in_flight->token) {
+		if (nopoll_conn_pending_write_bytes (_conn) > 0)
+			nopoll_conn_complete_pending_write (_conn);
+
+		if (nopoll_conn_pending_write_bytes (_conn) > 0) {
+			myqtt_mutex_unlock (mutex);
+			if (! nopoll_conn_is_ok (_conn))
+				return -1;
+
+			/* still not writable */
+			errno = MYQTT_EWOULDBLOCK;
+			return -2;
+		} /* end if */
+
+		/* frame completed, report it if this is the retry
+		 * of the send operation that queued it */
+		if (in_flight->token == token) {
+			in_flight->token = 0;
+			myqtt_mutex_unlock (mutex);
+			return buffer_len;
+		} /* end if */
 
+		/* keep it to be reported to its owner (if any) */
+		if (in_flight->token != MYQTT_WEB_SOCKET_NO_OWNER)
+			axl_list_append (in_flight->completed, INT_TO_PTR (in_flight->token));
+		in_flight->token = 0;
+	} /* end if */
+
+	/* frame completed by another send operation */
+	if (__myqtt_web_socket_take_completed (in_flight, token)) {
+		myqtt_mutex_unlock (mutex);
+		return buffer_len;
+	} /* end if */
+
+	/* send the whole content on a single binary frame */
+	result = nopoll_conn_send_binary (_conn, (const char *) buffer, buffer_len);
+
+	/* check if noPoll kept part of the frame to be written later */
+	if (nopoll_conn_pending_write_bytes (_conn) > 0 && token == 0) {
+		/* tokenless send: nobody retries it, so the frame is
+		 * reported as sent. Wait a bit for it (as previous
+		 * versions did) and, if still pending, let the next
+		 * send operation complete it */
+		nopoll_conn_flush_writes (_conn, 2000000, result);
+		if (nopoll_conn_pending_write_bytes (_conn) > 0)
+			in_flight->token = MYQTT_WEB_SOCKET_NO_OWNER;
+		myqtt_mutex_unlock (mutex);
+		return buffer_len;
+	} /* end if */
+	if (nopoll_conn_pending_write_bytes (_conn) > 0) {
+		in_flight->token = token;
+		myqtt_mutex_unlock (mutex);
+
+		errno = MYQTT_EWOULDBLOCK;
+		return -2;
+	} /* end if */
 	myqtt_mutex_unlock (mutex);
 
-	return result;
+	if (result < 0) {
+		if (! nopoll_conn_is_ok (_conn))
+			return -1;
+
+		/* nothing was written, retry later */
+		errno = MYQTT_EWOULDBLOCK;
+		return -2;
+	} /* end if */
+
+	return buffer_len;
+}
+
+/** 
+ * @internal Send handler used when no token is available (direct
+ * myqtt_conn_invoke_send calls). No token is recorded for these
+ * calls: -2 is only returned before writing anything (a frame from
+ * another operation is still pending), so retrying never sends the
+ * content twice.
+ */
+int __myqtt_web_socket_send (MyQttConn            * conn,
+			     const unsigned char  * buffer,
+			     int                    buffer_len)
+{
+	return __myqtt_web_socket_send_token (conn, 0, buffer, buffer_len);
+}
+
+/** 
+ * @internal Releases the in flight frame state.
+ */
+void __myqtt_web_socket_free_send (MyQttWebSocketSend * in_flight)
+{
+	axl_list_free (in_flight->completed);
+	axl_free (in_flight);
+	return;
 }
 
 void __myqtt_web_socket_nopoll_on_close (noPollCtx * _ctx, noPollConn * conn, noPollPtr ptr)
@@ -278,21 +432,31 @@ void __myqtt_web_socket_close_conn (noPollConn * conn)
 
 void __myqtt_web_socket_common_association (MyQttConn * conn, noPollConn * nopoll_conn)
 {
-	MyQttMutex * mutex;
+	MyQttMutex         * mutex;
+	MyQttWebSocketSend * in_flight;
 
 	/* associate connection */
 	myqtt_conn_set_data_full (conn, "__my:ws:conn", nopoll_conn, 
 				  NULL, (axlDestroyFunc) __myqtt_web_socket_close_conn);
 
 	/* configure default handlers */
-	conn->receive = __myqtt_web_socket_receive;
-	conn->send    = __myqtt_web_socket_send;
+	conn->receive    = __myqtt_web_socket_receive;
+	conn->send       = __myqtt_web_socket_send;
+	conn->send_token = __myqtt_web_socket_send_token;
+	myqtt_conn_set_read_buffer (conn, MYQTT_WEB_SOCKET_READ_BUFFER);
 
 	/* setup I/O handlers */
 	mutex = axl_new (MyQttMutex, 1);
 	myqtt_mutex_create (mutex);
 	myqtt_conn_set_data_full (conn, "ws:mutex", mutex,
 				  NULL, (axlDestroyFunc) __myqtt_web_socket_free_mutex);
+	in_flight            = axl_new (MyQttWebSocketSend, 1);
+	in_flight->completed = axl_list_new (axl_list_always_return_1, NULL);
+	myqtt_conn_set_data_full (conn, "ws:send", in_flight,
+				  NULL, (axlDestroyFunc) __myqtt_web_socket_free_send);
+
+	/* one binary frame per MQTT packet */
+	conn->send_whole_msg = axl_true;
 
 	/* setup on close handler to control sockets */
 	nopoll_conn_set_on_close (nopoll_conn, __myqtt_web_socket_nopoll_on_close, conn);